@@ -0,0 +1,269 @@
+#include "attributes.hpp"
+#include <array>
+
+#include "classFileBuffer.hpp"
+
+
+constexpr static auto
+attributeNames = std::to_array<std::string_view>({
+    "",
+    "ConstantValue",
+    "Code",
+    "StackMapTable",
+    "Exceptions",
+    "InnerClasses",
+    "EnclosingMethod",
+    "Synthetic",
+    "Signature",
+    "SourceFile",
+    "SourceDebugExtension",
+    "LineNumberTable",
+    "LocalVariableTable",
+    "LocalVariableTypeTable",
+    "Deprecated",
+    "RuntimeVisibleAnnotations",
+    "RuntimeInvisibleAnnotations",
+    "RuntimeVisibleParameterAnnotations",
+    "RuntimeInvisibleParameterAnnotations",
+    "RuntimeVisibleTypeAnnotations",
+    "RuntimeInvisibleTypeAnnotations",
+    "AnnotationDefault",
+    "BootstrapMethods",
+    "MethodParameters",
+    "Module",
+    "ModulePackages",
+    "ModuleMainClass",
+    "NestHost",
+    "NestMembers",
+    "Record",
+    "PermittedSubclasses"
+});
+
+static_assert(attributeNames.size() == (size_t)AttributeKind::Count);
+
+
+AttributeKind
+attributeKindFromName(std::string_view name) {
+    for (size_t kind = 1; kind < attributeNames.size(); kind++) {
+        if (attributeNames[kind] == name) {
+            return (AttributeKind)kind;
+        }
+    }
+    return AttributeKind::Unknown;
+}
+
+
+std::string_view
+attributeKindName(AttributeKind kind) {
+    return ((size_t)kind < attributeNames.size()) ? attributeNames[(size_t)kind] : std::string_view{};
+}
+
+
+static inline uint16_t
+readU2(const uint8_t *bytes) {
+    return (uint16_t)((bytes[0] << 8) | bytes[1]);
+}
+
+
+RawAttributeList::Entry
+RawAttributeList::Iterator::operator*() const {
+    size_t ptr = 2;
+    auto length = getValueFromClassFileBuffer<uint32_t>(m_rest, ptr);
+    return { readU2(m_rest.data()), m_rest.subspan(6, length) };
+}
+
+
+RawAttributeList::Iterator &
+RawAttributeList::Iterator::operator++() {
+    size_t ptr = 2;
+    auto length = getValueFromClassFileBuffer<uint32_t>(m_rest, ptr);
+    m_rest = m_rest.subspan(6 + length);
+    m_left--;
+    return *this;
+}
+
+
+/*
+ * Checks that count attribute_info entries fit in bytes exactly as far as
+ * they go and returns how many bytes they take, or nullopt
+ */
+static std::optional<size_t>
+rawAttributesSize(std::span<const uint8_t> bytes, uint16_t count) {
+    size_t ptr = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        if (!bufferReadNBytesCorrect(bytes, ptr, 6)) {
+            return std::nullopt;
+        }
+        ptr += 2;
+        auto length = getValueFromClassFileBuffer<uint32_t>(bytes, ptr);
+        if (!bufferReadNBytesCorrect(bytes, ptr, length)) {
+            return std::nullopt;
+        }
+        ptr += length;
+    }
+    return ptr;
+}
+
+
+ExceptionTableEntry
+CodeAttribute::exceptionTableEntry(size_t i) const {
+    const uint8_t *entry = exceptionTableBytes.data() + i * 8;
+    return { readU2(entry), readU2(entry + 2), readU2(entry + 4), readU2(entry + 6) };
+}
+
+
+LineNumberEntry
+decodeLineNumberEntry(const uint8_t *bytes) {
+    return { readU2(bytes), readU2(bytes + 2) };
+}
+
+
+LocalVariableEntry
+decodeLocalVariableEntry(const uint8_t *bytes) {
+    return { readU2(bytes), readU2(bytes + 2), readU2(bytes + 4), readU2(bytes + 6), readU2(bytes + 8) };
+}
+
+
+uint16_t
+decodeU2Entry(const uint8_t *bytes) {
+    return readU2(bytes);
+}
+
+
+std::optional<CodeAttribute>
+decodeCodeAttribute(std::span<const uint8_t> info) {
+    size_t ptr = 0;
+    if (!bufferReadNBytesCorrect(info, ptr, 8)) {
+        return std::nullopt;
+    }
+
+    CodeAttribute code{};
+    code.maxStack = getValueFromClassFileBuffer<uint16_t>(info, ptr);
+    code.maxLocals = getValueFromClassFileBuffer<uint16_t>(info, ptr);
+    auto codeLength = getValueFromClassFileBuffer<uint32_t>(info, ptr);
+    if (!bufferReadNBytesCorrect(info, ptr, (size_t)codeLength + 2)) {
+        return std::nullopt;
+    }
+    code.code = info.subspan(ptr, codeLength);
+    ptr += codeLength;
+
+    code.exceptionTableLength = getValueFromClassFileBuffer<uint16_t>(info, ptr);
+    if (!bufferReadNBytesCorrect(info, ptr, (size_t)code.exceptionTableLength * 8 + 2)) {
+        return std::nullopt;
+    }
+    code.exceptionTableBytes = info.subspan(ptr, (size_t)code.exceptionTableLength * 8);
+    ptr += code.exceptionTableBytes.size();
+
+    auto attributesCount = getValueFromClassFileBuffer<uint16_t>(info, ptr);
+    auto rest = info.subspan(ptr);
+    auto attributesSize = rawAttributesSize(rest, attributesCount);
+    if (!attributesSize || (*attributesSize != rest.size())) {
+        return std::nullopt;
+    }
+    code.attributes = RawAttributeList(rest, attributesCount);
+
+    return code;
+}
+
+
+// u2 count followed by exactly count entries of entrySize bytes
+static std::optional<std::span<const uint8_t>>
+countedEntries(std::span<const uint8_t> info, size_t entrySize) {
+    if (info.size() < 2) {
+        return std::nullopt;
+    }
+    size_t count = readU2(info.data());
+    if (info.size() != 2 + count * entrySize) {
+        return std::nullopt;
+    }
+    return info.subspan(2);
+}
+
+
+std::optional<LineNumberTableView>
+decodeLineNumberTable(std::span<const uint8_t> info) {
+    auto entries = countedEntries(info, 4);
+    if (!entries) {
+        return std::nullopt;
+    }
+    return LineNumberTableView(*entries);
+}
+
+
+std::optional<LocalVariableTableView>
+decodeLocalVariableTable(std::span<const uint8_t> info) {
+    auto entries = countedEntries(info, 10);
+    if (!entries) {
+        return std::nullopt;
+    }
+    return LocalVariableTableView(*entries);
+}
+
+
+std::optional<StackMapTableAttribute>
+decodeStackMapTable(std::span<const uint8_t> info) {
+    if (info.size() < 2) {
+        return std::nullopt;
+    }
+    return StackMapTableAttribute{ readU2(info.data()), info.subspan(2) };
+}
+
+
+std::optional<U2ListView>
+decodeU2ListAttribute(std::span<const uint8_t> info) {
+    auto entries = countedEntries(info, 2);
+    if (!entries) {
+        return std::nullopt;
+    }
+    return U2ListView(*entries);
+}
+
+
+std::optional<uint16_t>
+decodeIndexAttribute(std::span<const uint8_t> info) {
+    if (info.size() != 2) {
+        return std::nullopt;
+    }
+    return readU2(info.data());
+}
+
+
+std::optional<BootstrapMethodsView>
+decodeBootstrapMethods(std::span<const uint8_t> info) {
+    if (info.size() < 2) {
+        return std::nullopt;
+    }
+    auto count = readU2(info.data());
+
+    // validate the whole layout once so at() can walk without bounds checks
+    size_t ptr = 2;
+    for (uint16_t i = 0; i < count; i++) {
+        if (!bufferReadNBytesCorrect(info, ptr, 4)) {
+            return std::nullopt;
+        }
+        size_t argc = readU2(info.data() + ptr + 2);
+        ptr += 4;
+        if (!bufferReadNBytesCorrect(info, ptr, argc * 2)) {
+            return std::nullopt;
+        }
+        ptr += argc * 2;
+    }
+    if (ptr != info.size()) {
+        return std::nullopt;
+    }
+    return BootstrapMethodsView(info.subspan(2), count);
+}
+
+
+std::optional<BootstrapMethod>
+BootstrapMethodsView::at(size_t i) const {
+    if (i >= m_count) {
+        return std::nullopt;
+    }
+    size_t ptr = 0;
+    for (size_t skip = 0; skip < i; skip++) {
+        ptr += 4 + (size_t)readU2(m_bytes.data() + ptr + 2) * 2;
+    }
+    size_t argc = readU2(m_bytes.data() + ptr + 2);
+    return BootstrapMethod{ readU2(m_bytes.data() + ptr), U2ListView(m_bytes.subspan(ptr + 4, argc * 2)) };
+}
@@ -0,0 +1,238 @@
+#ifndef SJBCDC_ATTRIBUTES_HPP
+#define SJBCDC_ATTRIBUTES_HPP
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+// attributes of JVMS 4.7 known by name; everything else is Unknown
+enum class AttributeKind : uint8_t {
+    Unknown,
+    ConstantValue,
+    Code,
+    StackMapTable,
+    Exceptions,
+    InnerClasses,
+    EnclosingMethod,
+    Synthetic,
+    Signature,
+    SourceFile,
+    SourceDebugExtension,
+    LineNumberTable,
+    LocalVariableTable,
+    LocalVariableTypeTable,
+    Deprecated,
+    RuntimeVisibleAnnotations,
+    RuntimeInvisibleAnnotations,
+    RuntimeVisibleParameterAnnotations,
+    RuntimeInvisibleParameterAnnotations,
+    RuntimeVisibleTypeAnnotations,
+    RuntimeInvisibleTypeAnnotations,
+    AnnotationDefault,
+    BootstrapMethods,
+    MethodParameters,
+    Module,
+    ModulePackages,
+    ModuleMainClass,
+    NestHost,
+    NestMembers,
+    Record,
+    PermittedSubclasses,
+    Count
+};
+
+using AttributeMask = uint64_t;
+
+constexpr AttributeMask
+attributeBit(AttributeKind kind) { return 1ull << (uint8_t)kind; }
+
+constexpr AttributeMask AllAttributes = ~0ull;
+constexpr AttributeMask NoAttributes = 0;
+
+AttributeKind
+attributeKindFromName(std::string_view name);
+
+std::string_view
+attributeKindName(AttributeKind kind);
+
+/*
+ * attribute_info located in the class bytes; the info bytes are not read
+ * until one of the decoders below is asked for them
+ */
+struct AttributeInfo {
+    uint16_t nameIndex;
+    AttributeKind kind;
+    uint32_t offset;    // of info[0] in the class buffer
+    uint32_t length;
+};
+
+
+// attribute_info entries packed back to back, as inside Code or Record
+class RawAttributeList {
+private:
+    std::span<const uint8_t> m_bytes;
+    uint16_t m_count = 0;
+
+public:
+    struct Entry {
+        uint16_t nameIndex;
+        std::span<const uint8_t> info;
+    };
+
+    class Iterator {
+    private:
+        std::span<const uint8_t> m_rest;
+        uint16_t m_left;
+
+    public:
+        Iterator(std::span<const uint8_t> rest, uint16_t left) : m_rest(rest), m_left(left) {}
+
+        Entry
+        operator*() const;
+
+        Iterator &
+        operator++();
+
+        bool
+        operator==(const Iterator &other) const { return m_left == other.m_left; }
+    };
+
+    RawAttributeList() = default;
+    RawAttributeList(std::span<const uint8_t> bytes, uint16_t count) : m_bytes(bytes), m_count(count) {}
+
+    uint16_t
+    size() const { return m_count; }
+
+    Iterator
+    begin() const { return { m_bytes, m_count }; }
+
+    Iterator
+    end() const { return { {}, 0 }; }
+};
+
+
+struct ExceptionTableEntry {
+    uint16_t startPc;
+    uint16_t endPc;
+    uint16_t handlerPc;
+    uint16_t catchType;
+};
+
+struct CodeAttribute {
+    uint16_t maxStack;
+    uint16_t maxLocals;
+    std::span<const uint8_t> code;
+    uint16_t exceptionTableLength;
+    std::span<const uint8_t> exceptionTableBytes;
+    RawAttributeList attributes;
+
+    ExceptionTableEntry
+    exceptionTableEntry(size_t i) const;
+};
+
+
+/*
+ * Fixed-size entry tables (u2 count followed by count entries) read straight
+ * from the attribute bytes
+ */
+template <typename Entry, size_t EntrySize, Entry (*Decode)(const uint8_t *)>
+class AttributeTableView {
+private:
+    std::span<const uint8_t> m_entries;
+
+public:
+    AttributeTableView() = default;
+    explicit AttributeTableView(std::span<const uint8_t> entries) : m_entries(entries) {}
+
+    size_t
+    size() const { return m_entries.size() / EntrySize; }
+
+    Entry
+    operator[](size_t i) const { return Decode(m_entries.data() + i * EntrySize); }
+};
+
+struct LineNumberEntry {
+    uint16_t startPc;
+    uint16_t lineNumber;
+};
+
+struct LocalVariableEntry {
+    uint16_t startPc;
+    uint16_t length;
+    uint16_t nameIndex;
+    uint16_t descriptorIndex;   // signatureIndex for LocalVariableTypeTable
+    uint16_t index;
+};
+
+LineNumberEntry
+decodeLineNumberEntry(const uint8_t *bytes);
+
+LocalVariableEntry
+decodeLocalVariableEntry(const uint8_t *bytes);
+
+uint16_t
+decodeU2Entry(const uint8_t *bytes);
+
+using LineNumberTableView = AttributeTableView<LineNumberEntry, 4, decodeLineNumberEntry>;
+using LocalVariableTableView = AttributeTableView<LocalVariableEntry, 10, decodeLocalVariableEntry>;
+using U2ListView = AttributeTableView<uint16_t, 2, decodeU2Entry>;
+
+struct StackMapTableAttribute {
+    uint16_t numberOfEntries;
+    std::span<const uint8_t> frames;   // undecoded stack_map_frame entries
+};
+
+struct BootstrapMethod {
+    uint16_t bootstrapMethodRef;
+    U2ListView arguments;
+};
+
+// BootstrapMethods entries are variable-sized, so they are walked in order
+class BootstrapMethodsView {
+private:
+    std::span<const uint8_t> m_bytes;
+    uint16_t m_count = 0;
+
+public:
+    BootstrapMethodsView() = default;
+    BootstrapMethodsView(std::span<const uint8_t> bytes, uint16_t count) : m_bytes(bytes), m_count(count) {}
+
+    uint16_t
+    size() const { return m_count; }
+
+    // nullopt when i is out of range
+    std::optional<BootstrapMethod>
+    at(size_t i) const;
+};
+
+
+/*
+ * Decoders for the info bytes of one attribute. All of them return views
+ * into info and nullopt when the bytes do not match the attribute layout.
+ */
+std::optional<CodeAttribute>
+decodeCodeAttribute(std::span<const uint8_t> info);
+
+std::optional<LineNumberTableView>
+decodeLineNumberTable(std::span<const uint8_t> info);
+
+// also decodes LocalVariableTypeTable, which shares the layout
+std::optional<LocalVariableTableView>
+decodeLocalVariableTable(std::span<const uint8_t> info);
+
+std::optional<StackMapTableAttribute>
+decodeStackMapTable(std::span<const uint8_t> info);
+
+// Exceptions, NestMembers, PermittedSubclasses, ModulePackages
+std::optional<U2ListView>
+decodeU2ListAttribute(std::span<const uint8_t> info);
+
+// ConstantValue, Signature, SourceFile, NestHost, ModuleMainClass
+std::optional<uint16_t>
+decodeIndexAttribute(std::span<const uint8_t> info);
+
+std::optional<BootstrapMethodsView>
+decodeBootstrapMethods(std::span<const uint8_t> info);
+
+#endif //SJBCDC_ATTRIBUTES_HPP
@@ -0,0 +1,189 @@
+#include "batchParse.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <optional>
+
+#include "threadPool.hpp"
+
+
+std::vector<std::filesystem::path>
+collectClassFiles(const std::filesystem::path &root) {
+    std::vector<std::filesystem::path> paths;
+    std::error_code ec;
+
+    if (std::filesystem::is_regular_file(root, ec)) {
+        paths.push_back(root);
+        return paths;
+    }
+
+    auto it = std::filesystem::recursive_directory_iterator(
+            root, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && (it != std::filesystem::recursive_directory_iterator()); it.increment(ec)) {
+        if (it->is_regular_file(ec) && (it->path().extension() == ".class")) {
+            paths.push_back(it->path());
+        }
+    }
+
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+
+std::vector<std::filesystem::path>
+readClassFileList(const std::filesystem::path &listFile) {
+    std::vector<std::filesystem::path> paths;
+    std::ifstream src(listFile);
+    std::string line;
+    while (std::getline(src, line)) {
+        if (!line.empty() && (line.back() == '\r')) {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            paths.emplace_back(line);
+        }
+    }
+    return paths;
+}
+
+
+std::string
+archiveEntryPath(const ZipArchive &archive, const ZipEntry &entry) {
+    return archive.path().string() + "!/" + entry.name;
+}
+
+
+std::string
+formatBatchResult(std::string_view name, const BatchParseResult &result) {
+    if (result.archiveError == ZipEntryError::UnsupportedMethod) {
+        return std::string(name) + ": " + std::string(zipEntryErrorMessage(result.archiveError)) + " " +
+               std::to_string(result.entry->method);
+    }
+    if (result.archiveError != ZipEntryError::None) {
+        return std::string(name) + ": " + std::string(zipEntryErrorMessage(result.archiveError));
+    }
+    return formatClassFileError(name, result.error);
+}
+
+
+static void
+parseLoadedClassFiles(const std::vector<std::filesystem::path> &paths, const BatchParseOptions &options,
+                      std::vector<BatchParseResult> &results) {
+    ClassFileLoaderOptions loaderOptions = options.loaderOptions;
+    if (loaderOptions.memoryResource == nullptr) {
+        loaderOptions.memoryResource = options.classFileOptions.memoryResource;
+    }
+    ClassFileLoader loader(loaderOptions);
+    WorkStealingPool pool(options.threads);
+
+    // emplaced rather than assigned, so each buffer keeps the loader's memory resource
+    std::vector<std::optional<std::pmr::vector<uint8_t>>> loaded(paths.size());
+    std::mutex mutex;
+    std::condition_variable parsed;
+    size_t unparsed = 0;
+    size_t maxUnparsed = std::max<size_t>(loaderOptions.maxInFlight, 1);
+
+    // blocking here until a worker catches up holds the loader back as well
+    loader.load(paths, [&](size_t i, std::pmr::vector<uint8_t> &&bytes, bool ok) {
+        {
+            std::unique_lock lock(mutex);
+            parsed.wait(lock, [&] { return unparsed < maxUnparsed; });
+            unparsed++;
+        }
+        loaded[i].emplace(std::move(bytes));
+        pool.submit([&, i, ok] {
+            auto &result = results[i];
+            ClassFile local;
+            ClassFile *clf = options.keepClassFiles ? (result.classFile = std::make_unique<ClassFile>()).get()
+                                                    : &local;
+            std::string pathStr = paths[i].string();
+            if (ok) {
+                clf->init(std::move(*loaded[i]), pathStr, options.classFileOptions);
+            } else {
+                clf->init(pathStr, options.classFileOptions);
+            }
+
+            result.parseError = clf->parseError();
+            result.error = clf->error();
+            loaded[i].reset();
+            {
+                std::lock_guard lock(mutex);
+                unparsed--;
+            }
+            parsed.notify_one();
+        });
+    });
+    pool.wait();
+}
+
+
+std::vector<BatchParseResult>
+parseClassFiles(const std::vector<std::filesystem::path> &paths, const BatchParseOptions &options) {
+    std::vector<BatchParseResult> results(paths.size());
+    if (options.asyncLoad) {
+        parseLoadedClassFiles(paths, options, results);
+        return results;
+    }
+    WorkStealingPool pool(options.threads);
+
+    // small chunks keep the tail short when a few classes are much bigger than the rest
+    size_t grain = std::clamp<size_t>(paths.size() / (pool.threadCount() * 16), 1, 64);
+    pool.parallelFor(paths.size(), grain, [&](size_t i) {
+        auto &result = results[i];
+        ClassFile local;
+        ClassFile *clf = options.keepClassFiles ? (result.classFile = std::make_unique<ClassFile>()).get() : &local;
+        std::string pathStr = paths[i].string();
+        clf->init(pathStr, options.classFileOptions);
+
+        result.parseError = clf->parseError();
+        result.error = clf->error();
+    });
+
+    return results;
+}
+
+
+std::vector<BatchParseResult>
+parseArchiveClasses(const ZipArchive &archive, const BatchParseOptions &options) {
+    std::vector<const ZipEntry *> classEntries;
+    for (auto &entry : archive.entries()) {
+        if (entry.name.ends_with(".class")) {
+            classEntries.push_back(&entry);
+        }
+    }
+
+    std::vector<BatchParseResult> results(classEntries.size());
+    WorkStealingPool pool(options.threads);
+    std::pmr::memory_resource *resource = options.classFileOptions.memoryResource
+                                          ? options.classFileOptions.memoryResource
+                                          : std::pmr::get_default_resource();
+
+    size_t grain = std::clamp<size_t>(classEntries.size() / (pool.threadCount() * 16), 1, 64);
+    pool.parallelFor(classEntries.size(), grain, [&](size_t i) {
+        auto &entry = *classEntries[i];
+        auto &result = results[i];
+        result.entry = &entry;
+
+        std::pmr::vector<uint8_t> inflated(resource);
+        auto bytes = archive.read(entry, inflated, result.archiveError);
+        if (result.archiveError != ZipEntryError::None) {
+            result.parseError = true;
+            return;
+        }
+
+        ClassFile local;
+        ClassFile *clf = options.keepClassFiles ? (result.classFile = std::make_unique<ClassFile>()).get() : &local;
+        std::string name = archiveEntryPath(archive, entry);
+        if (bytes.data() == inflated.data()) {
+            clf->init(std::move(inflated), name, options.classFileOptions);
+        } else {
+            clf->init(bytes, name, options.classFileOptions);
+        }
+
+        result.parseError = clf->parseError();
+        result.error = clf->error();
+    });
+
+    return results;
+}
@@ -0,0 +1,77 @@
+#ifndef SJBCDC_BATCHPARSE_HPP
+#define SJBCDC_BATCHPARSE_HPP
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "classFileLoader.hpp"
+#include "classFileRead.hpp"
+#include "zipArchive.hpp"
+
+struct BatchParseOptions {
+    /*
+     * Applied to every file. A memoryResource set here is shared by all
+     * workers and therefore has to be thread-safe
+     * (e.g. std::pmr::synchronized_pool_resource).
+     */
+    ClassFileOptions classFileOptions;
+    // 0 means one worker per hardware thread
+    size_t threads = 0;
+    // keep the parsed ClassFile in each result; otherwise only the outcome is kept
+    bool keepClassFiles = false;
+    /*
+     * parseClassFiles only: read the files ahead of the workers with a
+     * ClassFileLoader and parse them from the buffers it fills, at most
+     * loaderOptions.maxInFlight files read but not parsed yet. Only files
+     * the loader cannot read are opened by the worker as usual (with
+     * classFileOptions.loadMode), so their errors stay the same.
+     */
+    bool asyncLoad = false;
+    ClassFileLoaderOptions loaderOptions;
+};
+
+/*
+ * Outcome of one class. Results hold no text, so a run with many failures
+ * allocates nothing for them; formatBatchResult() builds the message.
+ */
+struct BatchParseResult {
+    bool parseError = false;
+    ClassFileError error;                   // ClassFile::error()
+    const ZipEntry *entry = nullptr;        // parseArchiveClasses only
+    ZipEntryError archiveError = ZipEntryError::None;  // the entry could not be read, error is unset
+    std::unique_ptr<ClassFile> classFile;   // only with keepClassFiles
+};
+
+// name of the class parsed: the path or "archive.jar!/pkg/Name.class"
+std::string
+archiveEntryPath(const ZipArchive &archive, const ZipEntry &entry);
+
+// what ClassFile::initResult() reported for it; name is the path or archiveEntryPath()
+std::string
+formatBatchResult(std::string_view name, const BatchParseResult &result);
+
+// every regular *.class file below root (or root itself when it is a file), sorted
+std::vector<std::filesystem::path>
+collectClassFiles(const std::filesystem::path &root);
+
+// one path per line, empty lines skipped
+std::vector<std::filesystem::path>
+readClassFileList(const std::filesystem::path &listFile);
+
+// results come back in the order of paths
+std::vector<BatchParseResult>
+parseClassFiles(const std::vector<std::filesystem::path> &paths, const BatchParseOptions &options = {});
+
+/*
+ * Parses every *.class entry of an opened archive straight from memory:
+ * stored entries are parsed in place from the mapping, deflated ones are
+ * inflated by the worker that parses them, named after archiveEntryPath().
+ * Results come back in the order of the archive entries. Kept ClassFiles of stored entries view the
+ * archive mapping, so the archive must outlive them.
+ */
+std::vector<BatchParseResult>
+parseArchiveClasses(const ZipArchive &archive, const BatchParseOptions &options = {});
+
+#endif //SJBCDC_BATCHPARSE_HPP
@@ -0,0 +1,285 @@
+/*
+ * Throughput of BytecodeIterator over a generated corpus of method bodies
+ * with a javac-like opcode mix (loads/stores, invokes, field access, branches,
+ * occasional wide and switch instructions), plus the methods of any class
+ * files given on the command line.
+ *
+ *   sJBcDcBytecodeBench [--mb N] [--seed N] [class files...]
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../bytecode.hpp"
+#include "../classFileRead.hpp"
+
+
+struct Method {
+    size_t offset;
+    size_t length;
+};
+
+
+class CorpusGenerator {
+private:
+    uint64_t m_state;
+    std::vector<uint8_t> &m_out;
+    size_t m_methodStart = 0;
+
+    uint32_t
+    random(uint32_t bound) {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return (uint32_t)(((m_state * 0x2545f4914f6cdd1dULL) >> 32) % bound);
+    }
+
+    void
+    u1(uint32_t value) { m_out.push_back((uint8_t)value); }
+
+    void
+    u2(uint32_t value) { u1(value >> 8); u1(value); }
+
+    void
+    s4(int32_t value) { u2((uint32_t)value >> 16); u2((uint32_t)value & 0xffff); }
+
+    uint32_t
+    pc() const { return (uint32_t)(m_out.size() - m_methodStart); }
+
+    void
+    padSwitch() {
+        while (pc() & 3) {
+            u1(0);
+        }
+    }
+
+    void
+    instruction() {
+        uint32_t pick = random(1000);
+        if (pick < 300) {
+            u1(OPCODE_iload_0 + random(OPCODE_aload_3 - OPCODE_iload_0 + 1));
+        } else if (pick < 380) {
+            u1(OPCODE_istore_0 + random(OPCODE_astore_3 - OPCODE_istore_0 + 1));
+        } else if (pick < 460) {
+            u1(OPCODE_iload + random(5));
+            u1(4 + random(20));
+        } else if (pick < 600) {
+            u1(OPCODE_invokevirtual + random(3));
+            u2(1 + random(2000));
+        } else if (pick < 680) {
+            u1(OPCODE_getstatic + random(4));
+            u2(1 + random(2000));
+        } else if (pick < 760) {
+            u1(OPCODE_ifeq + random(OPCODE_jsr - OPCODE_ifeq));
+            u2((uint32_t)(int16_t)(random(200) - 100));
+        } else if (pick < 820) {
+            u1(OPCODE_iconst_m1 + random(7));
+        } else if (pick < 850) {
+            u1(OPCODE_bipush);
+            u1(random(256));
+        } else if (pick < 870) {
+            u1(OPCODE_ldc);
+            u1(1 + random(255));
+        } else if (pick < 880) {
+            u1(OPCODE_invokeinterface);
+            u2(1 + random(2000));
+            u1(1 + random(4));
+            u1(0);
+        } else if (pick < 885) {
+            u1(OPCODE_wide);
+            if (random(2)) {
+                u1(OPCODE_iinc);
+                u2(random(1000));
+                u2(random(65536));
+            } else {
+                u1(OPCODE_iload + random(5));
+                u2(random(1000));
+            }
+        } else if (pick < 888) {
+            u1(OPCODE_tableswitch);
+            padSwitch();
+            int32_t low = (int32_t)random(10);
+            int32_t high = low + (int32_t)random(16);
+            s4(100);
+            s4(low);
+            s4(high);
+            for (int32_t i = low; i <= high; i++) {
+                s4((int32_t)random(400));
+            }
+        } else if (pick < 890) {
+            u1(OPCODE_lookupswitch);
+            padSwitch();
+            uint32_t pairs = random(12);
+            s4(100);
+            s4((int32_t)pairs);
+            for (uint32_t i = 0; i < pairs; i++) {
+                s4((int32_t)(i * 17));
+                s4((int32_t)random(400));
+            }
+        } else {
+            u1(OPCODE_iadd + random(OPCODE_lxor - OPCODE_iadd + 1));
+        }
+    }
+
+public:
+    CorpusGenerator(uint64_t seed, std::vector<uint8_t> &out) : m_state(seed | 1), m_out(out) {}
+
+    Method
+    method() {
+        m_methodStart = m_out.size();
+        // mostly small methods with a long tail, like real classes
+        uint32_t target = 8 + random(64) + ((random(10) == 0) ? random(4000) : 0);
+        while (pc() < target) {
+            instruction();
+        }
+        u1(OPCODE_return);
+        return { m_methodStart, m_out.size() - m_methodStart };
+    }
+};
+
+
+struct WalkResult {
+    size_t instructions = 0;
+    uint64_t checksum = 0;
+    bool error = false;
+};
+
+
+// opcode histogram only: the cost of the iterator itself
+static WalkResult
+walkOpcodes(std::span<const uint8_t> code, std::array<uint32_t, 256> &histogram) {
+    WalkResult result;
+    BytecodeIterator it(code);
+    Instruction insn;
+    while (it.next(insn)) {
+        histogram[insn.opcode]++;
+        result.instructions++;
+    }
+    result.error = it.error();
+    return result;
+}
+
+
+// iterator plus the operand accessors a typical analysis touches
+static WalkResult
+walk(std::span<const uint8_t> code) {
+    WalkResult result;
+    BytecodeIterator it(code);
+    Instruction insn;
+    while (it.next(insn)) {
+        result.instructions++;
+        uint64_t operand = 0;
+        switch (insn.format) {
+            case OperandFormat::ConstPoolU1:
+            case OperandFormat::ConstPoolU2:
+            case OperandFormat::InvokeInterface:
+            case OperandFormat::InvokeDynamic:
+            case OperandFormat::MultiANewArray: {
+                operand = insn.cpIndex();
+                break;
+            }
+            case OperandFormat::Local:
+            case OperandFormat::Iinc: {
+                operand = insn.local();
+                break;
+            }
+            case OperandFormat::Branch2:
+            case OperandFormat::Branch4: {
+                operand = insn.branchTarget();
+                break;
+            }
+            case OperandFormat::TableSwitch:
+            case OperandFormat::LookupSwitch: {
+                operand = (uint32_t)insn.switchDefault() + insn.padding();
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+        result.checksum = result.checksum * 31 + insn.opcode + operand;
+    }
+    result.error = it.error();
+    return result;
+}
+
+
+int
+main(int argc, char **argv) {
+    size_t megabytes = 64;
+    uint64_t seed = 42;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--mb") == 0) && (i + 1 < argc)) {
+            megabytes = std::stoul(argv[++i]);
+        } else if ((std::strcmp(argv[i], "--seed") == 0) && (i + 1 < argc)) {
+            seed = std::stoull(argv[++i]);
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+
+    for (auto &path : paths) {
+        ClassFile clf;
+        clf.init(path, ClassFileOptions{ .utf8Storage = Utf8Storage::View });
+        if (clf.parseError()) {
+            std::cerr << clf.initResult() << std::endl;
+            return 1;
+        }
+        for (auto &method : clf.methods()) {
+            auto code = clf.code(method);
+            if (!code) {
+                continue;
+            }
+            auto result = walk(code->code);
+            std::cout << clf.thisClassName() << "." << clf.utf8(method.nameIndex) << ": "
+                      << code->code.size() << " bytes, " << result.instructions << " instructions"
+                      << (result.error ? " (malformed)" : "") << std::endl;
+        }
+    }
+
+    std::vector<uint8_t> corpus;
+    corpus.reserve(megabytes << 20);
+    std::vector<Method> methods;
+    CorpusGenerator generator(seed, corpus);
+    while (corpus.size() < (megabytes << 20)) {
+        methods.push_back(generator.method());
+    }
+
+    auto measure = [&](const char *name, auto &&walkMethod) {
+        double best = 0;
+        WalkResult total;
+        for (int round = 0; round < 5; round++) {
+            total = {};
+            auto start = std::chrono::steady_clock::now();
+            for (auto &method : methods) {
+                auto result = walkMethod(std::span(corpus).subspan(method.offset, method.length));
+                total.instructions += result.instructions;
+                total.checksum += result.checksum;
+                total.error |= result.error;
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::max(best, (double)corpus.size() / elapsed.count());
+        }
+        std::cout << name << ": " << best / (1 << 20) << " MiB/s, "
+                  << best / (double)corpus.size() * (double)total.instructions / 1e6 << " M instructions/s"
+                  << std::endl;
+        return total;
+    };
+
+    std::array<uint32_t, 256> histogram{};
+    auto total = measure("opcodes only ", [&](std::span<const uint8_t> code) { return walkOpcodes(code, histogram); });
+    total = measure("with operands", walk);
+
+    if (total.error) {
+        std::cerr << "generated corpus failed to decode" << std::endl;
+        return 1;
+    }
+    std::cout << "corpus: " << corpus.size() / (1 << 20) << " MiB, " << methods.size() << " methods, "
+              << total.instructions << " instructions (checksum " << total.checksum << ")" << std::endl;
+    return 0;
+}
@@ -0,0 +1,763 @@
+#include "classGen.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../bytecode.hpp"
+#include "../constant_pool.hpp"
+
+
+ClassGenOptions::ClassGenOptions() {
+    setTagMix(*this, "javac");
+}
+
+
+bool
+setTagMix(ClassGenOptions &options, std::string_view preset) {
+    auto &w = options.tagWeights;
+    w.fill(0);
+    if (preset == "javac") {
+        // roughly what compiled application code looks like
+        w[CONSTANT_Utf8] = 20;
+        w[CONSTANT_Integer] = 2;
+        w[CONSTANT_Float] = 1;
+        w[CONSTANT_Long] = 1;
+        w[CONSTANT_Double] = 1;
+        w[CONSTANT_Class] = 6;
+        w[CONSTANT_String] = 8;
+        w[CONSTANT_Fieldref] = 12;
+        w[CONSTANT_Methodref] = 30;
+        w[CONSTANT_InterfaceMethodref] = 5;
+        w[CONSTANT_MethodHandle] = 1;
+        w[CONSTANT_MethodType] = 1;
+    } else if (preset == "utf8") {
+        w[CONSTANT_Utf8] = 70;
+        w[CONSTANT_String] = 30;
+    } else if (preset == "numeric") {
+        w[CONSTANT_Integer] = 30;
+        w[CONSTANT_Float] = 20;
+        w[CONSTANT_Long] = 25;
+        w[CONSTANT_Double] = 25;
+    } else if (preset == "refs") {
+        w[CONSTANT_Fieldref] = 30;
+        w[CONSTANT_Methodref] = 50;
+        w[CONSTANT_InterfaceMethodref] = 20;
+    } else {
+        setTagMix(options, "javac");
+        return false;
+    }
+    return true;
+}
+
+
+static uint64_t
+splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+// the limit stays clear of 65535 so that the constants one member needs always fit
+constexpr static uint32_t maxConstantPoolSize = 65000;
+constexpr static uint32_t constantPoolLimit = 65535;
+constexpr static size_t maxCodeLength = 60000;
+
+constexpr static std::string_view identifierChars =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_$";
+constexpr static std::array<std::string_view, 3> nonAsciiChars{ "\xc3\xa9", "\xd0\xb6", "\xe4\xb8\xad" };
+constexpr static std::array<std::string_view, 10> fieldTypes{
+        "I", "J", "F", "D", "Z", "B", "C", "S", "Ljava/lang/String;", "[I" };
+
+
+struct Signature {
+    std::string descriptor;
+    std::vector<char> params;   // first character of every parameter type
+    std::vector<std::string> paramTypes;
+    char returnType = 'V';
+};
+
+
+// a stack map frame at offset: the parameters and the loop counter, plus the caught Throwable in a handler
+struct FrameMark {
+    uint32_t offset;
+    bool caught;
+};
+
+
+struct MemberRef {
+    uint16_t index;
+    Signature signature;        // only the return type is set for field references
+};
+
+
+static uint32_t
+slots(char type) {
+    return ((type == 'J') || (type == 'D')) ? 2 : 1;
+}
+
+
+class ClassGenerator {
+private:
+    const ClassGenOptions &m_options;
+    uint64_t m_state;
+
+    std::vector<uint8_t> m_pool;
+    uint32_t m_count = 1;       // constant_pool_count so far
+    std::unordered_map<std::string, uint16_t> m_utf8s;
+    std::unordered_map<std::string, uint16_t> m_namedClasses;   // by classFor()
+
+    std::vector<uint16_t> m_classes;
+    std::vector<std::pair<uint16_t, Signature>> m_fieldNats;
+    std::vector<std::pair<uint16_t, Signature>> m_methodNats;
+    std::vector<MemberRef> m_fieldrefs;
+    std::vector<MemberRef> m_methodrefs;
+    std::vector<MemberRef> m_interfaceMethodrefs;
+    std::vector<uint16_t> m_loadable;       // ldc / ldc_w
+    std::vector<uint16_t> m_wideLoadable;   // ldc2_w
+
+    uint32_t
+    random(uint32_t bound) {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return (uint32_t)(((m_state * 0x2545f4914f6cdd1dULL) >> 32) % bound);
+    }
+
+    bool
+    chance(uint32_t percent) { return random(100) < percent; }
+
+    uint32_t
+    utf8Length() {
+        uint32_t min = std::max(m_options.utf8MinLength, 1u);
+        uint32_t max = std::max(m_options.utf8MaxLength, min);
+        double mean = std::max((double)m_options.utf8MeanLength, (double)min);
+        double u = (double)random(1u << 30) / (double)(1u << 30);
+        auto length = (uint32_t)std::lround(min - std::log1p(-u) * (mean - min));
+        return std::clamp(length, min, max);
+    }
+
+    void
+    appendChar(std::string &out, std::string_view ascii) {
+        if (chance(m_options.nonAsciiPercent)) {
+            out += nonAsciiChars[random(nonAsciiChars.size())];
+        } else {
+            out += ascii[random(ascii.size())];
+        }
+    }
+
+    std::string
+    identifier() {
+        uint32_t length = utf8Length();
+        std::string out;
+        while (out.size() < length) {
+            appendChar(out, identifierChars);
+        }
+        return out;
+    }
+
+    std::string
+    text() {
+        static constexpr std::string_view printable =
+                " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+        uint32_t length = utf8Length();
+        std::string out;
+        while (out.size() < length) {
+            if (random(500) == 0) {
+                out += "\xc0\x80";      // U+0000
+            } else {
+                appendChar(out, printable);
+            }
+        }
+        return out;
+    }
+
+    std::string
+    className() {
+        return "p" + std::to_string(random(16)) + "/" + identifier();
+    }
+
+    std::string
+    fieldType() {
+        if (chance(20)) {
+            return "L" + className() + ";";
+        }
+        return std::string(fieldTypes[random(fieldTypes.size())]);
+    }
+
+    Signature
+    methodSignature() {
+        Signature signature;
+        signature.descriptor = "(";
+        uint32_t params = random(4);
+        for (uint32_t i = 0; i < params; i++) {
+            std::string type = fieldType();
+            signature.params.push_back(type[0]);
+            signature.descriptor += type;
+            signature.paramTypes.push_back(type);
+        }
+        signature.descriptor += ")";
+        if (chance(40)) {
+            signature.descriptor += "V";
+        } else {
+            std::string type = fieldType();
+            signature.returnType = type[0];
+            signature.descriptor += type;
+        }
+        return signature;
+    }
+
+    void
+    u1(std::vector<uint8_t> &out, uint32_t value) { out.push_back((uint8_t)value); }
+
+    void
+    u2(std::vector<uint8_t> &out, uint32_t value) { u1(out, value >> 8); u1(out, value); }
+
+    void
+    u4(std::vector<uint8_t> &out, uint32_t value) { u2(out, value >> 16); u2(out, value & 0xffff); }
+
+    uint16_t
+    utf8(const std::string &value) {
+        auto it = m_utf8s.find(value);
+        if (it != m_utf8s.end()) {
+            return it->second;
+        }
+        u1(m_pool, CONSTANT_Utf8);
+        u2(m_pool, (uint32_t)value.size());
+        m_pool.insert(m_pool.end(), value.begin(), value.end());
+        m_utf8s.emplace(value, (uint16_t)m_count);
+        return (uint16_t)m_count++;
+    }
+
+    uint16_t
+    newClass(const std::string &name) {
+        uint16_t nameIndex = utf8(name);
+        u1(m_pool, CONSTANT_Class);
+        u2(m_pool, nameIndex);
+        m_classes.push_back((uint16_t)m_count);
+        return (uint16_t)m_count++;
+    }
+
+    // one Class constant per name, for the types stack map frames and handlers refer to
+    uint16_t
+    classFor(const std::string &name) {
+        auto it = m_namedClasses.find(name);
+        if (it != m_namedClasses.end()) {
+            return it->second;
+        }
+        uint16_t index = newClass(name);
+        m_namedClasses.emplace(name, index);
+        return index;
+    }
+
+    uint16_t
+    classConstant() {
+        if (!m_classes.empty() && chance(50)) {
+            return m_classes[random(m_classes.size())];
+        }
+        return newClass(className());
+    }
+
+    const std::pair<uint16_t, Signature> &
+    nameAndType(bool method) {
+        auto &nats = method ? m_methodNats : m_fieldNats;
+        if (!nats.empty() && chance(50)) {
+            return nats[random(nats.size())];
+        }
+        Signature signature;
+        if (method) {
+            signature = methodSignature();
+        } else {
+            signature.descriptor = fieldType();
+            signature.returnType = signature.descriptor[0];
+        }
+        uint16_t nameIndex = utf8(identifier());
+        uint16_t descriptorIndex = utf8(signature.descriptor);
+        u1(m_pool, CONSTANT_NameAndType);
+        u2(m_pool, nameIndex);
+        u2(m_pool, descriptorIndex);
+        nats.emplace_back((uint16_t)m_count++, std::move(signature));
+        return nats.back();
+    }
+
+    const MemberRef &
+    memberRef(uint8_t tag) {
+        auto &refs = (tag == CONSTANT_Fieldref) ? m_fieldrefs :
+                     (tag == CONSTANT_Methodref) ? m_methodrefs : m_interfaceMethodrefs;
+        uint16_t classIndex = classConstant();
+        auto &[natIndex, signature] = nameAndType(tag != CONSTANT_Fieldref);
+        u1(m_pool, tag);
+        u2(m_pool, classIndex);
+        u2(m_pool, natIndex);
+        refs.push_back({ (uint16_t)m_count++, signature });
+        return refs.back();
+    }
+
+    void
+    addConstant(uint8_t tag) {
+        switch (tag) {
+            case CONSTANT_Utf8: {
+                utf8(text());
+                break;
+            }
+            case CONSTANT_Integer:
+            case CONSTANT_Float: {
+                u1(m_pool, tag);
+                u4(m_pool, random(UINT32_MAX) & 0x3fffffff);    // no NaN payloads for floats
+                m_loadable.push_back((uint16_t)m_count++);
+                break;
+            }
+            case CONSTANT_Long:
+            case CONSTANT_Double: {
+                u1(m_pool, tag);
+                u4(m_pool, random(0x40000000));
+                u4(m_pool, random(UINT32_MAX));
+                m_wideLoadable.push_back((uint16_t)m_count);
+                m_count += 2;
+                break;
+            }
+            case CONSTANT_Class: {
+                m_loadable.push_back(newClass(className()));
+                break;
+            }
+            case CONSTANT_String: {
+                uint16_t stringIndex = utf8(text());
+                u1(m_pool, CONSTANT_String);
+                u2(m_pool, stringIndex);
+                m_loadable.push_back((uint16_t)m_count++);
+                break;
+            }
+            case CONSTANT_Fieldref:
+            case CONSTANT_Methodref:
+            case CONSTANT_InterfaceMethodref: {
+                memberRef(tag);
+                break;
+            }
+            case CONSTANT_NameAndType: {
+                nameAndType(chance(70));
+                break;
+            }
+            case CONSTANT_MethodHandle: {
+                bool field = chance(30);
+                uint16_t refIndex = memberRef(field ? CONSTANT_Fieldref : CONSTANT_Methodref).index;
+                u1(m_pool, CONSTANT_MethodHandle);
+                u1(m_pool, field ? REF_getStatic : REF_invokeStatic);
+                u2(m_pool, refIndex);
+                m_loadable.push_back((uint16_t)m_count++);
+                break;
+            }
+            case CONSTANT_MethodType: {
+                uint16_t descriptorIndex = utf8(methodSignature().descriptor);
+                u1(m_pool, CONSTANT_MethodType);
+                u2(m_pool, descriptorIndex);
+                m_loadable.push_back((uint16_t)m_count++);
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    void
+    fillConstantPool() {
+        uint32_t target = std::min(m_options.constantPoolSize, maxConstantPoolSize);
+        uint64_t total = 0;
+        for (uint32_t weight : m_options.tagWeights) {
+            total += weight;
+        }
+        while (m_count < target) {
+            if (total == 0) {
+                utf8(text());
+                continue;
+            }
+            uint64_t pick = random((uint32_t)std::min<uint64_t>(total, UINT32_MAX));
+            uint8_t tag = 0;
+            while (pick >= m_options.tagWeights[tag]) {
+                pick -= m_options.tagWeights[tag];
+                tag++;
+            }
+            addConstant(tag);
+        }
+    }
+
+    static void
+    pushDefault(std::vector<uint8_t> &code, char type) {
+        switch (type) {
+            case 'J': code.push_back(OPCODE_lconst_0); break;
+            case 'F': code.push_back(OPCODE_fconst_0); break;
+            case 'D': code.push_back(OPCODE_dconst_0); break;
+            case 'L':
+            case '[': code.push_back(OPCODE_aconst_null); break;
+            default: code.push_back(OPCODE_iconst_0); break;
+        }
+    }
+
+    static void
+    popValue(std::vector<uint8_t> &code, char type) {
+        if (type != 'V') {
+            code.push_back((slots(type) == 2) ? OPCODE_pop2 : OPCODE_pop);
+        }
+    }
+
+    void
+    invoke(std::vector<uint8_t> &code, uint32_t &maxStack, const MemberRef &ref, bool interface) {
+        uint32_t depth = 0;
+        if (interface) {
+            code.push_back(OPCODE_aconst_null);
+            depth++;
+        }
+        for (char param : ref.signature.params) {
+            pushDefault(code, param);
+            depth += slots(param);
+        }
+        code.push_back(interface ? OPCODE_invokeinterface : OPCODE_invokestatic);
+        u2(code, ref.index);
+        if (interface) {
+            u1(code, depth);
+            u1(code, 0);
+        }
+        maxStack = std::max({ maxStack, depth, (ref.signature.returnType == 'V') ? 0 : slots(ref.signature.returnType) });
+        popValue(code, ref.signature.returnType);
+    }
+
+    // one statement that leaves the operand stack empty again
+    void
+    statement(std::vector<uint8_t> &code, uint32_t &maxStack) {
+        uint32_t pick = random(100);
+        if ((pick < 30) && !m_methodrefs.empty()) {
+            invoke(code, maxStack, m_methodrefs[random(m_methodrefs.size())], false);
+        } else if ((pick < 35) && !m_interfaceMethodrefs.empty()) {
+            invoke(code, maxStack, m_interfaceMethodrefs[random(m_interfaceMethodrefs.size())], true);
+        } else if ((pick < 55) && !m_fieldrefs.empty()) {
+            const MemberRef &ref = m_fieldrefs[random(m_fieldrefs.size())];
+            code.push_back(OPCODE_getstatic);
+            u2(code, ref.index);
+            popValue(code, ref.signature.returnType);
+        } else if ((pick < 85) && !m_loadable.empty()) {
+            uint16_t index = m_loadable[random(m_loadable.size())];
+            if (index < 256) {
+                code.push_back(OPCODE_ldc);
+                u1(code, index);
+            } else {
+                code.push_back(OPCODE_ldc_w);
+                u2(code, index);
+            }
+            code.push_back(OPCODE_pop);
+        } else if (!m_wideLoadable.empty()) {
+            code.push_back(OPCODE_ldc2_w);
+            u2(code, m_wideLoadable[random(m_wideLoadable.size())]);
+            code.push_back(OPCODE_pop2);
+        } else {
+            code.push_back(OPCODE_iconst_0 + random(6));
+            code.push_back(OPCODE_pop);
+        }
+    }
+
+    // a branch instruction whose offset patchBranch() fills in; returns its pc
+    static uint32_t
+    branch(std::vector<uint8_t> &code, uint8_t opcode) {
+        code.push_back(opcode);
+        code.insert(code.end(), { 0, 0 });
+        return (uint32_t)code.size() - 3;
+    }
+
+    static void
+    patchBranch(std::vector<uint8_t> &code, uint32_t pc, uint32_t target) {
+        auto offset = (uint16_t)(int16_t)((int32_t)target - (int32_t)pc);
+        code[pc + 1] = (uint8_t)(offset >> 8);
+        code[pc + 2] = (uint8_t)offset;
+    }
+
+    static void
+    local(std::vector<uint8_t> &code, uint8_t opcode, uint32_t index) {
+        code.push_back(opcode);
+        code.push_back((uint8_t)index);
+    }
+
+    /*
+     * One of: statements skipped when the loop counter is 0, a loop counting
+     * the long counter up to a small bound, or statements in a try block
+     * whose Throwable handler stores the exception in the local after the
+     * counter. Every branch target gets a frame in frames.
+     */
+    void
+    controlFlow(std::vector<uint8_t> &code, uint32_t &maxStack, uint32_t counter, std::vector<FrameMark> &frames,
+                std::vector<uint8_t> &exceptionTable) {
+        uint32_t pick = random(3);
+        if (pick == 0) {
+            local(code, OPCODE_lload, counter);
+            code.push_back(OPCODE_l2i);
+            uint32_t skip = branch(code, OPCODE_ifeq);
+            statement(code, maxStack);
+            patchBranch(code, skip, (uint32_t)code.size());
+            frames.push_back({ (uint32_t)code.size(), false });
+        } else if (pick == 1) {
+            code.push_back(OPCODE_lconst_0);
+            local(code, OPCODE_lstore, counter);
+            uint32_t toCondition = branch(code, OPCODE_goto);
+            uint32_t body = (uint32_t)code.size();
+            frames.push_back({ body, false });
+            for (uint32_t i = 1 + random(2); i > 0; i--) {
+                statement(code, maxStack);
+            }
+            local(code, OPCODE_lload, counter);
+            code.push_back(OPCODE_lconst_1);
+            code.push_back(OPCODE_ladd);
+            local(code, OPCODE_lstore, counter);
+            patchBranch(code, toCondition, (uint32_t)code.size());
+            frames.push_back({ (uint32_t)code.size(), false });
+            local(code, OPCODE_lload, counter);
+            local(code, OPCODE_bipush, 1 + random(16));
+            code.push_back(OPCODE_i2l);
+            code.push_back(OPCODE_lcmp);
+            patchBranch(code, branch(code, OPCODE_iflt), body);
+        } else {
+            uint32_t start = (uint32_t)code.size();
+            for (uint32_t i = 1 + random(2); i > 0; i--) {
+                statement(code, maxStack);
+            }
+            uint32_t end = (uint32_t)code.size();
+            uint32_t toAfter = branch(code, OPCODE_goto);
+            uint32_t handler = (uint32_t)code.size();
+            frames.push_back({ handler, true });
+            local(code, OPCODE_astore, counter + 2);
+            patchBranch(code, toAfter, (uint32_t)code.size());
+            frames.push_back({ (uint32_t)code.size(), false });
+            for (uint32_t value : { start, end, handler, (uint32_t)classFor("java/lang/Throwable") }) {
+                u2(exceptionTable, value);
+            }
+        }
+        maxStack = std::max(maxStack, 4u);
+    }
+
+    // verification_type_info of a parameter (JVMS 4.7.4)
+    void
+    parameterTypeInfo(std::vector<uint8_t> &out, const std::string &type) {
+        switch (type[0]) {
+            case 'J': u1(out, 4); break;
+            case 'F': u1(out, 2); break;
+            case 'D': u1(out, 3); break;
+            case 'L': u1(out, 7); u2(out, classFor(type.substr(1, type.size() - 2))); break;
+            case '[': u1(out, 7); u2(out, classFor(type)); break;
+            default: u1(out, 1); break;
+        }
+    }
+
+    /*
+     * The frames of a method with control flow: the first appends the loop
+     * counter to the parameters, the rest are same frames, handlers
+     * same_locals_1_stack_item frames. Some are written as full frames.
+     */
+    std::vector<uint8_t>
+    stackMapTable(const Signature &signature, const std::vector<FrameMark> &frames) {
+        std::vector<uint8_t> table;
+        u2(table, (uint32_t)frames.size());
+        int64_t previous = -1;
+        for (size_t i = 0; i < frames.size(); i++) {
+            auto delta = (uint32_t)(frames[i].offset - previous - 1);
+            previous = frames[i].offset;
+            if (((i == 0) && frames[i].caught) || chance(10)) {
+                u1(table, 255);
+                u2(table, delta);
+                u2(table, (uint32_t)signature.paramTypes.size() + 1);
+                for (auto &type : signature.paramTypes) {
+                    parameterTypeInfo(table, type);
+                }
+                u1(table, 4);
+                u2(table, frames[i].caught ? 1 : 0);
+            } else if (i == 0) {
+                u1(table, 252);
+                u2(table, delta);
+                u1(table, 4);
+                continue;
+            } else if (frames[i].caught) {
+                if (delta < 64) {
+                    u1(table, 64 + delta);
+                } else {
+                    u1(table, 247);
+                    u2(table, delta);
+                }
+            } else {
+                if (delta < 64) {
+                    u1(table, delta);
+                } else {
+                    u1(table, 251);
+                    u2(table, delta);
+                }
+                continue;
+            }
+            if (frames[i].caught) {
+                u1(table, 7);
+                u2(table, classFor("java/lang/Throwable"));
+            }
+        }
+        return table;
+    }
+
+    /*
+     * Statements that only touch the operand stack, and in controlFlowPercent
+     * of the methods also branches, loops and catch handlers with the stack
+     * map frames they need. Such methods start by zeroing a long loop
+     * counter in the local after the parameters.
+     */
+    std::vector<uint8_t>
+    codeAttribute(const Signature &signature, uint16_t codeNameIndex) {
+        std::vector<uint8_t> code;
+        uint32_t maxStack = 2;
+        uint32_t maxLocals = 0;
+        for (char param : signature.params) {
+            maxLocals += slots(param);
+        }
+        // the constants frames and handlers may add: a class per parameter, Throwable and the attribute name
+        bool withControlFlow = (m_options.controlFlowPercent != 0) && chance(m_options.controlFlowPercent) &&
+                               (m_count + 2 * signature.params.size() + 4 < constantPoolLimit);
+        uint32_t counter = maxLocals;
+        std::vector<FrameMark> frames;
+        std::vector<uint8_t> exceptionTable;
+        if (withControlFlow) {
+            code.push_back(OPCODE_lconst_0);
+            local(code, OPCODE_lstore, counter);
+            maxLocals += 3;     // the counter and the caught exception
+        }
+
+        uint32_t instructions = random(2 * m_options.instructionsPerMethod + 1);
+        for (uint32_t i = 0; (i < instructions) && (code.size() < maxCodeLength); i++) {
+            if (withControlFlow && chance(20)) {
+                controlFlow(code, maxStack, counter, frames, exceptionTable);
+            } else {
+                statement(code, maxStack);
+            }
+        }
+
+        char returnType = signature.returnType;
+        if (returnType != 'V') {
+            pushDefault(code, returnType);
+        }
+        switch (returnType) {
+            case 'V': code.push_back(OPCODE_return); break;
+            case 'J': code.push_back(OPCODE_lreturn); break;
+            case 'F': code.push_back(OPCODE_freturn); break;
+            case 'D': code.push_back(OPCODE_dreturn); break;
+            case 'L':
+            case '[': code.push_back(OPCODE_areturn); break;
+            default: code.push_back(OPCODE_ireturn); break;
+        }
+
+        std::vector<uint8_t> table;
+        if (!frames.empty()) {
+            table = stackMapTable(signature, frames);
+        }
+
+        std::vector<uint8_t> out;
+        u2(out, codeNameIndex);
+        u4(out, 12 + (uint32_t)(code.size() + exceptionTable.size()) + (table.empty() ? 0 : 6 + (uint32_t)table.size()));
+        u2(out, maxStack);
+        u2(out, maxLocals);
+        u4(out, (uint32_t)code.size());
+        out.insert(out.end(), code.begin(), code.end());
+        u2(out, (uint32_t)exceptionTable.size() / 8);
+        out.insert(out.end(), exceptionTable.begin(), exceptionTable.end());
+        u2(out, table.empty() ? 0 : 1);
+        if (!table.empty()) {
+            u2(out, utf8("StackMapTable"));
+            u4(out, (uint32_t)table.size());
+            out.insert(out.end(), table.begin(), table.end());
+        }
+        return out;
+    }
+
+public:
+    ClassGenerator(const ClassGenOptions &options, uint64_t classNumber)
+            : m_options(options), m_state(splitmix64(options.seed ^ splitmix64(classNumber)) | 1) {}
+
+    std::vector<uint8_t>
+    generate(uint64_t classNumber) {
+        uint16_t thisClass = newClass("bench/Gen" + std::to_string(classNumber));
+        uint16_t superClass = newClass("java/lang/Object");
+        uint16_t codeName = utf8("Code");
+        uint16_t sourceFileName = utf8("SourceFile");
+        uint16_t sourceFile = utf8("Gen" + std::to_string(classNumber) + ".java");
+
+        struct Member {
+            uint16_t nameIndex;
+            uint16_t descriptorIndex;
+            Signature signature;
+        };
+        std::unordered_set<std::string> memberKeys;
+        auto newMember = [&](bool method) {
+            Member member;
+            std::string name;
+            do {
+                name = identifier();
+                if (method) {
+                    member.signature = methodSignature();
+                } else {
+                    member.signature.descriptor = fieldType();
+                }
+            } while (!memberKeys.insert(name + member.signature.descriptor).second);
+            member.nameIndex = utf8(name);
+            member.descriptorIndex = utf8(member.signature.descriptor);
+            return member;
+        };
+        std::vector<Member> fields;
+        for (uint32_t i = 0; i < m_options.fieldCount; i++) {
+            fields.push_back(newMember(false));
+        }
+        std::vector<Member> methods;
+        for (uint32_t i = 0; i < m_options.methodCount; i++) {
+            methods.push_back(newMember(true));
+        }
+
+        fillConstantPool();
+        // before the pool is written out: frames and handlers add the constants they refer to
+        std::vector<std::vector<uint8_t>> codes;
+        for (auto &method : methods) {
+            codes.push_back(codeAttribute(method.signature, codeName));
+        }
+
+        std::vector<uint8_t> out;
+        u4(out, 0xCAFEBABE);
+        u2(out, 0);
+        u2(out, 52);
+        u2(out, m_count);
+        out.insert(out.end(), m_pool.begin(), m_pool.end());
+        u2(out, 0x0021);    // ACC_PUBLIC | ACC_SUPER
+        u2(out, thisClass);
+        u2(out, superClass);
+        u2(out, 0);         // interfaces_count
+
+        u2(out, (uint32_t)fields.size());
+        for (auto &field : fields) {
+            u2(out, 0x0009);    // ACC_PUBLIC | ACC_STATIC
+            u2(out, field.nameIndex);
+            u2(out, field.descriptorIndex);
+            u2(out, 0);
+        }
+
+        u2(out, (uint32_t)methods.size());
+        for (size_t i = 0; i < methods.size(); i++) {
+            u2(out, 0x0009);
+            u2(out, methods[i].nameIndex);
+            u2(out, methods[i].descriptorIndex);
+            u2(out, 1);
+            out.insert(out.end(), codes[i].begin(), codes[i].end());
+        }
+
+        u2(out, 1);
+        u2(out, sourceFileName);
+        u4(out, 2);
+        u2(out, sourceFile);
+        return out;
+    }
+};
+
+
+std::vector<uint8_t>
+generateClass(const ClassGenOptions &options, uint64_t classNumber) {
+    return ClassGenerator(options, classNumber).generate(classNumber);
+}
@@ -0,0 +1,50 @@
+#ifndef SJBCDC_CLASSGEN_HPP
+#define SJBCDC_CLASSGEN_HPP
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+ * Deterministic generator of synthetic class files for the benchmarks. Every
+ * class passes VerifyLevel::Full and BytecodeVerifier. Methods are
+ * statements of constant loads, static field reads and calls with default
+ * arguments; some also branch, loop on a long local and catch Throwable,
+ * with the StackMapTable frames that takes.
+ */
+struct ClassGenOptions {
+    uint64_t seed = 42;
+    // constant_pool_count to aim for; ends up slightly above when dependencies do not fit exactly
+    uint32_t constantPoolSize = 400;
+    /*
+     * Relative weights, indexed by tag, of the constants added to fill the
+     * pool. Reference constants bring the Class, NameAndType and Utf8
+     * constants they need (shared with earlier ones about half the time).
+     */
+    std::array<uint32_t, 21> tagWeights{};
+    // Utf8 lengths in bytes follow an exponential distribution clamped to [min, max]
+    uint32_t utf8MinLength = 1;
+    uint32_t utf8MeanLength = 16;
+    uint32_t utf8MaxLength = 200;
+    // share of characters outside ASCII (2- and 3-byte modified UTF-8)
+    uint32_t nonAsciiPercent = 2;
+    uint32_t fieldCount = 8;
+    uint32_t methodCount = 16;
+    // average number of instructions per method body
+    uint32_t instructionsPerMethod = 24;
+    // share of methods with branches, loops and catch handlers; 0 gives straight-line code only
+    uint32_t controlFlowPercent = 50;
+
+    ClassGenOptions();
+};
+
+// known presets: javac (the default), utf8, numeric, refs
+bool
+setTagMix(ClassGenOptions &options, std::string_view preset);
+
+// the same options and classNumber always give the same bytes
+std::vector<uint8_t>
+generateClass(const ClassGenOptions &options, uint64_t classNumber);
+
+#endif //SJBCDC_CLASSGEN_HPP
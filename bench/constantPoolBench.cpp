@@ -0,0 +1,172 @@
+/*
+ * Resolution-heavy workload over many parsed classes: random
+ * Fieldref/Methodref/InterfaceMethodref -> Class/NameAndType -> Utf8 chains,
+ * resolved through ClassFileConstants (idxTable + per-tag vectors) and through
+ * CompactConstantPool.
+ *
+ *   sJBcDcConstantPoolBench [--copies N] [--queries N] [class files...]
+ */
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../classFileRead.hpp"
+#include "../compactConstantPool.hpp"
+
+
+template <typename RefVector>
+static bool
+legacyResolve(const ClassFileConstants &constants, const RefVector &refs, size_t idxInType, ResolvedMemberRef &out) {
+    auto &ref = refs[idxInType];
+    const idxRef &classRef = constants[ref.classIndex];
+    const idxRef &natRef = constants[ref.nameAndTypeIndex];
+    if ((classRef.type != CONSTANT_Class) || (natRef.type != CONSTANT_NameAndType)) {
+        return false;
+    }
+
+    const idxRef &classNameRef = constants[constants.classConsts[classRef.idxInType].nameIndex];
+    auto &nat = constants.nameAndTypeConsts[natRef.idxInType];
+    const idxRef &nameRef = constants[nat.nameIndex];
+    const idxRef &descRef = constants[nat.descriptorIndex];
+    if ((classNameRef.type != CONSTANT_Utf8) || (nameRef.type != CONSTANT_Utf8) || (descRef.type != CONSTANT_Utf8)) {
+        return false;
+    }
+
+    out.className = constants.utf8View(constants.utf8Consts[classNameRef.idxInType]);
+    out.name = constants.utf8View(constants.utf8Consts[nameRef.idxInType]);
+    out.descriptor = constants.utf8View(constants.utf8Consts[descRef.idxInType]);
+    return true;
+}
+
+
+static bool
+legacyMemberRef(const ClassFileConstants &constants, size_t cpIdx, ResolvedMemberRef &out) {
+    const idxRef &ref = constants[cpIdx];
+    switch (ref.type) {
+        case CONSTANT_Fieldref:
+            return legacyResolve(constants, constants.fieldrefConsts, ref.idxInType, out);
+        case CONSTANT_Methodref:
+            return legacyResolve(constants, constants.methodrefConsts, ref.idxInType, out);
+        case CONSTANT_InterfaceMethodref:
+            return legacyResolve(constants, constants.interfaceMetodrefConsts, ref.idxInType, out);
+        default:
+            return false;
+    }
+}
+
+
+static inline size_t
+digest(const ResolvedMemberRef &ref) {
+    return ref.className.size() + ref.name.size() + ref.descriptor.size() +
+           (uint8_t)ref.name[0] + (uint8_t)ref.descriptor.back();
+}
+
+
+struct Query {
+    uint32_t classNum;
+    uint16_t cpIdx;
+};
+
+
+int
+main(int argc, char **argv) {
+    size_t copies = 4096;
+    size_t queryCount = 4'000'000;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--copies") == 0) && (i + 1 < argc)) {
+            copies = std::stoul(argv[++i]);
+        } else if ((std::strcmp(argv[i], "--queries") == 0) && (i + 1 < argc)) {
+            queryCount = std::stoul(argv[++i]);
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        paths.emplace_back("../ArithmeticAlgo.class");
+    }
+
+    // every copy gets its own buffer, so the working set grows like a real corpus
+    std::vector<std::unique_ptr<ClassFile>> classes;
+    std::vector<CompactConstantPool> compact;
+    for (size_t c = 0; c < copies; c++) {
+        for (auto &path : paths) {
+            auto clf = std::make_unique<ClassFile>();
+            clf->init(path, ClassFileOptions{ .utf8Storage = Utf8Storage::View });
+            if (!clf->initResult().empty()) {
+                std::cerr << clf->initResult() << std::endl;
+                return 1;
+            }
+            compact.emplace_back(clf->constants());
+            classes.push_back(std::move(clf));
+        }
+    }
+
+    std::vector<std::vector<uint16_t>> refIdxs(classes.size());
+    for (size_t c = 0; c < classes.size(); c++) {
+        auto &constants = classes[c]->constants();
+        for (size_t cpIdx = 1; cpIdx <= constants.idxTable.size(); cpIdx++) {
+            auto type = constants[cpIdx].type;
+            if ((type == CONSTANT_Fieldref) || (type == CONSTANT_Methodref) || (type == CONSTANT_InterfaceMethodref)) {
+                refIdxs[c].push_back((uint16_t)cpIdx);
+            }
+        }
+        if (refIdxs[c].empty()) {
+            std::cerr << "no member references to resolve" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Query> queries(queryCount);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (auto &query : queries) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto classNum = (uint32_t)((state >> 33) % classes.size());
+        auto &refs = refIdxs[classNum];
+        query = { classNum, refs[(state >> 13) % refs.size()] };
+    }
+
+    auto run = [&](const char *name, auto &&resolve) {
+        auto start = std::chrono::steady_clock::now();
+        size_t sum = 0;
+        for (auto &query : queries) {
+            sum += resolve(query);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        double perQuery = elapsed.count() / (double)queries.size();
+        std::cout << name << ": " << perQuery << " ns/resolution (checksum " << sum << ")" << std::endl;
+        return perQuery;
+    };
+
+    double legacy = run("ClassFileConstants  ", [&](const Query &query) {
+        ResolvedMemberRef ref;
+        return legacyMemberRef(classes[query.classNum]->constants(), query.cpIdx, ref) ? digest(ref) : 0;
+    });
+    double dense = run("CompactConstantPool ", [&](const Query &query) {
+        auto ref = compact[query.classNum].memberRef(query.cpIdx);
+        return ref ? digest(*ref) : 0;
+    });
+
+    size_t legacyBytes = 0;
+    size_t compactBytes = 0;
+    for (size_t c = 0; c < classes.size(); c++) {
+        auto &constants = classes[c]->constants();
+        legacyBytes += constants.idxTable.size() * sizeof(idxRef) +
+                       constants.utf8Consts.size() * sizeof(CONSTANT_Utf8Info) +
+                       constants.classConsts.size() * sizeof(CONSTANT_ClassInfo) +
+                       constants.nameAndTypeConsts.size() * sizeof(CONSTANT_NameAndTypeInfo) +
+                       (constants.fieldrefConsts.size() + constants.methodrefConsts.size() +
+                        constants.interfaceMetodrefConsts.size()) * sizeof(CONSTANT_MethodrefInfo);
+        compactBytes += compact[c].size() * sizeof(uint64_t) + compact[c].stringAreaSize();
+    }
+
+    std::cout << "classes: " << classes.size() << ", queries: " << queries.size() << std::endl;
+    std::cout << "speedup: " << legacy / dense << "x" << std::endl;
+    std::cout << "index bytes per class: legacy " << legacyBytes / classes.size()
+              << " (Utf8 bytes not counted), compact " << compactBytes / classes.size()
+              << " (string area included)" << std::endl;
+    return 0;
+}
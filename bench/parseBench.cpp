@@ -0,0 +1,450 @@
+/*
+ * Throughput of ClassFile::init over a corpus of generated class files (see
+ * classGen.hpp), plus any class files given on the command line. Every case
+ * parses the whole corpus with one configuration; the phases of init are
+ * estimated from the differences between cases (e.g. Full verification is
+ * "verify Full" minus "verify Structural"). The write cases run
+ * writeClassFile() over the parsed corpus against a plain copy of its bytes,
+ * and "verify bytecode" runs BytecodeVerifier over every parsed class.
+ * Where perf_event_open is allowed,
+ * cycles, instructions and cache misses of the best round are reported too.
+ *
+ *   sJBcDcParseBench [--classes N] [--cp N] [--mix javac|utf8|numeric|refs]
+ *                    [--utf8-min N] [--utf8-mean N] [--utf8-max N] [--non-ascii PERCENT]
+ *                    [--fields N] [--methods N] [--instructions N] [--control-flow PERCENT] [--seed N]
+ *                    [--rounds N] [--json FILE|-] [--write DIR] [class files...]
+ *
+ * --write keeps the generated files in DIR; otherwise they are written to a
+ * temporary directory for the file cases and removed afterwards. With
+ * --json -, the JSON goes to stdout and the report to stderr.
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "classGen.hpp"
+#include "../bytecodeVerifier.hpp"
+#include "../classFileRead.hpp"
+#include "../classFileWrite.hpp"
+
+
+struct CounterValues {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;
+};
+
+
+// cycles, instructions and cache misses of this thread (user space only), read as one group
+class PerfCounters {
+private:
+    std::array<int, 3> m_fds{ -1, -1, -1 };
+    std::string m_error;
+
+public:
+    PerfCounters() {
+#ifdef __linux__
+        constexpr std::array<uint64_t, 3> configs{
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+        for (size_t i = 0; i < configs.size(); i++) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = (i == 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            m_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, (i == 0) ? -1 : m_fds[0], 0);
+            if (m_fds[i] < 0) {
+                m_error = std::strerror(errno);
+                close();
+                return;
+            }
+        }
+#else
+        m_error = "not supported on this platform";
+#endif
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters() { close(); }
+
+    void
+    close() {
+#ifdef __linux__
+        for (int &fd : m_fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            fd = -1;
+        }
+#endif
+    }
+
+    bool
+    available() const { return m_fds[0] >= 0; }
+
+    const std::string &
+    error() const { return m_error; }
+
+    void
+    start() {
+#ifdef __linux__
+        if (available()) {
+            ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    std::optional<CounterValues>
+    stop() {
+#ifdef __linux__
+        if (!available()) {
+            return std::nullopt;
+        }
+        ioctl(m_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        std::array<uint64_t, 4> group{};    // nr, then one value per counter
+        if ((read(m_fds[0], group.data(), sizeof(group)) != (ssize_t)sizeof(group)) || (group[0] != 3)) {
+            return std::nullopt;
+        }
+        return CounterValues{ group[1], group[2], group[3] };
+#else
+        return std::nullopt;
+#endif
+    }
+};
+
+
+struct CorpusClass {
+    std::string path;
+    std::vector<uint8_t> bytes;
+};
+
+
+struct CaseResult {
+    std::string name;
+    double seconds = 0;     // best round
+    std::optional<CounterValues> counters{};
+};
+
+
+static double
+nsPerClass(const CaseResult &result, size_t classes) {
+    return result.seconds * 1e9 / (double)classes;
+}
+
+
+static std::string
+jsonString(std::string_view value) {
+    std::string out = "\"";
+    for (char c : value) {
+        if ((c == '"') || (c == '\\')) {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+
+int
+main(int argc, char **argv) {
+    ClassGenOptions genOptions;
+    std::string mix = "javac";
+    size_t classCount = 2000;
+    int rounds = 5;
+    std::string jsonPath;
+    std::string writeDir;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        auto option = [&](const char *name) { return (std::strcmp(argv[i], name) == 0) && (i + 1 < argc); };
+        if (option("--classes")) {
+            classCount = std::stoul(argv[++i]);
+        } else if (option("--cp")) {
+            genOptions.constantPoolSize = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--mix")) {
+            mix = argv[++i];
+            if (!setTagMix(genOptions, mix)) {
+                std::cerr << "unknown tag mix " << mix << std::endl;
+                return 1;
+            }
+        } else if (option("--utf8-min")) {
+            genOptions.utf8MinLength = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--utf8-mean")) {
+            genOptions.utf8MeanLength = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--utf8-max")) {
+            genOptions.utf8MaxLength = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--non-ascii")) {
+            genOptions.nonAsciiPercent = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--fields")) {
+            genOptions.fieldCount = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--methods")) {
+            genOptions.methodCount = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--instructions")) {
+            genOptions.instructionsPerMethod = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--control-flow")) {
+            genOptions.controlFlowPercent = (uint32_t)std::stoul(argv[++i]);
+        } else if (option("--seed")) {
+            genOptions.seed = std::stoull(argv[++i]);
+        } else if (option("--rounds")) {
+            rounds = std::max(1, std::stoi(argv[++i]));
+        } else if (option("--json")) {
+            jsonPath = argv[++i];
+        } else if (option("--write")) {
+            writeDir = argv[++i];
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+
+    std::error_code ec;
+    bool keepFiles = !writeDir.empty();
+    std::filesystem::path dir = keepFiles ? std::filesystem::path(writeDir) :
+                                std::filesystem::temp_directory_path() / ("sJBcDcParseBench-" +
+                                        std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << dir.string() << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::vector<CorpusClass> corpus;
+    size_t corpusBytes = 0;
+    for (size_t n = 0; n < classCount; n++) {
+        CorpusClass entry{ (dir / ("Gen" + std::to_string(n) + ".class")).string(), generateClass(genOptions, n) };
+        std::ofstream out(entry.path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(entry.bytes.data()), (std::streamsize)entry.bytes.size());
+        if (!out) {
+            std::cerr << entry.path << ": write failed" << std::endl;
+            return 1;
+        }
+        corpusBytes += entry.bytes.size();
+        corpus.push_back(std::move(entry));
+    }
+    for (auto &path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), {});
+        if (!in.good() && !in.eof()) {
+            std::cerr << path << ": read failed" << std::endl;
+            return 1;
+        }
+        corpusBytes += bytes.size();
+        corpus.push_back({ path, std::move(bytes) });
+    }
+    if (corpus.empty()) {
+        std::cerr << "empty corpus" << std::endl;
+        return 1;
+    }
+
+    PerfCounters counters;
+    std::vector<CaseResult> results;
+    bool failed = false;
+
+    /*
+     * body does one pass over the corpus and returns how many classes failed;
+     * the result keeps the fastest of the rounds
+     */
+    auto timeRounds = [&](const std::string &name, int rounds, auto body) {
+        CaseResult result{ name };
+        for (int round = 0; round < rounds; round++) {
+            counters.start();
+            auto start = std::chrono::steady_clock::now();
+            size_t errors = body();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            auto values = counters.stop();
+            if (errors != 0) {
+                std::cerr << name << ": " << errors << " classes failed" << std::endl;
+                failed = true;
+            }
+            if ((round == 0) || (elapsed.count() < result.seconds)) {
+                result.seconds = elapsed.count();
+                result.counters = values;
+            }
+        }
+        results.push_back(result);
+        return result;
+    };
+
+    // fromFile: init(path) with the options, otherwise init(span) over the bytes already in memory
+    auto measure = [&](const char *name, bool fromFile, const ClassFileOptions &options) {
+        return timeRounds(name, rounds, [&] {
+            size_t errors = 0;
+            for (auto &entry : corpus) {
+                ClassFile clf;
+                if (fromFile) {
+                    clf.init(entry.path, options);
+                } else {
+                    clf.init(std::span<const uint8_t>(entry.bytes), entry.path, options);
+                }
+                errors += clf.parseError();
+            }
+            return errors;
+        });
+    };
+
+    auto fileCopy = measure("file, Copy", true, { .loadMode = ClassFileLoadMode::Copy });
+    measure("file, Mmap", true, { .loadMode = ClassFileLoadMode::Mmap });
+    auto full = measure("verify Full", false, {});
+    auto structural = measure("verify Structural", false, { .verifyLevel = VerifyLevel::Structural });
+    auto none = measure("verify None", false, { .verifyLevel = VerifyLevel::None });
+    auto view = measure("Utf8 View", false, { .utf8Storage = Utf8Storage::View });
+    auto noAttributes = measure("no attributes", false, { .attributeMask = NoAttributes });
+    measure("lazy constant pool", false, { .lazyConstantPool = true, .verifyLevel = VerifyLevel::None });
+    auto fingerprints = measure("fingerprints", false, { .fingerprints = true });
+
+    // every class parsed once; edit gives the edits of a class, nullopt for a plain copy
+    std::vector<std::unique_ptr<ClassFile>> parsed;
+    for (auto &entry : corpus) {
+        parsed.push_back(std::make_unique<ClassFile>());
+        parsed.back()->init(std::span<const uint8_t>(entry.bytes), entry.path, { .utf8Storage = Utf8Storage::View });
+    }
+    auto measureWrite = [&](const char *name, auto edit) {
+        std::vector<std::optional<ClassFileEdits>> edits;
+        for (auto &classFile : parsed) {
+            edits.push_back(edit(*classFile));
+        }
+        std::vector<uint8_t> out;
+        timeRounds(name, rounds, [&] {
+            size_t errors = 0;
+            for (size_t n = 0; n < corpus.size(); n++) {
+                if (!edits[n]) {
+                    out.assign(corpus[n].bytes.begin(), corpus[n].bytes.end());
+                } else {
+                    errors += !writeClassFile(*parsed[n], *edits[n], out);
+                }
+            }
+            return errors;
+        });
+    };
+    measureWrite("copy bytes", [](const ClassFile &) { return std::optional<ClassFileEdits>(); });
+    measureWrite("write, no edits", [](const ClassFile &classFile) { return std::optional(ClassFileEdits(classFile)); });
+    // the this_class name replaced, as when relocating a class to another package
+    measureWrite("write, this_class renamed", [](const ClassFile &classFile) {
+        ClassFileEdits edits(classFile);
+        auto thisClass = classFile.constant(classFile.thisClass());
+        uint16_t nameIndex = classFile.constants().classConsts[thisClass->idxInType].nameIndex;
+        edits.replaceUtf8(nameIndex, "shaded/" + std::string(classFile.thisClassName()));
+        return std::optional(std::move(edits));
+    });
+
+    // the type checking verifier over every method, with no hierarchy; one verifier reused throughout
+    BytecodeVerifier verifier;
+    timeRounds("verify bytecode", rounds, [&] {
+        size_t errors = 0;
+        for (auto &classFile : parsed) {
+            errors += (bool)verifier.verifyClass(*classFile);
+        }
+        return errors;
+    });
+
+    // cost of each phase of init, as the difference between two cases
+    std::vector<std::pair<std::string, double>> phases{
+            { "read file", nsPerClass(fileCopy, corpus.size()) - nsPerClass(full, corpus.size()) },
+            { "decode (verify None)", nsPerClass(none, corpus.size()) },
+            { "Structural checks", nsPerClass(structural, corpus.size()) - nsPerClass(none, corpus.size()) },
+            { "Full checks", nsPerClass(full, corpus.size()) - nsPerClass(structural, corpus.size()) },
+            { "Utf8 copies", nsPerClass(full, corpus.size()) - nsPerClass(view, corpus.size()) },
+            { "attributes", nsPerClass(full, corpus.size()) - nsPerClass(noAttributes, corpus.size()) },
+            { "fingerprints", nsPerClass(fingerprints, corpus.size()) - nsPerClass(full, corpus.size()) },
+    };
+
+    double megabytes = (double)corpusBytes / 1e6;
+    // stdout is left to the JSON when it goes there
+    std::ostream &report = (jsonPath == "-") ? std::cerr : std::cout;
+    report << "corpus: " << corpus.size() << " classes, " << megabytes << " MB, mix " << mix
+              << ", constant pool " << genOptions.constantPoolSize << ", seed " << genOptions.seed << std::endl;
+    if (!counters.available()) {
+        report << "hardware counters unavailable: " << counters.error() << std::endl;
+    }
+    for (auto &result : results) {
+        report << result.name << ": " << megabytes / result.seconds << " MB/s, "
+                  << (double)corpus.size() / result.seconds << " classes/s, "
+                  << nsPerClass(result, corpus.size()) << " ns/class";
+        if (result.counters) {
+            auto &values = *result.counters;
+            report << ", IPC " << (double)values.instructions / (double)values.cycles << ", "
+                      << (double)values.cacheMisses / ((double)corpusBytes / 1024) << " cache misses/KB";
+        }
+        report << std::endl;
+    }
+    for (auto &[name, ns] : phases) {
+        report << "phase " << name << ": " << ns << " ns/class" << std::endl;
+    }
+
+    if (!jsonPath.empty()) {
+        std::ostringstream json;
+        json << "{\n  \"corpus\": {\"classes\": " << corpus.size() << ", \"bytes\": " << corpusBytes
+             << ", \"seed\": " << genOptions.seed << ", \"mix\": " << jsonString(mix)
+             << ", \"constantPoolSize\": " << genOptions.constantPoolSize
+             << ", \"utf8MinLength\": " << genOptions.utf8MinLength
+             << ", \"utf8MeanLength\": " << genOptions.utf8MeanLength
+             << ", \"utf8MaxLength\": " << genOptions.utf8MaxLength
+             << ", \"nonAsciiPercent\": " << genOptions.nonAsciiPercent
+             << ", \"fields\": " << genOptions.fieldCount << ", \"methods\": " << genOptions.methodCount
+             << ", \"instructionsPerMethod\": " << genOptions.instructionsPerMethod
+             << ", \"controlFlowPercent\": " << genOptions.controlFlowPercent
+             << ", \"files\": " << paths.size() << "},\n  \"cases\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            auto &result = results[i];
+            json << (i ? "," : "") << "\n    {\"name\": " << jsonString(result.name)
+                 << ", \"seconds\": " << result.seconds
+                 << ", \"mbPerSecond\": " << megabytes / result.seconds
+                 << ", \"classesPerSecond\": " << (double)corpus.size() / result.seconds
+                 << ", \"nsPerClass\": " << nsPerClass(result, corpus.size());
+            if (result.counters) {
+                auto &values = *result.counters;
+                json << ", \"cycles\": " << values.cycles << ", \"instructions\": " << values.instructions
+                     << ", \"cacheMisses\": " << values.cacheMisses
+                     << ", \"cacheMissesPerKB\": " << (double)values.cacheMisses / ((double)corpusBytes / 1024);
+            }
+            json << "}";
+        }
+        json << "\n  ],\n  \"phasesNsPerClass\": {";
+        for (size_t i = 0; i < phases.size(); i++) {
+            json << (i ? ", " : "") << jsonString(phases[i].first) << ": " << phases[i].second;
+        }
+        json << "}\n}\n";
+
+        if (jsonPath == "-") {
+            std::cout << json.str();
+        } else {
+            std::ofstream out(jsonPath);
+            out << json.str();
+            if (!out) {
+                std::cerr << jsonPath << ": write failed" << std::endl;
+                failed = true;
+            }
+        }
+    }
+
+    if (!keepFiles) {
+        std::filesystem::remove_all(dir, ec);
+    }
+    return failed ? 1 : 0;
+}
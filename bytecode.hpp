@@ -0,0 +1,500 @@
+#ifndef SJBCDC_BYTECODE_HPP
+#define SJBCDC_BYTECODE_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/*
+ * Operand layouts of JVMS 6.5 instructions (sizes exclude the opcode byte):
+ *   S1, S2             signed immediate (bipush, sipush)
+ *   ConstPoolU1/U2     constant pool index
+ *   Local              local variable index, u1 (u2 under wide)
+ *   Iinc               local index u1 + signed const s1 (u2 + s2 under wide)
+ *   Branch2/4          signed branch offset relative to the opcode
+ *   InvokeInterface    u2 index, u1 count, u1 zero
+ *   InvokeDynamic      u2 index, two zero bytes
+ *   MultiANewArray     u2 index, u1 dimensions
+ *   NewArray           u1 array type
+ *   TableSwitch,
+ *   LookupSwitch       0-3 padding bytes to a 4-byte boundary, then s4 words
+ *   Wide               prefix modifying the next Local/Iinc instruction
+ */
+enum class OperandFormat : uint8_t {
+    Invalid,
+    None,
+    S1,
+    S2,
+    ConstPoolU1,
+    ConstPoolU2,
+    Local,
+    Iinc,
+    Branch2,
+    Branch4,
+    InvokeInterface,
+    InvokeDynamic,
+    MultiANewArray,
+    NewArray,
+    TableSwitch,
+    LookupSwitch,
+    Wide
+};
+
+// name, opcode, total length (0 when variable), operand format
+#define SJBCDC_OPCODES(X) \
+    X(nop,             0x00, 1, None) \
+    X(aconst_null,     0x01, 1, None) \
+    X(iconst_m1,       0x02, 1, None) \
+    X(iconst_0,        0x03, 1, None) \
+    X(iconst_1,        0x04, 1, None) \
+    X(iconst_2,        0x05, 1, None) \
+    X(iconst_3,        0x06, 1, None) \
+    X(iconst_4,        0x07, 1, None) \
+    X(iconst_5,        0x08, 1, None) \
+    X(lconst_0,        0x09, 1, None) \
+    X(lconst_1,        0x0a, 1, None) \
+    X(fconst_0,        0x0b, 1, None) \
+    X(fconst_1,        0x0c, 1, None) \
+    X(fconst_2,        0x0d, 1, None) \
+    X(dconst_0,        0x0e, 1, None) \
+    X(dconst_1,        0x0f, 1, None) \
+    X(bipush,          0x10, 2, S1) \
+    X(sipush,          0x11, 3, S2) \
+    X(ldc,             0x12, 2, ConstPoolU1) \
+    X(ldc_w,           0x13, 3, ConstPoolU2) \
+    X(ldc2_w,          0x14, 3, ConstPoolU2) \
+    X(iload,           0x15, 2, Local) \
+    X(lload,           0x16, 2, Local) \
+    X(fload,           0x17, 2, Local) \
+    X(dload,           0x18, 2, Local) \
+    X(aload,           0x19, 2, Local) \
+    X(iload_0,         0x1a, 1, None) \
+    X(iload_1,         0x1b, 1, None) \
+    X(iload_2,         0x1c, 1, None) \
+    X(iload_3,         0x1d, 1, None) \
+    X(lload_0,         0x1e, 1, None) \
+    X(lload_1,         0x1f, 1, None) \
+    X(lload_2,         0x20, 1, None) \
+    X(lload_3,         0x21, 1, None) \
+    X(fload_0,         0x22, 1, None) \
+    X(fload_1,         0x23, 1, None) \
+    X(fload_2,         0x24, 1, None) \
+    X(fload_3,         0x25, 1, None) \
+    X(dload_0,         0x26, 1, None) \
+    X(dload_1,         0x27, 1, None) \
+    X(dload_2,         0x28, 1, None) \
+    X(dload_3,         0x29, 1, None) \
+    X(aload_0,         0x2a, 1, None) \
+    X(aload_1,         0x2b, 1, None) \
+    X(aload_2,         0x2c, 1, None) \
+    X(aload_3,         0x2d, 1, None) \
+    X(iaload,          0x2e, 1, None) \
+    X(laload,          0x2f, 1, None) \
+    X(faload,          0x30, 1, None) \
+    X(daload,          0x31, 1, None) \
+    X(aaload,          0x32, 1, None) \
+    X(baload,          0x33, 1, None) \
+    X(caload,          0x34, 1, None) \
+    X(saload,          0x35, 1, None) \
+    X(istore,          0x36, 2, Local) \
+    X(lstore,          0x37, 2, Local) \
+    X(fstore,          0x38, 2, Local) \
+    X(dstore,          0x39, 2, Local) \
+    X(astore,          0x3a, 2, Local) \
+    X(istore_0,        0x3b, 1, None) \
+    X(istore_1,        0x3c, 1, None) \
+    X(istore_2,        0x3d, 1, None) \
+    X(istore_3,        0x3e, 1, None) \
+    X(lstore_0,        0x3f, 1, None) \
+    X(lstore_1,        0x40, 1, None) \
+    X(lstore_2,        0x41, 1, None) \
+    X(lstore_3,        0x42, 1, None) \
+    X(fstore_0,        0x43, 1, None) \
+    X(fstore_1,        0x44, 1, None) \
+    X(fstore_2,        0x45, 1, None) \
+    X(fstore_3,        0x46, 1, None) \
+    X(dstore_0,        0x47, 1, None) \
+    X(dstore_1,        0x48, 1, None) \
+    X(dstore_2,        0x49, 1, None) \
+    X(dstore_3,        0x4a, 1, None) \
+    X(astore_0,        0x4b, 1, None) \
+    X(astore_1,        0x4c, 1, None) \
+    X(astore_2,        0x4d, 1, None) \
+    X(astore_3,        0x4e, 1, None) \
+    X(iastore,         0x4f, 1, None) \
+    X(lastore,         0x50, 1, None) \
+    X(fastore,         0x51, 1, None) \
+    X(dastore,         0x52, 1, None) \
+    X(aastore,         0x53, 1, None) \
+    X(bastore,         0x54, 1, None) \
+    X(castore,         0x55, 1, None) \
+    X(sastore,         0x56, 1, None) \
+    X(pop,             0x57, 1, None) \
+    X(pop2,            0x58, 1, None) \
+    X(dup,             0x59, 1, None) \
+    X(dup_x1,          0x5a, 1, None) \
+    X(dup_x2,          0x5b, 1, None) \
+    X(dup2,            0x5c, 1, None) \
+    X(dup2_x1,         0x5d, 1, None) \
+    X(dup2_x2,         0x5e, 1, None) \
+    X(swap,            0x5f, 1, None) \
+    X(iadd,            0x60, 1, None) \
+    X(ladd,            0x61, 1, None) \
+    X(fadd,            0x62, 1, None) \
+    X(dadd,            0x63, 1, None) \
+    X(isub,            0x64, 1, None) \
+    X(lsub,            0x65, 1, None) \
+    X(fsub,            0x66, 1, None) \
+    X(dsub,            0x67, 1, None) \
+    X(imul,            0x68, 1, None) \
+    X(lmul,            0x69, 1, None) \
+    X(fmul,            0x6a, 1, None) \
+    X(dmul,            0x6b, 1, None) \
+    X(idiv,            0x6c, 1, None) \
+    X(ldiv,            0x6d, 1, None) \
+    X(fdiv,            0x6e, 1, None) \
+    X(ddiv,            0x6f, 1, None) \
+    X(irem,            0x70, 1, None) \
+    X(lrem,            0x71, 1, None) \
+    X(frem,            0x72, 1, None) \
+    X(drem,            0x73, 1, None) \
+    X(ineg,            0x74, 1, None) \
+    X(lneg,            0x75, 1, None) \
+    X(fneg,            0x76, 1, None) \
+    X(dneg,            0x77, 1, None) \
+    X(ishl,            0x78, 1, None) \
+    X(lshl,            0x79, 1, None) \
+    X(ishr,            0x7a, 1, None) \
+    X(lshr,            0x7b, 1, None) \
+    X(iushr,           0x7c, 1, None) \
+    X(lushr,           0x7d, 1, None) \
+    X(iand,            0x7e, 1, None) \
+    X(land,            0x7f, 1, None) \
+    X(ior,             0x80, 1, None) \
+    X(lor,             0x81, 1, None) \
+    X(ixor,            0x82, 1, None) \
+    X(lxor,            0x83, 1, None) \
+    X(iinc,            0x84, 3, Iinc) \
+    X(i2l,             0x85, 1, None) \
+    X(i2f,             0x86, 1, None) \
+    X(i2d,             0x87, 1, None) \
+    X(l2i,             0x88, 1, None) \
+    X(l2f,             0x89, 1, None) \
+    X(l2d,             0x8a, 1, None) \
+    X(f2i,             0x8b, 1, None) \
+    X(f2l,             0x8c, 1, None) \
+    X(f2d,             0x8d, 1, None) \
+    X(d2i,             0x8e, 1, None) \
+    X(d2l,             0x8f, 1, None) \
+    X(d2f,             0x90, 1, None) \
+    X(i2b,             0x91, 1, None) \
+    X(i2c,             0x92, 1, None) \
+    X(i2s,             0x93, 1, None) \
+    X(lcmp,            0x94, 1, None) \
+    X(fcmpl,           0x95, 1, None) \
+    X(fcmpg,           0x96, 1, None) \
+    X(dcmpl,           0x97, 1, None) \
+    X(dcmpg,           0x98, 1, None) \
+    X(ifeq,            0x99, 3, Branch2) \
+    X(ifne,            0x9a, 3, Branch2) \
+    X(iflt,            0x9b, 3, Branch2) \
+    X(ifge,            0x9c, 3, Branch2) \
+    X(ifgt,            0x9d, 3, Branch2) \
+    X(ifle,            0x9e, 3, Branch2) \
+    X(if_icmpeq,       0x9f, 3, Branch2) \
+    X(if_icmpne,       0xa0, 3, Branch2) \
+    X(if_icmplt,       0xa1, 3, Branch2) \
+    X(if_icmpge,       0xa2, 3, Branch2) \
+    X(if_icmpgt,       0xa3, 3, Branch2) \
+    X(if_icmple,       0xa4, 3, Branch2) \
+    X(if_acmpeq,       0xa5, 3, Branch2) \
+    X(if_acmpne,       0xa6, 3, Branch2) \
+    X(goto,            0xa7, 3, Branch2) \
+    X(jsr,             0xa8, 3, Branch2) \
+    X(ret,             0xa9, 2, Local) \
+    X(tableswitch,     0xaa, 0, TableSwitch) \
+    X(lookupswitch,    0xab, 0, LookupSwitch) \
+    X(ireturn,         0xac, 1, None) \
+    X(lreturn,         0xad, 1, None) \
+    X(freturn,         0xae, 1, None) \
+    X(dreturn,         0xaf, 1, None) \
+    X(areturn,         0xb0, 1, None) \
+    X(return,          0xb1, 1, None) \
+    X(getstatic,       0xb2, 3, ConstPoolU2) \
+    X(putstatic,       0xb3, 3, ConstPoolU2) \
+    X(getfield,        0xb4, 3, ConstPoolU2) \
+    X(putfield,        0xb5, 3, ConstPoolU2) \
+    X(invokevirtual,   0xb6, 3, ConstPoolU2) \
+    X(invokespecial,   0xb7, 3, ConstPoolU2) \
+    X(invokestatic,    0xb8, 3, ConstPoolU2) \
+    X(invokeinterface, 0xb9, 5, InvokeInterface) \
+    X(invokedynamic,   0xba, 5, InvokeDynamic) \
+    X(new,             0xbb, 3, ConstPoolU2) \
+    X(newarray,        0xbc, 2, NewArray) \
+    X(anewarray,       0xbd, 3, ConstPoolU2) \
+    X(arraylength,     0xbe, 1, None) \
+    X(athrow,          0xbf, 1, None) \
+    X(checkcast,       0xc0, 3, ConstPoolU2) \
+    X(instanceof,      0xc1, 3, ConstPoolU2) \
+    X(monitorenter,    0xc2, 1, None) \
+    X(monitorexit,     0xc3, 1, None) \
+    X(wide,            0xc4, 0, Wide) \
+    X(multianewarray,  0xc5, 4, MultiANewArray) \
+    X(ifnull,          0xc6, 3, Branch2) \
+    X(ifnonnull,       0xc7, 3, Branch2) \
+    X(goto_w,          0xc8, 5, Branch4) \
+    X(jsr_w,           0xc9, 5, Branch4)
+
+
+enum Opcode : uint8_t {
+#define SJBCDC_OPCODE_ENUM(name, code, length, format) OPCODE_##name = code,
+    SJBCDC_OPCODES(SJBCDC_OPCODE_ENUM)
+#undef SJBCDC_OPCODE_ENUM
+};
+
+struct OpcodeInfo {
+    std::string_view name;
+    uint8_t length;
+    OperandFormat format;
+};
+
+constexpr std::array<OpcodeInfo, 256> opcodeTable = [] {
+    std::array<OpcodeInfo, 256> table{};
+    for (auto &info : table) {
+        info = { "", 0, OperandFormat::Invalid };
+    }
+#define SJBCDC_OPCODE_INFO(name, code, length, format) table[code] = { #name, length, OperandFormat::format };
+    SJBCDC_OPCODES(SJBCDC_OPCODE_INFO)
+#undef SJBCDC_OPCODE_INFO
+    return table;
+}();
+
+// separate dense tables for the decode loop, which only needs lengths and formats
+constexpr std::array<uint8_t, 256> opcodeLengths = [] {
+    std::array<uint8_t, 256> lengths{};
+    for (size_t op = 0; op < 256; op++) {
+        lengths[op] = opcodeTable[op].length;
+    }
+    return lengths;
+}();
+
+constexpr std::array<OperandFormat, 256> opcodeFormats = [] {
+    std::array<OperandFormat, 256> formats{};
+    for (size_t op = 0; op < 256; op++) {
+        formats[op] = opcodeTable[op].format;
+    }
+    return formats;
+}();
+
+constexpr std::string_view
+opcodeName(uint8_t opcode) { return opcodeTable[opcode].name; }
+
+
+/*
+ * One decoded instruction. Operands are read from the code bytes by the
+ * accessors only when asked for, so walking the code costs one table lookup
+ * per instruction (plus the switch headers).
+ */
+struct Instruction {
+    const uint8_t *bytes;   // the opcode byte, or the wide prefix
+    uint32_t pc;
+    uint32_t length;        // including wide prefix and switch padding
+    uint8_t opcode;         // the modified opcode for wide instructions
+    bool wide;
+    OperandFormat format;
+
+    static constexpr int32_t
+    s4(const uint8_t *p) { return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]); }
+
+    static constexpr uint16_t
+    u2(const uint8_t *p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+    const uint8_t *
+    operands() const { return bytes + (wide ? 2 : 1); }
+
+    // ConstPoolU1/U2, InvokeInterface, InvokeDynamic, MultiANewArray
+    uint16_t
+    cpIndex() const { return (format == OperandFormat::ConstPoolU1) ? operands()[0] : u2(operands()); }
+
+    // Local and Iinc
+    uint16_t
+    local() const { return wide ? u2(operands()) : operands()[0]; }
+
+    int16_t
+    iincConst() const { return wide ? (int16_t)u2(operands() + 2) : (int8_t)operands()[1]; }
+
+    // bipush / sipush
+    int16_t
+    immediate() const { return (format == OperandFormat::S1) ? (int8_t)operands()[0] : (int16_t)u2(operands()); }
+
+    int32_t
+    branchOffset() const { return (format == OperandFormat::Branch2) ? (int16_t)u2(operands()) : s4(operands()); }
+
+    uint32_t
+    branchTarget() const { return pc + branchOffset(); }
+
+    uint8_t
+    invokeInterfaceCount() const { return operands()[2]; }
+
+    uint8_t
+    dimensions() const { return operands()[2]; }
+
+    uint8_t
+    arrayType() const { return operands()[0]; }
+
+    // switch instructions: padding bytes after the opcode and the aligned s4 words
+    uint32_t
+    padding() const { return (4 - ((pc + 1) & 3)) & 3; }
+
+    const uint8_t *
+    switchWords() const { return bytes + 1 + padding(); }
+
+    int32_t
+    switchDefault() const { return s4(switchWords()); }
+
+    int32_t
+    tableLow() const { return s4(switchWords() + 4); }
+
+    int32_t
+    tableHigh() const { return s4(switchWords() + 8); }
+
+    // i in [0, tableHigh() - tableLow()]
+    int32_t
+    tableOffset(uint32_t i) const { return s4(switchWords() + 12 + 4 * i); }
+
+    uint32_t
+    lookupPairs() const { return (uint32_t)s4(switchWords() + 4); }
+
+    int32_t
+    lookupMatch(uint32_t i) const { return s4(switchWords() + 8 + 8 * i); }
+
+    int32_t
+    lookupOffset(uint32_t i) const { return s4(switchWords() + 12 + 8 * i); }
+};
+
+
+/*
+ * Allocation-free walk over the code array of a Code attribute. next()
+ * returns false at the end of the code or on a malformed instruction, which
+ * error() tells apart.
+ */
+class BytecodeIterator {
+private:
+    const uint8_t *m_code;
+    uint32_t m_size;
+    uint32_t m_pc = 0;
+    bool m_error = false;
+
+    bool
+    fail() {
+        m_error = true;
+        return false;
+    }
+
+    bool
+    decodeVariable(Instruction &insn, uint8_t opcode);
+
+public:
+    explicit BytecodeIterator(std::span<const uint8_t> code)
+        : m_code(code.data()), m_size((uint32_t)code.size()) {}
+
+    bool
+    error() const { return m_error; }
+
+    uint32_t
+    pc() const { return m_pc; }
+
+    bool
+    next(Instruction &insn) {
+        if (m_pc >= m_size) {
+            return false;
+        }
+        uint8_t opcode = m_code[m_pc];
+        uint32_t length = opcodeLengths[opcode];
+        if (length == 0) {
+            return decodeVariable(insn, opcode);
+        }
+        if (length > m_size - m_pc) {
+            return fail();
+        }
+
+        insn = { m_code + m_pc, m_pc, length, opcode, false, opcodeFormats[opcode] };
+        m_pc += length;
+        return true;
+    }
+};
+
+
+// wide, tableswitch, lookupswitch and invalid opcodes
+inline bool
+BytecodeIterator::decodeVariable(Instruction &insn, uint8_t opcode) {
+    uint32_t left = m_size - m_pc;
+    const uint8_t *bytes = m_code + m_pc;
+
+    switch (opcodeFormats[opcode]) {
+        case OperandFormat::Wide: {
+            if (left < 2) {
+                return fail();
+            }
+            uint8_t modified = bytes[1];
+            OperandFormat format = opcodeFormats[modified];
+            uint32_t length;
+            if (format == OperandFormat::Local) {
+                length = 4;
+            } else if (format == OperandFormat::Iinc) {
+                length = 6;
+            } else {
+                return fail();
+            }
+            if (length > left) {
+                return fail();
+            }
+            insn = { bytes, m_pc, length, modified, true, format };
+            m_pc += length;
+            return true;
+        }
+        case OperandFormat::TableSwitch: {
+            uint32_t padding = (4 - ((m_pc + 1) & 3)) & 3;
+            uint32_t header = 1 + padding + 12;
+            if (header > left) {
+                return fail();
+            }
+            int32_t low = Instruction::s4(bytes + 1 + padding + 4);
+            int32_t high = Instruction::s4(bytes + 1 + padding + 8);
+            if (high < low) {
+                return fail();
+            }
+            uint64_t length = header + 4 * ((uint64_t)high - low + 1);
+            if (length > left) {
+                return fail();
+            }
+            insn = { bytes, m_pc, (uint32_t)length, opcode, false, OperandFormat::TableSwitch };
+            m_pc += (uint32_t)length;
+            return true;
+        }
+        case OperandFormat::LookupSwitch: {
+            uint32_t padding = (4 - ((m_pc + 1) & 3)) & 3;
+            uint32_t header = 1 + padding + 8;
+            if (header > left) {
+                return fail();
+            }
+            int32_t npairs = Instruction::s4(bytes + 1 + padding + 4);
+            if (npairs < 0) {
+                return fail();
+            }
+            uint64_t length = header + 8 * (uint64_t)npairs;
+            if (length > left) {
+                return fail();
+            }
+            insn = { bytes, m_pc, (uint32_t)length, opcode, false, OperandFormat::LookupSwitch };
+            m_pc += (uint32_t)length;
+            return true;
+        }
+        default: {
+            return fail();
+        }
+    }
+}
+
+#endif //SJBCDC_BYTECODE_HPP
@@ -0,0 +1,1801 @@
+#include "bytecodeVerifier.hpp"
+#include "bytecode.hpp"
+#include "classFileRead.hpp"
+#include "classHierarchy.hpp"
+#include "descriptorCache.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <functional>
+
+
+constexpr static auto
+errorMessages = std::to_array<std::string_view>({
+    "",
+    "Class file version needs the type inference verifier",
+    "Missing Code attribute",
+    "Invalid Code attribute",
+    "Invalid instruction",
+    "Invalid StackMapTable",
+    "Invalid constant operand",
+    "Invalid local variable",
+    "Operand stack overflow",
+    "Operand stack underflow",
+    "Type mismatch",
+    "Invalid branch target",
+    "Type state does not match the stack map frame",
+    "Missing stack map frame",
+    "Falls off the end of the code",
+    "Invalid exception handler",
+    "Invalid return",
+    "Uninitialized object"
+});
+static_assert(errorMessages.size() == (size_t)VerifyErrorCode::Count);
+
+
+// first class file version verified by type checking (JVMS 4.10)
+constexpr static uint16_t
+typeCheckingMajorVersion = 50;
+
+constexpr static uint16_t
+accStatic = 0x0008;
+
+constexpr static uint16_t
+accNative = 0x0100;
+
+constexpr static uint16_t
+accAbstract = 0x0400;
+
+constexpr static size_t
+maxArrayDimensions = 255;
+
+
+std::string_view
+verifyErrorMessage(VerifyErrorCode code) {
+    return ((size_t)code < errorMessages.size()) ? errorMessages[(size_t)code] : std::string_view();
+}
+
+
+std::string
+formatVerifyError(std::string_view name, const ClassFile &classFile, const VerifyError &error) {
+    if (!error) {
+        return {};
+    }
+    std::string text = std::string(name) + ": ";
+    if (error.method < classFile.methods().size()) {
+        const MemberInfo &method = classFile.methods()[error.method];
+        text += "method " + std::string(classFile.utf8(method.nameIndex)) +
+                std::string(classFile.utf8(method.descriptorIndex)) + ", pc " + std::to_string(error.pc) + ": ";
+    }
+    return text + std::string(verifyErrorMessage(error.code));
+}
+
+
+/*
+ * Verification types of JVMS 4.10.1.2. A long or double takes two slots,
+ * the second one Top, in the locals and on the operand stack alike; a Top
+ * on the stack is therefore always the second half of one. Arrays are
+ * references with dimensions and the element type, classes references
+ * with no dimensions; an Object element refers to a name by its id in the
+ * verifier's name table.
+ */
+enum class TypeKind : uint8_t {
+    Top,
+    Integer,
+    Float,
+    Long,
+    Double,
+    Null,
+    UninitializedThis,
+    Uninitialized,      // value is the offset of the new instruction
+    Reference
+};
+
+struct VType {
+    TypeKind kind = TypeKind::Top;
+    uint8_t dimensions = 0;
+    BaseType element = BaseType::Object;
+    uint32_t value = 0;
+
+    bool
+    operator==(const VType &other) const = default;
+
+    bool
+    isCategory2() const { return (kind == TypeKind::Long) || (kind == TypeKind::Double); }
+
+    bool
+    isReference() const { return kind >= TypeKind::Null; }
+};
+
+constexpr static VType
+topType{ TypeKind::Top };
+
+constexpr static VType
+intType{ TypeKind::Integer };
+
+constexpr static VType
+floatType{ TypeKind::Float };
+
+constexpr static VType
+longType{ TypeKind::Long };
+
+constexpr static VType
+doubleType{ TypeKind::Double };
+
+constexpr static VType
+nullType{ TypeKind::Null };
+
+constexpr static VType
+uninitializedThisType{ TypeKind::UninitializedThis };
+
+
+// names every method may need, interned first so their ids are fixed
+enum WellKnownName : uint32_t {
+    NameObject,
+    NameCloneable,
+    NameSerializable,
+    NameThrowable,
+    NameString,
+    NameClass,
+    NameMethodType,
+    NameMethodHandle,
+    WellKnownNameCount
+};
+
+constexpr static std::array<std::string_view, WellKnownNameCount>
+wellKnownNames = {
+    "java/lang/Object", "java/lang/Cloneable", "java/io/Serializable", "java/lang/Throwable",
+    "java/lang/String", "java/lang/Class", "java/lang/invoke/MethodType", "java/lang/invoke/MethodHandle"
+};
+
+constexpr static VType
+classType(uint32_t name) { return { TypeKind::Reference, 0, BaseType::Object, name }; }
+
+
+/*
+ * Stack effects of the instructions that only pop and push primitive
+ * values: "JI>J" pops an int (the top) and a long, then pushes a long
+ */
+constexpr static auto
+simpleEffects = [] {
+    std::array<std::string_view, 256> effects{};
+    auto set = [&](std::initializer_list<uint8_t> opcodes, std::string_view effect) {
+        for (uint8_t opcode : opcodes) {
+            effects[opcode] = effect;
+        }
+    };
+    set({ OPCODE_iconst_m1, OPCODE_iconst_0, OPCODE_iconst_1, OPCODE_iconst_2, OPCODE_iconst_3, OPCODE_iconst_4,
+          OPCODE_iconst_5, OPCODE_bipush, OPCODE_sipush }, ">I");
+    set({ OPCODE_lconst_0, OPCODE_lconst_1 }, ">J");
+    set({ OPCODE_fconst_0, OPCODE_fconst_1, OPCODE_fconst_2 }, ">F");
+    set({ OPCODE_dconst_0, OPCODE_dconst_1 }, ">D");
+    set({ OPCODE_iadd, OPCODE_isub, OPCODE_imul, OPCODE_idiv, OPCODE_irem, OPCODE_ishl, OPCODE_ishr,
+          OPCODE_iushr, OPCODE_iand, OPCODE_ior, OPCODE_ixor }, "II>I");
+    set({ OPCODE_ladd, OPCODE_lsub, OPCODE_lmul, OPCODE_ldiv, OPCODE_lrem, OPCODE_land, OPCODE_lor,
+          OPCODE_lxor }, "JJ>J");
+    set({ OPCODE_lshl, OPCODE_lshr, OPCODE_lushr }, "JI>J");
+    set({ OPCODE_fadd, OPCODE_fsub, OPCODE_fmul, OPCODE_fdiv, OPCODE_frem }, "FF>F");
+    set({ OPCODE_dadd, OPCODE_dsub, OPCODE_dmul, OPCODE_ddiv, OPCODE_drem }, "DD>D");
+    set({ OPCODE_ineg, OPCODE_i2b, OPCODE_i2c, OPCODE_i2s }, "I>I");
+    set({ OPCODE_lneg }, "J>J");
+    set({ OPCODE_fneg }, "F>F");
+    set({ OPCODE_dneg }, "D>D");
+    set({ OPCODE_i2l }, "I>J");
+    set({ OPCODE_i2f }, "I>F");
+    set({ OPCODE_i2d }, "I>D");
+    set({ OPCODE_l2i }, "J>I");
+    set({ OPCODE_l2f }, "J>F");
+    set({ OPCODE_l2d }, "J>D");
+    set({ OPCODE_f2i }, "F>I");
+    set({ OPCODE_f2l }, "F>J");
+    set({ OPCODE_f2d }, "F>D");
+    set({ OPCODE_d2i }, "D>I");
+    set({ OPCODE_d2l }, "D>J");
+    set({ OPCODE_d2f }, "D>F");
+    set({ OPCODE_lcmp }, "JJ>I");
+    set({ OPCODE_fcmpl, OPCODE_fcmpg }, "FF>I");
+    set({ OPCODE_dcmpl, OPCODE_dcmpg }, "DD>I");
+    set({ OPCODE_ifeq, OPCODE_ifne, OPCODE_iflt, OPCODE_ifge, OPCODE_ifgt, OPCODE_ifle }, "I>");
+    set({ OPCODE_if_icmpeq, OPCODE_if_icmpne, OPCODE_if_icmplt, OPCODE_if_icmpge, OPCODE_if_icmpgt,
+          OPCODE_if_icmple }, "II>");
+    return effects;
+}();
+
+
+static VType
+primitiveType(char letter) {
+    switch (letter) {
+        case 'J': {
+            return longType;
+        }
+        case 'F': {
+            return floatType;
+        }
+        case 'D': {
+            return doubleType;
+        }
+        default: {
+            return intType;
+        }
+    }
+}
+
+
+class BytecodeVerifier::Impl {
+private:
+    // a decoded stack map frame: maxLocals locals, then stackSize stack slots, from m_frameTypes[firstType]
+    struct Frame {
+        uint32_t offset;
+        uint32_t firstType;
+        uint16_t stackSize;
+        bool thisUninit;
+    };
+
+    struct Handler {
+        uint16_t startPc;
+        uint16_t endPc;
+        uint32_t frame;     // index in m_frames
+        VType catchType;
+    };
+
+    // a field or method reference operand
+    struct MemberRef {
+        uint16_t classIndex;
+        std::string_view name;
+        const ParsedDescriptor *descriptor;
+    };
+
+    const ClassHierarchy *m_hierarchy;
+
+    // names of the current class, open addressed by hash; slots hold id + 1
+    std::vector<std::string_view> m_names;
+    std::vector<uint32_t> m_nameClassIds;       // ClassId in m_hierarchy, unresolvedClass until looked up
+    std::vector<uint32_t> m_nameSlots;
+    // CONSTANT_Class operands of the current class resolved to types; 0 unresolved, 1 valid, 2 invalid
+    std::vector<VType> m_classTypes;
+    std::vector<uint8_t> m_classTypeStates;
+
+    // storage of the current method, reused by the next one
+    std::vector<uint8_t> m_instructionStarts;
+    std::vector<Frame> m_frames;
+    std::vector<VType> m_frameTypes;
+    std::vector<Handler> m_handlers;
+    std::vector<VType> m_locals;
+    std::vector<VType> m_stack;
+
+    const ClassFile *m_classFile = nullptr;
+    std::span<const uint8_t> m_classBytes;      // of m_classFile when beginClass() saw it
+    VType m_thisType;
+    std::span<const uint8_t> m_code;
+    const ParsedDescriptor *m_descriptor = nullptr;
+    bool m_isInit = false;
+    uint16_t m_maxLocals = 0;
+    uint16_t m_maxStack = 0;
+    size_t m_stackSize = 0;
+    bool m_thisUninit = false;
+    uint32_t m_pc = 0;
+    VerifyError m_error;
+
+    constexpr static uint32_t unresolvedClass = UINT32_MAX - 1;
+
+    bool
+    fail(VerifyErrorCode code) {
+        m_error.code = code;
+        m_error.pc = m_pc;
+        return true;
+    }
+
+    uint32_t
+    intern(std::string_view name);
+
+    bool
+    typeFromClassName(std::string_view name, VType &type);
+
+    bool
+    resolveClass(uint16_t cpIdx, VType &type);
+
+    VType
+    typeOf(const ParsedDescriptor &descriptor, const DescriptorType &type);
+
+    bool
+    resolveMember(uint16_t cpIdx, uint32_t allowedTags, MemberRef &member);
+
+    bool
+    classAssignable(uint32_t from, uint32_t to);
+
+    bool
+    isAssignable(const VType &from, const VType &to);
+
+    void
+    initialFrame(size_t &localsSize);
+
+    bool
+    decodeFrameType(const uint8_t *&p, const uint8_t *end, VType *slots, size_t &count, size_t limit);
+
+    bool
+    decodeFrames(const CodeAttribute &code);
+
+    bool
+    decodeHandlers(const CodeAttribute &code);
+
+    const Frame *
+    frameAt(uint32_t offset) const;
+
+    bool
+    stateAssignable(const Frame &frame, bool withStack);
+
+    void
+    loadFrame(const Frame &frame);
+
+    bool
+    checkTarget(uint32_t target);
+
+    bool
+    checkHandlers();
+
+    bool
+    push(const VType &type);
+
+    bool
+    pop(const VType &expected);
+
+    bool
+    popValue(VType &value);
+
+    bool
+    popReference(VType &value);
+
+    bool
+    popArray(VType &array);
+
+    bool
+    load(uint16_t index, TypeKind kind);
+
+    bool
+    store(uint16_t index, TypeKind kind);
+
+    bool
+    copyUnder(size_t copied, size_t skipped);
+
+    bool
+    arrayLoad(uint8_t opcode);
+
+    bool
+    arrayStore(uint8_t opcode);
+
+    bool
+    loadConstant(uint16_t cpIdx, bool wide);
+
+    bool
+    fieldAccess(uint8_t opcode, uint16_t cpIdx);
+
+    bool
+    invoke(const Instruction &insn);
+
+    bool
+    execute(const Instruction &insn, bool &fallsThrough);
+
+    bool
+    verifyCode(const CodeAttribute &code);
+
+public:
+    explicit Impl(const ClassHierarchy *hierarchy) : m_hierarchy(hierarchy) {}
+
+    void
+    beginClass(const ClassFile &classFile);
+
+    // whether the class state is still that of classFile, not re-initialized in place since
+    bool
+    inClass(const ClassFile &classFile) const {
+        auto bytes = classFile.classBytes();
+        return (m_classFile == &classFile) && (m_classBytes.data() == bytes.data()) &&
+               (m_classBytes.size() == bytes.size());
+    }
+
+    VerifyError
+    verifyMethod(size_t methodNum);
+};
+
+
+void
+BytecodeVerifier::Impl::beginClass(const ClassFile &classFile) {
+    m_classFile = &classFile;
+    m_classBytes = classFile.classBytes();
+    m_names.clear();
+    m_nameClassIds.clear();
+    m_nameSlots.assign(std::max<size_t>(m_nameSlots.size(), 64), 0);
+    for (std::string_view name : wellKnownNames) {
+        intern(name);
+    }
+    m_thisType = classType(intern(classFile.thisClassName()));
+    m_classTypes.resize(classFile.constantPoolCount());
+    m_classTypeStates.assign(classFile.constantPoolCount(), 0);
+}
+
+
+uint32_t
+BytecodeVerifier::Impl::intern(std::string_view name) {
+    if (m_names.size() * 2 >= m_nameSlots.size()) {
+        m_nameSlots.assign(m_nameSlots.size() * 2, 0);
+        size_t mask = m_nameSlots.size() - 1;
+        for (uint32_t id = 0; id < m_names.size(); id++) {
+            size_t slot = std::hash<std::string_view>{}(m_names[id]) & mask;
+            while (m_nameSlots[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            m_nameSlots[slot] = id + 1;
+        }
+    }
+    size_t mask = m_nameSlots.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(name) & mask;
+    while (m_nameSlots[slot] != 0) {
+        if (m_names[m_nameSlots[slot] - 1] == name) {
+            return m_nameSlots[slot] - 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    m_names.push_back(name);
+    m_nameClassIds.push_back(unresolvedClass);
+    m_nameSlots[slot] = (uint32_t)m_names.size();
+    return (uint32_t)m_names.size() - 1;
+}
+
+
+// a CONSTANT_Class name: a class in internal form or an array descriptor
+bool
+BytecodeVerifier::Impl::typeFromClassName(std::string_view name, VType &type) {
+    size_t dimensions = 0;
+    while ((dimensions < name.size()) && (name[dimensions] == '[')) {
+        dimensions++;
+    }
+    if (dimensions == 0) {
+        if (name.empty()) {
+            return true;
+        }
+        type = classType(intern(name));
+        return false;
+    }
+    std::string_view element = name.substr(dimensions);
+    if (dimensions > maxArrayDimensions) {
+        return true;
+    }
+    if ((element.size() == 1) && (std::string_view("BCDFIJSZ").find(element[0]) != std::string_view::npos)) {
+        type = { TypeKind::Reference, (uint8_t)dimensions, (BaseType)element[0], 0 };
+        return false;
+    }
+    if ((element.size() > 2) && (element.front() == 'L') && (element.back() == ';')) {
+        type = { TypeKind::Reference, (uint8_t)dimensions, BaseType::Object,
+                 intern(element.substr(1, element.size() - 2)) };
+        return false;
+    }
+    return true;
+}
+
+
+bool
+BytecodeVerifier::Impl::resolveClass(uint16_t cpIdx, VType &type) {
+    if ((cpIdx == 0) || (cpIdx >= m_classTypeStates.size())) {
+        return true;
+    }
+    if (m_classTypeStates[cpIdx] == 0) {
+        bool invalid = (m_classFile->constantTag(cpIdx) != CONSTANT_Class) ||
+                       typeFromClassName(m_classFile->className(cpIdx), m_classTypes[cpIdx]);
+        m_classTypeStates[cpIdx] = invalid ? 2 : 1;
+    }
+    type = m_classTypes[cpIdx];
+    return m_classTypeStates[cpIdx] != 1;
+}
+
+
+// boolean, byte, char and short values are ints on the operand stack and in locals
+VType
+BytecodeVerifier::Impl::typeOf(const ParsedDescriptor &descriptor, const DescriptorType &type) {
+    uint32_t name = (type.base == BaseType::Object) ? intern(descriptor.className(type)) : 0;
+    if (type.dimensions != 0) {
+        return { TypeKind::Reference, type.dimensions, type.base, name };
+    }
+    switch (type.base) {
+        case BaseType::Long: {
+            return longType;
+        }
+        case BaseType::Double: {
+            return doubleType;
+        }
+        case BaseType::Float: {
+            return floatType;
+        }
+        case BaseType::Object: {
+            return classType(name);
+        }
+        case BaseType::Void: {
+            return topType;
+        }
+        default: {
+            return intType;
+        }
+    }
+}
+
+
+/*
+ * A Fieldref, Methodref, InterfaceMethodref or InvokeDynamic operand whose
+ * tag is in allowedTags (a bit per tag) with a valid descriptor of the
+ * matching kind; classIndex is 0 for InvokeDynamic
+ */
+bool
+BytecodeVerifier::Impl::resolveMember(uint16_t cpIdx, uint32_t allowedTags, MemberRef &member) {
+    uint8_t tag = m_classFile->constantTag(cpIdx);
+    auto ref = m_classFile->constant(cpIdx);
+    if (!((allowedTags >> tag) & 1) || !ref) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    const ClassFileConstants &constants = m_classFile->constants();
+    uint16_t nameAndTypeIndex;
+    switch (tag) {
+        case CONSTANT_Fieldref: {
+            member.classIndex = constants.fieldrefConsts[ref->idxInType].classIndex;
+            nameAndTypeIndex = constants.fieldrefConsts[ref->idxInType].nameAndTypeIndex;
+            break;
+        }
+        case CONSTANT_Methodref: {
+            member.classIndex = constants.methodrefConsts[ref->idxInType].classIndex;
+            nameAndTypeIndex = constants.methodrefConsts[ref->idxInType].nameAndTypeIndex;
+            break;
+        }
+        case CONSTANT_InterfaceMethodref: {
+            member.classIndex = constants.interfaceMetodrefConsts[ref->idxInType].classIndex;
+            nameAndTypeIndex = constants.interfaceMetodrefConsts[ref->idxInType].nameAndTypeIndex;
+            break;
+        }
+        default: {
+            member.classIndex = 0;
+            nameAndTypeIndex = constants.invokeDynamicConsts[ref->idxInType].nameAndTypeIndex;
+            break;
+        }
+    }
+    auto nameAndType = m_classFile->constant(nameAndTypeIndex);
+    if (!nameAndType || (nameAndType->type != CONSTANT_NameAndType)) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    const CONSTANT_NameAndTypeInfo &info = constants.nameAndTypeConsts[nameAndType->idxInType];
+    member.name = m_classFile->utf8(info.nameIndex);
+    member.descriptor = m_classFile->descriptor(info.descriptorIndex);
+    DescriptorKind kind = (tag == CONSTANT_Fieldref) ? DescriptorKind::Field : DescriptorKind::Method;
+    if ((member.descriptor == nullptr) || (member.descriptor->kind != kind)) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    return false;
+}
+
+
+/*
+ * Whether class from can be assigned to class to. Only a class whose whole
+ * superclass chain is defined in the hierarchy can be told not to be.
+ */
+bool
+BytecodeVerifier::Impl::classAssignable(uint32_t from, uint32_t to) {
+    if ((from == to) || (to == NameObject) || (m_hierarchy == nullptr)) {
+        return true;
+    }
+    for (uint32_t name : { from, to }) {
+        if (m_nameClassIds[name] == unresolvedClass) {
+            m_nameClassIds[name] = m_hierarchy->find(m_names[name]);
+        }
+    }
+    ClassId fromId = m_nameClassIds[from];
+    ClassId toId = m_nameClassIds[to];
+    if ((fromId == noClass) || (toId == noClass) || !m_hierarchy->defined(toId) || m_hierarchy->isInterface(toId) ||
+        m_hierarchy->isAssignable(fromId, toId)) {
+        return true;
+    }
+    for (ClassId id = fromId; id != noClass; id = m_hierarchy->superClass(id)) {
+        if (!m_hierarchy->defined(id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool
+BytecodeVerifier::Impl::isAssignable(const VType &from, const VType &to) {
+    if ((from == to) || (to.kind == TypeKind::Top)) {
+        return true;
+    }
+    if ((to.kind != TypeKind::Reference) || ((from.kind != TypeKind::Reference) && (from.kind != TypeKind::Null))) {
+        return false;
+    }
+    if (from.kind == TypeKind::Null) {
+        return true;
+    }
+
+    auto arrayInterface = [](uint32_t name) {
+        return (name == NameObject) || (name == NameCloneable) || (name == NameSerializable);
+    };
+    if (to.dimensions == 0) {
+        return (from.dimensions == 0) ? classAssignable(from.value, to.value) : arrayInterface(to.value);
+    }
+    if (from.dimensions < to.dimensions) {
+        return false;
+    }
+    if (to.element != BaseType::Object) {
+        return (from.dimensions == to.dimensions) && (from.element == to.element);
+    }
+    if (from.dimensions == to.dimensions) {
+        return (from.element == BaseType::Object) && classAssignable(from.value, to.value);
+    }
+    // the elements of to are arrays themselves when seen from from
+    return arrayInterface(to.value);
+}
+
+
+// locals on entry to the method (JVMS 4.10.1.6) into m_locals; localsSize is the slots they take
+void
+BytecodeVerifier::Impl::initialFrame(size_t &localsSize) {
+    std::fill(m_locals.begin(), m_locals.end(), topType);
+    localsSize = 0;
+    m_thisUninit = false;
+    const MemberInfo &method = m_classFile->methods()[m_error.method];
+    if (!(method.accessFlags & accStatic)) {
+        if (m_isInit && (m_thisType.value != NameObject)) {
+            m_locals[localsSize++] = uninitializedThisType;
+            m_thisUninit = true;
+        } else {
+            m_locals[localsSize++] = m_thisType;
+        }
+    }
+    for (const DescriptorType &parameter : m_descriptor->parameters()) {
+        VType type = typeOf(*m_descriptor, parameter);
+        m_locals[localsSize++] = type;
+        if (type.isCategory2()) {
+            m_locals[localsSize++] = topType;
+        }
+    }
+}
+
+
+// one verification_type_info appended to slots[count], a long or double with its second slot
+bool
+BytecodeVerifier::Impl::decodeFrameType(const uint8_t *&p, const uint8_t *end, VType *slots, size_t &count,
+                                        size_t limit) {
+    if (p >= end) {
+        return true;
+    }
+    uint8_t tag = *p++;
+    VType type;
+    switch (tag) {
+        case 0: {
+            type = topType;
+            break;
+        }
+        case 1: {
+            type = intType;
+            break;
+        }
+        case 2: {
+            type = floatType;
+            break;
+        }
+        case 3: {
+            type = doubleType;
+            break;
+        }
+        case 4: {
+            type = longType;
+            break;
+        }
+        case 5: {
+            type = nullType;
+            break;
+        }
+        case 6: {
+            type = uninitializedThisType;
+            break;
+        }
+        case 7:
+        case 8: {
+            if (end - p < 2) {
+                return true;
+            }
+            uint16_t operand = Instruction::u2(p);
+            p += 2;
+            if (tag == 7) {
+                if (resolveClass(operand, type)) {
+                    return true;
+                }
+                break;
+            }
+            // the offset of the new instruction creating the object
+            if ((operand >= m_code.size()) || !m_instructionStarts[operand] || (m_code[operand] != OPCODE_new)) {
+                return true;
+            }
+            type = { TypeKind::Uninitialized, 0, BaseType::Object, operand };
+            break;
+        }
+        default: {
+            return true;
+        }
+    }
+    size_t slots2 = type.isCategory2() ? 2 : 1;
+    if (count + slots2 > limit) {
+        return true;
+    }
+    slots[count++] = type;
+    if (slots2 == 2) {
+        slots[count++] = topType;
+    }
+    return false;
+}
+
+
+/*
+ * Expands every stack_map_frame (JVMS 4.7.4) against the one before it,
+ * starting from the initial frame. Frames come out sorted by offset.
+ */
+bool
+BytecodeVerifier::Impl::decodeFrames(const CodeAttribute &code) {
+    m_frames.clear();
+    m_frameTypes.clear();
+
+    std::optional<StackMapTableAttribute> table;
+    for (auto attribute : code.attributes) {
+        if (m_classFile->utf8(attribute.nameIndex) != "StackMapTable") {
+            continue;
+        }
+        if (table) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+        table = decodeStackMapTable(attribute.info);
+        if (!table) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+    }
+    if (!table) {
+        return false;
+    }
+
+    size_t localsSize;
+    initialFrame(localsSize);
+    const uint8_t *p = table->frames.data();
+    const uint8_t *end = p + table->frames.size();
+    auto readU2 = [&](uint16_t &value) {
+        if (end - p < 2) {
+            return true;
+        }
+        value = Instruction::u2(p);
+        p += 2;
+        return false;
+    };
+
+    int64_t offset = -1;
+    for (size_t frameNum = 0; frameNum < table->numberOfEntries; frameNum++) {
+        if (p >= end) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+        uint8_t frameType = *p++;
+        uint16_t delta = frameType;
+        size_t stackSize = 0;
+        if ((frameType >= 128) && (frameType < 247)) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+        if ((frameType >= 247) && readU2(delta)) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+        if ((frameType >= 64) && (frameType < 128)) {
+            delta = frameType - 64;
+        }
+        offset += delta + 1;
+        if ((offset >= (int64_t)m_code.size()) || !m_instructionStarts[offset]) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+
+        // the stack lands in m_stack, the locals are changed in place
+        bool invalid = false;
+        if (((frameType >= 64) && (frameType < 128)) || (frameType == 247)) {
+            invalid = decodeFrameType(p, end, m_stack.data(), stackSize, m_maxStack);
+        } else if ((frameType >= 248) && (frameType <= 250)) {
+            for (size_t chopped = 0; !invalid && (chopped < 251u - frameType); chopped++) {
+                if (localsSize == 0) {
+                    invalid = true;
+                    break;
+                }
+                localsSize -= ((localsSize >= 2) && m_locals[localsSize - 2].isCategory2()) ? 2 : 1;
+                std::fill(m_locals.begin() + (std::ptrdiff_t)localsSize, m_locals.end(), topType);
+            }
+        } else if ((frameType >= 252) && (frameType <= 254)) {
+            for (size_t appended = 0; !invalid && (appended < frameType - 251u); appended++) {
+                invalid = decodeFrameType(p, end, m_locals.data(), localsSize, m_maxLocals);
+            }
+        } else if (frameType == 255) {
+            uint16_t count;
+            std::fill(m_locals.begin(), m_locals.end(), topType);
+            localsSize = 0;
+            invalid = readU2(count);
+            for (size_t i = 0; !invalid && (i < count); i++) {
+                invalid = decodeFrameType(p, end, m_locals.data(), localsSize, m_maxLocals);
+            }
+            invalid = invalid || readU2(count);
+            for (size_t i = 0; !invalid && (i < count); i++) {
+                invalid = decodeFrameType(p, end, m_stack.data(), stackSize, m_maxStack);
+            }
+        }
+        // a Top on the stack is only ever the second slot of a long or double
+        for (size_t i = 0; !invalid && (i < stackSize); i++) {
+            invalid = (m_stack[i].kind == TypeKind::Top) && ((i == 0) || !m_stack[i - 1].isCategory2());
+        }
+        if (invalid) {
+            return fail(VerifyErrorCode::InvalidStackMapTable);
+        }
+
+        bool thisUninit = std::find(m_locals.begin(), m_locals.begin() + (std::ptrdiff_t)localsSize,
+                                    uninitializedThisType) != m_locals.begin() + (std::ptrdiff_t)localsSize;
+        m_frames.push_back({ (uint32_t)offset, (uint32_t)m_frameTypes.size(), (uint16_t)stackSize, thisUninit });
+        m_frameTypes.insert(m_frameTypes.end(), m_locals.begin(), m_locals.end());
+        m_frameTypes.insert(m_frameTypes.end(), m_stack.begin(), m_stack.begin() + (std::ptrdiff_t)stackSize);
+    }
+    if (p != end) {
+        return fail(VerifyErrorCode::InvalidStackMapTable);
+    }
+    return false;
+}
+
+
+bool
+BytecodeVerifier::Impl::decodeHandlers(const CodeAttribute &code) {
+    m_handlers.clear();
+    for (size_t i = 0; i < code.exceptionTableLength; i++) {
+        ExceptionTableEntry entry = code.exceptionTableEntry(i);
+        Handler handler{ entry.startPc, entry.endPc, 0, classType(NameThrowable) };
+        const Frame *frame = frameAt(entry.handlerPc);
+        if ((entry.startPc >= entry.endPc) || (entry.endPc > m_code.size()) || !m_instructionStarts[entry.startPc] ||
+            !m_instructionStarts[entry.endPc] || (frame == nullptr) || (frame->stackSize != 1) ||
+            ((entry.catchType != 0) && resolveClass(entry.catchType, handler.catchType)) ||
+            !isAssignable(handler.catchType, classType(NameThrowable))) {
+            return fail(VerifyErrorCode::InvalidExceptionHandler);
+        }
+        handler.frame = (uint32_t)(frame - m_frames.data());
+        m_handlers.push_back(handler);
+    }
+    return false;
+}
+
+
+const BytecodeVerifier::Impl::Frame *
+BytecodeVerifier::Impl::frameAt(uint32_t offset) const {
+    auto it = std::lower_bound(m_frames.begin(), m_frames.end(), offset,
+                               [](const Frame &frame, uint32_t value) { return frame.offset < value; });
+    return ((it != m_frames.end()) && (it->offset == offset)) ? &*it : nullptr;
+}
+
+
+// the current locals (and stack, unless withStack is false) assignable to frame's
+bool
+BytecodeVerifier::Impl::stateAssignable(const Frame &frame, bool withStack) {
+    if (m_thisUninit && !frame.thisUninit) {
+        return false;
+    }
+    const VType *types = m_frameTypes.data() + frame.firstType;
+    for (size_t i = 0; i < m_maxLocals; i++) {
+        if (!isAssignable(m_locals[i], types[i])) {
+            return false;
+        }
+    }
+    if (!withStack) {
+        return true;
+    }
+    if (m_stackSize != frame.stackSize) {
+        return false;
+    }
+    for (size_t i = 0; i < m_stackSize; i++) {
+        if (!isAssignable(m_stack[i], types[m_maxLocals + i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void
+BytecodeVerifier::Impl::loadFrame(const Frame &frame) {
+    const VType *types = m_frameTypes.data() + frame.firstType;
+    std::copy(types, types + m_maxLocals, m_locals.begin());
+    std::copy(types + m_maxLocals, types + m_maxLocals + frame.stackSize, m_stack.begin());
+    m_stackSize = frame.stackSize;
+    m_thisUninit = frame.thisUninit;
+}
+
+
+bool
+BytecodeVerifier::Impl::checkTarget(uint32_t target) {
+    const Frame *frame = frameAt(target);
+    if (frame == nullptr) {
+        return fail(VerifyErrorCode::InvalidBranchTarget);
+    }
+    return !stateAssignable(*frame, true) && fail(VerifyErrorCode::FrameMismatch);
+}
+
+
+// the incoming locals, with the caught exception as the only stack entry, against every handler covering m_pc
+bool
+BytecodeVerifier::Impl::checkHandlers() {
+    for (const Handler &handler : m_handlers) {
+        if ((m_pc < handler.startPc) || (m_pc >= handler.endPc)) {
+            continue;
+        }
+        const Frame &frame = m_frames[handler.frame];
+        if (!stateAssignable(frame, false) ||
+            !isAssignable(handler.catchType, m_frameTypes[frame.firstType + m_maxLocals])) {
+            return fail(VerifyErrorCode::InvalidExceptionHandler);
+        }
+    }
+    return false;
+}
+
+
+bool
+BytecodeVerifier::Impl::push(const VType &type) {
+    size_t slots = type.isCategory2() ? 2 : 1;
+    if (m_stackSize + slots > m_maxStack) {
+        return fail(VerifyErrorCode::StackOverflow);
+    }
+    m_stack[m_stackSize++] = type;
+    if (slots == 2) {
+        m_stack[m_stackSize++] = topType;
+    }
+    return false;
+}
+
+
+// a value assignable to expected; both slots of a long or double
+bool
+BytecodeVerifier::Impl::pop(const VType &expected) {
+    size_t slots = expected.isCategory2() ? 2 : 1;
+    if (m_stackSize < slots) {
+        return fail(VerifyErrorCode::StackUnderflow);
+    }
+    const VType &actual = m_stack[m_stackSize - slots];
+    if (!isAssignable(actual, expected)) {
+        return fail(VerifyErrorCode::TypeMismatch);
+    }
+    m_stackSize -= slots;
+    return false;
+}
+
+
+// any category 1 value
+bool
+BytecodeVerifier::Impl::popValue(VType &value) {
+    if (m_stackSize == 0) {
+        return fail(VerifyErrorCode::StackUnderflow);
+    }
+    value = m_stack[m_stackSize - 1];
+    if (value.kind == TypeKind::Top) {
+        return fail(VerifyErrorCode::TypeMismatch);
+    }
+    m_stackSize--;
+    return false;
+}
+
+
+// any reference, uninitialized ones included
+bool
+BytecodeVerifier::Impl::popReference(VType &value) {
+    if (popValue(value)) {
+        return true;
+    }
+    return !value.isReference() && fail(VerifyErrorCode::TypeMismatch);
+}
+
+
+// null or an array
+bool
+BytecodeVerifier::Impl::popArray(VType &array) {
+    if (popReference(array)) {
+        return true;
+    }
+    bool isArray = (array.kind == TypeKind::Null) || ((array.kind == TypeKind::Reference) && (array.dimensions > 0));
+    return !isArray && fail(VerifyErrorCode::TypeMismatch);
+}
+
+
+// kind Reference loads any reference
+bool
+BytecodeVerifier::Impl::load(uint16_t index, TypeKind kind) {
+    bool category2 = (kind == TypeKind::Long) || (kind == TypeKind::Double);
+    if ((size_t)index + (category2 ? 2 : 1) > m_maxLocals) {
+        return fail(VerifyErrorCode::InvalidLocal);
+    }
+    const VType &type = m_locals[index];
+    bool matches = (kind == TypeKind::Reference) ? type.isReference() : (type.kind == kind);
+    if (!matches) {
+        return fail(VerifyErrorCode::TypeMismatch);
+    }
+    return push(type);
+}
+
+
+bool
+BytecodeVerifier::Impl::store(uint16_t index, TypeKind kind) {
+    bool category2 = (kind == TypeKind::Long) || (kind == TypeKind::Double);
+    VType value;
+    if (kind == TypeKind::Reference) {
+        if (popReference(value)) {
+            return true;
+        }
+    } else {
+        value = { kind };
+        if (pop(value)) {
+            return true;
+        }
+    }
+    if ((size_t)index + (category2 ? 2 : 1) > m_maxLocals) {
+        return fail(VerifyErrorCode::InvalidLocal);
+    }
+    m_locals[index] = value;
+    if (category2) {
+        m_locals[index + 1] = topType;
+    }
+    // a long or double right below loses its second slot
+    if ((index > 0) && m_locals[index - 1].isCategory2()) {
+        m_locals[index - 1] = topType;
+    }
+    return false;
+}
+
+
+/*
+ * The dup family: copies the top copied slots below the skipped slots under
+ * them. Neither group may start inside a long or double.
+ */
+bool
+BytecodeVerifier::Impl::copyUnder(size_t copied, size_t skipped) {
+    size_t depth = copied + skipped;
+    if (m_stackSize < depth) {
+        return fail(VerifyErrorCode::StackUnderflow);
+    }
+    if ((m_stack[m_stackSize - copied].kind == TypeKind::Top) || (m_stack[m_stackSize - depth].kind == TypeKind::Top)) {
+        return fail(VerifyErrorCode::TypeMismatch);
+    }
+    if (m_stackSize + copied > m_maxStack) {
+        return fail(VerifyErrorCode::StackOverflow);
+    }
+    VType *base = m_stack.data() + m_stackSize - depth;
+    std::copy_backward(base, base + depth, base + depth + copied);
+    std::copy(base + depth, base + depth + copied, base);
+    m_stackSize += copied;
+    return false;
+}
+
+
+bool
+BytecodeVerifier::Impl::arrayLoad(uint8_t opcode) {
+    VType array;
+    if (pop(intType) || popArray(array)) {
+        return true;
+    }
+    if (opcode == OPCODE_aaload) {
+        if (array.kind == TypeKind::Null) {
+            return push(nullType);
+        }
+        if ((array.dimensions == 1) && (array.element != BaseType::Object)) {
+            return fail(VerifyErrorCode::TypeMismatch);
+        }
+        VType component = array;
+        component.dimensions--;
+        return push(component);
+    }
+
+    BaseType element;
+    switch (opcode) {
+        case OPCODE_iaload: {
+            element = BaseType::Int;
+            break;
+        }
+        case OPCODE_laload: {
+            element = BaseType::Long;
+            break;
+        }
+        case OPCODE_faload: {
+            element = BaseType::Float;
+            break;
+        }
+        case OPCODE_daload: {
+            element = BaseType::Double;
+            break;
+        }
+        case OPCODE_caload: {
+            element = BaseType::Char;
+            break;
+        }
+        case OPCODE_saload: {
+            element = BaseType::Short;
+            break;
+        }
+        default: {
+            // baload serves byte and boolean arrays
+            element = ((array.kind == TypeKind::Reference) && (array.element == BaseType::Boolean)) ? BaseType::Boolean
+                                                                                                    : BaseType::Byte;
+            break;
+        }
+    }
+    if ((array.kind == TypeKind::Reference) && ((array.dimensions != 1) || (array.element != element))) {
+        return fail(VerifyErrorCode::TypeMismatch);
+    }
+    return push(primitiveType((char)element));
+}
+
+
+bool
+BytecodeVerifier::Impl::arrayStore(uint8_t opcode) {
+    VType value;
+    BaseType element = BaseType::Object;
+    switch (opcode) {
+        case OPCODE_aastore: {
+            if (popReference(value)) {
+                return true;
+            }
+            break;
+        }
+        case OPCODE_lastore: {
+            element = BaseType::Long;
+            break;
+        }
+        case OPCODE_fastore: {
+            element = BaseType::Float;
+            break;
+        }
+        case OPCODE_dastore: {
+            element = BaseType::Double;
+            break;
+        }
+        case OPCODE_iastore: {
+            element = BaseType::Int;
+            break;
+        }
+        case OPCODE_castore: {
+            element = BaseType::Char;
+            break;
+        }
+        case OPCODE_sastore: {
+            element = BaseType::Short;
+            break;
+        }
+        default: {
+            element = BaseType::Byte;
+            break;
+        }
+    }
+    if ((element != BaseType::Object) && pop(primitiveType((char)element))) {
+        return true;
+    }
+    VType array;
+    if (pop(intType) || popArray(array)) {
+        return true;
+    }
+    if (array.kind == TypeKind::Null) {
+        return false;
+    }
+    bool matches;
+    if (element == BaseType::Object) {
+        matches = (array.dimensions > 1) || (array.element == BaseType::Object);
+    } else if (element == BaseType::Byte) {
+        matches = (array.dimensions == 1) && ((array.element == BaseType::Byte) || (array.element == BaseType::Boolean));
+    } else {
+        matches = (array.dimensions == 1) && (array.element == element);
+    }
+    return !matches && fail(VerifyErrorCode::TypeMismatch);
+}
+
+
+// ldc, ldc_w (wide false) and ldc2_w
+bool
+BytecodeVerifier::Impl::loadConstant(uint16_t cpIdx, bool wide) {
+    uint8_t tag = m_classFile->constantTag(cpIdx);
+    VType type;
+    switch (tag) {
+        case CONSTANT_Integer: {
+            type = intType;
+            break;
+        }
+        case CONSTANT_Float: {
+            type = floatType;
+            break;
+        }
+        case CONSTANT_Long: {
+            type = longType;
+            break;
+        }
+        case CONSTANT_Double: {
+            type = doubleType;
+            break;
+        }
+        case CONSTANT_String: {
+            type = classType(NameString);
+            break;
+        }
+        case CONSTANT_Class: {
+            type = classType(NameClass);
+            break;
+        }
+        case CONSTANT_MethodType: {
+            type = classType(NameMethodType);
+            break;
+        }
+        case CONSTANT_MethodHandle: {
+            type = classType(NameMethodHandle);
+            break;
+        }
+        case CONSTANT_Dynamic: {
+            auto ref = m_classFile->constant(cpIdx);
+            const ClassFileConstants &constants = m_classFile->constants();
+            auto nameAndType = ref ? m_classFile->constant(constants.dynamicConsts[ref->idxInType].nameAndTypeIndex)
+                                   : std::nullopt;
+            if (!nameAndType || (nameAndType->type != CONSTANT_NameAndType)) {
+                return fail(VerifyErrorCode::InvalidConstant);
+            }
+            const ParsedDescriptor *descriptor =
+                    m_classFile->descriptor(constants.nameAndTypeConsts[nameAndType->idxInType].descriptorIndex);
+            if ((descriptor == nullptr) || (descriptor->kind != DescriptorKind::Field)) {
+                return fail(VerifyErrorCode::InvalidConstant);
+            }
+            type = typeOf(*descriptor, descriptor->returnType());
+            break;
+        }
+        default: {
+            return fail(VerifyErrorCode::InvalidConstant);
+        }
+    }
+    if (type.isCategory2() != wide) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    return push(type);
+}
+
+
+bool
+BytecodeVerifier::Impl::fieldAccess(uint8_t opcode, uint16_t cpIdx) {
+    MemberRef field;
+    VType owner;
+    if (resolveMember(cpIdx, 1u << CONSTANT_Fieldref, field) || resolveClass(field.classIndex, owner)) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    VType type = typeOf(*field.descriptor, field.descriptor->returnType());
+    switch (opcode) {
+        case OPCODE_getstatic: {
+            return push(type);
+        }
+        case OPCODE_putstatic: {
+            return pop(type);
+        }
+        case OPCODE_getfield: {
+            return pop(owner) || push(type);
+        }
+        default: {
+            if (pop(type)) {
+                return true;
+            }
+            // a constructor may set fields of its own class before calling super() (JVMS 4.10.1.9.putfield)
+            if ((m_stackSize > 0) && (m_stack[m_stackSize - 1] == uninitializedThisType) && (owner == m_thisType)) {
+                m_stackSize--;
+                return false;
+            }
+            return pop(owner);
+        }
+    }
+}
+
+
+bool
+BytecodeVerifier::Impl::invoke(const Instruction &insn) {
+    uint8_t opcode = insn.opcode;
+    uint32_t allowedTags;
+    switch (opcode) {
+        case OPCODE_invokevirtual: {
+            allowedTags = 1u << CONSTANT_Methodref;
+            break;
+        }
+        case OPCODE_invokeinterface: {
+            allowedTags = 1u << CONSTANT_InterfaceMethodref;
+            break;
+        }
+        case OPCODE_invokedynamic: {
+            allowedTags = 1u << CONSTANT_InvokeDynamic;
+            if ((insn.operands()[2] != 0) || (insn.operands()[3] != 0)) {
+                return fail(VerifyErrorCode::InvalidInstruction);
+            }
+            break;
+        }
+        default: {
+            allowedTags = (1u << CONSTANT_Methodref) | (1u << CONSTANT_InterfaceMethodref);
+            break;
+        }
+    }
+    MemberRef method;
+    VType owner;
+    if (resolveMember(insn.cpIndex(), allowedTags, method) ||
+        ((opcode != OPCODE_invokedynamic) && resolveClass(method.classIndex, owner))) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    bool isInit = method.name == "<init>";
+    if ((method.name.starts_with('<') && !(isInit && (opcode == OPCODE_invokespecial))) ||
+        (isInit && !method.descriptor->returnsVoid())) {
+        return fail(VerifyErrorCode::InvalidConstant);
+    }
+    if ((opcode == OPCODE_invokeinterface) &&
+        ((insn.invokeInterfaceCount() != method.descriptor->parameterSlots + 1) || (insn.operands()[3] != 0))) {
+        return fail(VerifyErrorCode::InvalidInstruction);
+    }
+
+    auto parameters = method.descriptor->parameters();
+    for (size_t i = parameters.size(); i > 0; i--) {
+        if (pop(typeOf(*method.descriptor, parameters[i - 1]))) {
+            return true;
+        }
+    }
+
+    if (isInit) {
+        // the object being constructed becomes initialized wherever it is
+        VType receiver;
+        if (popReference(receiver)) {
+            return true;
+        }
+        VType initialized;
+        if (receiver.kind == TypeKind::UninitializedThis) {
+            VType superType;
+            bool superCall = (m_classFile->superClass() != 0) && !resolveClass(m_classFile->superClass(), superType) &&
+                             (owner == superType);
+            if ((owner != m_thisType) && !superCall) {
+                return fail(VerifyErrorCode::UninitializedObject);
+            }
+            initialized = m_thisType;
+            m_thisUninit = false;
+        } else if (receiver.kind == TypeKind::Uninitialized) {
+            if (resolveClass(Instruction::u2(m_code.data() + receiver.value + 1), initialized) ||
+                (initialized != owner)) {
+                return fail(VerifyErrorCode::UninitializedObject);
+            }
+        } else {
+            return fail(VerifyErrorCode::UninitializedObject);
+        }
+        std::replace(m_locals.begin(), m_locals.end(), receiver, initialized);
+        std::replace(m_stack.begin(), m_stack.begin() + (std::ptrdiff_t)m_stackSize, receiver, initialized);
+        return false;
+    }
+
+    if (opcode == OPCODE_invokespecial) {
+        // only methods of this class and its superclasses, on this class or a subclass
+        if (pop(m_thisType)) {
+            return true;
+        }
+    } else if ((opcode == OPCODE_invokevirtual) || (opcode == OPCODE_invokeinterface)) {
+        if (pop(owner)) {
+            return true;
+        }
+    }
+    return !method.descriptor->returnsVoid() && push(typeOf(*method.descriptor, method.descriptor->returnType()));
+}
+
+
+bool
+BytecodeVerifier::Impl::execute(const Instruction &insn, bool &fallsThrough) {
+    uint8_t opcode = insn.opcode;
+    std::string_view effect = simpleEffects[opcode];
+    if (!effect.empty()) {
+        size_t arrow = effect.find('>');
+        for (size_t i = arrow; i > 0; i--) {
+            if (pop(primitiveType(effect[i - 1]))) {
+                return true;
+            }
+        }
+        for (size_t i = arrow + 1; i < effect.size(); i++) {
+            if (push(primitiveType(effect[i]))) {
+                return true;
+            }
+        }
+        return (insn.format == OperandFormat::Branch2) && checkTarget(insn.branchTarget());
+    }
+
+    VType value;
+    switch (opcode) {
+        case OPCODE_nop: {
+            return false;
+        }
+        case OPCODE_aconst_null: {
+            return push(nullType);
+        }
+        case OPCODE_ldc:
+        case OPCODE_ldc_w:
+        case OPCODE_ldc2_w: {
+            return loadConstant(insn.cpIndex(), opcode == OPCODE_ldc2_w);
+        }
+        case OPCODE_iload:
+        case OPCODE_lload:
+        case OPCODE_fload:
+        case OPCODE_dload:
+        case OPCODE_aload: {
+            constexpr TypeKind kinds[] = { TypeKind::Integer, TypeKind::Long, TypeKind::Float, TypeKind::Double,
+                                           TypeKind::Reference };
+            return load(insn.local(), kinds[opcode - OPCODE_iload]);
+        }
+        case OPCODE_istore:
+        case OPCODE_lstore:
+        case OPCODE_fstore:
+        case OPCODE_dstore:
+        case OPCODE_astore: {
+            constexpr TypeKind kinds[] = { TypeKind::Integer, TypeKind::Long, TypeKind::Float, TypeKind::Double,
+                                           TypeKind::Reference };
+            return store(insn.local(), kinds[opcode - OPCODE_istore]);
+        }
+        case OPCODE_iaload:
+        case OPCODE_laload:
+        case OPCODE_faload:
+        case OPCODE_daload:
+        case OPCODE_aaload:
+        case OPCODE_baload:
+        case OPCODE_caload:
+        case OPCODE_saload: {
+            return arrayLoad(opcode);
+        }
+        case OPCODE_iastore:
+        case OPCODE_lastore:
+        case OPCODE_fastore:
+        case OPCODE_dastore:
+        case OPCODE_aastore:
+        case OPCODE_bastore:
+        case OPCODE_castore:
+        case OPCODE_sastore: {
+            return arrayStore(opcode);
+        }
+        case OPCODE_pop: {
+            return popValue(value);
+        }
+        case OPCODE_pop2: {
+            if (m_stackSize < 2) {
+                return fail(VerifyErrorCode::StackUnderflow);
+            }
+            if (m_stack[m_stackSize - 2].kind == TypeKind::Top) {
+                return fail(VerifyErrorCode::TypeMismatch);
+            }
+            m_stackSize -= 2;
+            return false;
+        }
+        case OPCODE_dup:
+        case OPCODE_dup_x1:
+        case OPCODE_dup_x2: {
+            return copyUnder(1, opcode - OPCODE_dup);
+        }
+        case OPCODE_dup2:
+        case OPCODE_dup2_x1:
+        case OPCODE_dup2_x2: {
+            return copyUnder(2, opcode - OPCODE_dup2);
+        }
+        case OPCODE_swap: {
+            if (m_stackSize < 2) {
+                return fail(VerifyErrorCode::StackUnderflow);
+            }
+            if ((m_stack[m_stackSize - 1].kind == TypeKind::Top) || (m_stack[m_stackSize - 2].kind == TypeKind::Top)) {
+                return fail(VerifyErrorCode::TypeMismatch);
+            }
+            std::swap(m_stack[m_stackSize - 1], m_stack[m_stackSize - 2]);
+            return false;
+        }
+        case OPCODE_iinc: {
+            if (insn.local() >= m_maxLocals) {
+                return fail(VerifyErrorCode::InvalidLocal);
+            }
+            return (m_locals[insn.local()] != intType) && fail(VerifyErrorCode::TypeMismatch);
+        }
+        case OPCODE_if_acmpeq:
+        case OPCODE_if_acmpne: {
+            return popReference(value) || popReference(value) || checkTarget(insn.branchTarget());
+        }
+        case OPCODE_ifnull:
+        case OPCODE_ifnonnull: {
+            return popReference(value) || checkTarget(insn.branchTarget());
+        }
+        case OPCODE_goto:
+        case OPCODE_goto_w: {
+            fallsThrough = false;
+            return checkTarget(insn.branchTarget());
+        }
+        case OPCODE_tableswitch:
+        case OPCODE_lookupswitch: {
+            fallsThrough = false;
+            if (pop(intType) || checkTarget(insn.pc + insn.switchDefault())) {
+                return true;
+            }
+            if (opcode == OPCODE_tableswitch) {
+                for (uint32_t i = 0; i <= (uint32_t)(insn.tableHigh() - insn.tableLow()); i++) {
+                    if (checkTarget(insn.pc + insn.tableOffset(i))) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            for (uint32_t i = 0; i < insn.lookupPairs(); i++) {
+                if ((i > 0) && (insn.lookupMatch(i) <= insn.lookupMatch(i - 1))) {
+                    return fail(VerifyErrorCode::InvalidInstruction);
+                }
+                if (checkTarget(insn.pc + insn.lookupOffset(i))) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case OPCODE_ireturn:
+        case OPCODE_lreturn:
+        case OPCODE_freturn:
+        case OPCODE_dreturn:
+        case OPCODE_areturn: {
+            fallsThrough = false;
+            const DescriptorType &returnType = m_descriptor->returnType();
+            if (returnType.base == BaseType::Void) {
+                return fail(VerifyErrorCode::InvalidReturn);
+            }
+            VType type = typeOf(*m_descriptor, returnType);
+            constexpr TypeKind kinds[] = { TypeKind::Integer, TypeKind::Long, TypeKind::Float, TypeKind::Double,
+                                           TypeKind::Reference };
+            if (type.kind != kinds[opcode - OPCODE_ireturn]) {
+                return fail(VerifyErrorCode::InvalidReturn);
+            }
+            return pop(type);
+        }
+        case OPCODE_return: {
+            fallsThrough = false;
+            if (!m_descriptor->returnsVoid()) {
+                return fail(VerifyErrorCode::InvalidReturn);
+            }
+            return m_thisUninit && fail(VerifyErrorCode::UninitializedObject);
+        }
+        case OPCODE_getstatic:
+        case OPCODE_putstatic:
+        case OPCODE_getfield:
+        case OPCODE_putfield: {
+            return fieldAccess(opcode, insn.cpIndex());
+        }
+        case OPCODE_invokevirtual:
+        case OPCODE_invokespecial:
+        case OPCODE_invokestatic:
+        case OPCODE_invokeinterface:
+        case OPCODE_invokedynamic: {
+            return invoke(insn);
+        }
+        case OPCODE_new: {
+            if (resolveClass(insn.cpIndex(), value) || (value.dimensions != 0)) {
+                return fail(VerifyErrorCode::InvalidConstant);
+            }
+            VType created{ TypeKind::Uninitialized, 0, BaseType::Object, insn.pc };
+            if (std::find(m_stack.begin(), m_stack.begin() + (std::ptrdiff_t)m_stackSize, created) !=
+                m_stack.begin() + (std::ptrdiff_t)m_stackSize) {
+                return fail(VerifyErrorCode::UninitializedObject);
+            }
+            std::replace(m_locals.begin(), m_locals.end(), created, topType);
+            return push(created);
+        }
+        case OPCODE_newarray: {
+            constexpr std::string_view elements = "ZCFDBSIJ";
+            uint8_t arrayType = insn.arrayType();
+            if ((arrayType < 4) || (arrayType > 11)) {
+                return fail(VerifyErrorCode::InvalidInstruction);
+            }
+            return pop(intType) || push({ TypeKind::Reference, 1, (BaseType)elements[arrayType - 4], 0 });
+        }
+        case OPCODE_anewarray: {
+            if (resolveClass(insn.cpIndex(), value) || (value.dimensions >= maxArrayDimensions)) {
+                return fail(VerifyErrorCode::InvalidConstant);
+            }
+            value.dimensions++;
+            return pop(intType) || push(value);
+        }
+        case OPCODE_multianewarray: {
+            if (resolveClass(insn.cpIndex(), value) || (insn.dimensions() == 0) ||
+                (value.dimensions < insn.dimensions())) {
+                return fail(VerifyErrorCode::InvalidConstant);
+            }
+            for (size_t i = 0; i < insn.dimensions(); i++) {
+                if (pop(intType)) {
+                    return true;
+                }
+            }
+            return push(value);
+        }
+        case OPCODE_arraylength: {
+            return popArray(value) || push(intType);
+        }
+        case OPCODE_athrow: {
+            fallsThrough = false;
+            return pop(classType(NameThrowable));
+        }
+        case OPCODE_checkcast:
+        case OPCODE_instanceof: {
+            VType type;
+            if (resolveClass(insn.cpIndex(), type)) {
+                return fail(VerifyErrorCode::InvalidConstant);
+            }
+            return pop(classType(NameObject)) || push((opcode == OPCODE_checkcast) ? type : intType);
+        }
+        case OPCODE_monitorenter:
+        case OPCODE_monitorexit: {
+            return popReference(value);
+        }
+        default: {
+            constexpr TypeKind kinds[] = { TypeKind::Integer, TypeKind::Long, TypeKind::Float, TypeKind::Double,
+                                           TypeKind::Reference };
+            // iload_0 ... aload_3 and istore_0 ... astore_3, four per type
+            if ((opcode >= OPCODE_iload_0) && (opcode <= OPCODE_aload_3)) {
+                return load((opcode - OPCODE_iload_0) % 4, kinds[(opcode - OPCODE_iload_0) / 4]);
+            }
+            if ((opcode >= OPCODE_istore_0) && (opcode <= OPCODE_astore_3)) {
+                return store((opcode - OPCODE_istore_0) % 4, kinds[(opcode - OPCODE_istore_0) / 4]);
+            }
+            // jsr, jsr_w and ret have no place in a class verified by type checking
+            return fail(VerifyErrorCode::InvalidInstruction);
+        }
+    }
+}
+
+
+bool
+BytecodeVerifier::Impl::verifyCode(const CodeAttribute &code) {
+    m_code = code.code;
+    m_maxLocals = code.maxLocals;
+    m_maxStack = code.maxStack;
+    if (m_code.empty() || (m_code.size() >= 65536)) {
+        return fail(VerifyErrorCode::InvalidCode);
+    }
+
+    // every instruction start, and the end of the code for exception table end_pc
+    m_instructionStarts.assign(m_code.size() + 1, 0);
+    m_instructionStarts[m_code.size()] = 1;
+    BytecodeIterator iterator(m_code);
+    Instruction insn{};
+    while (iterator.next(insn)) {
+        m_instructionStarts[insn.pc] = 1;
+    }
+    if (iterator.error()) {
+        m_pc = iterator.pc();
+        return fail(VerifyErrorCode::InvalidInstruction);
+    }
+
+    m_locals.assign(m_maxLocals, topType);
+    m_stack.assign(m_maxStack, topType);
+    if (m_descriptor->parameterSlots + ((m_classFile->methods()[m_error.method].accessFlags & accStatic) ? 0 : 1) >
+        m_maxLocals) {
+        return fail(VerifyErrorCode::InvalidLocal);
+    }
+    if (decodeFrames(code) || decodeHandlers(code)) {
+        return true;
+    }
+
+    size_t localsSize;
+    initialFrame(localsSize);
+    m_stackSize = 0;
+    size_t nextFrame = 0;
+    bool reachable = true;
+    iterator = BytecodeIterator(m_code);
+    while (iterator.next(insn)) {
+        m_pc = insn.pc;
+        if ((nextFrame < m_frames.size()) && (m_frames[nextFrame].offset == insn.pc)) {
+            if (reachable && !stateAssignable(m_frames[nextFrame], true)) {
+                return fail(VerifyErrorCode::FrameMismatch);
+            }
+            loadFrame(m_frames[nextFrame++]);
+        } else if (!reachable) {
+            return fail(VerifyErrorCode::MissingFrame);
+        }
+        if (checkHandlers()) {
+            return true;
+        }
+        bool fallsThrough = true;
+        if (execute(insn, fallsThrough)) {
+            return true;
+        }
+        reachable = fallsThrough;
+    }
+    return reachable && fail(VerifyErrorCode::FallsOffEnd);
+}
+
+
+VerifyError
+BytecodeVerifier::Impl::verifyMethod(size_t methodNum) {
+    m_error = { VerifyErrorCode::None, (uint16_t)methodNum, 0 };
+    m_pc = 0;
+    if (m_classFile->majorVersion() < typeCheckingMajorVersion) {
+        fail(VerifyErrorCode::UnsupportedVersion);
+        return m_error;
+    }
+
+    const MemberInfo &method = m_classFile->methods()[methodNum];
+    const AttributeInfo *codeAttribute = ClassFile::findAttribute(m_classFile->attributes(method), AttributeKind::Code);
+    if (method.accessFlags & (accAbstract | accNative)) {
+        if (codeAttribute != nullptr) {
+            fail(VerifyErrorCode::InvalidCode);
+        }
+        return m_error;
+    }
+    if (codeAttribute == nullptr) {
+        fail(VerifyErrorCode::MissingCode);
+        return m_error;
+    }
+    auto code = decodeCodeAttribute(m_classFile->attributeBytes(*codeAttribute));
+    m_descriptor = m_classFile->descriptor(method.descriptorIndex);
+    if (!code || (m_descriptor == nullptr) || (m_descriptor->kind != DescriptorKind::Method)) {
+        fail(VerifyErrorCode::InvalidCode);
+        return m_error;
+    }
+    m_isInit = m_classFile->utf8(method.nameIndex) == "<init>";
+    verifyCode(*code);
+    return m_error;
+}
+
+
+BytecodeVerifier::BytecodeVerifier(const ClassHierarchy *hierarchy) : m_impl(std::make_unique<Impl>(hierarchy)) {}
+
+BytecodeVerifier::BytecodeVerifier(BytecodeVerifier &&other) noexcept = default;
+
+BytecodeVerifier &BytecodeVerifier::operator=(BytecodeVerifier &&other) noexcept = default;
+
+BytecodeVerifier::~BytecodeVerifier() = default;
+
+
+VerifyError
+BytecodeVerifier::verifyMethod(const ClassFile &classFile, size_t methodNum) {
+    // names and resolved constants carry over between methods of one class
+    if (!m_impl->inClass(classFile)) {
+        m_impl->beginClass(classFile);
+    }
+    return m_impl->verifyMethod(methodNum);
+}
+
+
+VerifyError
+BytecodeVerifier::verifyClass(const ClassFile &classFile) {
+    m_impl->beginClass(classFile);
+    for (size_t methodNum = 0; methodNum < classFile.methods().size(); methodNum++) {
+        VerifyError error = m_impl->verifyMethod(methodNum);
+        if (error) {
+            return error;
+        }
+    }
+    return {};
+}
+
+
+std::vector<VerifyError>
+verifyClasses(std::span<const ClassFile *const> classes, const ClassHierarchy *hierarchy, size_t threads) {
+    // every method is a task of its own, so one huge class does not hold up the rest
+    std::vector<std::pair<uint32_t, uint16_t>> methods;
+    for (uint32_t classNum = 0; classNum < classes.size(); classNum++) {
+        const ClassFile *classFile = classes[classNum];
+        if ((classFile == nullptr) || classFile->parseError()) {
+            continue;
+        }
+        for (size_t methodNum = 0; methodNum < classFile->methods().size(); methodNum++) {
+            methods.emplace_back(classNum, (uint16_t)methodNum);
+        }
+    }
+
+    WorkStealingPool pool(threads);
+    std::vector<BytecodeVerifier> verifiers;
+    verifiers.reserve(pool.threadCount());
+    for (size_t i = 0; i < pool.threadCount(); i++) {
+        verifiers.emplace_back(hierarchy);
+    }
+    std::vector<VerifyError> methodErrors(methods.size());
+    size_t grain = std::clamp<size_t>(methods.size() / (pool.threadCount() * 16), 1, 64);
+    // a worker takes consecutive methods, mostly of one class, so it rarely has to set up a class again
+    pool.parallelFor(methods.size(), grain, [&](size_t i) {
+        auto [classNum, methodNum] = methods[i];
+        methodErrors[i] = verifiers[pool.currentWorker()].verifyMethod(*classes[classNum], methodNum);
+    });
+
+    // methods are listed in order, so the first error seen for a class is its first one
+    std::vector<VerifyError> results(classes.size());
+    for (size_t i = 0; i < methods.size(); i++) {
+        VerifyError &result = results[methods[i].first];
+        if (methodErrors[i] && !result) {
+            result = methodErrors[i];
+        }
+    }
+    return results;
+}
@@ -0,0 +1,106 @@
+#ifndef SJBCDC_BYTECODEVERIFIER_HPP
+#define SJBCDC_BYTECODEVERIFIER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ClassFile;
+class ClassHierarchy;
+
+enum class VerifyErrorCode : uint8_t {
+    None,
+    UnsupportedVersion,         // major version < 50: such classes need the type inference verifier
+    MissingCode,
+    InvalidCode,                // Code attribute that does not decode, or on an abstract/native method
+    InvalidInstruction,         // undecodable code, jsr/ret, malformed operands
+    InvalidStackMapTable,
+    InvalidConstant,            // constant pool operand of the wrong kind or with a bad descriptor
+    InvalidLocal,
+    StackOverflow,
+    StackUnderflow,
+    TypeMismatch,
+    InvalidBranchTarget,        // no stack map frame at a branch target
+    FrameMismatch,              // the type state does not match the stack map frame
+    MissingFrame,               // no stack map frame after an unconditional branch
+    FallsOffEnd,
+    InvalidExceptionHandler,
+    InvalidReturn,
+    UninitializedObject,        // <init> not called on an object before it is used or returned
+    Count
+};
+
+struct VerifyError {
+    VerifyErrorCode code = VerifyErrorCode::None;
+    uint16_t method = 0;        // number in ClassFile::methods()
+    uint32_t pc = 0;            // of the instruction that failed, 0 for errors about the whole method
+
+    explicit
+    operator bool() const { return code != VerifyErrorCode::None; }
+};
+
+// the message of a code, e.g. "Type mismatch"; empty for None
+std::string_view
+verifyErrorMessage(VerifyErrorCode code);
+
+// "name: method nameDescriptor, pc N: message"; empty for no error
+std::string
+formatVerifyError(std::string_view name, const ClassFile &classFile, const VerifyError &error);
+
+/*
+ * Type checking bytecode verifier of JVMS 4.10.1: every method is checked in
+ * one linear pass over its code, against the StackMapTable frames at branch
+ * targets, exception handlers and after unconditional branches, so nothing
+ * is ever merged or iterated to a fixpoint.
+ *
+ * Frames, type states and the names they refer to live in storage owned by
+ * the verifier and reused from method to method; verifying a method
+ * allocates nothing once that storage has grown to the largest method seen.
+ * One verifier is used by one thread at a time.
+ *
+ * Class types are assignable when the hierarchy says so. Without a
+ * hierarchy, or when a class is not defined in it, an assignment to a class
+ * type is assumed to hold, as are all assignments to interface types (as in
+ * JVMS 4.10.1.2). Protected member access (JVMS 4.10.1.8) is not checked.
+ * Classes must have been parsed without lazyConstantPool.
+ */
+class BytecodeVerifier {
+private:
+    class Impl;
+    std::unique_ptr<Impl> m_impl;
+
+public:
+    /*
+     * hierarchy is queried from every verifier using it, so call its
+     * refresh() after the last change
+     */
+    explicit BytecodeVerifier(const ClassHierarchy *hierarchy = nullptr);
+    BytecodeVerifier(BytecodeVerifier &&other) noexcept;
+    BytecodeVerifier &operator=(BytecodeVerifier &&other) noexcept;
+    ~BytecodeVerifier();
+
+    /*
+     * the first error in method methodNum of a successfully parsed class;
+     * what was resolved for the class is kept for the next call with it
+     */
+    VerifyError
+    verifyMethod(const ClassFile &classFile, size_t methodNum);
+
+    // the first error in method order
+    VerifyError
+    verifyClass(const ClassFile &classFile);
+};
+
+/*
+ * The first error of every class (code None when it verifies), in the order
+ * of classes. Methods are verified in parallel, each worker with its own
+ * BytecodeVerifier; classes that are nullptr or failed to parse are skipped.
+ */
+std::vector<VerifyError>
+verifyClasses(std::span<const ClassFile *const> classes, const ClassHierarchy *hierarchy = nullptr,
+              size_t threads = 0);
+
+#endif //SJBCDC_BYTECODEVERIFIER_HPP
@@ -0,0 +1,472 @@
+#include "classCache.hpp"
+#include "classFileRead.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unistd.h>
+
+
+constexpr static uint32_t
+archiveMagic = 0x41424a53; // "SJBA" read as little endian
+
+constexpr static uint32_t
+imageMagic = 0x434a4253; // "SJBC"
+
+constexpr static uint16_t
+imageVersion = 1;
+
+enum ImageSection : uint8_t {
+    SectionIdxTable,
+    SectionUtf8,
+    SectionInteger,
+    SectionFloat,
+    SectionLong,
+    SectionDouble,
+    SectionClass,
+    SectionString,
+    SectionFieldref,
+    SectionMethodref,
+    SectionInterfaceMethodref,
+    SectionNameAndType,
+    SectionMethodHandle,
+    SectionMethodType,
+    SectionDynamic,
+    SectionInvokeDynamic,
+    SectionModule,
+    SectionPackage,
+    SectionInterfaces,
+    SectionFields,
+    SectionMethods,
+    SectionAttributes,
+    SectionCount
+};
+
+// section holding the per-tag array idxRef::idxInType points into
+constexpr static auto
+tagSections = [] {
+    std::array<uint8_t, CONSTANT_TagCount> sections{};
+    sections.fill(SectionCount);
+    sections[CONSTANT_Utf8] = SectionUtf8;
+    sections[CONSTANT_Integer] = SectionInteger;
+    sections[CONSTANT_Float] = SectionFloat;
+    sections[CONSTANT_Long] = SectionLong;
+    sections[CONSTANT_Double] = SectionDouble;
+    sections[CONSTANT_Class] = SectionClass;
+    sections[CONSTANT_String] = SectionString;
+    sections[CONSTANT_Fieldref] = SectionFieldref;
+    sections[CONSTANT_Methodref] = SectionMethodref;
+    sections[CONSTANT_InterfaceMethodref] = SectionInterfaceMethodref;
+    sections[CONSTANT_NameAndType] = SectionNameAndType;
+    sections[CONSTANT_MethodHandle] = SectionMethodHandle;
+    sections[CONSTANT_MethodType] = SectionMethodType;
+    sections[CONSTANT_Dynamic] = SectionDynamic;
+    sections[CONSTANT_InvokeDynamic] = SectionInvokeDynamic;
+    sections[CONSTANT_Module] = SectionModule;
+    sections[CONSTANT_Package] = SectionPackage;
+    return sections;
+}();
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t layout;
+    uint64_t count;     // ArchiveEntry records following the header
+};
+
+struct ImageHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t verifyLevel;
+    uint8_t sectionCount;
+    uint64_t layout;
+    uint64_t contentHash;
+    uint64_t classSize;
+    uint64_t attributeMask;
+    uint32_t firstClassAttribute;
+    uint16_t classAttributesCount;
+    uint16_t minorVersion;
+    uint16_t majorVersion;
+    uint16_t accessFlags;
+    uint16_t thisClass;
+    uint16_t superClass;
+};
+
+struct ImageSectionEntry {
+    uint64_t offset;    // from the start of the image, 8-byte aligned
+    uint64_t count;     // elements, not bytes
+};
+
+// CONSTANT_Utf8Info without its owned bytes
+struct CachedUtf8 {
+    uint32_t offset;
+    uint16_t length;
+    uint16_t reserved;
+};
+
+constexpr static size_t
+sectionTableOffset = sizeof(ImageHeader);
+
+constexpr static size_t
+sectionsDataOffset = sectionTableOffset + SectionCount * sizeof(ImageSectionEntry);
+
+
+/*
+ * Calls fn(section, vector) for every array stored verbatim; shared by
+ * store and load so both agree on what goes where
+ */
+template <typename Constants, typename Members, typename Fn>
+static void
+forEachArray(Constants &constants, Members &members, Fn &&fn) {
+    fn(SectionIdxTable, constants.idxTable);
+    fn(SectionInteger, constants.intConsts);
+    fn(SectionFloat, constants.floatConsts);
+    fn(SectionLong, constants.longConsts);
+    fn(SectionDouble, constants.doubleConsts);
+    fn(SectionClass, constants.classConsts);
+    fn(SectionString, constants.stringConsts);
+    fn(SectionFieldref, constants.fieldrefConsts);
+    fn(SectionMethodref, constants.methodrefConsts);
+    fn(SectionInterfaceMethodref, constants.interfaceMetodrefConsts);
+    fn(SectionNameAndType, constants.nameAndTypeConsts);
+    fn(SectionMethodHandle, constants.methodHandleConsts);
+    fn(SectionMethodType, constants.methodTypeConsts);
+    fn(SectionDynamic, constants.dynamicConsts);
+    fn(SectionInvokeDynamic, constants.invokeDynamicConsts);
+    fn(SectionModule, constants.moduleConsts);
+    fn(SectionPackage, constants.packageConsts);
+    fn(SectionInterfaces, members.interfaces);
+    fn(SectionFields, members.fields);
+    fn(SectionMethods, members.methods);
+    fn(SectionAttributes, members.attributes);
+}
+
+
+// sizes of everything stored verbatim, so images of other builds are rejected
+static uint64_t
+layoutFingerprint() {
+    static const uint64_t fingerprint = [] {
+        std::array<uint64_t, SectionCount + 4> sizes{};
+        ClassFileConstants constants;
+        ClassFileMembers members;
+        forEachArray(constants, members, [&](ImageSection section, auto &array) {
+            sizes[section] = sizeof(typename std::decay_t<decltype(array)>::value_type);
+        });
+        sizes[SectionUtf8] = sizeof(CachedUtf8);
+        sizes[SectionCount] = sizeof(ImageHeader);
+        sizes[SectionCount + 1] = sizeof(ImageSectionEntry) + sizeof(ArchiveHeader);
+        sizes[SectionCount + 2] = (std::endian::native == std::endian::little);
+        sizes[SectionCount + 3] = imageVersion;
+        return xxh64({ reinterpret_cast<const uint8_t *>(sizes.data()), sizeof(sizes) });
+    }();
+    return fingerprint;
+}
+
+
+ClassCache::ClassCache(std::filesystem::path directory) : m_directory(std::move(directory)) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    openArchive();
+}
+
+
+ClassCache::~ClassCache() {
+    flush();
+}
+
+
+void
+ClassCache::openArchive() {
+    m_archive = MappedFile{};
+    m_entries = {};
+    if (!std::filesystem::exists(archivePath()) ||
+        (m_archive.map(archivePath(), false) != MappedFile::Status::Ok)) {
+        return;
+    }
+
+    std::span<const uint8_t> archive = m_archive.bytes();
+    ArchiveHeader header{};
+    if (archive.size() < sizeof(header)) {
+        m_archive = MappedFile{};
+        return;
+    }
+    std::memcpy(&header, archive.data(), sizeof(header));
+    if ((header.magic != archiveMagic) || (header.version != imageVersion) ||
+        (header.layout != layoutFingerprint()) ||
+        (header.count > (archive.size() - sizeof(header)) / sizeof(ArchiveEntry))) {
+        m_archive = MappedFile{};
+        return;
+    }
+
+    // the mapping is page aligned and the header 8-byte sized, so the records can be used in place
+    std::span entries(reinterpret_cast<const ArchiveEntry *>(archive.data() + sizeof(header)), header.count);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const ArchiveEntry &entry = entries[i];
+        if ((entry.offset % 8 != 0) || (entry.offset > archive.size()) ||
+            (entry.size > archive.size() - entry.offset) ||
+            ((i > 0) && (entries[i - 1].key >= entry.key))) {
+            m_archive = MappedFile{};
+            return;
+        }
+    }
+    m_entries = entries;
+}
+
+
+// the options that change what an image holds are part of its key
+uint64_t
+ClassCache::imageKey(uint64_t contentHash, const ClassFileOptions &options) {
+    std::array<uint64_t, 2> parameters{ options.attributeMask, (uint64_t)options.verifyLevel };
+    return xxh64({ reinterpret_cast<const uint8_t *>(parameters.data()), sizeof(parameters) }, contentHash);
+}
+
+
+std::span<const uint8_t>
+ClassCache::findImage(uint64_t key) const {
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key,
+                               [](const ArchiveEntry &entry, uint64_t k) { return entry.key < k; });
+    if ((it == m_entries.end()) || (it->key != key)) {
+        return {};
+    }
+    return m_archive.bytes().subspan(it->offset, it->size);
+}
+
+
+void
+ClassCache::store(const ClassFile &classFile, uint64_t contentHash) {
+    const ClassFileConstants &constants = classFile.m_constants;
+    const ClassFileMembers &members = classFile.m_members;
+
+    ImageHeader header{};
+    header.magic = imageMagic;
+    header.version = imageVersion;
+    header.verifyLevel = (uint8_t)classFile.m_options.verifyLevel;
+    header.sectionCount = SectionCount;
+    header.layout = layoutFingerprint();
+    header.contentHash = contentHash;
+    header.classSize = classFile.m_buf.size();
+    header.attributeMask = classFile.m_options.attributeMask;
+    header.firstClassAttribute = members.firstClassAttribute;
+    header.classAttributesCount = members.classAttributesCount;
+    header.minorVersion = classFile.m_minorVersion;
+    header.majorVersion = classFile.m_majorVersion;
+    header.accessFlags = classFile.m_accessFlags;
+    header.thisClass = classFile.m_thisClass;
+    header.superClass = classFile.m_superClass;
+
+    std::array<ImageSectionEntry, SectionCount> sections{};
+    std::vector<uint8_t> image(sectionsDataOffset);
+    auto append = [&](ImageSection section, const auto &array) {
+        using Element = typename std::decay_t<decltype(array)>::value_type;
+        static_assert(std::is_trivially_copyable_v<Element>);
+        size_t offset = (image.size() + 7) & ~size_t(7);
+        image.resize(offset + array.size() * sizeof(Element));
+        if (!array.empty()) {
+            std::memcpy(image.data() + offset, array.data(), array.size() * sizeof(Element));
+        }
+        sections[section] = ImageSectionEntry{ offset, array.size() };
+    };
+
+    forEachArray(constants, members, append);
+    std::vector<CachedUtf8> utf8;
+    utf8.reserve(constants.utf8Consts.size());
+    for (auto &constant : constants.utf8Consts) {
+        utf8.push_back(CachedUtf8{ constant.offset, constant.length, 0 });
+    }
+    append(SectionUtf8, utf8);
+
+    std::memcpy(image.data(), &header, sizeof(header));
+    std::memcpy(image.data() + sectionTableOffset, sections.data(), sizeof(sections));
+
+    std::lock_guard lock(m_pendingMutex);
+    m_pending.insert_or_assign(imageKey(contentHash, classFile.m_options), std::move(image));
+}
+
+
+bool
+ClassCache::flush() {
+    std::lock_guard lock(m_pendingMutex);
+    if (m_pending.empty()) {
+        return true;
+    }
+
+    // images stored in this run replace archived ones with the same key
+    std::vector<std::pair<uint64_t, std::span<const uint8_t>>> images;
+    images.reserve(m_entries.size() + m_pending.size());
+    for (auto &entry : m_entries) {
+        if (!m_pending.contains(entry.key)) {
+            images.emplace_back(entry.key, m_archive.bytes().subspan(entry.offset, entry.size));
+        }
+    }
+    for (auto &[key, image] : m_pending) {
+        images.emplace_back(key, image);
+    }
+    std::sort(images.begin(), images.end(), [](auto &a, auto &b) { return a.first < b.first; });
+
+    ArchiveHeader header{ archiveMagic, imageVersion, 0, layoutFingerprint(), images.size() };
+    std::vector<ArchiveEntry> entries;
+    entries.reserve(images.size());
+    uint64_t offset = sizeof(header) + images.size() * sizeof(ArchiveEntry);
+    for (auto &[hash, image] : images) {
+        entries.push_back(ArchiveEntry{ hash, offset, image.size() });
+        offset = (offset + image.size() + 7) & ~uint64_t(7);
+    }
+
+    std::filesystem::path target = archivePath();
+    std::filesystem::path tmp = target;
+    // unique across processes sharing the directory and across flushes within one
+    static std::atomic<uint64_t> flushCount{0};
+    tmp += ".tmp" + std::to_string(getpid()) + "." + std::to_string(flushCount.fetch_add(1));
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(entries.data()),
+                  (std::streamsize)(entries.size() * sizeof(ArchiveEntry)));
+        static constexpr char padding[8] = {};
+        for (auto &[hash, image] : images) {
+            out.write(reinterpret_cast<const char *>(image.data()), (std::streamsize)image.size());
+            out.write(padding, (std::streamsize)(((image.size() + 7) & ~size_t(7)) - image.size()));
+        }
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, target, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    m_pending.clear();
+    openArchive();
+    return true;
+}
+
+
+bool
+ClassCache::load(ClassFile &classFile, uint64_t contentHash) const {
+    std::span<const uint8_t> image = findImage(imageKey(contentHash, classFile.m_options));
+    auto miss = [&] {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    };
+
+    ImageHeader header{};
+    std::array<ImageSectionEntry, SectionCount> sections{};
+    if (image.size() < sectionsDataOffset) {
+        // also when there is no image at all
+        return miss();
+    }
+    std::memcpy(&header, image.data(), sizeof(header));
+    std::memcpy(sections.data(), image.data() + sectionTableOffset, sizeof(sections));
+
+    const ClassFileOptions &options = classFile.m_options;
+    if ((header.magic != imageMagic) || (header.version != imageVersion) ||
+        (header.sectionCount != SectionCount) || (header.layout != layoutFingerprint()) ||
+        (header.contentHash != contentHash) || (header.classSize != classFile.m_buf.size()) ||
+        (header.attributeMask != options.attributeMask) || (header.verifyLevel != (uint8_t)options.verifyLevel)) {
+        return miss();
+    }
+
+    // every section inside the image before anything is read from it
+    bool sectionsValid = true;
+    auto checkSection = [&](ImageSection section, size_t elementSize) {
+        const ImageSectionEntry &entry = sections[section];
+        sectionsValid = sectionsValid && (entry.offset % 8 == 0) && (entry.offset <= image.size()) &&
+                        (entry.count <= (image.size() - entry.offset) / elementSize);
+    };
+    forEachArray(classFile.m_constants, classFile.m_members, [&](ImageSection section, auto &array) {
+        checkSection(section, sizeof(typename std::decay_t<decltype(array)>::value_type));
+    });
+    checkSection(SectionUtf8, sizeof(CachedUtf8));
+    if (!sectionsValid) {
+        return miss();
+    }
+
+    auto sectionData = [&](ImageSection section) { return image.data() + sections[section].offset; };
+    for (size_t i = 0; i < sections[SectionIdxTable].count; i++) {
+        idxRef ref;
+        std::memcpy(&ref, sectionData(SectionIdxTable) + i * sizeof(idxRef), sizeof(ref));
+        if ((ref.type != 0) &&
+            ((ref.type >= CONSTANT_TagCount) || (tagSections[ref.type] == SectionCount) ||
+             (ref.idxInType >= sections[tagSections[ref.type]].count))) {
+            return miss();
+        }
+    }
+    for (size_t i = 0; i < sections[SectionUtf8].count; i++) {
+        CachedUtf8 utf8;
+        std::memcpy(&utf8, sectionData(SectionUtf8) + i * sizeof(CachedUtf8), sizeof(utf8));
+        if ((size_t)utf8.offset + utf8.length > header.classSize) {
+            return miss();
+        }
+    }
+    for (size_t i = 0; i < sections[SectionAttributes].count; i++) {
+        AttributeInfo attribute;
+        std::memcpy(&attribute, sectionData(SectionAttributes) + i * sizeof(AttributeInfo), sizeof(attribute));
+        if ((size_t)attribute.offset + attribute.length > header.classSize) {
+            return miss();
+        }
+    }
+    size_t attributesCount = sections[SectionAttributes].count;
+    for (ImageSection section : { SectionFields, SectionMethods }) {
+        for (size_t i = 0; i < sections[section].count; i++) {
+            MemberInfo member;
+            std::memcpy(&member, sectionData(section) + i * sizeof(MemberInfo), sizeof(member));
+            if ((size_t)member.firstAttribute + member.attributesCount > attributesCount) {
+                return miss();
+            }
+        }
+    }
+    if ((size_t)header.firstClassAttribute + header.classAttributesCount > attributesCount) {
+        return miss();
+    }
+
+    ClassFileConstants &constants = classFile.m_constants;
+    ClassFileMembers &members = classFile.m_members;
+    forEachArray(constants, members, [&](ImageSection section, auto &array) {
+        using Element = typename std::decay_t<decltype(array)>::value_type;
+        array.resize(sections[section].count);
+        if (!array.empty()) {
+            std::memcpy(array.data(), sectionData(section), array.size() * sizeof(Element));
+        }
+    });
+
+    std::span<const uint8_t> classBytes = classFile.m_buf;
+    constants.utf8Consts.reserve(sections[SectionUtf8].count);
+    for (size_t i = 0; i < sections[SectionUtf8].count; i++) {
+        CachedUtf8 utf8;
+        std::memcpy(&utf8, sectionData(SectionUtf8) + i * sizeof(CachedUtf8), sizeof(utf8));
+        CONSTANT_Utf8Info constant{ std::pmr::vector<uint8_t>(constants.resource()), utf8.offset, utf8.length };
+        auto bytes = classBytes.subspan(utf8.offset, utf8.length);
+        if (options.utf8Storage == Utf8Storage::Owned) {
+            constant.bytes.assign(bytes.begin(), bytes.end());
+        } else if (options.utf8Storage == Utf8Storage::Interned) {
+            constant.symbol = options.symbolTable->intern({ reinterpret_cast<const char *>(bytes.data()),
+                                                            bytes.size() });
+        }
+        constants.utf8Consts.push_back(std::move(constant));
+    }
+
+    members.firstClassAttribute = header.firstClassAttribute;
+    members.classAttributesCount = header.classAttributesCount;
+    classFile.m_magic = 0xCAFEBABE;
+    classFile.m_minorVersion = header.minorVersion;
+    classFile.m_majorVersion = header.majorVersion;
+    classFile.m_accessFlags = header.accessFlags;
+    classFile.m_thisClass = header.thisClass;
+    classFile.m_superClass = header.superClass;
+
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
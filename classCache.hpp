@@ -0,0 +1,108 @@
+#ifndef SJBCDC_CLASSCACHE_HPP
+#define SJBCDC_CLASSCACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedFile.hpp"
+
+class ClassFile;
+struct ClassFileOptions;
+
+/*
+ * Archive of parsed-class images keyed by the XXH64 of the class bytes, kept
+ * in <directory>/classes.sjbc. An image holds the decoded constant pool and
+ * class structure as flat arrays of the in-memory structs, with no pointers
+ * and all offsets relative to the class bytes or the image, so a class is
+ * restored by copying arrays out of the mapped archive: no decoding and no
+ * verification, and no file system access per class.
+ *
+ * The archive is mapped once when the cache is opened. Images of classes
+ * parsed since then are collected in memory and merged into a new archive
+ * by flush() (also run by the destructor), written to a temporary file and
+ * renamed over the old one; when several processes flush at once the last
+ * one wins.
+ *
+ * Images are keyed by the content hash together with the verify level and
+ * attribute mask they were made with, so runs with different options keep
+ * separate images; images of a build with a different struct layout are
+ * ignored. An archive is trusted as much as the directory it lives in: only
+ * array bounds and offsets are checked when loading an image.
+ */
+class ClassCache {
+private:
+    struct ArchiveEntry {
+        uint64_t key;       // imageKey()
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    std::filesystem::path m_directory;
+    MappedFile m_archive;
+    std::span<const ArchiveEntry> m_entries;    // sorted by key
+
+    std::mutex m_pendingMutex;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> m_pending;
+
+    mutable std::atomic<size_t> m_hits{0};
+    mutable std::atomic<size_t> m_misses{0};
+
+    void
+    openArchive();
+
+    static uint64_t
+    imageKey(uint64_t contentHash, const ClassFileOptions &options);
+
+    std::span<const uint8_t>
+    findImage(uint64_t key) const;
+
+public:
+    // creates the directory if needed and maps the archive if there is one
+    explicit ClassCache(std::filesystem::path directory);
+    ClassCache(const ClassCache &) = delete;
+    ClassCache &operator=(const ClassCache &) = delete;
+    ~ClassCache();
+
+    const std::filesystem::path &
+    directory() const { return m_directory; }
+
+    std::filesystem::path
+    archivePath() const { return m_directory / "classes.sjbc"; }
+
+    /*
+     * Restores a ClassFile whose class bytes are already set up (called from
+     * ClassFile's parse). Returns false, leaving it untouched, when the
+     * archive has no usable image.
+     */
+    bool
+    load(ClassFile &classFile, uint64_t contentHash) const;
+
+    // keeps the image of a successfully parsed eager ClassFile for the next flush()
+    void
+    store(const ClassFile &classFile, uint64_t contentHash);
+
+    /*
+     * Writes the archive with the images stored since it was opened and maps
+     * the new one. Must not run while classes are being loaded or stored.
+     * Returns false on I/O errors.
+     */
+    bool
+    flush();
+
+    size_t
+    hits() const { return m_hits.load(std::memory_order_relaxed); }
+
+    size_t
+    misses() const { return m_misses.load(std::memory_order_relaxed); }
+
+    // images in the mapped archive
+    size_t
+    size() const { return m_entries.size(); }
+};
+
+#endif //SJBCDC_CLASSCACHE_HPP
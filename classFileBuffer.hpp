@@ -0,0 +1,38 @@
+#ifndef SJBCDC_CLASSFILEBUFFER_HPP
+#define SJBCDC_CLASSFILEBUFFER_HPP
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Big-endian reads shared by everything that walks class file bytes. Callers
+ * check the bounds with bufferReadNBytesCorrect/bufferReadTypeCorrect first.
+ */
+template <typename type, typename Buffer>
+static inline type
+getValueFromClassFileBuffer(Buffer &buffer, size_t &ptr) {
+    type ret;
+    std::memcpy(&ret, buffer.data() + ptr, sizeof(type));
+    ptr += sizeof(type);
+    return std::byteswap(ret);
+}
+
+
+template <typename Buffer>
+static inline bool
+bufferReadNBytesCorrect(Buffer &buf, size_t &bufPtr, size_t bytesNum) {
+    if (buf.size() < bufPtr + bytesNum) {
+        return false;
+    }
+    return true;
+}
+
+
+template <typename typeForRead, typename Buffer>
+static inline bool
+bufferReadTypeCorrect(Buffer &buf, size_t &bufPtr) {
+    return bufferReadNBytesCorrect(buf, bufPtr, sizeof(typeForRead));
+}
+
+#endif //SJBCDC_CLASSFILEBUFFER_HPP
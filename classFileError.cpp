@@ -0,0 +1,46 @@
+#include "classFileError.hpp"
+#include <array>
+
+
+constexpr static auto
+errorMessages = std::to_array<std::string_view>({
+    "",
+    "File not found",
+    "Error while opening file",
+    "Invalid file size",
+    "Not a class file",
+    "Minor version not found",
+    "Major version not found",
+    "Invalid major version",
+    "Invalid minor version",
+    "Constant pool size not found",
+    "Invalid constant",
+    "Access flags not found",
+    "Invalid this class",
+    "Invalid super class",
+    "Invalid interfaces",
+    "Invalid field",
+    "Invalid method",
+    "Invalid attribute",
+    "Extra bytes at the end of the class file"
+});
+static_assert(errorMessages.size() == (size_t)ClassFileErrorCode::Count);
+
+
+std::string_view
+classFileErrorMessage(ClassFileErrorCode code) {
+    return ((size_t)code < errorMessages.size()) ? errorMessages[(size_t)code] : std::string_view();
+}
+
+
+std::string
+formatClassFileError(std::string_view name, const ClassFileError &error) {
+    if (!error) {
+        return {};
+    }
+    std::string text = std::string(name) + ": " + std::string(classFileErrorMessage(error.code));
+    if (error.index != noErrorIndex) {
+        text += " " + std::to_string(error.index);
+    }
+    return text;
+}
@@ -0,0 +1,55 @@
+#ifndef SJBCDC_CLASSFILEERROR_HPP
+#define SJBCDC_CLASSFILEERROR_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum class ClassFileErrorCode : uint8_t {
+    None,
+    FileNotFound,
+    ErrorOpeningFile,
+    InvalidFileSize,
+    NotAClassFile,
+    MinorVersionNotFound,
+    MajorVersionNotFound,
+    InvalidMajorVersion,
+    InvalidMinorVersion,
+    ConstantPoolSizeNotFound,
+    InvalidConstant,
+    AccessFlagsNotFound,
+    InvalidThisClass,
+    InvalidSuperClass,
+    InvalidInterfaces,
+    InvalidField,
+    InvalidMethod,
+    InvalidAttribute,
+    ExtraBytes,
+    Count
+};
+
+constexpr uint16_t noErrorIndex = UINT16_MAX;
+
+/*
+ * Why ClassFile::init failed, as a plain record: recording one allocates
+ * nothing, the text is only built by formatClassFileError()
+ */
+struct ClassFileError {
+    ClassFileErrorCode code = ClassFileErrorCode::None;
+    uint8_t tag = 0;                // tag of the constant at index (InvalidConstant), 0 if unknown
+    uint16_t index = noErrorIndex;  // constant pool index (InvalidConstant) or field/method number
+    uint32_t offset = 0;            // class file offset where parsing stopped
+
+    explicit
+    operator bool() const { return code != ClassFileErrorCode::None; }
+};
+
+// the message of a code, e.g. "Invalid constant"; empty for None
+std::string_view
+classFileErrorMessage(ClassFileErrorCode code);
+
+// "name: message[ index]", the text ClassFile::initResult() reports; empty for no error
+std::string
+formatClassFileError(std::string_view name, const ClassFileError &error);
+
+#endif //SJBCDC_CLASSFILEERROR_HPP
@@ -0,0 +1,438 @@
+#include "classFileLoader.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+
+// one read() of a class file never needs more than this (READ lengths are 32 bit)
+constexpr static size_t
+maxFileSize = UINT32_MAX;
+
+
+// whole file into bytes; false when it cannot be opened or read
+static bool
+readWholeFile(const char *path, std::pmr::vector<uint8_t> &bytes) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || ((size_t)st.st_size > maxFileSize)) {
+        close(fd);
+        return false;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    // the whole file in one read-ahead request rather than a window at a time
+    posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+#endif
+
+    bytes.resize((size_t)st.st_size);
+    size_t filled = 0;
+    while (filled < bytes.size()) {
+        ssize_t n = pread(fd, bytes.data() + filled, bytes.size() - filled, (off_t)filled);
+        if ((n < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (n < 0) {
+            close(fd);
+            return false;
+        }
+        if (n == 0) {
+            // the file shrank since fstat
+            bytes.resize(filled);
+            break;
+        }
+        filled += (size_t)n;
+    }
+    close(fd);
+    return true;
+}
+
+
+#ifdef __linux__
+
+// a file being read through the ring
+struct RingSlot {
+    size_t index = 0;
+    std::string path;       // must outlive the OPENAT
+    int fd = -1;
+    bool busy = false;      // has a request in the ring
+    size_t filled = 0;
+    std::pmr::vector<uint8_t> bytes;
+};
+
+
+/*
+ * An io_uring set up by hand: the submission and completion rings and the
+ * SQE array mapped from the ring fd. Only one thread drives it.
+ */
+class ClassFileLoader::Ring {
+private:
+    int m_fd = -1;
+    void *m_sqRing = MAP_FAILED;
+    size_t m_sqRingSize = 0;
+    void *m_cqRing = MAP_FAILED;
+    size_t m_cqRingSize = 0;
+    io_uring_sqe *m_sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    size_t m_sqesSize = 0;
+
+    unsigned *m_sqHead = nullptr;
+    unsigned *m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned *m_sqArray = nullptr;
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe *m_cqes = nullptr;
+    unsigned m_toSubmit = 0;
+
+    bool
+    supportsOpcodes(std::initializer_list<uint8_t> opcodes) const {
+        constexpr unsigned probeOps = 256;
+        std::vector<uint8_t> buffer(sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op));
+        auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+        if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, probeOps) < 0) {
+            return false;
+        }
+        return std::all_of(opcodes.begin(), opcodes.end(), [&](uint8_t opcode) {
+            return (opcode < probe->ops_len) && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+        });
+    }
+
+    template <typename T>
+    T *
+    at(void *ring, uint32_t offset) const { return reinterpret_cast<T *>(static_cast<uint8_t *>(ring) + offset); }
+
+public:
+    unsigned entries = 0;
+    // slots of requests the ring may still complete after it failed
+    std::vector<RingSlot> stranded;
+
+    Ring() = default;
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    ~Ring() {
+        if (m_sqes != MAP_FAILED) {
+            munmap(m_sqes, m_sqesSize);
+        }
+        if ((m_cqRing != MAP_FAILED) && (m_cqRing != m_sqRing)) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing != MAP_FAILED) {
+            munmap(m_sqRing, m_sqRingSize);
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    // nullptr when io_uring is missing, not allowed or too old for OPENAT and READ
+    static std::unique_ptr<Ring>
+    create(unsigned wantedEntries) {
+        auto ring = std::make_unique<Ring>();
+        io_uring_params params{};
+        ring->m_fd = (int)syscall(__NR_io_uring_setup, wantedEntries, &params);
+        if (ring->m_fd < 0) {
+            return nullptr;
+        }
+
+        ring->m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            ring->m_sqRingSize = ring->m_cqRingSize = std::max(ring->m_sqRingSize, ring->m_cqRingSize);
+        }
+        ring->m_sqRing = mmap(nullptr, ring->m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ring->m_fd, IORING_OFF_SQ_RING);
+        if (ring->m_sqRing == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->m_cqRing = singleMap ? ring->m_sqRing
+                                   : mmap(nullptr, ring->m_cqRingSize, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, ring->m_fd, IORING_OFF_CQ_RING);
+        ring->m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        ring->m_sqes = static_cast<io_uring_sqe *>(mmap(nullptr, ring->m_sqesSize, PROT_READ | PROT_WRITE,
+                                                        MAP_SHARED | MAP_POPULATE, ring->m_fd, IORING_OFF_SQES));
+        if ((ring->m_cqRing == MAP_FAILED) || (ring->m_sqes == MAP_FAILED) ||
+            !ring->supportsOpcodes({ IORING_OP_OPENAT, IORING_OP_READ })) {
+            return nullptr;
+        }
+
+        ring->m_sqHead = ring->at<unsigned>(ring->m_sqRing, params.sq_off.head);
+        ring->m_sqTail = ring->at<unsigned>(ring->m_sqRing, params.sq_off.tail);
+        ring->m_sqMask = *ring->at<unsigned>(ring->m_sqRing, params.sq_off.ring_mask);
+        ring->m_sqArray = ring->at<unsigned>(ring->m_sqRing, params.sq_off.array);
+        ring->m_cqHead = ring->at<unsigned>(ring->m_cqRing, params.cq_off.head);
+        ring->m_cqTail = ring->at<unsigned>(ring->m_cqRing, params.cq_off.tail);
+        ring->m_cqMask = *ring->at<unsigned>(ring->m_cqRing, params.cq_off.ring_mask);
+        ring->m_cqes = ring->at<io_uring_cqe>(ring->m_cqRing, params.cq_off.cqes);
+        ring->entries = params.sq_entries;
+        return ring;
+    }
+
+    // a cleared SQE queued for the next submit(); at most entries may be outstanding
+    io_uring_sqe &
+    queue() {
+        unsigned tail = *m_sqTail + m_toSubmit;
+        unsigned slot = tail & m_sqMask;
+        io_uring_sqe &sqe = m_sqes[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+        m_sqArray[slot] = slot;
+        m_toSubmit++;
+        return sqe;
+    }
+
+    // submits what was queued and waits for at least one completion; false on errors other than EINTR
+    bool
+    submitAndWait() {
+        unsigned tail = *m_sqTail + m_toSubmit;
+        std::atomic_ref<unsigned>(*m_sqTail).store(tail, std::memory_order_release);
+        unsigned toSubmit = m_toSubmit;
+        m_toSubmit = 0;
+        while (true) {
+            long submitted = syscall(__NR_io_uring_enter, m_fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted >= 0) {
+                return true;
+            }
+            if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+                return false;
+            }
+            // whatever the kernel has not taken from the ring yet is submitted again
+            toSubmit = tail - std::atomic_ref<unsigned>(*m_sqHead).load(std::memory_order_acquire);
+        }
+    }
+
+    template <typename Body>
+    void
+    reap(Body &&body) {
+        unsigned head = *m_cqHead;
+        unsigned tail = std::atomic_ref<unsigned>(*m_cqTail).load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            const io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+            body(cqe.user_data, cqe.res);
+        }
+        std::atomic_ref<unsigned>(*m_cqHead).store(head, std::memory_order_release);
+    }
+};
+
+#else
+
+class ClassFileLoader::Ring {};
+
+#endif
+
+
+ClassFileLoader::ClassFileLoader(const ClassFileLoaderOptions &options) : m_options(options) {
+    m_options.maxInFlight = std::max<size_t>(m_options.maxInFlight, 1);
+    if (m_options.memoryResource == nullptr) {
+        m_options.memoryResource = std::pmr::get_default_resource();
+    }
+#ifdef __linux__
+    if (m_options.useIoUring) {
+        m_ring = Ring::create((unsigned)std::min<size_t>(m_options.maxInFlight, 4096));
+    }
+#endif
+}
+
+
+ClassFileLoader::~ClassFileLoader() = default;
+
+
+void
+ClassFileLoader::loadWithThreads(const std::vector<std::filesystem::path> &paths, const Done &done) {
+    struct Loaded {
+        size_t index;
+        std::pmr::vector<uint8_t> bytes;
+        bool ok;
+    };
+    std::mutex mutex;
+    std::condition_variable ready;      // something was loaded
+    std::condition_variable taken;      // room for more
+    std::deque<Loaded> loaded;
+    size_t next = 0;
+    size_t outstanding = 0;             // being read, or loaded and not yet handed to done; at most maxInFlight
+
+    auto reader = [&] {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock lock(mutex);
+                taken.wait(lock, [&] { return (outstanding < m_options.maxInFlight) || (next >= paths.size()); });
+                if (next >= paths.size()) {
+                    return;
+                }
+                index = next++;
+                outstanding++;
+            }
+            std::pmr::vector<uint8_t> bytes(m_options.memoryResource);
+            bool ok = readWholeFile(paths[index].c_str(), bytes);
+            if (!ok) {
+                bytes.clear();
+            }
+            {
+                std::lock_guard lock(mutex);
+                loaded.push_back({ index, std::move(bytes), ok });
+            }
+            ready.notify_one();
+        }
+    };
+
+    // more threads than cores only take turns on them
+    size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::thread> readers;
+    size_t readerCount = std::min({ m_options.maxInFlight, cores, paths.size() });
+    for (size_t i = 0; i < readerCount; i++) {
+        readers.emplace_back(reader);
+    }
+    for (size_t delivered = 0; delivered < paths.size(); delivered++) {
+        std::unique_lock lock(mutex);
+        ready.wait(lock, [&] { return !loaded.empty(); });
+        Loaded item = std::move(loaded.front());
+        loaded.pop_front();
+        outstanding--;
+        lock.unlock();
+        taken.notify_one();
+        done(item.index, std::move(item.bytes), item.ok);
+    }
+    for (auto &thread : readers) {
+        thread.join();
+    }
+}
+
+
+void
+ClassFileLoader::load(const std::vector<std::filesystem::path> &paths, const Done &done) {
+    if (!m_ring) {
+        loadWithThreads(paths, done);
+        return;
+    }
+#ifdef __linux__
+    /*
+     * Every slot is one file: an OPENAT, then READs until it is whole. A slot
+     * has at most one request in the ring, so entries slots never overflow it;
+     * the kernel rounds entries up to a power of two, hence the maxInFlight bound.
+     */
+    std::vector<RingSlot> slots(std::min<size_t>(m_ring->entries, m_options.maxInFlight));
+    std::vector<uint32_t> freeSlots;
+    for (uint32_t i = 0; i < slots.size(); i++) {
+        freeSlots.push_back((uint32_t)slots.size() - 1 - i);
+    }
+    size_t next = 0;
+    size_t active = 0;
+
+    auto finish = [&](uint32_t slotNum, bool ok) {
+        RingSlot &slot = slots[slotNum];
+        if (slot.fd >= 0) {
+            close(slot.fd);
+            slot.fd = -1;
+        }
+        if (!ok) {
+            slot.bytes.clear();
+        }
+        slot.busy = false;
+        freeSlots.push_back(slotNum);
+        active--;
+        done(slot.index, std::move(slot.bytes), ok);
+    };
+    auto queueRead = [&](uint32_t slotNum) {
+        RingSlot &slot = slots[slotNum];
+        io_uring_sqe &sqe = m_ring->queue();
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = slot.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(slot.bytes.data() + slot.filled);
+        sqe.len = (uint32_t)(slot.bytes.size() - slot.filled);
+        sqe.off = slot.filled;
+        sqe.user_data = slotNum;
+    };
+
+    while ((next < paths.size()) || (active > 0)) {
+        while ((next < paths.size()) && !freeSlots.empty()) {
+            uint32_t slotNum = freeSlots.back();
+            freeSlots.pop_back();
+            RingSlot &slot = slots[slotNum];
+            slot.index = next++;
+            slot.path = paths[slot.index].string();
+            slot.filled = 0;
+            slot.bytes = std::pmr::vector<uint8_t>(m_options.memoryResource);
+            slot.busy = true;
+            active++;
+
+            io_uring_sqe &sqe = m_ring->queue();
+            sqe.opcode = IORING_OP_OPENAT;
+            sqe.fd = AT_FDCWD;
+            sqe.addr = reinterpret_cast<uint64_t>(slot.path.c_str());
+            sqe.open_flags = O_RDONLY | O_CLOEXEC;
+            sqe.user_data = slotNum;
+        }
+
+        if (!m_ring->submitAndWait()) {
+            /*
+             * Not expected once the ring is set up. Requests already in the
+             * kernel may still write into their slots, so the ring keeps them
+             * until the loader goes away; those files count as unreadable and
+             * the ones not started yet are read with threads.
+             */
+            for (auto &slot : slots) {
+                if (slot.busy) {
+                    done(slot.index, std::pmr::vector<uint8_t>(m_options.memoryResource), false);
+                }
+            }
+            m_ring->stranded = std::move(slots);
+            m_failedRing = std::move(m_ring);
+
+            std::vector<std::filesystem::path> rest(paths.begin() + (std::ptrdiff_t)next, paths.end());
+            loadWithThreads(rest, [&](size_t index, std::pmr::vector<uint8_t> &&bytes, bool ok) {
+                done(next + index, std::move(bytes), ok);
+            });
+            return;
+        }
+
+        m_ring->reap([&](uint64_t userData, int32_t res) {
+            auto slotNum = (uint32_t)userData;
+            RingSlot &slot = slots[slotNum];
+            if (res < 0) {
+                finish(slotNum, false);
+                return;
+            }
+            if (slot.fd < 0) {
+                // OPENAT done: size the buffer and read the whole file
+                slot.fd = res;
+                struct stat st{};
+                if ((fstat(slot.fd, &st) != 0) || !S_ISREG(st.st_mode) || ((size_t)st.st_size > maxFileSize)) {
+                    finish(slotNum, false);
+                    return;
+                }
+                slot.bytes.resize((size_t)st.st_size);
+            } else {
+                slot.filled += (size_t)res;
+                if (res == 0) {
+                    // the file shrank since fstat
+                    slot.bytes.resize(slot.filled);
+                }
+            }
+            if (slot.filled == slot.bytes.size()) {
+                finish(slotNum, true);
+                return;
+            }
+            queueRead(slotNum);
+        });
+    }
+#endif
+}
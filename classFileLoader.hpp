@@ -0,0 +1,78 @@
+#ifndef SJBCDC_CLASSFILELOADER_HPP
+#define SJBCDC_CLASSFILELOADER_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+enum class ClassFileLoaderBackend {
+    IoUring,    // opens and reads queued to the kernel through one io_uring
+    Pread       // reader threads doing open, posix_fadvise and pread
+};
+
+struct ClassFileLoaderOptions {
+    /*
+     * files being opened or read at once: io_uring entries, or for Pread the
+     * files being read or waiting for done, read by at most
+     * hardware_concurrency() threads
+     */
+    size_t maxInFlight = 64;
+    // false skips io_uring and always reads with the reader threads
+    bool useIoUring = true;
+    // where the file buffers are allocated; nullptr means std::pmr::get_default_resource()
+    std::pmr::memory_resource *memoryResource = nullptr;
+};
+
+/*
+ * Reads many whole files ahead of whoever parses them. Parsing a directory
+ * of small class files on a cold cache is bound by the open/stat/read
+ * round trips of each file, not by parsing; the loader keeps up to
+ * maxInFlight of them outstanding at once instead of one per parser.
+ *
+ * io_uring is driven through the raw syscalls (no liburing): every file is
+ * an IORING_OP_OPENAT followed by IORING_OP_READs of its fstat() size. When
+ * the kernel has no io_uring, forbids it or lacks those opcodes, the Pread
+ * backend is used instead.
+ */
+class ClassFileLoader {
+public:
+    /*
+     * bytes is empty (and ok false) when the file could not be opened or
+     * read; the loader does not say why, the caller opening the path itself
+     * gets the error as usual
+     */
+    using Done = std::function<void(size_t index, std::pmr::vector<uint8_t> &&bytes, bool ok)>;
+
+private:
+    class Ring;
+
+    ClassFileLoaderOptions m_options;
+    std::unique_ptr<Ring> m_ring;       // nullptr for ClassFileLoaderBackend::Pread
+    std::unique_ptr<Ring> m_failedRing; // kept for the buffers of requests it never completed
+
+    void
+    loadWithThreads(const std::vector<std::filesystem::path> &paths, const Done &done);
+
+public:
+    explicit ClassFileLoader(const ClassFileLoaderOptions &options = {});
+    ClassFileLoader(const ClassFileLoader &) = delete;
+    ClassFileLoader &operator=(const ClassFileLoader &) = delete;
+    ~ClassFileLoader();
+
+    ClassFileLoaderBackend
+    backend() const { return m_ring ? ClassFileLoaderBackend::IoUring : ClassFileLoaderBackend::Pread; }
+
+    /*
+     * Reads every path and calls done once per path, on the calling thread,
+     * in completion order. A done that blocks (e.g. until a parser is free)
+     * holds back further reads, so the buffers handed out stay bounded too.
+     * One load() at a time.
+     */
+    void
+    load(const std::vector<std::filesystem::path> &paths, const Done &done);
+};
+
+#endif //SJBCDC_CLASSFILELOADER_HPP
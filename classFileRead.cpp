@@ -1,54 +1,24 @@
 #include "classFileRead.hpp"
+#include "classFileBuffer.hpp"
+#include "utf8Validate.hpp"
+#include "descriptor.hpp"
+#include "descriptorCache.hpp"
+#include "classCache.hpp"
+#include "hash.hpp"
+#include "parseStats.hpp"
 #include <filesystem>
 #include <array>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
+#include <memory>
 
 
-template <typename type>
-static type
-getValueFromClassFileBuffer(std::vector<uint8_t> &buffer, size_t &ptr) {
-    auto ret = std::byteswap(*((type *)(&(buffer[ptr]))));
-    ptr += sizeof(type);
-    return ret;
-}
-
-
-constexpr static auto
-initResults = std::to_array<std::string_view>({
-    "File not found",
-    "Error while opening file",
-    "Invalid file size",
-    "Not a class file",
-    "Minor version not found",
-    "Major version not found",
-    "Invalid major version",
-    "Invalid minor version",
-    "Constant pool size not found",
-    "Invalid constant"
-});
-
-
-template <typename str1, typename str2>
-static inline std::string
-createErrorString(str1 pathStr, str2 initResultStr) {
-    return std::string(pathStr) + ": " + std::string(initResultStr);
-}
-
-
-template <typename T1, typename T2>
 static inline bool
-setupErrStrAndReturnTrue(T1 argErrStr1, T2 argErrStr2, std::string &strDst) {
-    strDst = createErrorString(argErrStr1, argErrStr2);
-    return true;
-}
-
-
-template <typename T1, typename T2, typename T3>
-static inline bool
-setupErrStrWithAdditionalInfoAndReturnTrue(T1 argErrStr1, T2 argErrStr2, std::string &strDst, T3 addInfo) {
-    setupErrStrAndReturnTrue(argErrStr1, argErrStr2, strDst);
-    strDst += std::string(addInfo);
+setupErrorAndReturnTrue(ClassFileError &dst, ClassFileErrorCode code, size_t offset,
+                        size_t index = noErrorIndex, uint8_t tag = 0) {
+    SJBCDC_STATS(parseStats::addError((size_t)code - 1));
+    dst = ClassFileError{ code, tag, (uint16_t)index, (uint32_t)std::min<size_t>(offset, UINT32_MAX) };
     return true;
 }
 
@@ -57,41 +27,24 @@ bool
 ClassFile::parseFilePath(std::string &pathStr) {
     m_path = std::filesystem::path(pathStr);
     if (!std::filesystem::exists(m_path)) {
-        return setupErrStrAndReturnTrue(pathStr, initResults[0], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::FileNotFound, 0);
     }
     return false;
 }
 
 
-template <typename Buffer>
-static inline bool
-bufferReadNBytesCorrect(Buffer &buf, size_t &bufPtr, size_t bytesNum) {
-    if (buf.size() < bufPtr + bytesNum) {
-        return false;
-    }
-    return true;
-}
-
-
-template <typename typeForRead, typename Buffer>
-static inline bool
-bufferReadTypeCorrect(Buffer &buf, size_t &bufPtr) {
-    return bufferReadNBytesCorrect(buf, bufPtr, sizeof(typeForRead));
-}
-
-
 bool
-ClassFile::setupClassFileBuf(std::vector<uint8_t> &buf) {
+ClassFile::setupClassFileBuf(std::pmr::vector<uint8_t> &buf) {
     std::ifstream src(m_path, std::ios::in | std::ios::binary);
     if (!src.is_open()) {
-        return setupErrStrAndReturnTrue(m_path, initResults[1], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::ErrorOpeningFile, 0);
     }
 
     size_t srcSz = std::filesystem::file_size(m_path);
     buf.resize(srcSz);
     if (srcSz > std::numeric_limits<long>::max()) {
         src.close();
-        return setupErrStrAndReturnTrue(m_path, initResults[2], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidFileSize, 0);
     }
     src.read((char *)&(buf[0]), (long)srcSz);
     src.close();
@@ -100,14 +53,30 @@ ClassFile::setupClassFileBuf(std::vector<uint8_t> &buf) {
 
 
 bool
-ClassFile::parseMagicConst(std::vector<uint8_t> &buf, size_t &bufPtr) {
+ClassFile::setupClassFileMapping() {
+    switch (m_mappedFile.map(m_path)) {
+        case MappedFile::Status::Ok: {
+            return false;
+        }
+        case MappedFile::Status::InvalidSize: {
+            return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidFileSize, 0);
+        }
+        default: {
+            return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::ErrorOpeningFile, 0);
+        }
+    }
+}
+
+
+bool
+ClassFile::parseMagicConst(std::span<const uint8_t> buf, size_t &bufPtr) {
     if (!bufferReadTypeCorrect<uint32_t>(buf, bufPtr)) {
-        return setupErrStrAndReturnTrue(m_path, initResults[3], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::NotAClassFile, bufPtr);
     }
 
     m_magic = getValueFromClassFileBuffer<uint32_t>(buf, bufPtr);
     if (m_magic != 0xCAFEBABE) {
-        return setupErrStrAndReturnTrue(m_path, initResults[3], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::NotAClassFile, bufPtr);
     }
 
     return false;
@@ -115,9 +84,9 @@ ClassFile::parseMagicConst(std::vector<uint8_t> &buf, size_t &bufPtr) {
 
 
 bool
-ClassFile::parseMinorVersion(std::vector<uint8_t> &buf, size_t &bufPtr) {
+ClassFile::parseMinorVersion(std::span<const uint8_t> buf, size_t &bufPtr) {
     if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        return setupErrStrAndReturnTrue(m_path, initResults[4], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::MinorVersionNotFound, bufPtr);
     }
     m_minorVersion = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
 
@@ -126,608 +95,1016 @@ ClassFile::parseMinorVersion(std::vector<uint8_t> &buf, size_t &bufPtr) {
 
 
 bool
-ClassFile::parseMajorVersion(std::vector<uint8_t> &buf, size_t &bufPtr) {
+ClassFile::parseMajorVersion(std::span<const uint8_t> buf, size_t &bufPtr) {
     if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        return setupErrStrAndReturnTrue(m_path, initResults[5], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::MajorVersionNotFound, bufPtr);
     }
 
     m_majorVersion = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
     if ((m_majorVersion < 45) || (m_majorVersion > 63)) {
-        return setupErrStrAndReturnTrue(m_path, initResults[6], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidMajorVersion, bufPtr);
     } else if ((m_majorVersion >= 56) && (m_minorVersion != 0) && (m_minorVersion != 65535)) {
-        return setupErrStrAndReturnTrue(m_path, initResults[7], m_result);
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidMinorVersion, bufPtr);
     }
 
     return false;
 }
 
 
-static inline bool
-incorrectUtf8Byte(uint8_t &byte) {
-    return (byte == 0) || ((byte >= 0xf0) && (byte <= 0xff));
-}
-
-
 template <typename Buffer>
 static CONSTANT_Utf8Info
-readConstantUtf8FromBuf(Buffer &buf, size_t &bufPtr, bool &flagError) {
-    CONSTANT_Utf8Info constant{};
+readConstantUtf8FromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, Utf8Storage storage,
+                        std::pmr::memory_resource *resource, SymbolTable *symbols, bool validate) {
+    CONSTANT_Utf8Info constant{ std::pmr::vector<uint8_t>(resource) };
     if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
         flagError = true;
         return constant;
     }
 
-    constant.bytes.resize(getValueFromClassFileBuffer<uint16_t>(buf, bufPtr));
-    if (!bufferReadNBytesCorrect(buf, bufPtr, constant.bytes.size())) {
+    constant.length = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+    constant.offset = (uint32_t)bufPtr;
+    if (!bufferReadNBytesCorrect(buf, bufPtr, constant.length)) {
         flagError = true;
         return constant;
     }
 
-    for (auto &byte : constant.bytes) {
-        byte = getValueFromClassFileBuffer<uint8_t>(buf, bufPtr);
-        if (incorrectUtf8Byte(byte)) {
-            flagError = true;
-            return constant;
-        }
+    auto bytes = std::span(buf).subspan(bufPtr, constant.length);
+    if (validate && !validModifiedUtf8(bytes.data(), bytes.size())) {
+        flagError = true;
+        return constant;
     }
 
+    if (storage == Utf8Storage::Owned) {
+        constant.bytes.assign(bytes.begin(), bytes.end());
+    } else if (storage == Utf8Storage::Interned) {
+        constant.symbol = symbols->intern({ reinterpret_cast<const char *>(bytes.data()), bytes.size() });
+    }
+    bufPtr += constant.length;
+
     return constant;
 }
 
 
-template <typename CONSTANT_IntOrFloatType, typename Buffer>
-static CONSTANT_IntOrFloatType
-readConstantIntOrFloatFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError) {
-    CONSTANT_IntOrFloatType constant{};
-    if (!bufferReadTypeCorrect<uint32_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+template <typename T>
+static inline T
+readBigEndian(const uint8_t *bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return std::byteswap(value);
+}
+
+
+/*
+ * Decodes the constant of tag Tag from the constantLayoutSize<Tag> bytes at
+ * info, which the caller has bounds checked: every field is read at an
+ * offset known at compile time, and only the index fields are range checked
+ */
+template <uint8_t Tag>
+static bool
+decodeFixedSizeConstant(ClassFileConstants &constants, const uint8_t *info, size_t constantPoolCount, idxRef &ref) {
+    using Layout = ConstantLayout<Tag>;
+    typename Layout::Info constant{};
+    bool valid = true;
+    std::apply([&](auto... fields) {
+        size_t offset = 0;
+        size_t fieldNum = 0;
+        auto decodeField = [&](auto field) {
+            using Field = typename ConstantFieldType<decltype(field)>::Type;
+            constant.*field = readBigEndian<Field>(info + offset);
+            if (Layout::indexFields & (1u << fieldNum)) {
+                valid &= (constant.*field > 0) && (constant.*field < constantPoolCount);
+            }
+            offset += sizeof(Field);
+            fieldNum++;
+        };
+        (decodeField(fields), ...);
+    }, Layout::fields);
+
+    if constexpr (Tag == CONSTANT_MethodHandle) {
+        valid &= (constant.referenceKind >= REF_getField) && (constant.referenceKind <= REF_invokeInterface);
+    }
+    if (!valid) {
+        return false;
     }
 
-    constant.bytes = getValueFromClassFileBuffer<uint32_t>(buf, bufPtr);
-    return constant;
+    auto &storage = constants.*Layout::storage;
+    storage.push_back(constant);
+    ref = idxRef{ Tag, storage.size() - 1 };
+    return true;
 }
 
 
-template <typename CONSTANT_LongOrDoubleType, typename Buffer>
-static CONSTANT_LongOrDoubleType
-readConstantLongOrDoubleFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError) {
-    CONSTANT_LongOrDoubleType constant{};
-    if (!bufferReadTypeCorrect<uint64_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+/*
+ * Calls the decoder of tag: the fold over the tag list compiles to a jump
+ * table with every decoder inlined into it
+ */
+template <uint8_t... Tags>
+static inline bool
+decodeFixedSizeConstant(ConstantTagList<Tags...>, uint8_t tag, ClassFileConstants &constants, const uint8_t *info,
+                        size_t constantPoolCount, idxRef &ref) {
+    bool valid = false;
+    (void)((tag == Tags && ((valid = decodeFixedSizeConstant<Tags>(constants, info, constantPoolCount, ref)), true)) ||
+           ...);
+    return valid;
+}
+
+
+bool
+ClassFile::decodeConstant(std::span<const uint8_t> buf, size_t &bufPtr, size_t constantPoolCount, idxRef &ref) const {
+    if (!bufferReadTypeCorrect<uint8_t>(buf, bufPtr)) {
+        return false;
+    }
+    auto tag = getValueFromClassFileBuffer<uint8_t>(buf, bufPtr);
+
+    if (tag == CONSTANT_Utf8) {
+        bool parseError = false;
+        m_constants.utf8Consts.push_back(
+                readConstantUtf8FromBuf(buf, bufPtr, parseError, m_options.utf8Storage,
+                                        m_constants.resource(), m_options.symbolTable,
+                                        m_options.verifyLevel != VerifyLevel::None)
+        );
+        if (parseError) { return false; }
+        ref = idxRef{ CONSTANT_Utf8, m_constants.utf8Consts.size() - 1 };
+        return true;
     }
 
-    constant.highBytes = getValueFromClassFileBuffer<uint32_t>(buf, bufPtr);
-    constant.lowBytes = getValueFromClassFileBuffer<uint32_t>(buf, bufPtr);
-    return constant;
+    // one bounds check for the whole constant; unknown tags have size 0
+    size_t size = (tag < CONSTANT_TagCount) ? constantFixedSizes[tag] : 0;
+    if ((size == 0) || !bufferReadNBytesCorrect(buf, bufPtr, size)) {
+        return false;
+    }
+    bool valid = decodeFixedSizeConstant(FixedSizeConstantTags{}, tag, m_constants, buf.data() + bufPtr,
+                                         constantPoolCount, ref);
+    bufPtr += size;
+    return valid;
 }
 
-template <typename T1, typename T2>
-static bool
-validIndexInConstantPoolTable(T1 &idx, T2 &constantPoolCount) {
-    if ((idx > 0) && (idx < constantPoolCount)) {
+bool
+ClassFile::parseConstant(std::span<const uint8_t> buf, size_t &bufPtr, size_t &constantPoolCount) {
+    idxRef ref{};
+    if (!decodeConstant(buf, bufPtr, constantPoolCount, ref)) {
+        return false;
+    }
+    m_constants.idxTable.push_back(ref);
+    return true;
+}
+
+
+/*
+ * Checks the constant described by ref against the constants it refers to
+ * (JVMS 4.4), as far as m_options.verifyLevel asks for. Only indices below
+ * available are looked at: when the check needs a later one the result is
+ * Pending and the constant is checked again once the whole pool is decoded.
+ */
+ClassFile::ConstantCheck
+ClassFile::checkConstant(const idxRef &ref, size_t available) const {
+    bool full = m_options.verifyLevel == VerifyLevel::Full;
+    bool pending = false;
+
+    // with lazyConstantPool the referenced constant is decoded (and checked) too
+    auto tagAt = [&](size_t cpIdx) -> uint8_t {
+        if (cpIdx >= available) {
+            pending = true;
+            return 0;
+        }
+        if (m_options.lazyConstantPool && !constant(cpIdx)) {
+            return 0;
+        }
+        return constantTag(cpIdx);
+    };
+    auto nameAndTypeAt = [&](size_t cpIdx, std::string_view &name, std::string_view &descriptor) {
+        if (tagAt(cpIdx) != CONSTANT_NameAndType) {
+            return false;
+        }
+        CONSTANT_NameAndTypeInfo nameAndType = m_constants.nameAndTypeConsts[constant(cpIdx)->idxInType];
+        if ((tagAt(nameAndType.nameIndex) != CONSTANT_Utf8) ||
+            (tagAt(nameAndType.descriptorIndex) != CONSTANT_Utf8)) {
+            return false;
+        }
+        name = utf8(nameAndType.nameIndex);
+        descriptor = utf8(nameAndType.descriptorIndex);
         return true;
+    };
+    auto memberRefValid = [&](size_t classIndex, size_t nameAndTypeIndex, bool isMethod) {
+        if (tagAt(classIndex) != CONSTANT_Class) {
+            return false;
+        }
+        if (!full) {
+            return tagAt(nameAndTypeIndex) == CONSTANT_NameAndType;
+        }
+        std::string_view name;
+        std::string_view descriptor;
+        if (!nameAndTypeAt(nameAndTypeIndex, name, descriptor)) {
+            return false;
+        }
+        const ParsedDescriptor *parsed = m_options.descriptorCache->get(descriptor);
+        if (!isMethod) {
+            return isValidUnqualifiedName(name) && (parsed->kind == DescriptorKind::Field);
+        }
+        if (parsed->kind != DescriptorKind::Method) {
+            return false;
+        }
+        if (name == "<init>") {
+            return parsed->returnsVoid();
+        }
+        return isValidMethodName(name) && (name != "<clinit>");
+    };
+    // CONSTANT_NameAndType index of the Fieldref/Methodref/InterfaceMethodref at cpIdx
+    auto memberRefNameAndType = [&](size_t cpIdx) -> size_t {
+        size_t idxInType = constant(cpIdx)->idxInType;
+        switch (constantTag(cpIdx)) {
+            case CONSTANT_Fieldref: {
+                return m_constants.fieldrefConsts[idxInType].nameAndTypeIndex;
+            }
+            case CONSTANT_Methodref: {
+                return m_constants.methodrefConsts[idxInType].nameAndTypeIndex;
+            }
+            default: {
+                return m_constants.interfaceMetodrefConsts[idxInType].nameAndTypeIndex;
+            }
+        }
+    };
+
+    bool valid = true;
+    switch (ref.type) {
+        case CONSTANT_Class: {
+            CONSTANT_ClassInfo constant = m_constants.classConsts[ref.idxInType];
+            valid = (tagAt(constant.nameIndex) == CONSTANT_Utf8) &&
+                    (!full || isValidClassConstantName(utf8(constant.nameIndex)));
+            break;
+        }
+        case CONSTANT_String: {
+            valid = tagAt(m_constants.stringConsts[ref.idxInType].stringIndex) == CONSTANT_Utf8;
+            break;
+        }
+        case CONSTANT_Fieldref: {
+            CONSTANT_FieldrefInfo constant = m_constants.fieldrefConsts[ref.idxInType];
+            valid = memberRefValid(constant.classIndex, constant.nameAndTypeIndex, false);
+            break;
+        }
+        case CONSTANT_Methodref: {
+            CONSTANT_MethodrefInfo constant = m_constants.methodrefConsts[ref.idxInType];
+            valid = memberRefValid(constant.classIndex, constant.nameAndTypeIndex, true);
+            break;
+        }
+        case CONSTANT_InterfaceMethodref: {
+            CONSTANT_InterfaceMethodrefInfo constant = m_constants.interfaceMetodrefConsts[ref.idxInType];
+            valid = memberRefValid(constant.classIndex, constant.nameAndTypeIndex, true);
+            break;
+        }
+        case CONSTANT_NameAndType: {
+            CONSTANT_NameAndTypeInfo constant = m_constants.nameAndTypeConsts[ref.idxInType];
+            valid = (tagAt(constant.nameIndex) == CONSTANT_Utf8) &&
+                    (tagAt(constant.descriptorIndex) == CONSTANT_Utf8);
+            if (valid && full) {
+                valid = isValidUnqualifiedName(utf8(constant.nameIndex)) &&
+                        (m_options.descriptorCache->get(utf8(constant.descriptorIndex))->kind !=
+                         DescriptorKind::Invalid);
+            }
+            break;
+        }
+        case CONSTANT_MethodHandle: {
+            CONSTANT_MethodHandleInfo constant = m_constants.methodHandleConsts[ref.idxInType];
+            uint8_t targetTag = tagAt(constant.referenceIndex);
+            switch (constant.referenceKind) {
+                case REF_getField:
+                case REF_getStatic:
+                case REF_putField:
+                case REF_putStatic: {
+                    valid = targetTag == CONSTANT_Fieldref;
+                    break;
+                }
+                case REF_invokeVirtual:
+                case REF_newInvokeSpecial: {
+                    valid = targetTag == CONSTANT_Methodref;
+                    break;
+                }
+                case REF_invokeStatic:
+                case REF_invokeSpecial: {
+                    valid = (targetTag == CONSTANT_Methodref) ||
+                            ((targetTag == CONSTANT_InterfaceMethodref) && (m_majorVersion >= 52));
+                    break;
+                }
+                default: {
+                    valid = targetTag == CONSTANT_InterfaceMethodref;
+                    break;
+                }
+            }
+            if (valid && full) {
+                std::string_view name;
+                std::string_view descriptor;
+                valid = nameAndTypeAt(memberRefNameAndType(constant.referenceIndex), name, descriptor);
+                if (valid && (constant.referenceKind == REF_newInvokeSpecial)) {
+                    valid = name == "<init>";
+                } else if (valid && (constant.referenceKind >= REF_invokeVirtual)) {
+                    valid = (name != "<init>") && (name != "<clinit>");
+                }
+            }
+            break;
+        }
+        case CONSTANT_MethodType: {
+            size_t descriptorIndex = m_constants.methodTypeConsts[ref.idxInType].descriptorIndex;
+            valid = (tagAt(descriptorIndex) == CONSTANT_Utf8) &&
+                    (!full || (m_options.descriptorCache->get(utf8(descriptorIndex))->kind == DescriptorKind::Method));
+            break;
+        }
+        case CONSTANT_Dynamic:
+        case CONSTANT_InvokeDynamic: {
+            size_t nameAndTypeIndex = (ref.type == CONSTANT_Dynamic)
+                    ? m_constants.dynamicConsts[ref.idxInType].nameAndTypeIndex
+                    : m_constants.invokeDynamicConsts[ref.idxInType].nameAndTypeIndex;
+            if (!full) {
+                valid = tagAt(nameAndTypeIndex) == CONSTANT_NameAndType;
+                break;
+            }
+            std::string_view name;
+            std::string_view descriptor;
+            valid = nameAndTypeAt(nameAndTypeIndex, name, descriptor) &&
+                    (m_options.descriptorCache->get(descriptor)->kind ==
+                     ((ref.type == CONSTANT_Dynamic) ? DescriptorKind::Field : DescriptorKind::Method));
+            break;
+        }
+        case CONSTANT_Module: {
+            valid = tagAt(m_constants.moduleConsts[ref.idxInType].nameIndex) == CONSTANT_Utf8;
+            break;
+        }
+        case CONSTANT_Package: {
+            valid = tagAt(m_constants.packageConsts[ref.idxInType].nameIndex) == CONSTANT_Utf8;
+            break;
+        }
+        default: {
+            break;
+        }
     }
-    return false;
+
+    if (pending) {
+        return ConstantCheck::Pending;
+    }
+    return valid ? ConstantCheck::Valid : ConstantCheck::Invalid;
 }
 
-template <typename Buffer>
-static CONSTANT_ClassInfo
-readConstantClassFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_ClassInfo constant{};
-    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+
+/*
+ * bootstrap_method_attr_index of every CONSTANT_Dynamic/InvokeDynamic has to
+ * be an entry of the BootstrapMethods attribute, which only comes after the
+ * members. Returns the index of the first constant that is not, or 0.
+ */
+size_t
+ClassFile::verifyBootstrapMethodRefs() const {
+    if ((m_constants.dynamicConsts.empty() && m_constants.invokeDynamicConsts.empty()) ||
+        !(m_options.attributeMask & attributeBit(AttributeKind::BootstrapMethods))) {
+        return 0;
     }
 
-    constant.nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.nameIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+    uint16_t bootstrapMethodsCount = 0;
+    const AttributeInfo *bootstrapMethods = findAttribute(classAttributes(), AttributeKind::BootstrapMethods);
+    if (bootstrapMethods != nullptr) {
+        auto view = decodeBootstrapMethods(attributeBytes(*bootstrapMethods));
+        bootstrapMethodsCount = view ? view->size() : 0;
     }
 
-    return constant;
+    auto outOfRange = [&](const auto &constant) {
+        return constant.bootstrapMethodAttrIndex >= bootstrapMethodsCount;
+    };
+    if (std::none_of(m_constants.dynamicConsts.begin(), m_constants.dynamicConsts.end(), outOfRange) &&
+        std::none_of(m_constants.invokeDynamicConsts.begin(), m_constants.invokeDynamicConsts.end(), outOfRange)) {
+        return 0;
+    }
+
+    // only a broken class file pays for finding the constant pool index
+    for (size_t cNum = 1; cNum < m_constants.idxTable.size() + 1; cNum++) {
+        const idxRef &ref = m_constants[cNum];
+        if (((ref.type == CONSTANT_Dynamic) && outOfRange(m_constants.dynamicConsts[ref.idxInType])) ||
+            ((ref.type == CONSTANT_InvokeDynamic) && outOfRange(m_constants.invokeDynamicConsts[ref.idxInType]))) {
+            return cNum;
+        }
+    }
+    return 0;
 }
 
 
-template <typename Buffer>
-static CONSTANT_StringInfo
-readConstantStringFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_StringInfo constant{};
-    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
-    }
+/*
+ * Walks the constant pool by tags and lengths only, calling
+ * onEntry(cpIdx, tag, tagOffset) for every constant. Leaves bufPtr past the
+ * pool and returns 0, or the index of the first malformed constant.
+ */
+template <typename Buffer, typename OnEntry>
+static size_t
+scanConstantPool(Buffer &buf, size_t &bufPtr, size_t constantPoolCount, OnEntry &&onEntry) {
+    for (size_t i = 1; i < constantPoolCount; i++) {
+        size_t tagOffset = bufPtr;
+        if (!bufferReadTypeCorrect<uint8_t>(buf, bufPtr)) {
+            return i;
+        }
+        auto tag = getValueFromClassFileBuffer<uint8_t>(buf, bufPtr);
+        if (tag >= CONSTANT_TagCount) {
+            return i;
+        }
 
-    constant.stringIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.stringIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+        size_t size = constantFixedSizes[tag];
+        if (tag == CONSTANT_Utf8) {
+            if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
+                return i;
+            }
+            size = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+        } else if (size == 0) {
+            return i;
+        }
+
+        if (!bufferReadNBytesCorrect(buf, bufPtr, size)) {
+            return i;
+        }
+        bufPtr += size;
+        // a long or double needs its second slot inside the pool too (JVMS 4.4.5)
+        if (constantTakesTwoSlots(tag) && (i + 1 >= constantPoolCount)) {
+            return i;
+        }
+        onEntry(i, tag, tagOffset);
+        if (constantTakesTwoSlots(tag)) {
+            i++;
+        }
     }
-    return constant;
+    return 0;
 }
 
 
-template <typename CONSTANT_FieldOrMethodOrInterfaceref, typename Buffer>
-static CONSTANT_FieldOrMethodOrInterfaceref
-readConstantFieldOrMethodOrInterfaceFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_FieldOrMethodOrInterfaceref constant{};
-    if (!bufferReadTypeCorrect<uint32_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+bool
+ClassFile::parseConstantPool(std::span<const uint8_t> buf, size_t &bufPtr) {
+    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::ConstantPoolSizeNotFound, bufPtr);
     }
+    size_t constantPoolCount = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
 
-    constant.classIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    constant.nameAndTypeIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.classIndex, constantPoolCount) ||
-            !validIndexInConstantPoolTable(constant.nameAndTypeIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+    if (m_options.lazyConstantPool) {
+        return parseConstantPoolLazy(buf, bufPtr, constantPoolCount);
     }
-    return constant;
-}
 
+    std::array<size_t, CONSTANT_TagCount> tagCounts{};
+    size_t scanPtr = bufPtr;
+    if ((constantPoolCount > 0) &&
+        !scanConstantPool(buf, scanPtr, constantPoolCount,
+                          [&](size_t, uint8_t tag, size_t) { tagCounts[tag]++; })) {
+        m_constants.reserve(constantPoolCount - 1, tagCounts);
+        SJBCDC_STATS(parseStats::addConstants(tagCounts));
+    }
 
-template <typename Buffer>
-static CONSTANT_NameAndTypeInfo
-readConstantNameAndTypeFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_NameAndTypeInfo constant{};
-    if (!bufferReadTypeCorrect<uint32_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+    /*
+     * Constants are checked right after decoding when everything they refer
+     * to precedes them; the others (javac puts most references forward) are
+     * checked in ascending index order once the pool is complete
+     */
+    bool verify = m_options.verifyLevel != VerifyLevel::None;
+    std::pmr::vector<uint16_t> pendingChecks(m_constants.resource());
+    for (size_t i = 1; i < constantPoolCount; i++) {
+        size_t constantOffset = bufPtr;
+        if (!parseConstant(buf, bufPtr, constantPoolCount)) {
+            uint8_t tag = (constantOffset < buf.size()) ? buf[constantOffset] : 0;
+            return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidConstant, constantOffset, i, tag);
+        }
+        if (verify) {
+            switch (checkConstant(m_constants.idxTable.back(), i + 1)) {
+                case ConstantCheck::Valid: {
+                    break;
+                }
+                case ConstantCheck::Pending: {
+                    pendingChecks.push_back((uint16_t)i);
+                    break;
+                }
+                case ConstantCheck::Invalid: {
+                    return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidConstant, constantOffset, i,
+                                                   m_constants.idxTable.back().type);
+                }
+            }
+        }
+        if (constantTakesTwoSlots(m_constants.idxTable.back().type)) {
+            // a long or double needs its second slot inside the pool too (JVMS 4.4.5)
+            if (i + 1 >= constantPoolCount) {
+                return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidConstant, constantOffset, i,
+                                               m_constants.idxTable.back().type);
+            }
+            m_constants.idxTable.push_back(idxRef{ 0, 0 });
+            i++;
+        }
     }
 
-    constant.nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    constant.descriptorIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.nameIndex, constantPoolCount) ||
-            !validIndexInConstantPoolTable(constant.descriptorIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+    SJBCDC_STATS(parseStats::lap(ParsePhase::ConstantPool));
+    for (uint16_t cpIdx : pendingChecks) {
+        if (checkConstant(m_constants[cpIdx], constantPoolCount) != ConstantCheck::Valid) {
+            return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidConstant, bufPtr, cpIdx,
+                                           m_constants[cpIdx].type);
+        }
     }
-    return constant;
+    SJBCDC_STATS(parseStats::lap(ParsePhase::DeferredChecks));
+
+    return false;
 }
 
+bool
+ClassFile::parseConstantPoolLazy(std::span<const uint8_t> buf, size_t &bufPtr, size_t constantPoolCount) {
+    auto &lazy = m_lazyConstants;
+    size_t entries = (constantPoolCount > 0) ? constantPoolCount : 1;
+    lazy.tags.assign(entries, 0);
+    lazy.offsets.assign(entries, 0);
+    lazy.decoded.assign(entries, 0);
+
+    size_t errIdx = scanConstantPool(buf, bufPtr, constantPoolCount, [&](size_t cpIdx, uint8_t tag, size_t offset) {
+        lazy.tags[cpIdx] = tag;
+        lazy.offsets[cpIdx] = (uint32_t)offset;
+    });
+    if (errIdx) {
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidConstant, bufPtr, errIdx);
+    }
 
-static bool
-validReferenceKind(uint8_t refKind) {
-    return (refKind >= 1) && (refKind <= 9);
+#ifdef SJBCDC_ENABLE_STATS
+    std::array<size_t, CONSTANT_TagCount> tagCounts{};
+    for (uint8_t tag : lazy.tags) {
+        tagCounts[tag]++;
+    }
+    parseStats::addConstants(tagCounts);
+    parseStats::lap(ParsePhase::ConstantPool);
+#endif
+    return false;
 }
 
 
-template <typename Buffer>
-static CONSTANT_MethodHandleInfo
-readConstantMethodHandleFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_MethodHandleInfo constant{};
-    if (!bufferReadNBytesCorrect(buf, bufPtr, sizeof(uint16_t) + sizeof(uint8_t))) {
-        flagError = true;
-        return constant;
+std::optional<idxRef>
+ClassFile::constant(size_t cpIdx) const {
+    if (!m_options.lazyConstantPool) {
+        if ((cpIdx == 0) || (cpIdx > m_constants.idxTable.size()) || (m_constants[cpIdx].type == 0)) {
+            return std::nullopt;
+        }
+        return m_constants[cpIdx];
     }
 
-    constant.referenceKind = getValueFromClassFileBuffer<uint8_t>(buf, bufPtr);
-    constant.referenceIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validReferenceKind(constant.referenceKind) ||
-            !validIndexInConstantPoolTable(constant.referenceIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+    auto &lazy = m_lazyConstants;
+    if ((cpIdx == 0) || (cpIdx >= lazy.tags.size()) || (lazy.tags[cpIdx] == 0)) {
+        return std::nullopt;
+    }
+    if (lazy.decoded[cpIdx] == lazyConstantInvalid) {
+        return std::nullopt;
+    }
+    if (lazy.decoded[cpIdx] != 0) {
+        return idxRef{ lazy.tags[cpIdx], lazy.decoded[cpIdx] - 1 };
     }
 
-    return constant;
+    size_t bufPtr = lazy.offsets[cpIdx];
+    idxRef ref{};
+    /*
+     * marked invalid while it is being checked, so a malformed pool that
+     * refers back to this constant cannot recurse
+     */
+    lazy.decoded[cpIdx] = lazyConstantInvalid;
+    if (!decodeConstant(m_buf, bufPtr, lazy.tags.size(), ref) ||
+        ((m_options.verifyLevel != VerifyLevel::None) &&
+         (checkConstant(ref, lazy.tags.size()) != ConstantCheck::Valid))) {
+        return std::nullopt;
+    }
+    lazy.decoded[cpIdx] = (uint32_t)ref.idxInType + 1;
+    return ref;
 }
 
 
-template <typename Buffer>
-static CONSTANT_MethodTypeInfo
-readConstantMethodTypeFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_MethodTypeInfo constant{};
-    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+uint8_t
+ClassFile::constantTag(size_t cpIdx) const {
+    if (m_options.lazyConstantPool) {
+        return (cpIdx < m_lazyConstants.tags.size()) ? m_lazyConstants.tags[cpIdx] : 0;
+    }
+    if ((cpIdx == 0) || (cpIdx > m_constants.idxTable.size())) {
+        return 0;
     }
+    return (uint8_t)m_constants[cpIdx].type;
+}
 
-    constant.descriptorIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.descriptorIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+
+size_t
+ClassFile::constantPoolCount() const {
+    if (m_options.lazyConstantPool) {
+        return m_lazyConstants.tags.size();
     }
-    return constant;
+    return m_constants.idxTable.size() + 1;
 }
 
 
-template <typename CONSTANT_DynamicOrInvokeDynamicInfo, typename Buffer>
-static CONSTANT_DynamicOrInvokeDynamicInfo
-readConstantDynamicOrInvokeDynamicFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_DynamicOrInvokeDynamicInfo constant{};
-    if (!bufferReadTypeCorrect<uint32_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+bool
+ClassFile::parseThisAndSuperClass(std::span<const uint8_t> buf, size_t &bufPtr) {
+    if (!bufferReadNBytesCorrect(buf, bufPtr, 3 * sizeof(uint16_t))) {
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::AccessFlagsNotFound, bufPtr);
     }
 
-    constant.bootstrapMethodAttrIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    constant.nameAndTypeIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.nameAndTypeIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+    m_accessFlags = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+    m_thisClass = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+    m_superClass = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+
+    if (constantTag(m_thisClass) != CONSTANT_Class) {
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidThisClass, bufPtr);
     }
-    return constant;
+    if ((m_superClass != 0) && (constantTag(m_superClass) != CONSTANT_Class)) {
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidSuperClass, bufPtr);
+    }
+
+    return false;
 }
 
 
-template <typename CONSTANT_ModuleOrPackageInfo, typename Buffer>
-static CONSTANT_ModuleOrPackageInfo
-readConstantModuleOrPackageFromBuf(Buffer &buf, size_t &bufPtr, bool &flagError, size_t &constantPoolCount) {
-    CONSTANT_ModuleOrPackageInfo constant{};
+bool
+ClassFile::parseInterfaces(std::span<const uint8_t> buf, size_t &bufPtr) {
     if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        flagError = true;
-        return constant;
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidInterfaces, bufPtr);
     }
 
-    constant.nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    if (!validIndexInConstantPoolTable(constant.nameIndex, constantPoolCount)) {
-        flagError = true;
-        return constant;
+    auto interfacesCount = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+    if (!bufferReadNBytesCorrect(buf, bufPtr, (size_t)interfacesCount * sizeof(uint16_t))) {
+        return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidInterfaces, bufPtr);
     }
-    return constant;
+
+    m_members.interfaces.resize(interfacesCount);
+    for (auto &interface : m_members.interfaces) {
+        interface = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+        if (constantTag(interface) != CONSTANT_Class) {
+            return setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidInterfaces, bufPtr);
+        }
+    }
+
+    return false;
 }
 
 
-template <typename CONST, typename BufferTo, typename BufferFrom>
-static void
-addIdxTableReference(BufferTo &bufferTo, CONST typeConstant, BufferFrom &bufferConstant) {
-    bufferTo.push_back(
-        idxRef{
-                (size_t)typeConstant,
-                bufferConstant.size() - 1
-        }
-    );
+AttributeKind
+ClassFile::attributeKind(uint16_t nameIndex) {
+    auto &cache = m_members.attributeKindCache;
+    if (cache.empty()) {
+        cache.assign(constantPoolCount(), 0);
+    }
+    if (cache[nameIndex] == 0) {
+        cache[nameIndex] = (uint8_t)attributeKindFromName(utf8(nameIndex)) + 1;
+    }
+    return (AttributeKind)(cache[nameIndex] - 1);
 }
 
 
+/*
+ * Reads attributes_count and the attribute headers that follow. Attributes
+ * let through by the mask are appended to m_members.attributes; keptCount is
+ * how many were. The info bytes are only stepped over.
+ */
 bool
-ClassFile::parseConstant(std::vector<uint8_t> &buf, size_t &bufPtr, size_t &constantPoolCount) {
-    if (!bufferReadTypeCorrect<uint8_t>(buf, bufPtr)) {
+ClassFile::parseAttributes(std::span<const uint8_t> buf, size_t &bufPtr, uint16_t &keptCount) {
+    keptCount = 0;
+    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
         return false;
     }
 
-    switch (getValueFromClassFileBuffer<uint8_t>(buf, bufPtr)) {
-        case CONSTANT_Utf8: {
-            m_constants.utf8Consts.push_back(
-                    readConstantUtf8FromBuf(buf, bufPtr, m_parseError)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Utf8,
-                                 m_constants.utf8Consts);
-            break;
+    auto attributesCount = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+    for (uint16_t i = 0; i < attributesCount; i++) {
+        if (!bufferReadNBytesCorrect(buf, bufPtr, sizeof(uint16_t) + sizeof(uint32_t))) {
+            return false;
         }
-
-        case CONSTANT_Integer: {
-            m_constants.intConsts.push_back(
-                readConstantIntOrFloatFromBuf<CONSTANT_IntegerInfo>(buf, bufPtr, m_parseError)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Integer,
-                                 m_constants.intConsts);
-            break;
+        auto nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+        auto length = getValueFromClassFileBuffer<uint32_t>(buf, bufPtr);
+        if ((constantTag(nameIndex) != CONSTANT_Utf8) || !bufferReadNBytesCorrect(buf, bufPtr, length)) {
+            return false;
         }
 
-        case CONSTANT_Float: {
-            m_constants.floatConsts.push_back(
-                readConstantIntOrFloatFromBuf<CONSTANT_FloatInfo>(buf, bufPtr, m_parseError)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Float,
-                                 m_constants.floatConsts);
-            break;
+        AttributeKind kind = attributeKind(nameIndex);
+        if (m_options.attributeMask & attributeBit(kind)) {
+            m_members.attributes.push_back(AttributeInfo{ nameIndex, kind, (uint32_t)bufPtr, length });
+            keptCount++;
         }
+        bufPtr += length;
+    }
 
-        case CONSTANT_Long: {
-            m_constants.longConsts.push_back(
-                readConstantLongOrDoubleFromBuf<CONSTANT_LongInfo>(buf, bufPtr, m_parseError)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Long,
-                                 m_constants.longConsts);
-            break;
-        }
+    return true;
+}
 
-        case CONSTANT_Double: {
-            m_constants.doubleConsts.push_back(
-                readConstantLongOrDoubleFromBuf<CONSTANT_DoubleInfo>(buf, bufPtr, m_parseError)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Double,
-                                 m_constants.doubleConsts);
-            break;
-        }
 
-        case CONSTANT_Class: {
-            m_constants.classConsts.push_back(
-                readConstantClassFromBuf(buf, bufPtr, m_parseError, constantPoolCount)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Class,
-                                 m_constants.classConsts);
-            break;
-        }
+// JVMS 4.5/4.6 name and descriptor of a field or method
+bool
+ClassFile::validMemberNameAndDescriptor(const MemberInfo &member, bool isMethod) const {
+    std::string_view name = utf8(member.nameIndex);
+    const ParsedDescriptor *descriptor = m_options.descriptorCache->get(utf8(member.descriptorIndex));
+    if (!isMethod) {
+        return isValidUnqualifiedName(name) && (descriptor->kind == DescriptorKind::Field);
+    }
+    if ((name == "<init>") && !descriptor->returnsVoid()) {
+        return false;
+    }
+    return isValidMethodName(name) && (descriptor->kind == DescriptorKind::Method);
+}
 
-        case CONSTANT_String: {
-            m_constants.stringConsts.push_back(
-                readConstantStringFromBuf(buf, bufPtr, m_parseError, constantPoolCount)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_String,
-                                 m_constants.stringConsts);
-            break;
-        }
 
-        case CONSTANT_Fieldref: {
-            m_constants.fieldrefConsts.push_back(
-                readConstantFieldOrMethodOrInterfaceFromBuf<CONSTANT_FieldrefInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Fieldref,
-                                 m_constants.fieldrefConsts);
-            break;
-        }
+bool
+ClassFile::parseMembers(std::span<const uint8_t> buf, size_t &bufPtr, std::pmr::vector<MemberInfo> &members,
+                        ClassFileErrorCode errCode) {
+    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
+        return setupErrorAndReturnTrue(m_error, errCode, bufPtr);
+    }
 
-        case CONSTANT_Methodref: {
-            m_constants.methodrefConsts.push_back(
-                readConstantFieldOrMethodOrInterfaceFromBuf<CONSTANT_MethodrefInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Methodref,
-                                 m_constants.methodrefConsts);
-            break;
+    bool isMethod = &members == &m_members.methods;
+    auto membersCount = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+    members.reserve(membersCount);
+    for (uint16_t i = 0; i < membersCount; i++) {
+        if (!bufferReadNBytesCorrect(buf, bufPtr, 3 * sizeof(uint16_t))) {
+            return setupErrorAndReturnTrue(m_error, errCode, bufPtr, i);
         }
 
-        case CONSTANT_InterfaceMethodref: {
-            m_constants.interfaceMetodrefConsts.push_back(
-                readConstantFieldOrMethodOrInterfaceFromBuf<CONSTANT_InterfaceMethodrefInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_InterfaceMethodref,
-                                 m_constants.interfaceMetodrefConsts);
-            break;
+        MemberInfo member{};
+        member.accessFlags = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+        member.nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+        member.descriptorIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+        member.firstAttribute = (uint32_t)m_members.attributes.size();
+        if ((constantTag(member.nameIndex) != CONSTANT_Utf8) ||
+            (constantTag(member.descriptorIndex) != CONSTANT_Utf8) ||
+            ((m_options.verifyLevel == VerifyLevel::Full) && !validMemberNameAndDescriptor(member, isMethod)) ||
+            !parseAttributes(buf, bufPtr, member.attributesCount)) {
+            return setupErrorAndReturnTrue(m_error, errCode, bufPtr, i);
         }
+        members.push_back(member);
+    }
 
-        case CONSTANT_NameAndType: {
-            m_constants.nameAndTypeConsts.push_back(
-                readConstantNameAndTypeFromBuf(buf, bufPtr, m_parseError, constantPoolCount)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_NameAndType,
-                                 m_constants.nameAndTypeConsts);
-            break;
-        }
+    return false;
+}
 
-        case CONSTANT_MethodHandle: {
-            m_constants.methodHandleConsts.push_back(
-                readConstantMethodHandleFromBuf(buf, bufPtr, m_parseError, constantPoolCount)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_MethodHandle,
-                                 m_constants.methodHandleConsts);
-            break;
-        }
 
-        case CONSTANT_MethodType: {
-            m_constants.methodTypeConsts.push_back(
-                readConstantMethodTypeFromBuf(buf, bufPtr, m_parseError, constantPoolCount)
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_MethodType,
-                                 m_constants.methodTypeConsts);
-            break;
-        }
-        //TODO: verify bootstrapMethodAttrIndex after parsing
-        case CONSTANT_Dynamic: {
-            m_constants.dynamicConsts.push_back(
-                readConstantDynamicOrInvokeDynamicFromBuf<CONSTANT_DynamicInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Dynamic,
-                                 m_constants.dynamicConsts);
-            break;
-        }
+std::string_view
+ClassFile::className(size_t classIdx) const {
+    if (constantTag(classIdx) != CONSTANT_Class) {
+        return {};
+    }
+    auto ref = constant(classIdx);
+    if (!ref) {
+        return {};
+    }
+    return utf8(m_constants.classConsts[ref->idxInType].nameIndex);
+}
 
-        case CONSTANT_InvokeDynamic: {
-            m_constants.invokeDynamicConsts.push_back(
-                readConstantDynamicOrInvokeDynamicFromBuf<CONSTANT_InvokeDynamicInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_InvokeDynamic,
-                                 m_constants.invokeDynamicConsts);
-            break;
-        }
 
-        case CONSTANT_Module: {
-            m_constants.moduleConsts.push_back(
-                readConstantModuleOrPackageFromBuf<CONSTANT_ModuleInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Module,
-                                 m_constants.moduleConsts);
-            break;
-        }
-
-        case CONSTANT_Package: {
-            m_constants.packageConsts.push_back(
-                readConstantModuleOrPackageFromBuf<CONSTANT_PackageInfo>(
-                        buf, bufPtr, m_parseError, constantPoolCount
-                )
-            );
-            if (m_parseError) { return false; }
-            addIdxTableReference(m_constants.idxTable, CONSTANT_Package,
-                                 m_constants.packageConsts);
-            break;
+const AttributeInfo *
+ClassFile::findAttribute(std::span<const AttributeInfo> attributes, AttributeKind kind) {
+    for (auto &attribute : attributes) {
+        if (attribute.kind == kind) {
+            return &attribute;
         }
+    }
+    return nullptr;
+}
 
 
-        default: {
-            return false;
-        }
+std::optional<CodeAttribute>
+ClassFile::code(const MemberInfo &method) const {
+    const AttributeInfo *codeAttribute = findAttribute(attributes(method), AttributeKind::Code);
+    if (codeAttribute == nullptr) {
+        return std::nullopt;
     }
-
-    return true;
+    return decodeCodeAttribute(attributeBytes(*codeAttribute));
 }
 
-static inline bool
-correctBinaryNameInClassFile(CONSTANT_Utf8Info &constant) {
-    /*
-     * TODO: re-read jvms 4.2 and 4.4.1
-     */
-    if (std::any_of(constant.bytes.begin(), constant.bytes.end(),
-                    [](uint8_t byte){ return (byte == '.') || (byte == ';') || (byte == '['); })) {
-        return false;
-    }
 
-    return true;
-}
+#define PARSE_ERR_STATUS \
+    if (m_parseError) { return; }
 
-static bool
-correctCONSTANT_ClassInfo(ClassFileConstants &constants, size_t &idxInType) {
-    if (idxInType >= constants.classConsts.size()) { return false; }
-    CONSTANT_ClassInfo &constant = constants.classConsts[idxInType];
-    idxRef &classUtf8Ref = constants[constant.nameIndex];
-    if ((classUtf8Ref.type != CONSTANT_Utf8) ||
-        (!correctBinaryNameInClassFile(constants.utf8Consts[classUtf8Ref.idxInType]))) {
-        return false;
+void
+ClassFile::reset(const ClassFileOptions &options) {
+    m_options = options;
+    if (m_options.symbolTable == nullptr) {
+        m_options.symbolTable = &SymbolTable::global();
     }
+    if (m_options.descriptorCache == nullptr) {
+        m_options.descriptorCache = &DescriptorCache::global();
+    }
+    std::pmr::memory_resource *resource = options.memoryResource ? options.memoryResource
+                                                                 : std::pmr::get_default_resource();
+    SJBCDC_STATS(resource = parseStats::countingResource(resource));
 
-    return true;
+    m_parseError = false;
+    m_error = {};
+    /*
+     * pmr containers keep their resource on assignment, so a different
+     * resource needs freshly constructed containers
+     */
+    std::destroy_at(&m_constants);
+    std::construct_at(&m_constants, resource);
+    m_constants.symbols = m_options.symbolTable;
+    std::destroy_at(&m_lazyConstants);
+    std::construct_at(&m_lazyConstants, resource);
+    std::destroy_at(&m_members);
+    std::construct_at(&m_members, resource);
+    std::destroy_at(&m_fingerprints);
+    std::construct_at(&m_fingerprints, resource);
+    m_accessFlags = 0;
+    m_thisClass = 0;
+    m_superClass = 0;
+    std::destroy_at(&m_ownedBuf);
+    std::construct_at(&m_ownedBuf, resource);
+    m_mappedFile = MappedFile{};
+    m_buf = {};
 }
 
 
-static inline bool
-hasFieldOrMethodAsMember(ClassFileConstants &constants, CONSTANT_ClassInfo &classConst) {
-    /* TODO
-     * one day, in a galaxy far, far away, we will verify this
-     */
-    return true;
+std::string_view
+ClassFile::utf8(size_t cpIdx) const {
+    if (constantTag(cpIdx) != CONSTANT_Utf8) {
+        return {};
+    }
+    auto ref = constant(cpIdx);
+    if (!ref) {
+        return {};
+    }
+    return m_constants.utf8View(m_constants.utf8Consts[ref->idxInType]);
 }
 
-static inline bool
-isFieldDescriptor(ClassFileConstants &constants, CONSTANT_NameAndTypeInfo &nameAndType) {
-    /*
-     * TODO:
-     * once day, in a galaxy far, far away, we will verify this
-     */
-    return true;
-}
 
+SymbolId
+ClassFile::symbol(size_t cpIdx) const {
+    if (constantTag(cpIdx) != CONSTANT_Utf8) {
+        return noSymbol;
+    }
+    auto ref = constant(cpIdx);
+    if (!ref) {
+        return noSymbol;
+    }
+    const CONSTANT_Utf8Info &constant = m_constants.utf8Consts[ref->idxInType];
+    if (constant.symbol != noSymbol) {
+        return constant.symbol;
+    }
+    return m_options.symbolTable->intern(m_constants.utf8View(constant));
+}
 
-static bool
-correctCONSTANT_Fieldref(ClassFileConstants &constants, size_t &idxInType) {
-    if (idxInType >= constants.fieldrefConsts.size()) { return false; }
-    CONSTANT_FieldrefInfo &constant = constants.fieldrefConsts[idxInType];
 
-    idxRef &fieldrefClassInfoRef = constants[constant.classIndex];
-    if ((fieldrefClassInfoRef.type != CONSTANT_Class) ||
-        (!hasFieldOrMethodAsMember(constants,constants.classConsts[fieldrefClassInfoRef.idxInType]))) {
-        return false;
+SymbolId
+ClassFile::classNameSymbol(size_t classIdx) const {
+    if (constantTag(classIdx) != CONSTANT_Class) {
+        return noSymbol;
     }
-
-    idxRef &fieldrefNameAndTypeReprRef = constants[constant.nameAndTypeIndex];
-    if ((fieldrefNameAndTypeReprRef.type != CONSTANT_NameAndType) ||
-        (!isFieldDescriptor(constants, constants.nameAndTypeConsts[fieldrefClassInfoRef.idxInType]))) {
-        return false;
+    auto ref = constant(classIdx);
+    if (!ref) {
+        return noSymbol;
     }
+    return symbol(m_constants.classConsts[ref->idxInType].nameIndex);
+}
 
-    return true;
+
+const ParsedDescriptor *
+ClassFile::descriptor(size_t cpIdx) const {
+    if (constantTag(cpIdx) != CONSTANT_Utf8) {
+        return nullptr;
+    }
+    return m_options.descriptorCache->get(utf8(cpIdx));
 }
 
 
-//TODO: verify additional info (like CONSTANT_String.stringIndex -> CONSTANT_Utf8 and more)
-size_t
-ClassFile::verifyConstantPool() {
-    for (size_t cNum = 1; cNum < m_constants.idxTable.size() + 1; cNum++) {
-        idxRef &constExpl = m_constants[cNum];
+std::u16string
+ClassFile::utf8Decoded(size_t cpIdx) const {
+    std::string_view bytes = utf8(cpIdx);
+    std::u16string decoded;
+    decoded.reserve(bytes.size());
+    for (size_t i = 0; i < bytes.size();) {
+        auto b0 = (uint8_t)bytes[i];
+        if ((b0 < 0x80) || (i + 1 >= bytes.size())) {
+            decoded.push_back(b0);
+            i += 1;
+        } else if (((b0 & 0xe0) == 0xc0) || (i + 2 >= bytes.size())) {
+            decoded.push_back((char16_t)(((b0 & 0x1f) << 6) | ((uint8_t)bytes[i + 1] & 0x3f)));
+            i += 2;
+        } else {
+            decoded.push_back((char16_t)(((b0 & 0x0f) << 12) | (((uint8_t)bytes[i + 1] & 0x3f) << 6) |
+                                         ((uint8_t)bytes[i + 2] & 0x3f)));
+            i += 3;
+        }
+    }
+    return decoded;
+}
 
-        switch(constExpl.type) {
-            case CONSTANT_Class: {
-                if (!correctCONSTANT_ClassInfo(m_constants, constExpl.idxInType)) {
-                    return cNum;
-                }
-                break;
-            }
-            case CONSTANT_Fieldref: {
-                if (!correctCONSTANT_Fieldref(m_constants, constExpl.idxInType)) {
-                    return cNum;
-                }
-                break;
-            }
-            case CONSTANT_Methodref: {
 
+void
+ClassFile::parseClassFileBuf() {
+    size_t bufPtr = 0;
+    m_constants.classBytes = m_buf;
+    SJBCDC_STATS(parseStats::addBytes(m_buf.size()));
+
+    ClassCache *cache = m_options.lazyConstantPool ? nullptr : m_options.classCache;
+    uint64_t contentHash = 0;
+    if (cache != nullptr) {
+        contentHash = xxh64(m_buf);
+        bool hit = cache->load(*this, contentHash);
+        SJBCDC_STATS(parseStats::lap(ParsePhase::CacheLookup));
+        if (hit) {
+            if (!m_parseError && m_options.fingerprints) {
+                computeClassFingerprints(*this, m_fingerprints, contentHash);
+                SJBCDC_STATS(parseStats::lap(ParsePhase::Fingerprints));
             }
+            return;
         }
     }
-    return 0;
-}
 
+    m_parseError = parseMagicConst(m_buf, bufPtr);
+    PARSE_ERR_STATUS
 
-bool
-ClassFile::parseConstantPool(std::vector<uint8_t> &buf, size_t &bufPtr) {
-    if (!bufferReadTypeCorrect<uint16_t>(buf, bufPtr)) {
-        return setupErrStrAndReturnTrue(m_path, initResults[8], m_result);
+    m_parseError = parseMinorVersion(m_buf, bufPtr);
+    PARSE_ERR_STATUS
+
+    m_parseError = parseMajorVersion(m_buf, bufPtr);
+    PARSE_ERR_STATUS
+    SJBCDC_STATS(parseStats::lap(ParsePhase::Header));
+
+    m_parseError = parseConstantPool(m_buf, bufPtr);
+    PARSE_ERR_STATUS
+
+    m_parseError = parseThisAndSuperClass(m_buf, bufPtr);
+    PARSE_ERR_STATUS
+
+    m_parseError = parseInterfaces(m_buf, bufPtr);
+    PARSE_ERR_STATUS
+    SJBCDC_STATS(parseStats::lap(ParsePhase::ClassStructure));
+
+    m_parseError = parseMembers(m_buf, bufPtr, m_members.fields, ClassFileErrorCode::InvalidField);
+    PARSE_ERR_STATUS
+
+    m_parseError = parseMembers(m_buf, bufPtr, m_members.methods, ClassFileErrorCode::InvalidMethod);
+    PARSE_ERR_STATUS
+    SJBCDC_STATS(parseStats::lap(ParsePhase::Members));
+
+    m_members.firstClassAttribute = (uint32_t)m_members.attributes.size();
+    if (!parseAttributes(m_buf, bufPtr, m_members.classAttributesCount)) {
+        m_parseError = setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidAttribute, bufPtr);
+        PARSE_ERR_STATUS
     }
-    size_t constantPoolCount = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
-    for (size_t i = 1; i < constantPoolCount; i++) {
-        if (!parseConstant(buf, bufPtr, constantPoolCount)) {
-            return setupErrStrWithAdditionalInfoAndReturnTrue(
-                    m_path, initResults[9], m_result, " " + std::to_string(i)
-            );
+
+    if (bufPtr != m_buf.size()) {
+        m_parseError = setupErrorAndReturnTrue(m_error, ClassFileErrorCode::ExtraBytes, bufPtr);
+        PARSE_ERR_STATUS
+    }
+    SJBCDC_STATS(parseStats::lap(ParsePhase::ClassAttributes));
+
+    if ((m_options.verifyLevel == VerifyLevel::Full) && !m_options.lazyConstantPool) {
+        size_t verifyErrIdx = verifyBootstrapMethodRefs();
+        if (verifyErrIdx) {
+            m_parseError = setupErrorAndReturnTrue(m_error, ClassFileErrorCode::InvalidConstant, bufPtr, verifyErrIdx,
+                                                    constantTag(verifyErrIdx));
+            PARSE_ERR_STATUS
         }
+        SJBCDC_STATS(parseStats::lap(ParsePhase::DeferredChecks, false));
     }
 
-    size_t verifyErrIdx = verifyConstantPool();
-    if (verifyErrIdx) {
-        return setupErrStrWithAdditionalInfoAndReturnTrue(
-                m_path, initResults[9], m_result, " " + std::to_string(verifyErrIdx)
-        );
+    if (m_options.fingerprints) {
+        computeClassFingerprints(*this, m_fingerprints,
+                                 (cache != nullptr) ? std::optional(contentHash) : std::nullopt);
+        SJBCDC_STATS(parseStats::lap(ParsePhase::Fingerprints));
     }
 
-    return false;
+    if (cache != nullptr) {
+        cache->store(*this, contentHash);
+        SJBCDC_STATS(parseStats::lap(ParsePhase::CacheStore));
+    }
 }
 
-#define PARSE_ERR_STATUS \
-    if (m_parseError) { return; }
 
 void
 ClassFile::init(std::string &pathStr) {
-    parseFilePath(pathStr);
-    PARSE_ERR_STATUS
+    init(pathStr, ClassFileOptions{});
+}
 
-    std::vector<uint8_t> buf;
-    size_t bufPtr = 0;
 
-    m_parseError = setupClassFileBuf(buf);
-    PARSE_ERR_STATUS
+void
+ClassFile::init(std::string &pathStr, const ClassFileOptions &options) {
+    reset(options);
+    SJBCDC_STATS(parseStats::begin());
 
-    m_parseError = parseMagicConst(buf, bufPtr);
+    m_parseError = parseFilePath(pathStr);
     PARSE_ERR_STATUS
 
-    m_parseError = parseMinorVersion(buf, bufPtr);
-    PARSE_ERR_STATUS
+    if (options.loadMode == ClassFileLoadMode::Mmap) {
+        m_parseError = setupClassFileMapping();
+        PARSE_ERR_STATUS
+        m_buf = m_mappedFile.bytes();
+    } else {
+        m_parseError = setupClassFileBuf(m_ownedBuf);
+        PARSE_ERR_STATUS
+        m_buf = m_ownedBuf;
+    }
+    SJBCDC_STATS(parseStats::lap(ParsePhase::Read));
 
-    m_parseError = parseMajorVersion(buf, bufPtr);
-    PARSE_ERR_STATUS
+    parseClassFileBuf();
+}
 
-    //TODO
-    m_parseError = parseConstantPool(buf, bufPtr);
-    PARSE_ERR_STATUS
 
+void
+ClassFile::init(std::span<const uint8_t> bytes, std::string_view name, const ClassFileOptions &options) {
+    reset(options);
+    SJBCDC_STATS(parseStats::begin());
+    m_path = std::filesystem::path(name);
+    m_buf = bytes;
+
+    parseClassFileBuf();
 }
 
 
+void
+ClassFile::init(std::pmr::vector<uint8_t> &&bytes, std::string_view name, const ClassFileOptions &options) {
+    reset(options);
+    SJBCDC_STATS(parseStats::begin());
+    m_path = std::filesystem::path(name);
+    m_ownedBuf = std::move(bytes);
+    m_buf = m_ownedBuf;
+
+    parseClassFileBuf();
+}
@@ -5,53 +5,321 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <span>
+#include <string_view>
+#include <memory_resource>
+#include <optional>
 
 #include "constant_pool.hpp"
+#include "classMembers.hpp"
+#include "mappedFile.hpp"
+#include "classFileError.hpp"
+#include "fingerprint.hpp"
+
+class ClassCache;
+class DescriptorCache;
+struct ParsedDescriptor;
+
+enum class ClassFileLoadMode {
+    Copy,   // read the whole file into an owned buffer through std::ifstream
+    Mmap    // map the file read-only and parse straight from the mapping
+};
+
+enum class Utf8Storage {
+    Owned,  // every CONSTANT_Utf8Info gets its own copy of the bytes
+    View,   // CONSTANT_Utf8Info only records offset/length into the class bytes
+    Interned // CONSTANT_Utf8Info refers to a symbol of ClassFileOptions::symbolTable
+};
+
+enum class VerifyLevel {
+    None,       // trusted input: only what decoding needs (indices in range, lengths)
+    Structural, // + modified UTF-8 and the tag every constant pool reference must point to
+    Full        // + JVMS 4.2/4.3 names and descriptors, method handle rules, bootstrap indices
+};
+
+struct ClassFileOptions {
+    ClassFileLoadMode loadMode = ClassFileLoadMode::Copy;
+    Utf8Storage utf8Storage = Utf8Storage::Owned;
+    /*
+     * Where the parsed data (constants, owned class bytes) is allocated;
+     * nullptr means std::pmr::get_default_resource(). The resource must
+     * outlive the ClassFile.
+     */
+    std::pmr::memory_resource *memoryResource = nullptr;
+    // where Utf8Storage::Interned and symbol() intern to; nullptr means SymbolTable::global()
+    SymbolTable *symbolTable = nullptr;
+    // where descriptor() and Full verification parse descriptors; nullptr means DescriptorCache::global()
+    DescriptorCache *descriptorCache = nullptr;
+    /*
+     * Only record tag and offset of every constant while parsing; constants
+     * are decoded (and their Utf8 validated) on first access through
+     * constant(), then memoized. Every constant is verified as it is decoded
+     * instead of the pool as a whole; bootstrap method indices are not checked.
+     */
+    bool lazyConstantPool = false;
+    VerifyLevel verifyLevel = VerifyLevel::Full;
+    /*
+     * Attribute kinds to record (attributeBit(kind) | ...). Attributes of
+     * other kinds are stepped over using their length, their bytes unread.
+     */
+    AttributeMask attributeMask = AllAttributes;
+    /*
+     * Restore classes from (and save them to) this cache instead of parsing
+     * the same bytes again. Not used with lazyConstantPool.
+     */
+    ClassCache *classCache = nullptr;
+    // compute fingerprints() after a successful parse
+    bool fingerprints = false;
+};
 
 class ClassFile {
 private:
-    uint32_t m_magic;
-    uint16_t m_minorVersion;
-    uint16_t m_majorVersion;
-    uint16_t m_accessFlags;
-    uint16_t m_thisClass;
-    uint16_t m_superClass;
+    // restores and saves the parsed state as an image
+    friend class ClassCache;
+
+    uint32_t m_magic = 0;
+    uint16_t m_minorVersion = 0;
+    uint16_t m_majorVersion = 0;
+    uint16_t m_accessFlags = 0;
+    uint16_t m_thisClass = 0;
+    uint16_t m_superClass = 0;
 
-    ClassFileConstants m_constants;
+    /*
+     * mutable: with lazyConstantPool the const accessors decode and memoize
+     * constants on first use, so a lazily parsed ClassFile must not be
+     * queried from several threads at once
+     */
+    mutable ClassFileConstants m_constants;
+    mutable LazyConstantTable m_lazyConstants;
+    ClassFileMembers m_members;
+    ClassFingerprints m_fingerprints;
+    ClassFileOptions m_options;
 
     bool m_parseError = false;
-    std::string m_result;
+    ClassFileError m_error;
     std::filesystem::path m_path;
 
+    /*
+     * m_buf always views the bytes being parsed: either m_ownedBuf,
+     * m_mappedFile or memory owned by the caller of init(std::span)
+     */
+    std::pmr::vector<uint8_t> m_ownedBuf;
+    MappedFile m_mappedFile;
+    std::span<const uint8_t> m_buf;
+
+    void
+    reset(const ClassFileOptions &options);
+
     bool
     parseFilePath(std::string& pathStr);
 
     bool
-    setupClassFileBuf(std::vector<uint8_t> &buf);
+    setupClassFileBuf(std::pmr::vector<uint8_t> &buf);
+
+    bool
+    setupClassFileMapping();
+
+    void
+    parseClassFileBuf();
+
+    bool
+    parseMagicConst(std::span<const uint8_t> buf, size_t &bufPtr);
 
     bool
-    parseMagicConst(std::vector<uint8_t> &buf, size_t &bufPtr);
+    parseMinorVersion(std::span<const uint8_t> buf, size_t &bufPtr);
 
     bool
-    parseMinorVersion(std::vector<uint8_t> &buf, size_t &bufPtr);
+    parseMajorVersion(std::span<const uint8_t> buf, size_t &bufPtr);
 
     bool
-    parseMajorVersion(std::vector<uint8_t> &buf, size_t &bufPtr);
+    parseConstantPool(std::span<const uint8_t> buf, size_t &bufPtr);
 
     bool
-    parseConstantPool(std::vector<uint8_t> &buf, size_t &bufPtr);
+    parseConstantPoolLazy(std::span<const uint8_t> buf, size_t &bufPtr, size_t constantPoolCount);
 
     bool
-    parseConstant(std::vector<uint8_t> &buf, size_t &bufPtr, size_t &constantPoolCount);
+    decodeConstant(std::span<const uint8_t> buf, size_t &bufPtr, size_t constantPoolCount, idxRef &ref) const;
+
+    bool
+    parseConstant(std::span<const uint8_t> buf, size_t &bufPtr, size_t &constantPoolCount);
+
+    enum class ConstantCheck {
+        Valid,
+        Pending,    // refers to a constant that is not decoded yet
+        Invalid
+    };
+
+    ConstantCheck
+    checkConstant(const idxRef &ref, size_t available) const;
 
     size_t
-    verifyConstantPool();
+    verifyBootstrapMethodRefs() const;
+
+    bool
+    parseThisAndSuperClass(std::span<const uint8_t> buf, size_t &bufPtr);
+
+    bool
+    parseInterfaces(std::span<const uint8_t> buf, size_t &bufPtr);
+
+    bool
+    parseMembers(std::span<const uint8_t> buf, size_t &bufPtr, std::pmr::vector<MemberInfo> &members,
+                 ClassFileErrorCode errCode);
+
+    bool
+    validMemberNameAndDescriptor(const MemberInfo &member, bool isMethod) const;
+
+    bool
+    parseAttributes(std::span<const uint8_t> buf, size_t &bufPtr, uint16_t &keptCount);
+
+    AttributeKind
+    attributeKind(uint16_t nameIndex);
 public:
     void
     init(std::string &path);
 
+    void
+    init(std::string &path, const ClassFileOptions &options);
+
+    /*
+     * Parses class bytes owned by the caller; they must stay alive and unchanged
+     * for as long as this ClassFile is used
+     */
+    void
+    init(std::span<const uint8_t> bytes, std::string_view name = "<memory>",
+         const ClassFileOptions &options = {});
+
+    // takes over a buffer the caller no longer needs (e.g. an inflated JAR entry)
+    void
+    init(std::pmr::vector<uint8_t> &&bytes, std::string_view name = "<memory>",
+         const ClassFileOptions &options = {});
+
+    // "path: message", empty after a successful parse; formatted from error() on every call
+    std::string
+    initResult() const { return formatClassFileError(m_path.string(), m_error); };
+
+    const ClassFileError &
+    error() const { return m_error; }
+
+    bool
+    parseError() const { return m_parseError; }
+
+    /*
+     * Decoded constants. With lazyConstantPool this only holds what has been
+     * accessed so far and idxTable stays empty; use constant() instead.
+     */
+    const ClassFileConstants &
+    constants() const { return m_constants; }
+
+    // constant_pool_count from the class file
+    size_t
+    constantPoolCount() const;
+
+    // tag at cpIdx without decoding the constant; 0 for invalid or unusable indices
+    uint8_t
+    constantTag(size_t cpIdx) const;
+
+    // where the constant at cpIdx lives in constants(), decoding it first when lazy
+    std::optional<idxRef>
+    constant(size_t cpIdx) const;
+
+    /*
+     * Utf8 constant at constant pool index cpIdx; empty when the index does
+     * not refer to a CONSTANT_Utf8. The view lives as long as the class bytes.
+     */
+    std::string_view
+    utf8(size_t cpIdx) const;
+
     std::string
-    initResult() { return m_result; };
+    utf8Copy(size_t cpIdx) const { return std::string(utf8(cpIdx)); }
+
+    // modified UTF-8 (JVMS 4.4.7) decoded to UTF-16 code units
+    std::u16string
+    utf8Decoded(size_t cpIdx) const;
+
+    /*
+     * Symbol of the Utf8 constant at cpIdx, noSymbol when it is not one.
+     * Without Utf8Storage::Interned the string is interned on every call.
+     */
+    SymbolId
+    symbol(size_t cpIdx) const;
+
+    // symbol of the name behind a CONSTANT_Class index
+    SymbolId
+    classNameSymbol(size_t classIdx) const;
+
+    /*
+     * The Utf8 constant at cpIdx parsed as a field or method descriptor
+     * through ClassFileOptions::descriptorCache, nullptr when it is not a
+     * Utf8 constant. Its kind is Invalid for a malformed descriptor.
+     */
+    const ParsedDescriptor *
+    descriptor(size_t cpIdx) const;
+
+    uint16_t
+    minorVersion() const { return m_minorVersion; }
+
+    uint16_t
+    majorVersion() const { return m_majorVersion; }
+
+    uint16_t
+    accessFlags() const { return m_accessFlags; }
+
+    uint16_t
+    thisClass() const { return m_thisClass; }
+
+    // 0 for java/lang/Object and module-info
+    uint16_t
+    superClass() const { return m_superClass; }
+
+    // name behind a CONSTANT_Class index; empty when it is not one
+    std::string_view
+    className(size_t classIdx) const;
+
+    std::string_view
+    thisClassName() const { return className(m_thisClass); }
+
+    std::string_view
+    superClassName() const { return className(m_superClass); }
+
+    // CONSTANT_Class indices
+    std::span<const uint16_t>
+    interfaces() const { return m_members.interfaces; }
+
+    std::span<const MemberInfo>
+    fields() const { return m_members.fields; }
+
+    std::span<const MemberInfo>
+    methods() const { return m_members.methods; }
+
+    std::span<const AttributeInfo>
+    attributes(const MemberInfo &member) const {
+        return std::span(m_members.attributes).subspan(member.firstAttribute, member.attributesCount);
+    }
+
+    std::span<const AttributeInfo>
+    classAttributes() const {
+        return std::span(m_members.attributes).subspan(m_members.firstClassAttribute,
+                                                       m_members.classAttributesCount);
+    }
+
+    std::span<const uint8_t>
+    attributeBytes(const AttributeInfo &attribute) const { return m_buf.subspan(attribute.offset, attribute.length); }
+
+    // first attribute of that kind, nullptr if there is none (or it was masked out)
+    static const AttributeInfo *
+    findAttribute(std::span<const AttributeInfo> attributes, AttributeKind kind);
+
+    // decoded Code attribute of a method; nullopt for abstract/native methods
+    std::optional<CodeAttribute>
+    code(const MemberInfo &method) const;
+
+    // the bytes this ClassFile was parsed from
+    std::span<const uint8_t>
+    classBytes() const { return m_buf; }
+
+    // all zero unless parsed with ClassFileOptions::fingerprints
+    const ClassFingerprints &
+    fingerprints() const { return m_fingerprints; }
 
 };
 #endif //SJBCDC_CLASSFILEREAD_HPP
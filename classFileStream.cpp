@@ -0,0 +1,610 @@
+#include "classFileStream.hpp"
+#include "classFileBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+ClassFileStreamParser::ClassFileStreamParser(ClassFileVisitor &visitor, VerifyLevel verifyLevel)
+        : m_visitor(visitor), m_verify(verifyLevel != VerifyLevel::None) {}
+
+
+void
+ClassFileStreamParser::reset() {
+    m_state = State::Magic;
+    m_error = {};
+    m_offset = 0;
+    m_fieldOffset = 0;
+    m_constantOffset = 0;
+    m_carrySize = 0;
+    m_minorVersion = 0;
+    m_majorVersion = 0;
+    m_poolCount = 0;
+    m_cpIdx = 0;
+    m_tag = 0;
+    m_constants.clear();
+    m_pendingChecks.clear();
+    m_utf8Validator.reset();
+    m_memberKind = StreamMember::Field;
+    m_itemsLeft = 0;
+    m_itemNumber = 0;
+    m_attributesLeft = 0;
+    m_dataLeft = 0;
+}
+
+
+bool
+ClassFileStreamParser::setupError(ClassFileErrorCode code, uint64_t offset, size_t index, uint8_t tag) {
+    m_error = ClassFileError{ code, tag, (uint16_t)index, (uint32_t)std::min<uint64_t>(offset, UINT32_MAX) };
+    m_state = State::Error;
+    return true;
+}
+
+
+ClassFileErrorCode
+ClassFileStreamParser::memberError() const {
+    switch (m_memberKind) {
+        case StreamMember::Field: {
+            return ClassFileErrorCode::InvalidField;
+        }
+        case StreamMember::Method: {
+            return ClassFileErrorCode::InvalidMethod;
+        }
+        default: {
+            return ClassFileErrorCode::InvalidAttribute;
+        }
+    }
+}
+
+
+// the size of the field the current state reads; the Utf8Bytes/AttributeData bodies are passed through instead
+size_t
+ClassFileStreamParser::fieldSize() const {
+    switch (m_state) {
+        case State::Magic: {
+            return sizeof(uint32_t);
+        }
+        case State::ConstantTag: {
+            return sizeof(uint8_t);
+        }
+        case State::ConstantInfo: {
+            return constantFixedSizes[m_tag];
+        }
+        case State::ClassInfo:
+        case State::Member:
+        case State::AttributeHeader: {
+            return 3 * sizeof(uint16_t);
+        }
+        default: {
+            return sizeof(uint16_t);
+        }
+    }
+}
+
+
+StreamStatus
+ClassFileStreamParser::status() const {
+    switch (m_state) {
+        case State::Done: {
+            return StreamStatus::Done;
+        }
+        case State::Error: {
+            return StreamStatus::Error;
+        }
+        default: {
+            return StreamStatus::NeedMore;
+        }
+    }
+}
+
+
+StreamStatus
+ClassFileStreamParser::feed(std::span<const uint8_t> chunk) {
+    while (!chunk.empty()) {
+        if (m_state == State::Error) {
+            break;
+        }
+        if (m_state == State::Done) {
+            setupError(ClassFileErrorCode::ExtraBytes, m_offset);
+            break;
+        }
+        if ((m_state == State::Utf8Bytes) || (m_state == State::AttributeData)) {
+            passThrough(chunk);
+            continue;
+        }
+
+        /*
+         * A field that lies whole in the chunk is read in place; only one
+         * that is cut off by the end of the chunk goes through m_carry
+         */
+        size_t size = fieldSize();
+        const uint8_t *field = nullptr;
+        if (m_carrySize == 0) {
+            m_fieldOffset = m_offset;
+        }
+        if ((m_carrySize == 0) && (chunk.size() >= size)) {
+            field = chunk.data();
+        } else {
+            size_t n = std::min(size - m_carrySize, chunk.size());
+            std::memcpy(m_carry.data() + m_carrySize, chunk.data(), n);
+            m_carrySize += n;
+            m_offset += n;
+            chunk = chunk.subspan(n);
+            if (m_carrySize < size) {
+                break;
+            }
+            field = m_carry.data();
+            m_carrySize = 0;
+            size = 0;
+        }
+        m_offset += size;
+        chunk = chunk.subspan(size);
+        handleField(field);
+    }
+    return status();
+}
+
+
+StreamStatus
+ClassFileStreamParser::finish() {
+    uint64_t offset = m_offset;
+    switch (m_state) {
+        case State::Done:
+        case State::Error: {
+            break;
+        }
+        case State::Magic: {
+            setupError(ClassFileErrorCode::NotAClassFile, offset);
+            break;
+        }
+        case State::MinorVersion: {
+            setupError(ClassFileErrorCode::MinorVersionNotFound, offset);
+            break;
+        }
+        case State::MajorVersion: {
+            setupError(ClassFileErrorCode::MajorVersionNotFound, offset);
+            break;
+        }
+        case State::PoolCount: {
+            setupError(ClassFileErrorCode::ConstantPoolSizeNotFound, offset);
+            break;
+        }
+        case State::ConstantTag: {
+            setupError(ClassFileErrorCode::InvalidConstant, offset, m_cpIdx);
+            break;
+        }
+        case State::ConstantInfo:
+        case State::Utf8Length:
+        case State::Utf8Bytes: {
+            setupError(ClassFileErrorCode::InvalidConstant, offset, m_cpIdx, m_tag);
+            break;
+        }
+        case State::ClassInfo: {
+            setupError(ClassFileErrorCode::AccessFlagsNotFound, offset);
+            break;
+        }
+        case State::InterfacesCount:
+        case State::Interface: {
+            setupError(ClassFileErrorCode::InvalidInterfaces, offset);
+            break;
+        }
+        case State::MembersCount: {
+            setupError(memberError(), offset);
+            break;
+        }
+        default: {
+            // a member or its attributes, or the class attributes
+            setupError(memberError(), offset, (m_memberKind == StreamMember::Class) ? noErrorIndex : m_itemNumber);
+            break;
+        }
+    }
+    return status();
+}
+
+
+/*
+ * Passes as much of a Utf8 constant or an attribute body on as the chunk
+ * holds; the Utf8 bytes are validated before the visitor sees them
+ */
+bool
+ClassFileStreamParser::passThrough(std::span<const uint8_t> &chunk) {
+    size_t n = std::min<size_t>(m_dataLeft, chunk.size());
+    auto bytes = chunk.first(n);
+    m_dataLeft -= (uint32_t)n;
+    bool last = m_dataLeft == 0;
+
+    if (m_state == State::AttributeData) {
+        m_visitor.attributeData(bytes, last);
+    } else {
+        if (m_verify && (!m_utf8Validator.update(bytes.data(), bytes.size()) ||
+                         (last && !m_utf8Validator.finish()))) {
+            return setupError(ClassFileErrorCode::InvalidConstant, m_offset, m_cpIdx, CONSTANT_Utf8);
+        }
+        m_visitor.utf8(m_cpIdx, bytes, last);
+    }
+    m_offset += n;
+    chunk = chunk.subspan(n);
+
+    if (!last) {
+        return false;
+    }
+    if (m_state == State::AttributeData) {
+        return endAttribute();
+    }
+    m_constants[m_cpIdx].tag = CONSTANT_Utf8;
+    return endConstant();
+}
+
+
+bool
+ClassFileStreamParser::handleField(const uint8_t *field) {
+    auto buf = std::span(field, fieldSize());
+    size_t bufPtr = 0;
+    switch (m_state) {
+        case State::Magic: {
+            if (getValueFromClassFileBuffer<uint32_t>(buf, bufPtr) != 0xCAFEBABE) {
+                return setupError(ClassFileErrorCode::NotAClassFile, m_offset);
+            }
+            m_state = State::MinorVersion;
+            return false;
+        }
+
+        case State::MinorVersion: {
+            m_minorVersion = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            m_state = State::MajorVersion;
+            return false;
+        }
+
+        case State::MajorVersion: {
+            m_majorVersion = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            if ((m_majorVersion < 45) || (m_majorVersion > 63)) {
+                return setupError(ClassFileErrorCode::InvalidMajorVersion, m_offset);
+            } else if ((m_majorVersion >= 56) && (m_minorVersion != 0) && (m_minorVersion != 65535)) {
+                return setupError(ClassFileErrorCode::InvalidMinorVersion, m_offset);
+            }
+            m_visitor.version(m_minorVersion, m_majorVersion);
+            m_state = State::PoolCount;
+            return false;
+        }
+
+        case State::PoolCount: {
+            m_poolCount = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            m_constants.assign(std::max<size_t>(m_poolCount, 1), ConstantEntry{});
+            m_visitor.constantPoolCount(m_poolCount);
+            m_cpIdx = 1;
+            if (m_cpIdx >= m_poolCount) {
+                return endConstantPool();
+            }
+            m_state = State::ConstantTag;
+            return false;
+        }
+
+        case State::ConstantTag: {
+            m_tag = getValueFromClassFileBuffer<uint8_t>(buf, bufPtr);
+            m_constantOffset = m_fieldOffset;
+            if (m_tag == CONSTANT_Utf8) {
+                m_state = State::Utf8Length;
+            } else if ((m_tag < CONSTANT_TagCount) && (constantFixedSizes[m_tag] != 0)) {
+                m_state = State::ConstantInfo;
+            } else {
+                return setupError(ClassFileErrorCode::InvalidConstant, m_constantOffset, m_cpIdx, m_tag);
+            }
+            return false;
+        }
+
+        case State::ConstantInfo: {
+            if (!decodeConstant(field)) {
+                return setupError(ClassFileErrorCode::InvalidConstant, m_constantOffset, m_cpIdx, m_tag);
+            }
+            m_visitor.constant(m_cpIdx, m_tag, buf);
+            return endConstant();
+        }
+
+        case State::Utf8Length: {
+            m_dataLeft = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            m_utf8Validator.reset();
+            m_state = State::Utf8Bytes;
+            if (m_dataLeft == 0) {
+                m_visitor.utf8(m_cpIdx, {}, true);
+                m_constants[m_cpIdx].tag = CONSTANT_Utf8;
+                return endConstant();
+            }
+            return false;
+        }
+
+        case State::ClassInfo: {
+            auto accessFlags = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            auto thisClass = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            auto superClass = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            if (tagAt(thisClass) != CONSTANT_Class) {
+                return setupError(ClassFileErrorCode::InvalidThisClass, m_offset);
+            }
+            if ((superClass != 0) && (tagAt(superClass) != CONSTANT_Class)) {
+                return setupError(ClassFileErrorCode::InvalidSuperClass, m_offset);
+            }
+            m_visitor.classInfo(accessFlags, thisClass, superClass);
+            m_state = State::InterfacesCount;
+            return false;
+        }
+
+        case State::InterfacesCount: {
+            m_itemsLeft = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            m_state = (m_itemsLeft != 0) ? State::Interface : State::MembersCount;
+            return false;
+        }
+
+        case State::Interface: {
+            auto classIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            if (tagAt(classIndex) != CONSTANT_Class) {
+                return setupError(ClassFileErrorCode::InvalidInterfaces, m_offset);
+            }
+            m_visitor.interface(classIndex);
+            if (--m_itemsLeft == 0) {
+                m_state = State::MembersCount;
+            }
+            return false;
+        }
+
+        case State::MembersCount: {
+            return beginMembers(getValueFromClassFileBuffer<uint16_t>(buf, bufPtr));
+        }
+
+        case State::Member: {
+            auto accessFlags = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            auto nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            auto descriptorIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            if ((tagAt(nameIndex) != CONSTANT_Utf8) || (tagAt(descriptorIndex) != CONSTANT_Utf8)) {
+                return setupError(memberError(), m_offset, m_itemNumber);
+            }
+            m_visitor.member(m_memberKind, m_itemNumber, accessFlags, nameIndex, descriptorIndex);
+            m_state = State::AttributesCount;
+            return false;
+        }
+
+        case State::AttributesCount: {
+            m_attributesLeft = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            if (m_attributesLeft == 0) {
+                m_attributesLeft = 1;   // endAttribute() counts one down
+                return endAttribute();
+            }
+            m_state = State::AttributeHeader;
+            return false;
+        }
+
+        case State::AttributeHeader: {
+            auto nameIndex = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            m_dataLeft = getValueFromClassFileBuffer<uint32_t>(buf, bufPtr);
+            if (tagAt(nameIndex) != CONSTANT_Utf8) {
+                return setupError(memberError(), m_offset,
+                                  (m_memberKind == StreamMember::Class) ? noErrorIndex : m_itemNumber);
+            }
+            m_visitor.attribute(m_memberKind, nameIndex, m_dataLeft);
+            m_state = State::AttributeData;
+            if (m_dataLeft == 0) {
+                m_visitor.attributeData({}, true);
+                return endAttribute();
+            }
+            return false;
+        }
+
+        default: {
+            return false;
+        }
+    }
+}
+
+
+static bool
+validIndex(size_t idx, size_t constantPoolCount) {
+    return (idx > 0) && (idx < constantPoolCount);
+}
+
+
+// the decoding checks of ClassFile::decodeConstant, on the bytes after the tag
+bool
+ClassFileStreamParser::decodeConstant(const uint8_t *info) {
+    auto buf = std::span(info, constantFixedSizes[m_tag]);
+    size_t bufPtr = 0;
+    ConstantEntry &entry = m_constants[m_cpIdx];
+    entry.tag = m_tag;
+
+    switch (m_tag) {
+        case CONSTANT_Class:
+        case CONSTANT_String:
+        case CONSTANT_MethodType:
+        case CONSTANT_Module:
+        case CONSTANT_Package: {
+            entry.first = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            return validIndex(entry.first, m_poolCount);
+        }
+        case CONSTANT_Fieldref:
+        case CONSTANT_Methodref:
+        case CONSTANT_InterfaceMethodref:
+        case CONSTANT_NameAndType: {
+            entry.first = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            entry.second = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            return validIndex(entry.first, m_poolCount) && validIndex(entry.second, m_poolCount);
+        }
+        case CONSTANT_MethodHandle: {
+            entry.referenceKind = getValueFromClassFileBuffer<uint8_t>(buf, bufPtr);
+            entry.first = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            return (entry.referenceKind >= REF_getField) && (entry.referenceKind <= REF_invokeInterface) &&
+                   validIndex(entry.first, m_poolCount);
+        }
+        case CONSTANT_Dynamic:
+        case CONSTANT_InvokeDynamic: {
+            // bootstrap_method_attr_index is not kept: the attribute it refers to comes last
+            bufPtr += sizeof(uint16_t);
+            entry.second = getValueFromClassFileBuffer<uint16_t>(buf, bufPtr);
+            return validIndex(entry.second, m_poolCount);
+        }
+        default: {
+            // Integer, Float, Long, Double
+            return true;
+        }
+    }
+}
+
+
+/*
+ * The Structural rules of ClassFile::checkConstant over the tags recorded so
+ * far; Pending when a referenced index is not below available yet
+ */
+ClassFileStreamParser::ConstantCheck
+ClassFileStreamParser::checkConstant(const ConstantEntry &entry, size_t available) const {
+    bool pending = false;
+    auto tagAt = [&](size_t cpIdx) -> uint8_t {
+        if (cpIdx >= available) {
+            pending = true;
+            return 0;
+        }
+        return this->tagAt(cpIdx);
+    };
+
+    bool valid = true;
+    switch (entry.tag) {
+        case CONSTANT_Class:
+        case CONSTANT_String:
+        case CONSTANT_MethodType:
+        case CONSTANT_Module:
+        case CONSTANT_Package: {
+            valid = tagAt(entry.first) == CONSTANT_Utf8;
+            break;
+        }
+        case CONSTANT_Fieldref:
+        case CONSTANT_Methodref:
+        case CONSTANT_InterfaceMethodref: {
+            valid = (tagAt(entry.first) == CONSTANT_Class) && (tagAt(entry.second) == CONSTANT_NameAndType);
+            break;
+        }
+        case CONSTANT_NameAndType: {
+            valid = (tagAt(entry.first) == CONSTANT_Utf8) && (tagAt(entry.second) == CONSTANT_Utf8);
+            break;
+        }
+        case CONSTANT_MethodHandle: {
+            uint8_t targetTag = tagAt(entry.first);
+            switch (entry.referenceKind) {
+                case REF_getField:
+                case REF_getStatic:
+                case REF_putField:
+                case REF_putStatic: {
+                    valid = targetTag == CONSTANT_Fieldref;
+                    break;
+                }
+                case REF_invokeVirtual:
+                case REF_newInvokeSpecial: {
+                    valid = targetTag == CONSTANT_Methodref;
+                    break;
+                }
+                case REF_invokeStatic:
+                case REF_invokeSpecial: {
+                    valid = (targetTag == CONSTANT_Methodref) ||
+                            ((targetTag == CONSTANT_InterfaceMethodref) && (m_majorVersion >= 52));
+                    break;
+                }
+                default: {
+                    valid = targetTag == CONSTANT_InterfaceMethodref;
+                    break;
+                }
+            }
+            break;
+        }
+        case CONSTANT_Dynamic:
+        case CONSTANT_InvokeDynamic: {
+            valid = tagAt(entry.second) == CONSTANT_NameAndType;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    if (pending) {
+        return ConstantCheck::Pending;
+    }
+    return valid ? ConstantCheck::Valid : ConstantCheck::Invalid;
+}
+
+
+// checks the constant at m_cpIdx as far as the pool allows and moves on to the next one
+bool
+ClassFileStreamParser::endConstant() {
+    if (m_verify) {
+        switch (checkConstant(m_constants[m_cpIdx], m_cpIdx + 1)) {
+            case ConstantCheck::Valid: {
+                break;
+            }
+            case ConstantCheck::Pending: {
+                m_pendingChecks.push_back(m_cpIdx);
+                break;
+            }
+            case ConstantCheck::Invalid: {
+                return setupError(ClassFileErrorCode::InvalidConstant, m_constantOffset, m_cpIdx, m_tag);
+            }
+        }
+    }
+
+    // a long or double needs its second slot inside the pool too (JVMS 4.4.5)
+    if (constantTakesTwoSlots(m_tag) && (m_cpIdx + 1 >= m_poolCount)) {
+        return setupError(ClassFileErrorCode::InvalidConstant, m_constantOffset, m_cpIdx, m_tag);
+    }
+    m_cpIdx += constantTakesTwoSlots(m_tag) ? 2 : 1;
+    if (m_cpIdx >= m_poolCount) {
+        return endConstantPool();
+    }
+    m_state = State::ConstantTag;
+    return false;
+}
+
+
+bool
+ClassFileStreamParser::endConstantPool() {
+    for (uint16_t cpIdx : m_pendingChecks) {
+        if (checkConstant(m_constants[cpIdx], m_poolCount) != ConstantCheck::Valid) {
+            return setupError(ClassFileErrorCode::InvalidConstant, m_offset, cpIdx, m_constants[cpIdx].tag);
+        }
+    }
+    m_state = State::ClassInfo;
+    return false;
+}
+
+
+// starts the fields or the methods, whichever m_memberKind says
+bool
+ClassFileStreamParser::beginMembers(uint16_t count) {
+    m_itemsLeft = count;
+    m_itemNumber = 0;
+    if (count != 0) {
+        m_state = State::Member;
+        return false;
+    }
+    if (m_memberKind == StreamMember::Field) {
+        m_memberKind = StreamMember::Method;
+        m_state = State::MembersCount;
+    } else {
+        m_memberKind = StreamMember::Class;
+        m_state = State::AttributesCount;
+    }
+    return false;
+}
+
+
+// one attribute is complete; moves on to the next attribute, member or section
+bool
+ClassFileStreamParser::endAttribute() {
+    if (--m_attributesLeft != 0) {
+        m_state = State::AttributeHeader;
+        return false;
+    }
+
+    if (m_memberKind == StreamMember::Class) {
+        m_state = State::Done;
+        m_visitor.end();
+        return false;
+    }
+    m_itemNumber++;
+    if (--m_itemsLeft != 0) {
+        m_state = State::Member;
+        return false;
+    }
+    return beginMembers(0);
+}
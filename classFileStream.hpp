@@ -0,0 +1,218 @@
+#ifndef SJBCDC_CLASSFILESTREAM_HPP
+#define SJBCDC_CLASSFILESTREAM_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "classFileRead.hpp"
+#include "utf8Validate.hpp"
+
+enum class StreamMember : uint8_t {
+    Field,
+    Method,
+    Class   // owner of the class attributes
+};
+
+/*
+ * Receives a class file from ClassFileStreamParser in file order, as soon as
+ * each part is complete. Utf8 constants and attribute bodies come in
+ * fragments as they arrive instead of being buffered; everything refers to
+ * the constant pool by index. The defaults ignore everything.
+ */
+class ClassFileVisitor {
+public:
+    virtual
+    ~ClassFileVisitor() = default;
+
+    virtual void
+    version(uint16_t /*minorVersion*/, uint16_t /*majorVersion*/) {}
+
+    virtual void
+    constantPoolCount(uint16_t /*count*/) {}
+
+    // any constant but CONSTANT_Utf8; info is what follows the tag (constantFixedSizes[tag] bytes)
+    virtual void
+    constant(uint16_t /*cpIdx*/, uint8_t /*tag*/, std::span<const uint8_t> /*info*/) {}
+
+    // a piece of the bytes of a CONSTANT_Utf8, last on the final (possibly empty) one
+    virtual void
+    utf8(uint16_t /*cpIdx*/, std::span<const uint8_t> /*bytes*/, bool /*last*/) {}
+
+    // after the whole pool has been checked
+    virtual void
+    classInfo(uint16_t /*accessFlags*/, uint16_t /*thisClass*/, uint16_t /*superClass*/) {}
+
+    virtual void
+    interface(uint16_t /*classIndex*/) {}
+
+    virtual void
+    member(StreamMember /*kind*/, uint16_t /*number*/, uint16_t /*accessFlags*/, uint16_t /*nameIndex*/,
+           uint16_t /*descriptorIndex*/) {}
+
+    // owner is the kind of the last member() call, or Class after the methods
+    virtual void
+    attribute(StreamMember /*owner*/, uint16_t /*nameIndex*/, uint32_t /*length*/) {}
+
+    // a piece of the body of the last attribute(), last on the final (possibly empty) one
+    virtual void
+    attributeData(std::span<const uint8_t> /*bytes*/, bool /*last*/) {}
+
+    // the class file is complete and valid
+    virtual void
+    end() {}
+};
+
+enum class StreamStatus {
+    NeedMore,   // everything fed so far is consumed
+    Done,       // the class file is complete; more bytes are an error
+    Error       // see error(); the parser stays here until reset()
+};
+
+/*
+ * Parses a class file from chunks of any size, e.g. as they are received from
+ * a pipe or a socket, handing every part to a ClassFileVisitor as soon as it
+ * is complete. A chunk may end anywhere, in the middle of a constant too:
+ * a field cut off at the end of a chunk is carried over in a buffer of
+ * carryCapacity bytes, Utf8 constants and attribute bodies are passed on
+ * piecewise instead of being collected.
+ *
+ * Errors are reported with the codes (and constant pool index and tag) that
+ * ClassFile::init would give for the same bytes; offsets count from the
+ * start of the stream. VerifyLevel::Full is checked as Structural: names and
+ * descriptors would need every Utf8 constant to be kept. The only state that
+ * grows with the input is the tag and references of each constant (at most
+ * 6 bytes per constant), which the checks of the pool need.
+ */
+class ClassFileStreamParser {
+public:
+    static constexpr size_t carryCapacity = 8;
+
+private:
+    enum class State : uint8_t {
+        Magic,
+        MinorVersion,
+        MajorVersion,
+        PoolCount,
+        ConstantTag,
+        ConstantInfo,
+        Utf8Length,
+        Utf8Bytes,
+        ClassInfo,
+        InterfacesCount,
+        Interface,
+        MembersCount,
+        Member,
+        AttributesCount,
+        AttributeHeader,
+        AttributeData,
+        Done,
+        Error
+    };
+
+    // what the pool checks need of a constant
+    struct ConstantEntry {
+        uint8_t tag = 0;
+        uint8_t referenceKind = 0;  // CONSTANT_MethodHandle
+        uint16_t first = 0;         // class, name, string, descriptor or reference index
+        uint16_t second = 0;        // name and type or descriptor index
+    };
+
+    enum class ConstantCheck {
+        Valid,
+        Pending,
+        Invalid
+    };
+
+    ClassFileVisitor &m_visitor;
+    bool m_verify;
+
+    State m_state = State::Magic;
+    ClassFileError m_error;
+    uint64_t m_offset = 0;          // stream offset of the next byte to consume
+    uint64_t m_fieldOffset = 0;     // where the current field started
+    uint64_t m_constantOffset = 0;  // where the current constant (its tag) started
+
+    std::array<uint8_t, carryCapacity> m_carry{};
+    size_t m_carrySize = 0;
+
+    uint16_t m_minorVersion = 0;
+    uint16_t m_majorVersion = 0;
+    uint16_t m_poolCount = 0;
+    uint16_t m_cpIdx = 0;
+    uint8_t m_tag = 0;
+    std::vector<ConstantEntry> m_constants;
+    std::vector<uint16_t> m_pendingChecks;
+    ModifiedUtf8Validator m_utf8Validator;
+
+    StreamMember m_memberKind = StreamMember::Field;
+    uint16_t m_itemsLeft = 0;       // interfaces or members
+    uint16_t m_itemNumber = 0;
+    uint16_t m_attributesLeft = 0;
+    uint32_t m_dataLeft = 0;        // of a Utf8 constant or an attribute body
+
+    size_t
+    fieldSize() const;
+
+    bool
+    handleField(const uint8_t *field);
+
+    bool
+    passThrough(std::span<const uint8_t> &chunk);
+
+    bool
+    decodeConstant(const uint8_t *info);
+
+    bool
+    endConstant();
+
+    ConstantCheck
+    checkConstant(const ConstantEntry &entry, size_t available) const;
+
+    bool
+    endConstantPool();
+
+    bool
+    beginMembers(uint16_t count);
+
+    bool
+    endAttribute();
+
+    uint8_t
+    tagAt(size_t cpIdx) const { return (cpIdx < m_constants.size()) ? m_constants[cpIdx].tag : 0; }
+
+    // the error code of the current member section
+    ClassFileErrorCode
+    memberError() const;
+
+    bool
+    setupError(ClassFileErrorCode code, uint64_t offset, size_t index = noErrorIndex, uint8_t tag = 0);
+
+public:
+    explicit ClassFileStreamParser(ClassFileVisitor &visitor, VerifyLevel verifyLevel = VerifyLevel::Structural);
+
+    // consumes the whole chunk unless the stream is done or broken
+    StreamStatus
+    feed(std::span<const uint8_t> chunk);
+
+    // the input has ended: Done, or Error for a class file that is cut off
+    StreamStatus
+    finish();
+
+    StreamStatus
+    status() const;
+
+    const ClassFileError &
+    error() const { return m_error; }
+
+    // bytes consumed so far
+    uint64_t
+    offset() const { return m_offset; }
+
+    // starts over with a new class file, keeping the allocated tables
+    void
+    reset();
+};
+
+#endif //SJBCDC_CLASSFILESTREAM_HPP
@@ -0,0 +1,201 @@
+#include "classFileWrite.hpp"
+#include "classFileBuffer.hpp"
+#include "utf8Validate.hpp"
+#include <bit>
+#include <cstring>
+
+
+// constant_pool_count is a u2, so the last usable index is 65534
+constexpr static size_t
+maxConstantPoolCount = UINT16_MAX;
+
+// magic, minor_version, major_version
+constexpr static size_t
+constantPoolCountOffset = 8;
+
+
+template<typename T>
+static void
+putBigEndian(std::vector<uint8_t> &out, T value) {
+    T big = std::byteswap(value);
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&big);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+
+static bool
+validUtf8Text(std::string_view text) {
+    return (text.size() <= UINT16_MAX) &&
+           validModifiedUtf8(reinterpret_cast<const uint8_t *>(text.data()), text.size());
+}
+
+
+static void
+putUtf8(std::vector<uint8_t> &out, std::string_view text) {
+    out.push_back(CONSTANT_Utf8);
+    putBigEndian(out, (uint16_t)text.size());
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+
+bool
+ClassFileEdits::replaceUtf8(uint16_t cpIdx, std::string_view text) {
+    if ((cpIdx == 0) || (cpIdx >= m_baseCount) || !validUtf8Text(text)) {
+        return false;
+    }
+    m_utf8Replacements.insert_or_assign(cpIdx, std::string(text));
+    return true;
+}
+
+
+uint16_t
+ClassFileEdits::append(uint8_t tag, std::initializer_list<uint16_t> operands) {
+    size_t slots = constantTakesTwoSlots(tag) ? 2 : 1;
+    if (m_constantPoolCount + slots > maxConstantPoolCount) {
+        return 0;
+    }
+    m_appended.push_back(tag);
+    for (uint16_t operand : operands) {
+        putBigEndian(m_appended, operand);
+    }
+    auto cpIdx = (uint16_t)m_constantPoolCount;
+    m_constantPoolCount += slots;
+    return cpIdx;
+}
+
+
+uint16_t
+ClassFileEdits::addUtf8(std::string_view text) {
+    if (!validUtf8Text(text) || (m_constantPoolCount + 1 > maxConstantPoolCount)) {
+        return 0;
+    }
+    putUtf8(m_appended, text);
+    return (uint16_t)m_constantPoolCount++;
+}
+
+
+uint16_t
+ClassFileEdits::addInteger(int32_t value) {
+    auto bits = (uint32_t)value;
+    return append(CONSTANT_Integer, { (uint16_t)(bits >> 16), (uint16_t)bits });
+}
+
+
+uint16_t
+ClassFileEdits::addLong(int64_t value) {
+    auto bits = (uint64_t)value;
+    return append(CONSTANT_Long, { (uint16_t)(bits >> 48), (uint16_t)(bits >> 32), (uint16_t)(bits >> 16),
+                                   (uint16_t)bits });
+}
+
+
+uint16_t
+ClassFileEdits::addClass(uint16_t nameIndex) {
+    return append(CONSTANT_Class, { nameIndex });
+}
+
+
+uint16_t
+ClassFileEdits::addString(uint16_t utf8Index) {
+    return append(CONSTANT_String, { utf8Index });
+}
+
+
+uint16_t
+ClassFileEdits::addNameAndType(uint16_t nameIndex, uint16_t descriptorIndex) {
+    return append(CONSTANT_NameAndType, { nameIndex, descriptorIndex });
+}
+
+
+uint16_t
+ClassFileEdits::addFieldref(uint16_t classIndex, uint16_t nameAndTypeIndex) {
+    return append(CONSTANT_Fieldref, { classIndex, nameAndTypeIndex });
+}
+
+
+uint16_t
+ClassFileEdits::addMethodref(uint16_t classIndex, uint16_t nameAndTypeIndex) {
+    return append(CONSTANT_Methodref, { classIndex, nameAndTypeIndex });
+}
+
+
+uint16_t
+ClassFileEdits::addInterfaceMethodref(uint16_t classIndex, uint16_t nameAndTypeIndex) {
+    return append(CONSTANT_InterfaceMethodref, { classIndex, nameAndTypeIndex });
+}
+
+
+bool
+writeClassFile(const ClassFile &classFile, const ClassFileEdits &edits, std::vector<uint8_t> &out) {
+    out.clear();
+    std::span<const uint8_t> bytes = classFile.classBytes();
+    if (classFile.parseError() || (edits.m_baseCount != classFile.constantPoolCount())) {
+        return false;
+    }
+    if (edits.empty()) {
+        out.assign(bytes.begin(), bytes.end());
+        return true;
+    }
+
+    size_t growth = edits.m_appended.size();
+    for (auto &[cpIdx, text] : edits.m_utf8Replacements) {
+        growth += text.size();
+    }
+    out.reserve(bytes.size() + growth);
+    out.insert(out.end(), bytes.begin(), bytes.begin() + constantPoolCountOffset);
+    putBigEndian(out, (uint16_t)edits.m_constantPoolCount);
+
+    /*
+     * The parse has checked the layout of the pool, so it is only stepped
+     * through here. Constants between two replacements go out as one copy;
+     * after the last replacement the rest of the class does, unless the end
+     * of the pool is needed for appended constants.
+     */
+    auto replacement = edits.m_utf8Replacements.begin();
+    auto replacementsEnd = edits.m_utf8Replacements.end();
+    size_t copyFrom = constantPoolCountOffset + sizeof(uint16_t);
+    size_t bufPtr = copyFrom;
+    for (size_t cpIdx = 1; cpIdx < edits.m_baseCount; cpIdx++) {
+        if ((replacement == replacementsEnd) && edits.m_appended.empty()) {
+            break;
+        }
+        if ((replacement != replacementsEnd) && (replacement->first < cpIdx)) {
+            // the second slot of a Long or Double
+            out.clear();
+            return false;
+        }
+
+        uint8_t tag = bytes[bufPtr];
+        size_t constantSize = 1 + constantFixedSizes[tag];
+        if (tag == CONSTANT_Utf8) {
+            size_t lengthPtr = bufPtr + 1;
+            constantSize = 3 + getValueFromClassFileBuffer<uint16_t>(bytes, lengthPtr);
+        }
+        if ((replacement != replacementsEnd) && (replacement->first == cpIdx)) {
+            if (tag != CONSTANT_Utf8) {
+                out.clear();
+                return false;
+            }
+            out.insert(out.end(), bytes.begin() + copyFrom, bytes.begin() + bufPtr);
+            putUtf8(out, replacement->second);
+            copyFrom = bufPtr + constantSize;
+            ++replacement;
+        }
+        bufPtr += constantSize;
+        if (constantTakesTwoSlots(tag)) {
+            cpIdx++;
+        }
+    }
+    if (replacement != replacementsEnd) {
+        out.clear();
+        return false;
+    }
+
+    if (!edits.m_appended.empty()) {
+        out.insert(out.end(), bytes.begin() + copyFrom, bytes.begin() + bufPtr);
+        out.insert(out.end(), edits.m_appended.begin(), edits.m_appended.end());
+        copyFrom = bufPtr;
+    }
+    out.insert(out.end(), bytes.begin() + copyFrom, bytes.end());
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef SJBCDC_CLASSFILEWRITE_HPP
+#define SJBCDC_CLASSFILEWRITE_HPP
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "classFileRead.hpp"
+
+/*
+ * Changes to one parsed class for writeClassFile(): Utf8 constants replaced
+ * in place and new constants appended to the constant pool. The index of
+ * every existing constant stays the same, so nothing that refers to the
+ * constant pool (members, attributes, bytecode) has to be rewritten.
+ */
+class ClassFileEdits {
+private:
+    size_t m_baseCount;                         // constant_pool_count of the class
+    size_t m_constantPoolCount;                 // with the appended constants
+    std::map<uint16_t, std::string> m_utf8Replacements;
+    std::vector<uint8_t> m_appended;            // cp_info entries as written
+
+    uint16_t
+    append(uint8_t tag, std::initializer_list<uint16_t> operands);
+
+public:
+    explicit ClassFileEdits(const ClassFile &classFile)
+        : m_baseCount(classFile.constantPoolCount()), m_constantPoolCount(m_baseCount) {}
+
+    /*
+     * The Utf8 constant at cpIdx gets text as its contents; false when text
+     * is not valid modified UTF-8 or does not fit in a CONSTANT_Utf8. Whether
+     * cpIdx is a Utf8 constant is checked by writeClassFile().
+     */
+    bool
+    replaceUtf8(uint16_t cpIdx, std::string_view text);
+
+    /*
+     * Each returns the constant pool index of the new constant, 0 when text
+     * is invalid (as in replaceUtf8) or the constant pool is full. Operands
+     * are not checked against the constant pool.
+     */
+    uint16_t
+    addUtf8(std::string_view text);
+
+    uint16_t
+    addInteger(int32_t value);
+
+    // takes two constant pool slots
+    uint16_t
+    addLong(int64_t value);
+
+    uint16_t
+    addClass(uint16_t nameIndex);
+
+    uint16_t
+    addString(uint16_t utf8Index);
+
+    uint16_t
+    addNameAndType(uint16_t nameIndex, uint16_t descriptorIndex);
+
+    uint16_t
+    addFieldref(uint16_t classIndex, uint16_t nameAndTypeIndex);
+
+    uint16_t
+    addMethodref(uint16_t classIndex, uint16_t nameAndTypeIndex);
+
+    uint16_t
+    addInterfaceMethodref(uint16_t classIndex, uint16_t nameAndTypeIndex);
+
+    bool
+    empty() const { return m_utf8Replacements.empty() && m_appended.empty(); }
+
+    size_t
+    constantPoolCount() const { return m_constantPoolCount; }
+
+    friend bool
+    writeClassFile(const ClassFile &classFile, const ClassFileEdits &edits, std::vector<uint8_t> &out);
+};
+
+/*
+ * Writes classFile with edits applied to out (replacing its contents).
+ * Everything the edits leave alone is copied from ClassFile::classBytes() as
+ * whole byte ranges: the runs of constants between replaced Utf8s and all
+ * of the class after the constant pool, members, attributes and bytecode
+ * included, are never re-encoded. Without edits out is the original bytes.
+ *
+ * false, leaving out empty, when classFile failed to parse, the edits were
+ * made for a class with another constant_pool_count or a replaced index is
+ * not a CONSTANT_Utf8.
+ */
+bool
+writeClassFile(const ClassFile &classFile, const ClassFileEdits &edits, std::vector<uint8_t> &out);
+
+#endif //SJBCDC_CLASSFILEWRITE_HPP
@@ -0,0 +1,422 @@
+#include "classHierarchy.hpp"
+#include <algorithm>
+#include <utility>
+
+
+constexpr static uint16_t
+accInterface = 0x0200;
+
+// numbers between neighbouring interval ends after a relabel
+constexpr static uint64_t
+relabelGap = uint64_t(1) << 24;
+
+// interval size of a root numbered without a relabel
+constexpr static uint64_t
+rootSpan = uint64_t(1) << 40;
+
+// a parent with less free space than this gets relabelled instead
+constexpr static uint64_t
+minFreeSpace = 4;
+
+
+static void
+eraseId(std::vector<ClassId> &ids, ClassId id) {
+    auto it = std::find(ids.begin(), ids.end(), id);
+    if (it != ids.end()) {
+        ids.erase(it);
+    }
+}
+
+
+ClassId
+ClassHierarchy::nodeFor(std::string_view name) {
+    SymbolId symbol = m_symbols.intern(name);
+    auto it = m_ids.find(symbol);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+
+    auto id = (ClassId)m_nodes.size();
+    m_nodes.push_back(Node{ .name = symbol });
+    m_interfaceSets.resize(m_interfaceSets.size() + m_setWords, 0);
+    m_ids.emplace(symbol, id);
+    return id;
+}
+
+
+void
+ClassHierarchy::markInterface(ClassId id) {
+    Node &node = m_nodes[id];
+    node.isInterface = true;
+    if (node.interfaceBit != UINT32_MAX) {
+        return;
+    }
+
+    node.interfaceBit = m_interfaceCount++;
+    if ((node.interfaceBit >= m_setWords * 64) || !node.subclasses.empty() || !node.implementors.empty()) {
+        m_setsDirty = true;
+    } else if (!m_setsDirty) {
+        m_interfaceSets[(size_t)id * m_setWords + node.interfaceBit / 64] |= uint64_t(1) << (node.interfaceBit % 64);
+    }
+}
+
+
+/*
+ * Numbers a node without subclasses: half of the free space left in its
+ * superclass, or the next rootSpan numbers for a root
+ */
+void
+ClassHierarchy::numberLeaf(ClassId id) {
+    if (m_treeDirty) {
+        return;
+    }
+
+    Node &node = m_nodes[id];
+    ClassId parent = node.superClass;
+    if ((parent == id) || ((parent != noClass) && (m_nodes[parent].pre > m_nodes[parent].post))) {
+        m_treeDirty = true;
+        return;
+    }
+
+    uint64_t &freeStart = (parent == noClass) ? m_rootFreeStart : m_nodes[parent].freeStart;
+    uint64_t end = (parent == noClass) ? UINT64_MAX : m_nodes[parent].post;
+    uint64_t space = (parent == noClass) ? rootSpan : (end - freeStart) / 2;
+    if ((freeStart >= end) || (end - freeStart < minFreeSpace) || (end - freeStart <= space)) {
+        m_treeDirty = true;
+        return;
+    }
+
+    node.pre = freeStart;
+    node.post = freeStart + space;
+    node.freeStart = node.pre + 1;
+    freeStart = node.post + 1;
+}
+
+
+// interface set of a class whose supertypes all have an up to date set
+void
+ClassHierarchy::computeInterfaceSet(ClassId id) {
+    if (m_setsDirty) {
+        return;
+    }
+
+    uint64_t *set = m_interfaceSets.data() + (size_t)id * m_setWords;
+    std::fill_n(set, m_setWords, 0);
+    const Node &node = m_nodes[id];
+    if (node.interfaceBit != UINT32_MAX) {
+        set[node.interfaceBit / 64] |= uint64_t(1) << (node.interfaceBit % 64);
+    }
+
+    auto merge = [&](ClassId from) {
+        const uint64_t *other = interfaceSet(from);
+        for (size_t w = 0; w < m_setWords; w++) {
+            set[w] |= other[w];
+        }
+    };
+    if (node.superClass != noClass) {
+        merge(node.superClass);
+    }
+    for (ClassId interface : node.interfaces) {
+        merge(interface);
+    }
+}
+
+
+void
+ClassHierarchy::unlink(ClassId id) {
+    Node &node = m_nodes[id];
+    if (node.superClass != noClass) {
+        eraseId(m_nodes[node.superClass].subclasses, id);
+    }
+    for (ClassId interface : node.interfaces) {
+        eraseId(m_nodes[interface].implementors, id);
+    }
+    node.interfaces.clear();
+    node.superClass = noClass;
+    node.defined = false;
+}
+
+
+ClassId
+ClassHierarchy::add(std::string_view name, std::string_view superName, std::span<const std::string_view> interfaces,
+                    bool isInterface) {
+    auto firstNew = (ClassId)m_nodes.size();
+    ClassId id = nodeFor(name);
+    if (m_nodes[id].defined) {
+        // replacing a definition may move the class and everything below it
+        unlink(id);
+        m_treeDirty = true;
+        m_setsDirty = true;
+    } else {
+        m_definedCount++;
+    }
+
+    ClassId superId = superName.empty() ? noClass : nodeFor(superName);
+    std::vector<ClassId> interfaceIds;
+    interfaceIds.reserve(interfaces.size());
+    for (auto interface : interfaces) {
+        ClassId interfaceId = nodeFor(interface);
+        markInterface(interfaceId);
+        interfaceIds.push_back(interfaceId);
+    }
+    if (isInterface) {
+        markInterface(id);
+    }
+
+    Node &node = m_nodes[id];
+    bool hasSubtypes = !node.subclasses.empty() || !node.implementors.empty();
+    node.defined = true;
+    node.superClass = superId;
+    node.interfaces = std::move(interfaceIds);
+    if (superId != noClass) {
+        m_nodes[superId].subclasses.push_back(id);
+    }
+    for (ClassId interfaceId : m_nodes[id].interfaces) {
+        m_nodes[interfaceId].implementors.push_back(id);
+    }
+
+    // placeholders created for the supertypes are roots, numbered before the class itself
+    for (ClassId created = firstNew; created < m_nodes.size(); created++) {
+        if (created != id) {
+            numberLeaf(created);
+        }
+    }
+    if (hasSubtypes) {
+        // a placeholder root with subtypes moves under its superclass
+        m_treeDirty = true;
+        m_setsDirty = true;
+    } else {
+        numberLeaf(id);
+    }
+    computeInterfaceSet(id);
+
+    return id;
+}
+
+
+ClassId
+ClassHierarchy::add(const ClassFile &classFile) {
+    if (classFile.parseError()) {
+        return noClass;
+    }
+
+    std::vector<std::string_view> interfaces;
+    interfaces.reserve(classFile.interfaces().size());
+    for (uint16_t interface : classFile.interfaces()) {
+        interfaces.push_back(classFile.className(interface));
+    }
+    return add(classFile.thisClassName(), classFile.superClassName(), interfaces,
+               (classFile.accessFlags() & accInterface) != 0);
+}
+
+
+bool
+ClassHierarchy::remove(ClassId id) {
+    if ((id >= m_nodes.size()) || !m_nodes[id].defined) {
+        return false;
+    }
+
+    unlink(id);
+    m_definedCount--;
+    Node &node = m_nodes[id];
+    if (!node.subclasses.empty() || !node.implementors.empty()) {
+        // stays as a placeholder root, its subtypes lose everything it inherited
+        m_treeDirty = true;
+        m_setsDirty = true;
+        return true;
+    }
+
+    // nothing is numbered inside it or inherits its interfaces: just retire it
+    m_ids.erase(node.name);
+    node.removed = true;
+    node.pre = 1;
+    node.post = 0;
+    std::fill_n(m_interfaceSets.begin() + (ptrdiff_t)(id * m_setWords), m_setWords, 0);
+    return true;
+}
+
+
+void
+ClassHierarchy::relabel() {
+    for (auto &node : m_nodes) {
+        node.pre = 1;
+        node.post = 0;
+    }
+
+    /*
+     * depth-first over the superclass forest; classes on a superclass cycle
+     * are never reached and keep an empty interval
+     */
+    uint64_t counter = 0;
+    std::vector<std::pair<ClassId, size_t>> stack;
+    for (ClassId root = 0; root < m_nodes.size(); root++) {
+        if (m_nodes[root].removed || (m_nodes[root].superClass != noClass)) {
+            continue;
+        }
+        m_nodes[root].pre = counter;
+        counter += relabelGap;
+        stack.emplace_back(root, 0);
+
+        while (!stack.empty()) {
+            auto &[id, nextChild] = stack.back();
+            Node &node = m_nodes[id];
+            if (nextChild < node.subclasses.size()) {
+                Node &child = m_nodes[node.subclasses[nextChild++]];
+                if (child.pre <= child.post) {
+                    continue;
+                }
+                child.pre = counter;
+                counter += relabelGap;
+                stack.emplace_back(node.subclasses[nextChild - 1], 0);
+                continue;
+            }
+            // free space for new subclasses after the existing ones
+            node.freeStart = counter;
+            node.post = counter + relabelGap - 1;
+            counter += relabelGap;
+            stack.pop_back();
+        }
+    }
+    m_rootFreeStart = counter;
+    m_treeDirty = false;
+}
+
+
+void
+ClassHierarchy::recomputeInterfaceSets() {
+    // room for twice the current interfaces before the next recompute
+    m_setWords = std::max<size_t>(1, (m_interfaceCount * 2 + 63) / 64);
+    m_interfaceSets.assign(m_nodes.size() * m_setWords, 0);
+    m_setsDirty = false;
+
+    enum : uint8_t { Todo, Active, Done };
+    std::vector<uint8_t> state(m_nodes.size(), Todo);
+    // (class, next supertype to visit): 0 is the superclass, k > 0 interface k - 1
+    std::vector<std::pair<ClassId, size_t>> stack;
+    for (ClassId start = 0; start < m_nodes.size(); start++) {
+        if ((state[start] != Todo) || m_nodes[start].removed) {
+            continue;
+        }
+        state[start] = Active;
+        stack.emplace_back(start, 0);
+
+        while (!stack.empty()) {
+            auto &[id, nextSupertype] = stack.back();
+            const Node &node = m_nodes[id];
+            if (nextSupertype <= node.interfaces.size()) {
+                ClassId supertype = (nextSupertype == 0) ? node.superClass : node.interfaces[nextSupertype - 1];
+                nextSupertype++;
+                if ((supertype != noClass) && (state[supertype] == Todo)) {
+                    state[supertype] = Active;
+                    stack.emplace_back(supertype, 0);
+                }
+                continue;
+            }
+
+            // a supertype still Active is on a cycle and contributes what it has so far
+            ClassId done = id;
+            stack.pop_back();
+            computeInterfaceSet(done);
+            state[done] = Done;
+        }
+    }
+}
+
+
+void
+ClassHierarchy::refresh() {
+    if (m_treeDirty) {
+        relabel();
+    }
+    if (m_setsDirty) {
+        recomputeInterfaceSets();
+    }
+}
+
+
+void
+ClassHierarchy::ensureFresh() const {
+    if (m_treeDirty || m_setsDirty) {
+        const_cast<ClassHierarchy *>(this)->refresh();
+    }
+}
+
+
+ClassId
+ClassHierarchy::find(SymbolId name) const {
+    auto it = m_ids.find(name);
+    return (it != m_ids.end()) ? it->second : noClass;
+}
+
+
+ClassId
+ClassHierarchy::find(std::string_view name) const {
+    SymbolId symbol = m_symbols.find(name);
+    return (symbol != noSymbol) ? find(symbol) : noClass;
+}
+
+
+bool
+ClassHierarchy::isSubclass(ClassId sub, ClassId super) const {
+    if (sub == super) {
+        return true;
+    }
+    ensureFresh();
+    const Node &a = m_nodes[sub];
+    const Node &b = m_nodes[super];
+    return (a.pre <= a.post) && (b.pre < a.pre) && (a.post <= b.post);
+}
+
+
+bool
+ClassHierarchy::isAssignable(ClassId from, ClassId to) const {
+    if ((from == to) || (m_nodes[to].name == m_objectName)) {
+        return true;
+    }
+    ensureFresh();
+    const Node &target = m_nodes[to];
+    if (target.interfaceBit != UINT32_MAX) {
+        return (interfaceSet(from)[target.interfaceBit / 64] >> (target.interfaceBit % 64)) & 1;
+    }
+    return isSubclass(from, to);
+}
+
+
+std::vector<ClassId>
+ClassHierarchy::subclasses(ClassId id) const {
+    std::vector<ClassId> result;
+    std::vector<ClassId> stack(m_nodes[id].subclasses.begin(), m_nodes[id].subclasses.end());
+    while (!stack.empty()) {
+        ClassId next = stack.back();
+        stack.pop_back();
+        if (next == id) {
+            continue;
+        }
+        result.push_back(next);
+        stack.insert(stack.end(), m_nodes[next].subclasses.begin(), m_nodes[next].subclasses.end());
+    }
+    return result;
+}
+
+
+std::vector<ClassId>
+ClassHierarchy::subtypes(ClassId id) const {
+    std::vector<ClassId> result;
+    std::vector<bool> seen(m_nodes.size(), false);
+    std::vector<ClassId> stack{ id };
+    seen[id] = true;
+    while (!stack.empty()) {
+        const Node &node = m_nodes[stack.back()];
+        stack.pop_back();
+        for (const auto *direct : { &node.subclasses, &node.implementors }) {
+            for (ClassId next : *direct) {
+                if (!seen[next]) {
+                    seen[next] = true;
+                    result.push_back(next);
+                    stack.push_back(next);
+                }
+            }
+        }
+    }
+    return result;
+}
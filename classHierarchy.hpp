@@ -0,0 +1,178 @@
+#ifndef SJBCDC_CLASSHIERARCHY_HPP
+#define SJBCDC_CLASSHIERARCHY_HPP
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "classFileRead.hpp"
+#include "symbolTable.hpp"
+
+using ClassId = uint32_t;
+
+constexpr ClassId noClass = UINT32_MAX;
+
+/*
+ * Subtype index over a set of classes, keyed by class name symbol. Classes
+ * that are only referenced (a superclass or interface outside the corpus,
+ * java/lang/Object usually) get a placeholder node, so every name has an id.
+ *
+ * Superclass queries use interval numbering of the superclass forest: a
+ * class lies in [pre, post] of each of its superclasses. Numbers are handed
+ * out with gaps, so a new leaf takes half of the free space left in its
+ * superclass's interval without touching anyone else. Interface queries use
+ * one bitset per class holding every interface it can be assigned to.
+ *
+ * Adding a leaf class is O(1) plus its interface bitset. Changes that move a
+ * whole subtree (a class added after its subclasses, a removed class with
+ * subclasses left, a parent running out of gaps) only mark the numbering or
+ * the bitsets stale; the next query relabels in O(classes). Queries are
+ * const but may do that relabel, so call refresh() after the last change
+ * before querying from several threads.
+ */
+class ClassHierarchy {
+private:
+    struct Node {
+        SymbolId name = noSymbol;
+        ClassId superClass = noClass;
+        std::vector<ClassId> interfaces{};
+        std::vector<ClassId> subclasses{};
+        std::vector<ClassId> implementors{};  // classes and interfaces listing this one directly
+        // empty interval (pre > post) while not numbered
+        uint64_t pre = 1;
+        uint64_t post = 0;
+        uint64_t freeStart = 0;             // first number not used by a subclass yet
+        uint32_t interfaceBit = UINT32_MAX;
+        bool defined = false;
+        bool isInterface = false;
+        bool removed = false;               // id retired by remove()
+    };
+
+    SymbolTable &m_symbols;
+    SymbolId m_objectName;
+    std::vector<Node> m_nodes;
+    std::unordered_map<SymbolId, ClassId> m_ids;
+    size_t m_definedCount = 0;
+
+    uint64_t m_rootFreeStart = 0;
+    mutable bool m_treeDirty = false;
+
+    // m_setWords words per node, bit interfaceBit of every assignable interface
+    std::vector<uint64_t> m_interfaceSets;
+    size_t m_setWords = 1;
+    uint32_t m_interfaceCount = 0;
+    mutable bool m_setsDirty = false;
+
+    ClassId
+    nodeFor(std::string_view name);
+
+    void
+    markInterface(ClassId id);
+
+    void
+    numberLeaf(ClassId id);
+
+    void
+    computeInterfaceSet(ClassId id);
+
+    void
+    unlink(ClassId id);
+
+    void
+    relabel();
+
+    void
+    recomputeInterfaceSets();
+
+    void
+    ensureFresh() const;
+
+    const uint64_t *
+    interfaceSet(ClassId id) const { return m_interfaceSets.data() + (size_t)id * m_setWords; }
+
+public:
+    explicit ClassHierarchy(SymbolTable &symbols = SymbolTable::global())
+        : m_symbols(symbols), m_objectName(symbols.intern("java/lang/Object")) {}
+
+    /*
+     * Adds (or replaces) a class; superName is empty for java/lang/Object and
+     * module-info. Returns its id, which stays the same as long as the class
+     * or any subtype of it is in the index.
+     */
+    ClassId
+    add(std::string_view name, std::string_view superName, std::span<const std::string_view> interfaces,
+        bool isInterface);
+
+    // noClass when the class file has not been parsed successfully
+    ClassId
+    add(const ClassFile &classFile);
+
+    /*
+     * Drops the definition of a class. A class that still has subtypes in the
+     * index stays as a placeholder. Returns false when it was not defined.
+     */
+    bool
+    remove(ClassId id);
+
+    bool
+    remove(std::string_view name) { return remove(find(name)); }
+
+    // relabels and recomputes whatever the last changes left stale
+    void
+    refresh();
+
+    ClassId
+    find(std::string_view name) const;
+
+    ClassId
+    find(SymbolId name) const;
+
+    // ids handed out so far, placeholders and removed classes included
+    size_t
+    size() const { return m_nodes.size(); }
+
+    size_t
+    definedCount() const { return m_definedCount; }
+
+    std::string_view
+    name(ClassId id) const { return m_symbols.name(m_nodes[id].name); }
+
+    // added through add(), not only referenced by another class
+    bool
+    defined(ClassId id) const { return m_nodes[id].defined; }
+
+    bool
+    isInterface(ClassId id) const { return m_nodes[id].isInterface; }
+
+    ClassId
+    superClass(ClassId id) const { return m_nodes[id].superClass; }
+
+    std::span<const ClassId>
+    interfaces(ClassId id) const { return m_nodes[id].interfaces; }
+
+    std::span<const ClassId>
+    directSubclasses(ClassId id) const { return m_nodes[id].subclasses; }
+
+    std::span<const ClassId>
+    directImplementors(ClassId id) const { return m_nodes[id].implementors; }
+
+    // sub == super or super is a (transitive) superclass of sub
+    bool
+    isSubclass(ClassId sub, ClassId super) const;
+
+    // whether a reference of class from can be assigned to class or interface to
+    bool
+    isAssignable(ClassId from, ClassId to) const;
+
+    // every transitive subclass, without id itself
+    std::vector<ClassId>
+    subclasses(ClassId id) const;
+
+    // every class and interface assignable to id, without id itself
+    std::vector<ClassId>
+    subtypes(ClassId id) const;
+};
+
+#endif //SJBCDC_CLASSHIERARCHY_HPP
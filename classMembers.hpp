@@ -0,0 +1,39 @@
+#ifndef SJBCDC_CLASSMEMBERS_HPP
+#define SJBCDC_CLASSMEMBERS_HPP
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+#include "attributes.hpp"
+
+// field_info or method_info
+struct MemberInfo {
+    uint16_t accessFlags;
+    uint16_t nameIndex;
+    uint16_t descriptorIndex;
+    uint16_t attributesCount;   // attributes kept after the attribute mask
+    uint32_t firstAttribute;    // into ClassFileMembers::attributes
+};
+
+/*
+ * Everything after the constant pool. Attributes of all fields, methods and
+ * the class itself share one table; members refer to slices of it.
+ */
+struct ClassFileMembers {
+    explicit ClassFileMembers(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : interfaces(resource), fields(resource), methods(resource), attributes(resource),
+          attributeKindCache(resource) {}
+
+    std::pmr::vector<uint16_t> interfaces;
+    std::pmr::vector<MemberInfo> fields;
+    std::pmr::vector<MemberInfo> methods;
+    std::pmr::vector<AttributeInfo> attributes;
+    uint32_t firstClassAttribute = 0;
+    uint16_t classAttributesCount = 0;
+
+    // AttributeKind + 1 per attribute name constant pool index, 0 until looked up
+    std::pmr::vector<uint8_t> attributeKindCache;
+};
+
+#endif //SJBCDC_CLASSMEMBERS_HPP
@@ -0,0 +1,164 @@
+#include "compactConstantPool.hpp"
+
+
+static inline uint64_t
+makeEntry(size_t tag, uint64_t payload) {
+    return (payload << 8) | (uint8_t)tag;
+}
+
+
+static inline uint64_t
+twoIndices(uint16_t first, uint16_t second) {
+    return (uint64_t)first | ((uint64_t)second << 16);
+}
+
+
+void
+CompactConstantPool::build(const ClassFileConstants &constants) {
+    m_entries.assign(constants.idxTable.size() + 1, 0);
+    m_wide.clear();
+    m_strings.clear();
+
+    size_t stringBytes = 0;
+    for (auto &utf8 : constants.utf8Consts) {
+        stringBytes += constants.utf8Bytes(utf8).size();
+    }
+    m_strings.reserve(stringBytes);
+    m_wide.reserve(constants.longConsts.size() + constants.doubleConsts.size());
+
+    for (size_t cpIdx = 1; cpIdx < m_entries.size(); cpIdx++) {
+        const idxRef &ref = constants[cpIdx];
+        uint64_t payload = 0;
+
+        switch (ref.type) {
+            case CONSTANT_Utf8: {
+                auto bytes = constants.utf8Bytes(constants.utf8Consts[ref.idxInType]);
+                payload = (uint64_t)m_strings.size() | ((uint64_t)bytes.size() << 32);
+                m_strings.insert(m_strings.end(), bytes.begin(), bytes.end());
+                break;
+            }
+            case CONSTANT_Integer: {
+                payload = constants.intConsts[ref.idxInType].bytes;
+                break;
+            }
+            case CONSTANT_Float: {
+                payload = constants.floatConsts[ref.idxInType].bytes;
+                break;
+            }
+            case CONSTANT_Long: {
+                auto &constant = constants.longConsts[ref.idxInType];
+                payload = m_wide.size();
+                m_wide.push_back(((uint64_t)constant.highBytes << 32) | constant.lowBytes);
+                break;
+            }
+            case CONSTANT_Double: {
+                auto &constant = constants.doubleConsts[ref.idxInType];
+                payload = m_wide.size();
+                m_wide.push_back(((uint64_t)constant.highBytes << 32) | constant.lowBytes);
+                break;
+            }
+            case CONSTANT_Class: {
+                payload = constants.classConsts[ref.idxInType].nameIndex;
+                break;
+            }
+            case CONSTANT_String: {
+                payload = constants.stringConsts[ref.idxInType].stringIndex;
+                break;
+            }
+            case CONSTANT_Fieldref: {
+                auto &constant = constants.fieldrefConsts[ref.idxInType];
+                payload = twoIndices(constant.classIndex, constant.nameAndTypeIndex);
+                break;
+            }
+            case CONSTANT_Methodref: {
+                auto &constant = constants.methodrefConsts[ref.idxInType];
+                payload = twoIndices(constant.classIndex, constant.nameAndTypeIndex);
+                break;
+            }
+            case CONSTANT_InterfaceMethodref: {
+                auto &constant = constants.interfaceMetodrefConsts[ref.idxInType];
+                payload = twoIndices(constant.classIndex, constant.nameAndTypeIndex);
+                break;
+            }
+            case CONSTANT_NameAndType: {
+                auto &constant = constants.nameAndTypeConsts[ref.idxInType];
+                payload = twoIndices(constant.nameIndex, constant.descriptorIndex);
+                break;
+            }
+            case CONSTANT_MethodHandle: {
+                auto &constant = constants.methodHandleConsts[ref.idxInType];
+                payload = (uint64_t)constant.referenceKind | ((uint64_t)constant.referenceIndex << 8);
+                break;
+            }
+            case CONSTANT_MethodType: {
+                payload = constants.methodTypeConsts[ref.idxInType].descriptorIndex;
+                break;
+            }
+            case CONSTANT_Dynamic: {
+                auto &constant = constants.dynamicConsts[ref.idxInType];
+                payload = twoIndices(constant.bootstrapMethodAttrIndex, constant.nameAndTypeIndex);
+                break;
+            }
+            case CONSTANT_InvokeDynamic: {
+                auto &constant = constants.invokeDynamicConsts[ref.idxInType];
+                payload = twoIndices(constant.bootstrapMethodAttrIndex, constant.nameAndTypeIndex);
+                break;
+            }
+            case CONSTANT_Module: {
+                payload = constants.moduleConsts[ref.idxInType].nameIndex;
+                break;
+            }
+            case CONSTANT_Package: {
+                payload = constants.packageConsts[ref.idxInType].nameIndex;
+                break;
+            }
+            default: {
+                // second slot of a Long/Double
+                break;
+            }
+        }
+
+        m_entries[cpIdx] = makeEntry(ref.type, payload);
+    }
+}
+
+
+std::string_view
+CompactConstantPool::className(size_t classIdx) const {
+    if (!holds<CONSTANT_Class>(classIdx)) {
+        return {};
+    }
+    uint16_t nameIdx = low16(payload(classIdx));
+    if (!holds<CONSTANT_Utf8>(nameIdx)) {
+        return {};
+    }
+    return get<CONSTANT_Utf8>(nameIdx);
+}
+
+
+std::optional<ResolvedMemberRef>
+CompactConstantPool::memberRef(size_t refIdx) const {
+    uint8_t refTag = tag(refIdx);
+    if ((refIdx == 0) ||
+        ((refTag != CONSTANT_Fieldref) && (refTag != CONSTANT_Methodref) && (refTag != CONSTANT_InterfaceMethodref))) {
+        return std::nullopt;
+    }
+
+    uint64_t ref = payload(refIdx);
+    uint16_t classIdx = low16(ref);
+    uint16_t nameAndTypeIdx = high16(ref);
+    if (!holds<CONSTANT_Class>(classIdx) || !holds<CONSTANT_Utf8>(low16(payload(classIdx))) ||
+        !holds<CONSTANT_NameAndType>(nameAndTypeIdx)) {
+        return std::nullopt;
+    }
+    uint64_t nameAndType = payload(nameAndTypeIdx);
+    if (!holds<CONSTANT_Utf8>(low16(nameAndType)) || !holds<CONSTANT_Utf8>(high16(nameAndType))) {
+        return std::nullopt;
+    }
+
+    return ResolvedMemberRef{
+        get<CONSTANT_Utf8>(low16(payload(classIdx))),
+        get<CONSTANT_Utf8>(low16(nameAndType)),
+        get<CONSTANT_Utf8>(high16(nameAndType))
+    };
+}
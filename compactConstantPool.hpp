@@ -0,0 +1,148 @@
+#ifndef SJBCDC_COMPACTCONSTANTPOOL_HPP
+#define SJBCDC_COMPACTCONSTANTPOOL_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "constant_pool.hpp"
+
+/*
+ * Maps a constant tag to the value CompactConstantPool::get returns for it.
+ * Tags without a specialization do not compile.
+ */
+template <uint8_t Tag>
+struct ConstantTagTraits;
+
+template <> struct ConstantTagTraits<CONSTANT_Utf8> { using type = std::string_view; };
+template <> struct ConstantTagTraits<CONSTANT_Integer> { using type = CONSTANT_IntegerInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Float> { using type = CONSTANT_FloatInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Long> { using type = CONSTANT_LongInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Double> { using type = CONSTANT_DoubleInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Class> { using type = CONSTANT_ClassInfo; };
+template <> struct ConstantTagTraits<CONSTANT_String> { using type = CONSTANT_StringInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Fieldref> { using type = CONSTANT_FieldrefInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Methodref> { using type = CONSTANT_MethodrefInfo; };
+template <> struct ConstantTagTraits<CONSTANT_InterfaceMethodref> { using type = CONSTANT_InterfaceMethodrefInfo; };
+template <> struct ConstantTagTraits<CONSTANT_NameAndType> { using type = CONSTANT_NameAndTypeInfo; };
+template <> struct ConstantTagTraits<CONSTANT_MethodHandle> { using type = CONSTANT_MethodHandleInfo; };
+template <> struct ConstantTagTraits<CONSTANT_MethodType> { using type = CONSTANT_MethodTypeInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Dynamic> { using type = CONSTANT_DynamicInfo; };
+template <> struct ConstantTagTraits<CONSTANT_InvokeDynamic> { using type = CONSTANT_InvokeDynamicInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Module> { using type = CONSTANT_ModuleInfo; };
+template <> struct ConstantTagTraits<CONSTANT_Package> { using type = CONSTANT_PackageInfo; };
+
+
+// class, name and descriptor of a Fieldref, Methodref or InterfaceMethodref
+struct ResolvedMemberRef {
+    std::string_view className;
+    std::string_view name;
+    std::string_view descriptor;
+};
+
+
+/*
+ * Alternative constant pool layout: one 8-byte tagged entry per constant pool
+ * index (tag in the low byte, payload above it) plus a separate string area
+ * with all Utf8 bytes back to back. A resolution is a single load from the
+ * entry array instead of idxTable followed by a per-tag vector.
+ *
+ * Payloads:
+ *   Utf8                         string area offset (32 bits), length (16 bits)
+ *   Integer, Float               the 32-bit value
+ *   Long, Double                 index into the wide value table
+ *   Class, String, MethodType,
+ *   Module, Package              one 16-bit index
+ *   *ref, NameAndType,
+ *   Dynamic, InvokeDynamic       two 16-bit indices, in class file order
+ *   MethodHandle                 reference kind (8 bits), reference index (16 bits)
+ */
+class CompactConstantPool {
+private:
+    std::vector<uint64_t> m_entries;
+    std::vector<uint64_t> m_wide;
+    std::vector<char> m_strings;
+
+    uint64_t
+    payload(size_t idx) const { return m_entries[idx] >> 8; }
+
+    static uint16_t
+    low16(uint64_t payload) { return (uint16_t)payload; }
+
+    static uint16_t
+    high16(uint64_t payload) { return (uint16_t)(payload >> 16); }
+
+public:
+    CompactConstantPool() = default;
+
+    explicit CompactConstantPool(const ClassFileConstants &constants) { build(constants); }
+
+    void
+    build(const ClassFileConstants &constants);
+
+    // constant_pool_count: valid indices are 1 .. size() - 1
+    size_t
+    size() const { return m_entries.size(); }
+
+    size_t
+    stringAreaSize() const { return m_strings.size(); }
+
+    uint8_t
+    tag(size_t idx) const { return (idx < m_entries.size()) ? (uint8_t)m_entries[idx] : 0; }
+
+    template <uint8_t Tag>
+    bool
+    holds(size_t idx) const { return (idx != 0) && (tag(idx) == Tag); }
+
+    template <uint8_t Tag>
+    typename ConstantTagTraits<Tag>::type
+    get(size_t idx) const;
+
+    template <uint8_t Tag>
+    std::optional<typename ConstantTagTraits<Tag>::type>
+    find(size_t idx) const {
+        if (!holds<Tag>(idx)) {
+            return std::nullopt;
+        }
+        return get<Tag>(idx);
+    }
+
+    // Utf8 behind a CONSTANT_Class; empty when the chain is broken
+    std::string_view
+    className(size_t classIdx) const;
+
+    /*
+     * Resolves Fieldref/Methodref/InterfaceMethodref -> Class/NameAndType -> Utf8;
+     * nullopt when any link has the wrong tag
+     */
+    std::optional<ResolvedMemberRef>
+    memberRef(size_t refIdx) const;
+};
+
+
+template <uint8_t Tag>
+typename ConstantTagTraits<Tag>::type
+CompactConstantPool::get(size_t idx) const {
+    assert(holds<Tag>(idx));
+    uint64_t p = payload(idx);
+
+    if constexpr (Tag == CONSTANT_Utf8) {
+        return { m_strings.data() + (uint32_t)p, (size_t)(uint16_t)(p >> 32) };
+    } else if constexpr ((Tag == CONSTANT_Integer) || (Tag == CONSTANT_Float)) {
+        return { (uint32_t)p };
+    } else if constexpr ((Tag == CONSTANT_Long) || (Tag == CONSTANT_Double)) {
+        uint64_t value = m_wide[(uint32_t)p];
+        return { (uint32_t)(value >> 32), (uint32_t)value };
+    } else if constexpr (Tag == CONSTANT_MethodHandle) {
+        return { (uint8_t)p, (uint16_t)(p >> 8) };
+    } else if constexpr ((Tag == CONSTANT_Class) || (Tag == CONSTANT_String) || (Tag == CONSTANT_MethodType) ||
+                         (Tag == CONSTANT_Module) || (Tag == CONSTANT_Package)) {
+        return { low16(p) };
+    } else {
+        return { low16(p), high16(p) };
+    }
+}
+
+#endif //SJBCDC_COMPACTCONSTANTPOOL_HPP
@@ -3,6 +3,13 @@
 
 #include <cinttypes>
 #include <vector>
+#include <array>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <tuple>
+
+#include "symbolTable.hpp"
 
 struct CpInfo {
     uint8_t tag;
@@ -27,6 +34,17 @@ struct CpInfo {
 #define CONSTANT_Module 19
 #define CONSTANT_Package 20
 
+// reference_kind of a CONSTANT_MethodHandle (JVMS 5.4.3.5)
+#define REF_getField 1
+#define REF_getStatic 2
+#define REF_putField 3
+#define REF_putStatic 4
+#define REF_invokeVirtual 5
+#define REF_invokeStatic 6
+#define REF_invokeSpecial 7
+#define REF_newInvokeSpecial 8
+#define REF_invokeInterface 9
+
 
 struct CONSTANT_ClassInfo {
     uint16_t nameIndex;
@@ -74,8 +92,15 @@ struct CONSTANT_NameAndTypeInfo {
     uint16_t descriptorIndex;
 };
 
+/*
+ * offset/length always locate the bytes in the class buffer; bytes holds an
+ * owned copy only when parsed with Utf8Storage::Owned
+ */
 struct CONSTANT_Utf8Info {
-    std::vector<uint8_t> bytes;
+    std::pmr::vector<uint8_t> bytes;
+    uint32_t offset = 0;
+    uint16_t length = 0;
+    SymbolId symbol = noSymbol;     // only with Utf8Storage::Interned
 };
 
 struct CONSTANT_MethodHandleInfo {
@@ -106,36 +131,309 @@ struct CONSTANT_PackageInfo {
 };
 
 
+/*
+ * type is 0 for the unusable slot that follows every CONSTANT_Long and
+ * CONSTANT_Double (JVMS 4.4.5)
+ */
 struct idxRef {
     size_t type;
     size_t idxInType;
 };
 
+// highest constant tag + 1, for per-tag tables
+constexpr size_t CONSTANT_TagCount = 21;
+
+/*
+ * Every container allocates from the memory resource given at construction,
+ * so a whole batch of classes can live in one std::pmr::monotonic_buffer_resource
+ * and be released together
+ */
 struct ClassFileConstants {
-    std::vector<idxRef> idxTable;
+    explicit ClassFileConstants(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : idxTable(resource), constantPoolInfo(resource), utf8Consts(resource), intConsts(resource),
+          floatConsts(resource), longConsts(resource), doubleConsts(resource), classConsts(resource),
+          stringConsts(resource), fieldrefConsts(resource), methodrefConsts(resource),
+          interfaceMetodrefConsts(resource), nameAndTypeConsts(resource), methodHandleConsts(resource),
+          methodTypeConsts(resource), dynamicConsts(resource), invokeDynamicConsts(resource),
+          moduleConsts(resource), packageConsts(resource) {}
+
+    std::pmr::memory_resource *
+    resource() const { return idxTable.get_allocator().resource(); }
+
+    // sizes every container exactly from a pre-scan of the constant pool tags
+    void
+    reserve(size_t entries, const std::array<size_t, CONSTANT_TagCount> &tagCounts) {
+        idxTable.reserve(entries);
+        utf8Consts.reserve(tagCounts[CONSTANT_Utf8]);
+        intConsts.reserve(tagCounts[CONSTANT_Integer]);
+        floatConsts.reserve(tagCounts[CONSTANT_Float]);
+        longConsts.reserve(tagCounts[CONSTANT_Long]);
+        doubleConsts.reserve(tagCounts[CONSTANT_Double]);
+        classConsts.reserve(tagCounts[CONSTANT_Class]);
+        stringConsts.reserve(tagCounts[CONSTANT_String]);
+        fieldrefConsts.reserve(tagCounts[CONSTANT_Fieldref]);
+        methodrefConsts.reserve(tagCounts[CONSTANT_Methodref]);
+        interfaceMetodrefConsts.reserve(tagCounts[CONSTANT_InterfaceMethodref]);
+        nameAndTypeConsts.reserve(tagCounts[CONSTANT_NameAndType]);
+        methodHandleConsts.reserve(tagCounts[CONSTANT_MethodHandle]);
+        methodTypeConsts.reserve(tagCounts[CONSTANT_MethodType]);
+        dynamicConsts.reserve(tagCounts[CONSTANT_Dynamic]);
+        invokeDynamicConsts.reserve(tagCounts[CONSTANT_InvokeDynamic]);
+        moduleConsts.reserve(tagCounts[CONSTANT_Module]);
+        packageConsts.reserve(tagCounts[CONSTANT_Package]);
+    }
+
+    std::pmr::vector<idxRef> idxTable;
     //return std::ref(idxTable[idx - 1]) or idxTable[idx - 1]?
     idxRef &operator[](size_t idx) {
         return idxTable[idx - 1];
     }
 
-    std::vector<CpInfo> constantPoolInfo;
-    std::vector<CONSTANT_Utf8Info> utf8Consts;
-    std::vector<CONSTANT_IntegerInfo> intConsts;
-    std::vector<CONSTANT_FloatInfo> floatConsts;
-    std::vector<CONSTANT_LongInfo> longConsts;
-    std::vector<CONSTANT_DoubleInfo> doubleConsts;
-    std::vector<CONSTANT_ClassInfo> classConsts;
-    std::vector<CONSTANT_StringInfo> stringConsts;
-    std::vector<CONSTANT_FieldrefInfo> fieldrefConsts;
-    std::vector<CONSTANT_MethodrefInfo> methodrefConsts;
-    std::vector<CONSTANT_InterfaceMethodrefInfo> interfaceMetodrefConsts;
-    std::vector<CONSTANT_NameAndTypeInfo> nameAndTypeConsts;
-    std::vector<CONSTANT_MethodHandleInfo> methodHandleConsts;
-    std::vector<CONSTANT_MethodTypeInfo> methodTypeConsts;
-    std::vector<CONSTANT_DynamicInfo> dynamicConsts;
-    std::vector<CONSTANT_InvokeDynamicInfo> invokeDynamicConsts;
-    std::vector<CONSTANT_ModuleInfo> moduleConsts;
-    std::vector<CONSTANT_PackageInfo> packageConsts;
+    const idxRef &operator[](size_t idx) const {
+        return idxTable[idx - 1];
+    }
+
+    // class file bytes the Utf8 views point into
+    std::span<const uint8_t> classBytes;
+    // table the Utf8 symbols were interned into
+    const SymbolTable *symbols = nullptr;
+
+    std::span<const uint8_t>
+    utf8Bytes(const CONSTANT_Utf8Info &constant) const {
+        if (!constant.bytes.empty()) {
+            return constant.bytes;
+        }
+        if (constant.symbol != noSymbol) {
+            std::string_view name = symbols->name(constant.symbol);
+            return { reinterpret_cast<const uint8_t *>(name.data()), name.size() };
+        }
+        return classBytes.subspan(constant.offset, constant.length);
+    }
+
+    std::string_view
+    utf8View(const CONSTANT_Utf8Info &constant) const {
+        auto bytes = utf8Bytes(constant);
+        return { reinterpret_cast<const char *>(bytes.data()), bytes.size() };
+    }
+
+    std::pmr::vector<CpInfo> constantPoolInfo;
+    std::pmr::vector<CONSTANT_Utf8Info> utf8Consts;
+    std::pmr::vector<CONSTANT_IntegerInfo> intConsts;
+    std::pmr::vector<CONSTANT_FloatInfo> floatConsts;
+    std::pmr::vector<CONSTANT_LongInfo> longConsts;
+    std::pmr::vector<CONSTANT_DoubleInfo> doubleConsts;
+    std::pmr::vector<CONSTANT_ClassInfo> classConsts;
+    std::pmr::vector<CONSTANT_StringInfo> stringConsts;
+    std::pmr::vector<CONSTANT_FieldrefInfo> fieldrefConsts;
+    std::pmr::vector<CONSTANT_MethodrefInfo> methodrefConsts;
+    std::pmr::vector<CONSTANT_InterfaceMethodrefInfo> interfaceMetodrefConsts;
+    std::pmr::vector<CONSTANT_NameAndTypeInfo> nameAndTypeConsts;
+    std::pmr::vector<CONSTANT_MethodHandleInfo> methodHandleConsts;
+    std::pmr::vector<CONSTANT_MethodTypeInfo> methodTypeConsts;
+    std::pmr::vector<CONSTANT_DynamicInfo> dynamicConsts;
+    std::pmr::vector<CONSTANT_InvokeDynamicInfo> invokeDynamicConsts;
+    std::pmr::vector<CONSTANT_ModuleInfo> moduleConsts;
+    std::pmr::vector<CONSTANT_PackageInfo> packageConsts;
+};
+
+/*
+ * Layout of every fixed-size constant, one specialization per tag: Info is
+ * what it decodes to, fields the members of Info in class file order,
+ * indexFields a bit per field that holds a constant pool index (checked to
+ * be in range while decoding) and storage the ClassFileConstants vector it
+ * is appended to. CONSTANT_Utf8 has a length prefix and is decoded on its own.
+ */
+template <uint8_t Tag>
+struct ConstantLayout;
+
+template <>
+struct ConstantLayout<CONSTANT_Integer> {
+    using Info = CONSTANT_IntegerInfo;
+    static constexpr auto fields = std::tuple{ &Info::bytes };
+    static constexpr uint8_t indexFields = 0b0;
+    static constexpr auto storage = &ClassFileConstants::intConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Float> {
+    using Info = CONSTANT_FloatInfo;
+    static constexpr auto fields = std::tuple{ &Info::bytes };
+    static constexpr uint8_t indexFields = 0b0;
+    static constexpr auto storage = &ClassFileConstants::floatConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Long> {
+    using Info = CONSTANT_LongInfo;
+    static constexpr auto fields = std::tuple{ &Info::highBytes, &Info::lowBytes };
+    static constexpr uint8_t indexFields = 0b00;
+    static constexpr auto storage = &ClassFileConstants::longConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Double> {
+    using Info = CONSTANT_DoubleInfo;
+    static constexpr auto fields = std::tuple{ &Info::highBytes, &Info::lowBytes };
+    static constexpr uint8_t indexFields = 0b00;
+    static constexpr auto storage = &ClassFileConstants::doubleConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Class> {
+    using Info = CONSTANT_ClassInfo;
+    static constexpr auto fields = std::tuple{ &Info::nameIndex };
+    static constexpr uint8_t indexFields = 0b1;
+    static constexpr auto storage = &ClassFileConstants::classConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_String> {
+    using Info = CONSTANT_StringInfo;
+    static constexpr auto fields = std::tuple{ &Info::stringIndex };
+    static constexpr uint8_t indexFields = 0b1;
+    static constexpr auto storage = &ClassFileConstants::stringConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Fieldref> {
+    using Info = CONSTANT_FieldrefInfo;
+    static constexpr auto fields = std::tuple{ &Info::classIndex, &Info::nameAndTypeIndex };
+    static constexpr uint8_t indexFields = 0b11;
+    static constexpr auto storage = &ClassFileConstants::fieldrefConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Methodref> {
+    using Info = CONSTANT_MethodrefInfo;
+    static constexpr auto fields = std::tuple{ &Info::classIndex, &Info::nameAndTypeIndex };
+    static constexpr uint8_t indexFields = 0b11;
+    static constexpr auto storage = &ClassFileConstants::methodrefConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_InterfaceMethodref> {
+    using Info = CONSTANT_InterfaceMethodrefInfo;
+    static constexpr auto fields = std::tuple{ &Info::classIndex, &Info::nameAndTypeIndex };
+    static constexpr uint8_t indexFields = 0b11;
+    static constexpr auto storage = &ClassFileConstants::interfaceMetodrefConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_NameAndType> {
+    using Info = CONSTANT_NameAndTypeInfo;
+    static constexpr auto fields = std::tuple{ &Info::nameIndex, &Info::descriptorIndex };
+    static constexpr uint8_t indexFields = 0b11;
+    static constexpr auto storage = &ClassFileConstants::nameAndTypeConsts;
+};
+
+// reference_kind is checked by the decoder itself
+template <>
+struct ConstantLayout<CONSTANT_MethodHandle> {
+    using Info = CONSTANT_MethodHandleInfo;
+    static constexpr auto fields = std::tuple{ &Info::referenceKind, &Info::referenceIndex };
+    static constexpr uint8_t indexFields = 0b10;
+    static constexpr auto storage = &ClassFileConstants::methodHandleConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_MethodType> {
+    using Info = CONSTANT_MethodTypeInfo;
+    static constexpr auto fields = std::tuple{ &Info::descriptorIndex };
+    static constexpr uint8_t indexFields = 0b1;
+    static constexpr auto storage = &ClassFileConstants::methodTypeConsts;
+};
+
+// bootstrap_method_attr_index indexes the BootstrapMethods attribute, see ClassFile::verifyBootstrapMethodRefs
+template <>
+struct ConstantLayout<CONSTANT_Dynamic> {
+    using Info = CONSTANT_DynamicInfo;
+    static constexpr auto fields = std::tuple{ &Info::bootstrapMethodAttrIndex, &Info::nameAndTypeIndex };
+    static constexpr uint8_t indexFields = 0b10;
+    static constexpr auto storage = &ClassFileConstants::dynamicConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_InvokeDynamic> {
+    using Info = CONSTANT_InvokeDynamicInfo;
+    static constexpr auto fields = std::tuple{ &Info::bootstrapMethodAttrIndex, &Info::nameAndTypeIndex };
+    static constexpr uint8_t indexFields = 0b10;
+    static constexpr auto storage = &ClassFileConstants::invokeDynamicConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Module> {
+    using Info = CONSTANT_ModuleInfo;
+    static constexpr auto fields = std::tuple{ &Info::nameIndex };
+    static constexpr uint8_t indexFields = 0b1;
+    static constexpr auto storage = &ClassFileConstants::moduleConsts;
+};
+
+template <>
+struct ConstantLayout<CONSTANT_Package> {
+    using Info = CONSTANT_PackageInfo;
+    static constexpr auto fields = std::tuple{ &Info::nameIndex };
+    static constexpr uint8_t indexFields = 0b1;
+    static constexpr auto storage = &ClassFileConstants::packageConsts;
+};
+
+template <uint8_t... Tags>
+struct ConstantTagList {};
+
+// the tags with a ConstantLayout; every per-tag table below is generated from this list
+using FixedSizeConstantTags = ConstantTagList<
+        CONSTANT_Integer, CONSTANT_Float, CONSTANT_Long, CONSTANT_Double, CONSTANT_Class, CONSTANT_String,
+        CONSTANT_Fieldref, CONSTANT_Methodref, CONSTANT_InterfaceMethodref, CONSTANT_NameAndType,
+        CONSTANT_MethodHandle, CONSTANT_MethodType, CONSTANT_Dynamic, CONSTANT_InvokeDynamic,
+        CONSTANT_Module, CONSTANT_Package>;
+
+template <typename MemberPointer>
+struct ConstantFieldType;
+
+template <typename Info, typename Field>
+struct ConstantFieldType<Field Info::*> {
+    using Type = Field;
+};
+
+// bytes of a constant of tag Tag after the tag byte
+template <uint8_t Tag>
+constexpr size_t constantLayoutSize = std::apply([](auto... fields) {
+    return (sizeof(typename ConstantFieldType<decltype(fields)>::Type) + ...);
+}, ConstantLayout<Tag>::fields);
+
+template <uint8_t... Tags>
+constexpr auto
+makeConstantFixedSizes(ConstantTagList<Tags...>) {
+    std::array<size_t, CONSTANT_TagCount> sizes{};
+    ((sizes[Tags] = constantLayoutSize<Tags>), ...);
+    return sizes;
+}
+
+/*
+ * Size of every constant after its tag; 0 for unknown tags and for
+ * CONSTANT_Utf8, whose size follows from its length prefix
+ */
+constexpr auto constantFixedSizes = makeConstantFixedSizes(FixedSizeConstantTags{});
+
+constexpr bool
+constantTakesTwoSlots(size_t tag) {
+    return (tag == CONSTANT_Long) || (tag == CONSTANT_Double);
+}
+
+/*
+ * Pre-scan result of a lazily parsed constant pool, indexed by constant pool
+ * index: offset of the tag byte, the tag, and idxInType + 1 once the
+ * constant has been decoded into ClassFileConstants (0 before,
+ * lazyConstantInvalid when it failed to decode or verify)
+ */
+constexpr uint32_t lazyConstantInvalid = UINT32_MAX;
+
+struct LazyConstantTable {
+    explicit LazyConstantTable(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : offsets(resource), tags(resource), decoded(resource) {}
+
+    std::pmr::vector<uint32_t> offsets;
+    std::pmr::vector<uint8_t> tags;
+    std::pmr::vector<uint32_t> decoded;
 };
 
 #endif //SJBCDC_CONSTANT_POOL_HPP
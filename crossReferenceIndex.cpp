@@ -0,0 +1,424 @@
+#include "crossReferenceIndex.hpp"
+#include "threadPool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+
+constexpr static uint32_t
+indexMagic = 0x58424a53; // "SJBX" read as little endian
+
+constexpr static uint16_t
+indexVersion = 1;
+
+// chunks of classes per worker, so a few large classes do not hold up the rest
+constexpr static size_t
+chunksPerWorker = 4;
+
+
+struct CrossReferenceIndex::Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t classCount;
+    uint32_t keyCount;
+    uint64_t classNamesSize;
+    uint64_t keyBytesSize;
+    uint64_t postingsSize;
+};
+
+
+static size_t
+align8(size_t offset) {
+    return (offset + 7) & ~size_t(7);
+}
+
+
+/*
+ * Section offsets of an index with the given counts and sizes, in file
+ * order; the last one is the size of the whole index
+ */
+struct SectionLayout {
+    size_t classNameOffsets;
+    size_t keyOffsets;
+    size_t postingOffsets;
+    size_t classNames;
+    size_t keyBytes;
+    size_t postings;
+    size_t end;
+
+    SectionLayout(size_t headerSize, uint64_t classCount, uint64_t keyCount, uint64_t classNamesSize,
+                  uint64_t keyBytesSize, uint64_t postingsSize) {
+        classNameOffsets = align8(headerSize);
+        keyOffsets = classNameOffsets + (classCount + 1) * sizeof(uint64_t);
+        postingOffsets = keyOffsets + (keyCount + 1) * sizeof(uint64_t);
+        classNames = postingOffsets + (keyCount + 1) * sizeof(uint64_t);
+        keyBytes = align8(classNames + classNamesSize);
+        postings = align8(keyBytes + keyBytesSize);
+        end = align8(postings + postingsSize);
+    }
+};
+
+
+static void
+appendVarint(std::vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+
+// the keys class file refers to, sorted and without duplicates
+static void
+collectKeys(const ClassFile &classFile, std::vector<std::string> &keys) {
+    keys.clear();
+    const ClassFileConstants &constants = classFile.constants();
+    for (size_t cpIdx = 1; cpIdx < classFile.constantPoolCount(); cpIdx++) {
+        uint8_t tag = classFile.constantTag(cpIdx);
+        if ((tag != CONSTANT_Class) && (tag != CONSTANT_Fieldref) && (tag != CONSTANT_Methodref) &&
+            (tag != CONSTANT_InterfaceMethodref)) {
+            continue;
+        }
+        auto ref = classFile.constant(cpIdx);
+        if (!ref) {
+            continue;
+        }
+
+        if (tag == CONSTANT_Class) {
+            std::string_view name = classFile.className(cpIdx);
+            if (!name.empty()) {
+                keys.emplace_back(name);
+            }
+            continue;
+        }
+
+        uint16_t classIndex;
+        uint16_t nameAndTypeIndex;
+        if (tag == CONSTANT_Fieldref) {
+            classIndex = constants.fieldrefConsts[ref->idxInType].classIndex;
+            nameAndTypeIndex = constants.fieldrefConsts[ref->idxInType].nameAndTypeIndex;
+        } else if (tag == CONSTANT_Methodref) {
+            classIndex = constants.methodrefConsts[ref->idxInType].classIndex;
+            nameAndTypeIndex = constants.methodrefConsts[ref->idxInType].nameAndTypeIndex;
+        } else {
+            classIndex = constants.interfaceMetodrefConsts[ref->idxInType].classIndex;
+            nameAndTypeIndex = constants.interfaceMetodrefConsts[ref->idxInType].nameAndTypeIndex;
+        }
+        auto nameAndType = classFile.constant(nameAndTypeIndex);
+        if (!nameAndType || (nameAndType->type != CONSTANT_NameAndType)) {
+            continue;
+        }
+        const CONSTANT_NameAndTypeInfo &info = constants.nameAndTypeConsts[nameAndType->idxInType];
+        std::string_view owner = classFile.className(classIndex);
+        std::string_view name = classFile.utf8(info.nameIndex);
+        std::string_view descriptor = classFile.utf8(info.descriptorIndex);
+
+        std::string &key = keys.emplace_back();
+        key.reserve(owner.size() + name.size() + descriptor.size() + 2);
+        key.append(owner).append(".").append(name).append(":").append(descriptor);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+
+CrossReferenceIndex
+CrossReferenceIndex::build(std::span<const ClassFile *const> classes, size_t threads) {
+    /*
+     * Every chunk of consecutive classes gets its own key -> classes map, so
+     * the workers share nothing; since chunks are merged in order, the
+     * postings of a key come out sorted by concatenating them
+     */
+    using ChunkPostings = std::unordered_map<std::string, std::vector<uint32_t>>;
+    WorkStealingPool pool(threads);
+    size_t chunkCount = std::max<size_t>(1, std::min(classes.size(), pool.threadCount() * chunksPerWorker));
+    size_t chunkSize = (classes.size() + chunkCount - 1) / std::max<size_t>(chunkCount, 1);
+    std::vector<ChunkPostings> chunks(chunkCount);
+
+    pool.parallelFor(chunkCount, 1, [&](size_t chunk) {
+        std::vector<std::string> keys;
+        size_t end = std::min(classes.size(), (chunk + 1) * chunkSize);
+        for (size_t classNum = chunk * chunkSize; classNum < end; classNum++) {
+            const ClassFile *classFile = classes[classNum];
+            if ((classFile == nullptr) || classFile->parseError()) {
+                continue;
+            }
+            collectKeys(*classFile, keys);
+            for (auto &key : keys) {
+                chunks[chunk][std::move(key)].push_back((uint32_t)classNum);
+            }
+        }
+    });
+
+    // every key with the postings of each chunk, in chunk order
+    std::map<std::string_view, std::vector<const std::vector<uint32_t> *>> merged;
+    for (auto &chunk : chunks) {
+        for (auto &[key, postings] : chunk) {
+            merged[key].push_back(&postings);
+        }
+    }
+
+    std::vector<uint8_t> classNames;
+    std::vector<uint64_t> classNameOffsets{ 0 };
+    for (const ClassFile *classFile : classes) {
+        if ((classFile != nullptr) && !classFile->parseError()) {
+            std::string_view name = classFile->thisClassName();
+            classNames.insert(classNames.end(), name.begin(), name.end());
+        }
+        classNameOffsets.push_back(classNames.size());
+    }
+
+    std::vector<uint8_t> keyBytes;
+    std::vector<uint64_t> keyOffsets{ 0 };
+    std::vector<uint8_t> postings;
+    std::vector<uint64_t> postingOffsets{ 0 };
+    for (auto &[key, lists] : merged) {
+        keyBytes.insert(keyBytes.end(), key.begin(), key.end());
+        keyOffsets.push_back(keyBytes.size());
+        uint32_t previous = 0;
+        for (auto *list : lists) {
+            for (uint32_t classNum : *list) {
+                appendVarint(postings, classNum - previous);
+                previous = classNum;
+            }
+        }
+        postingOffsets.push_back(postings.size());
+    }
+
+    CrossReferenceIndex index;
+    Header header{ indexMagic, indexVersion, 0, (uint32_t)classes.size(), (uint32_t)merged.size(),
+                   classNames.size(), keyBytes.size(), postings.size() };
+    SectionLayout layout(sizeof(Header), header.classCount, header.keyCount, header.classNamesSize,
+                         header.keyBytesSize, header.postingsSize);
+    std::vector<uint8_t> &bytes = index.m_owned;
+    bytes.assign(layout.end, 0);
+    auto put = [&](size_t offset, const auto &vector) {
+        if (!vector.empty()) {
+            std::memcpy(bytes.data() + offset, vector.data(), vector.size() * sizeof(vector[0]));
+        }
+    };
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    put(layout.classNameOffsets, classNameOffsets);
+    put(layout.keyOffsets, keyOffsets);
+    put(layout.postingOffsets, postingOffsets);
+    put(layout.classNames, classNames);
+    put(layout.keyBytes, keyBytes);
+    put(layout.postings, postings);
+
+    index.m_bytes = bytes;
+    index.attach();
+    return index;
+}
+
+
+CrossReferenceIndex::CrossReferenceIndex(CrossReferenceIndex &&other) noexcept {
+    *this = std::move(other);
+}
+
+
+CrossReferenceIndex &
+CrossReferenceIndex::operator=(CrossReferenceIndex &&other) noexcept {
+    // the spans point into the moved buffer or mapping, which keep their addresses
+    m_owned = std::move(other.m_owned);
+    m_mapping = std::move(other.m_mapping);
+    m_bytes = other.m_bytes;
+    m_classCount = other.m_classCount;
+    m_keyCount = other.m_keyCount;
+    m_classNameOffsets = other.m_classNameOffsets;
+    m_keyOffsets = other.m_keyOffsets;
+    m_postingOffsets = other.m_postingOffsets;
+    m_classNames = other.m_classNames;
+    m_keyBytes = other.m_keyBytes;
+    m_postings = other.m_postings;
+    other.m_bytes = {};
+    other.attach();
+    return *this;
+}
+
+
+bool
+CrossReferenceIndex::attach() {
+    m_classCount = 0;
+    m_keyCount = 0;
+    m_classNameOffsets = {};
+    m_keyOffsets = {};
+    m_postingOffsets = {};
+    m_classNames = {};
+    m_keyBytes = {};
+    m_postings = {};
+
+    Header header{};
+    if (m_bytes.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, m_bytes.data(), sizeof(header));
+    if ((header.magic != indexMagic) || (header.version != indexVersion) ||
+        (header.classNamesSize > m_bytes.size()) || (header.keyBytesSize > m_bytes.size()) ||
+        (header.postingsSize > m_bytes.size())) {
+        return false;
+    }
+    SectionLayout layout(sizeof(Header), header.classCount, header.keyCount, header.classNamesSize,
+                         header.keyBytesSize, header.postingsSize);
+    if (layout.end > m_bytes.size()) {
+        return false;
+    }
+
+    auto offsets = [&](size_t offset, size_t count) {
+        return std::span(reinterpret_cast<const uint64_t *>(m_bytes.data() + offset), count);
+    };
+    auto classNameOffsets = offsets(layout.classNameOffsets, header.classCount + 1);
+    auto keyOffsets = offsets(layout.keyOffsets, header.keyCount + 1);
+    auto postingOffsets = offsets(layout.postingOffsets, header.keyCount + 1);
+    // ascending offsets that end at the section size keep every slice inside its section
+    auto ascending = [](std::span<const uint64_t> list, uint64_t size) {
+        return (list.front() == 0) && (list.back() == size) && std::is_sorted(list.begin(), list.end());
+    };
+    if (!ascending(classNameOffsets, header.classNamesSize) || !ascending(keyOffsets, header.keyBytesSize) ||
+        !ascending(postingOffsets, header.postingsSize)) {
+        return false;
+    }
+
+    m_classCount = header.classCount;
+    m_keyCount = header.keyCount;
+    m_classNameOffsets = classNameOffsets;
+    m_keyOffsets = keyOffsets;
+    m_postingOffsets = postingOffsets;
+    m_classNames = m_bytes.subspan(layout.classNames, header.classNamesSize);
+    m_keyBytes = m_bytes.subspan(layout.keyBytes, header.keyBytesSize);
+    m_postings = m_bytes.subspan(layout.postings, header.postingsSize);
+    return true;
+}
+
+
+bool
+CrossReferenceIndex::save(const std::filesystem::path &path) const {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(m_bytes.data()), (std::streamsize)m_bytes.size());
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+
+bool
+CrossReferenceIndex::load(const std::filesystem::path &path) {
+    m_owned.clear();
+    m_bytes = {};
+    // queries jump around the file, so no sequential read-ahead
+    if ((m_mapping.map(path, false) != MappedFile::Status::Ok) ||
+        ((reinterpret_cast<uintptr_t>(m_mapping.bytes().data()) % alignof(uint64_t)) != 0)) {
+        m_mapping = MappedFile{};
+        attach();
+        return false;
+    }
+    m_bytes = m_mapping.bytes();
+    if (!attach()) {
+        m_mapping = MappedFile{};
+        m_bytes = {};
+        return false;
+    }
+    return true;
+}
+
+
+std::string_view
+CrossReferenceIndex::className(uint32_t classNum) const {
+    if (classNum >= m_classCount) {
+        return {};
+    }
+    size_t begin = m_classNameOffsets[classNum];
+    return { reinterpret_cast<const char *>(m_classNames.data()) + begin, m_classNameOffsets[classNum + 1] - begin };
+}
+
+
+std::string_view
+CrossReferenceIndex::key(size_t keyIdx) const {
+    if (keyIdx >= m_keyCount) {
+        return {};
+    }
+    size_t begin = m_keyOffsets[keyIdx];
+    return { reinterpret_cast<const char *>(m_keyBytes.data()) + begin, m_keyOffsets[keyIdx + 1] - begin };
+}
+
+
+size_t
+CrossReferenceIndex::findKey(std::string_view wanted) const {
+    size_t low = 0;
+    size_t high = m_keyCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (key(mid) < wanted) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+
+void
+CrossReferenceIndex::decodePostings(size_t keyIdx, std::vector<uint32_t> &classes) const {
+    auto bytes = m_postings.subspan(m_postingOffsets[keyIdx], m_postingOffsets[keyIdx + 1] - m_postingOffsets[keyIdx]);
+    uint32_t classNum = 0;
+    uint32_t gap = 0;
+    uint32_t shift = 0;
+    for (uint8_t byte : bytes) {
+        if (shift < 32) {
+            gap |= (uint32_t)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+        if (!(byte & 0x80)) {
+            classNum += gap;
+            classes.push_back(classNum);
+            gap = 0;
+            shift = 0;
+        }
+    }
+}
+
+
+std::vector<uint32_t>
+CrossReferenceIndex::find(std::string_view wanted) const {
+    std::vector<uint32_t> classes;
+    size_t keyIdx = findKey(wanted);
+    if ((keyIdx < m_keyCount) && (key(keyIdx) == wanted)) {
+        decodePostings(keyIdx, classes);
+    }
+    return classes;
+}
+
+
+std::vector<uint32_t>
+CrossReferenceIndex::findPrefix(std::string_view prefix) const {
+    std::vector<uint32_t> classes;
+    for (size_t keyIdx = findKey(prefix); (keyIdx < m_keyCount) && key(keyIdx).starts_with(prefix); keyIdx++) {
+        decodePostings(keyIdx, classes);
+    }
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+    return classes;
+}
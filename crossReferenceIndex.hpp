@@ -0,0 +1,114 @@
+#ifndef SJBCDC_CROSSREFERENCEINDEX_HPP
+#define SJBCDC_CROSSREFERENCEINDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "classFileRead.hpp"
+#include "mappedFile.hpp"
+
+/*
+ * Inverted index from what a class refers to through its constant pool to
+ * the classes that refer to it, over a whole corpus:
+ *
+ *   CONSTANT_Class                               "java/util/List"
+ *   CONSTANT_Fieldref                            "pkg/Owner.name:Ljava/lang/String;"
+ *   CONSTANT_Methodref / InterfaceMethodref      "pkg/Owner.name:(I)V"
+ *
+ * Classes are numbered by their position in the list the index was built
+ * from. Keys are kept sorted, each with a posting list of the classes using
+ * it: ascending class numbers stored as varint (LEB128) encoded gaps.
+ *
+ * The in-memory form is the file format: one buffer of 8-byte aligned
+ * sections, written by save() as is and mapped by load(), so a saved index
+ * is ready for queries without being decoded. Like a ClassCache archive it
+ * is trusted as much as the directory it lives in: load() checks that every
+ * offset stays inside the file, not what the postings decode to.
+ */
+class CrossReferenceIndex {
+private:
+    struct Header;
+
+    std::vector<uint8_t> m_owned;
+    MappedFile m_mapping;
+    std::span<const uint8_t> m_bytes;   // m_owned or m_mapping
+
+    uint32_t m_classCount = 0;
+    uint32_t m_keyCount = 0;
+    std::span<const uint64_t> m_classNameOffsets;  // m_classCount + 1, into m_classNames
+    std::span<const uint64_t> m_keyOffsets;        // m_keyCount + 1, into m_keyBytes
+    std::span<const uint64_t> m_postingOffsets;    // m_keyCount + 1, into m_postings
+    std::span<const uint8_t> m_classNames;
+    std::span<const uint8_t> m_keyBytes;
+    std::span<const uint8_t> m_postings;
+
+    // sets up the spans over m_bytes; false when the sections do not fit
+    bool
+    attach();
+
+    // index of key, or m_keyCount
+    size_t
+    findKey(std::string_view key) const;
+
+    void
+    decodePostings(size_t keyIdx, std::vector<uint32_t> &classes) const;
+
+public:
+    CrossReferenceIndex() = default;
+    CrossReferenceIndex(const CrossReferenceIndex &) = delete;
+    CrossReferenceIndex &operator=(const CrossReferenceIndex &) = delete;
+    CrossReferenceIndex(CrossReferenceIndex &&other) noexcept;
+    CrossReferenceIndex &operator=(CrossReferenceIndex &&other) noexcept;
+
+    /*
+     * Indexes classes[i] as class number i; nullptr and classes that failed
+     * to parse are numbered too and refer to nothing. Classes are read by
+     * several workers at once (threads as in WorkStealingPool), so lazily
+     * parsed ones must not be used elsewhere meanwhile.
+     */
+    static CrossReferenceIndex
+    build(std::span<const ClassFile *const> classes, size_t threads = 0);
+
+    // false on I/O errors
+    bool
+    save(const std::filesystem::path &path) const;
+
+    // maps a saved index; false (leaving the index empty) when it is missing or malformed
+    bool
+    load(const std::filesystem::path &path);
+
+    size_t
+    classCount() const { return m_classCount; }
+
+    size_t
+    keyCount() const { return m_keyCount; }
+
+    // this_class name of class number classNum; empty for classes that failed to parse
+    std::string_view
+    className(uint32_t classNum) const;
+
+    // the keyIdx-th key in sorted order
+    std::string_view
+    key(size_t keyIdx) const;
+
+    // ascending numbers of the classes referring to key; empty when nothing does
+    std::vector<uint32_t>
+    find(std::string_view key) const;
+
+    /*
+     * Classes referring to any key starting with prefix, e.g. "pkg/Owner."
+     * for every field and method of pkg/Owner; ascending, no duplicates
+     */
+    std::vector<uint32_t>
+    findPrefix(std::string_view prefix) const;
+
+    // bytes of the index, the size of a saved file
+    size_t
+    memoryUsage() const { return m_bytes.size(); }
+};
+
+#endif //SJBCDC_CROSSREFERENCEINDEX_HPP
@@ -0,0 +1,218 @@
+#include "descriptor.hpp"
+#include <cstddef>
+#include <cstdint>
+
+
+constexpr static size_t
+invalidDescriptor = std::string_view::npos;
+
+constexpr static size_t
+maxArrayDimensions = 255;
+
+constexpr static size_t
+maxParameterSlots = 255;
+
+
+bool
+isValidUnqualifiedName(std::string_view name) {
+    if (name.empty()) {
+        return false;
+    }
+    for (char c : name) {
+        if ((c == '.') || (c == ';') || (c == '[') || (c == '/')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool
+isValidMethodName(std::string_view name) {
+    if ((name == "<init>") || (name == "<clinit>")) {
+        return true;
+    }
+    if (!isValidUnqualifiedName(name)) {
+        return false;
+    }
+    return name.find_first_of("<>") == std::string_view::npos;
+}
+
+
+bool
+isValidBinaryClassName(std::string_view name) {
+    if (name.empty()) {
+        return false;
+    }
+    size_t segmentStart = 0;
+    for (size_t i = 0; i <= name.size(); i++) {
+        if ((i == name.size()) || (name[i] == '/')) {
+            if (i == segmentStart) {
+                return false;
+            }
+            segmentStart = i + 1;
+            continue;
+        }
+        char c = name[i];
+        if ((c == '.') || (c == ';') || (c == '[')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Parses one FieldType starting at pos; returns the position after it or
+ * invalidDescriptor. slots gets the number of local variable slots it takes,
+ * type (when given) what the FieldType is.
+ */
+static size_t
+parseFieldType(std::string_view descriptor, size_t pos, size_t &slots, DescriptorType *type = nullptr) {
+    size_t dimensions = 0;
+    while ((pos < descriptor.size()) && (descriptor[pos] == '[')) {
+        pos++;
+        dimensions++;
+    }
+    if ((dimensions > maxArrayDimensions) || (pos >= descriptor.size())) {
+        return invalidDescriptor;
+    }
+
+    slots = 1;
+    if (type != nullptr) {
+        *type = DescriptorType{ (BaseType)descriptor[pos], (uint8_t)dimensions };
+    }
+    switch (descriptor[pos]) {
+        case 'J':
+        case 'D': {
+            if (dimensions == 0) {
+                slots = 2;
+            }
+            return pos + 1;
+        }
+        case 'B':
+        case 'C':
+        case 'F':
+        case 'I':
+        case 'S':
+        case 'Z': {
+            return pos + 1;
+        }
+        case 'L': {
+            size_t end = descriptor.find(';', pos + 1);
+            if ((end == std::string_view::npos) ||
+                !isValidBinaryClassName(descriptor.substr(pos + 1, end - pos - 1))) {
+                return invalidDescriptor;
+            }
+            if (type != nullptr) {
+                type->nameOffset = (uint16_t)(pos + 1);
+                type->nameLength = (uint16_t)(end - pos - 1);
+            }
+            return end + 1;
+        }
+        default: {
+            return invalidDescriptor;
+        }
+    }
+}
+
+
+bool
+isValidClassConstantName(std::string_view name) {
+    if (!name.empty() && (name[0] == '[')) {
+        return isValidFieldDescriptor(name);
+    }
+    return isValidBinaryClassName(name);
+}
+
+
+bool
+isValidFieldDescriptor(std::string_view descriptor) {
+    size_t slots = 0;
+    return parseFieldType(descriptor, 0, slots) == descriptor.size();
+}
+
+
+bool
+isValidMethodDescriptor(std::string_view descriptor) {
+    if (descriptor.empty() || (descriptor[0] != '(')) {
+        return false;
+    }
+
+    size_t pos = 1;
+    size_t parameterSlots = 0;
+    while ((pos < descriptor.size()) && (descriptor[pos] != ')')) {
+        size_t slots = 0;
+        pos = parseFieldType(descriptor, pos, slots);
+        if (pos == invalidDescriptor) {
+            return false;
+        }
+        parameterSlots += slots;
+    }
+    if ((pos >= descriptor.size()) || (parameterSlots > maxParameterSlots)) {
+        return false;
+    }
+
+    pos++;
+    if ((pos + 1 == descriptor.size()) && (descriptor[pos] == 'V')) {
+        return true;
+    }
+    size_t slots = 0;
+    return parseFieldType(descriptor, pos, slots) == descriptor.size();
+}
+
+
+bool
+methodDescriptorReturnsVoid(std::string_view descriptor) {
+    return !descriptor.empty() && (descriptor.back() == 'V') &&
+           (descriptor.size() >= 2) && (descriptor[descriptor.size() - 2] == ')');
+}
+
+
+DescriptorKind
+parseDescriptor(std::string_view descriptor, std::vector<DescriptorType> &types, uint16_t &parameterSlots) {
+    types.clear();
+    parameterSlots = 0;
+    // Utf8 constants are at most 65535 bytes, so name offsets fit
+    if (descriptor.empty() || (descriptor.size() > UINT16_MAX)) {
+        return DescriptorKind::Invalid;
+    }
+
+    size_t slots = 0;
+    DescriptorType type;
+    if (descriptor[0] != '(') {
+        if (parseFieldType(descriptor, 0, slots, &type) != descriptor.size()) {
+            return DescriptorKind::Invalid;
+        }
+        types.push_back(type);
+        return DescriptorKind::Field;
+    }
+
+    size_t pos = 1;
+    size_t totalSlots = 0;
+    while ((pos < descriptor.size()) && (descriptor[pos] != ')')) {
+        pos = parseFieldType(descriptor, pos, slots, &type);
+        if (pos == invalidDescriptor) {
+            types.clear();
+            return DescriptorKind::Invalid;
+        }
+        types.push_back(type);
+        totalSlots += slots;
+    }
+    if ((pos >= descriptor.size()) || (totalSlots > maxParameterSlots)) {
+        types.clear();
+        return DescriptorKind::Invalid;
+    }
+
+    pos++;
+    if ((pos + 1 == descriptor.size()) && (descriptor[pos] == 'V')) {
+        types.push_back(DescriptorType{ BaseType::Void });
+    } else if (parseFieldType(descriptor, pos, slots, &type) == descriptor.size()) {
+        types.push_back(type);
+    } else {
+        types.clear();
+        return DescriptorKind::Invalid;
+    }
+    parameterSlots = (uint16_t)totalSlots;
+    return DescriptorKind::Method;
+}
@@ -0,0 +1,96 @@
+#ifndef SJBCDC_DESCRIPTOR_HPP
+#define SJBCDC_DESCRIPTOR_HPP
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/*
+ * Name and descriptor grammar of JVMS 4.2 and 4.3. Names are checked on the
+ * raw modified UTF-8 bytes; every byte of a multi-byte character is >= 0x80,
+ * so it never matches one of the ASCII characters the grammar forbids.
+ */
+
+// JVMS 4.2.2: non-empty, none of '.', ';', '[' or '/'
+bool
+isValidUnqualifiedName(std::string_view name);
+
+// unqualified name without '<' and '>', or exactly <init> / <clinit>
+bool
+isValidMethodName(std::string_view name);
+
+// JVMS 4.2.1 internal form: unqualified names separated by '/'
+bool
+isValidBinaryClassName(std::string_view name);
+
+// name of a CONSTANT_Class: a binary class name or an array type descriptor
+bool
+isValidClassConstantName(std::string_view name);
+
+// JVMS 4.3.2, at most 255 array dimensions
+bool
+isValidFieldDescriptor(std::string_view descriptor);
+
+// JVMS 4.3.3, parameters taking at most 255 local variable slots
+bool
+isValidMethodDescriptor(std::string_view descriptor);
+
+// whether a valid method descriptor returns void
+bool
+methodDescriptorReturnsVoid(std::string_view descriptor);
+
+enum class DescriptorKind : uint8_t {
+    Invalid,
+    Field,
+    Method
+};
+
+// the descriptor characters of JVMS table 4.3-A, and V for a void return
+enum class BaseType : uint8_t {
+    Byte = 'B',
+    Char = 'C',
+    Double = 'D',
+    Float = 'F',
+    Int = 'I',
+    Long = 'J',
+    Short = 'S',
+    Boolean = 'Z',
+    Object = 'L',
+    Void = 'V'
+};
+
+/*
+ * One FieldType (or a void return type) of a descriptor. For arrays base is
+ * the element type; the class name of an Object type is kept as its
+ * position in the descriptor text.
+ */
+struct DescriptorType {
+    BaseType base = BaseType::Void;
+    uint8_t dimensions = 0;
+    uint16_t nameOffset = 0;
+    uint16_t nameLength = 0;
+
+    bool
+    isReference() const { return (dimensions != 0) || (base == BaseType::Object); }
+
+    // local variable / operand stack slots: 2 for long and double, 0 for void
+    uint8_t
+    slots() const {
+        if (dimensions != 0) {
+            return 1;
+        }
+        return ((base == BaseType::Long) || (base == BaseType::Double)) ? 2 : (base == BaseType::Void) ? 0 : 1;
+    }
+};
+
+/*
+ * Parses a field or method descriptor into types; a method gets its
+ * parameters followed by the return type. Validates exactly like
+ * isValidFieldDescriptor/isValidMethodDescriptor; types is left empty for
+ * an Invalid descriptor. parameterSlots is the sum of the parameter slots.
+ */
+DescriptorKind
+parseDescriptor(std::string_view descriptor, std::vector<DescriptorType> &types, uint16_t &parameterSlots);
+
+#endif //SJBCDC_DESCRIPTOR_HPP
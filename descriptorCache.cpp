@@ -0,0 +1,70 @@
+#include "descriptorCache.hpp"
+#include <atomic>
+
+
+// slots of the per-thread table in front of the shards
+constexpr static size_t
+recentSlots = 512;
+
+static std::atomic<uint64_t> nextCacheId{1};
+
+
+DescriptorCache::DescriptorCache() : m_id(nextCacheId.fetch_add(1, std::memory_order_relaxed)) {}
+
+
+DescriptorCache &
+DescriptorCache::global() {
+    static DescriptorCache cache;
+    return cache;
+}
+
+
+const ParsedDescriptor *
+DescriptorCache::lookupShared(std::string_view descriptor, size_t hash) {
+    Shard &shard = m_shards[hash & (shardCount - 1)];
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.entries.find(descriptor);
+    if (it != shard.entries.end()) {
+        return &it->second;
+    }
+
+    // parsed under the lock, so every descriptor is parsed exactly once
+    it = shard.entries.emplace(std::string(descriptor), ParsedDescriptor{}).first;
+    ParsedDescriptor &entry = it->second;
+    entry.text = it->first;
+    entry.kind = parseDescriptor(entry.text, entry.types, entry.parameterSlots);
+    entry.types.shrink_to_fit();
+    return &entry;
+}
+
+
+const ParsedDescriptor *
+DescriptorCache::get(std::string_view descriptor) {
+    struct RecentEntry {
+        uint64_t cacheId = 0;
+        const ParsedDescriptor *entry = nullptr;
+    };
+    // an entry is only looked at when it belongs to this cache, so ones of destroyed caches are never followed
+    thread_local std::array<RecentEntry, recentSlots> recent{};
+
+    size_t hash = TransparentHash{}(descriptor);
+    RecentEntry &slot = recent[(hash >> shardBits) % recentSlots];
+    if ((slot.cacheId == m_id) && (slot.entry->text == descriptor)) {
+        return slot.entry;
+    }
+
+    const ParsedDescriptor *entry = lookupShared(descriptor, hash);
+    slot = RecentEntry{ m_id, entry };
+    return entry;
+}
+
+
+size_t
+DescriptorCache::size() {
+    size_t total = 0;
+    for (auto &shard : m_shards) {
+        std::lock_guard lock(shard.mutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
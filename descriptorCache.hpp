@@ -0,0 +1,98 @@
+#ifndef SJBCDC_DESCRIPTORCACHE_HPP
+#define SJBCDC_DESCRIPTORCACHE_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "descriptor.hpp"
+
+/*
+ * A descriptor parsed once by parseDescriptor(); text is the descriptor
+ * itself, kept by the DescriptorCache
+ */
+struct ParsedDescriptor {
+    std::string_view text;
+    DescriptorKind kind = DescriptorKind::Invalid;
+    uint16_t parameterSlots = 0;
+    std::vector<DescriptorType> types;
+
+    // empty for a field descriptor
+    std::span<const DescriptorType>
+    parameters() const {
+        return (kind == DescriptorKind::Method) ? std::span(types).first(types.size() - 1)
+                                                : std::span<const DescriptorType>();
+    }
+
+    // the return type of a method, the type of a field
+    const DescriptorType &
+    returnType() const { return types.back(); }
+
+    bool
+    returnsVoid() const { return (kind == DescriptorKind::Method) && (types.back().base == BaseType::Void); }
+
+    // internal form class name of an Object type (of the array element for arrays), empty otherwise
+    std::string_view
+    className(const DescriptorType &type) const {
+        return (type.base == BaseType::Object) ? text.substr(type.nameOffset, type.nameLength) : std::string_view();
+    }
+};
+
+/*
+ * Every distinct descriptor string parsed once and shared by all classes
+ * (invalid ones included), so verification, argument counting and
+ * signature queries never parse the same descriptor twice. Entries are
+ * never removed and never move.
+ *
+ * Like SymbolTable the table is split into shards with a lock each; in
+ * front of them every thread keeps a small direct-mapped table of the
+ * entries it looked up last, which answers most lookups without a lock.
+ */
+class DescriptorCache {
+private:
+    static constexpr uint32_t shardBits = 4;
+    static constexpr uint32_t shardCount = 1u << shardBits;
+
+    struct TransparentHash {
+        using is_transparent = void;
+
+        size_t
+        operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, ParsedDescriptor, TransparentHash, std::equal_to<>> entries;
+    };
+
+    std::array<Shard, shardCount> m_shards;
+    // tells the per-thread tables of different caches apart
+    uint64_t m_id;
+
+    const ParsedDescriptor *
+    lookupShared(std::string_view descriptor, size_t hash);
+
+public:
+    DescriptorCache();
+    DescriptorCache(const DescriptorCache &) = delete;
+    DescriptorCache &operator=(const DescriptorCache &) = delete;
+
+    // the process-wide cache used unless ClassFileOptions::descriptorCache says otherwise
+    static DescriptorCache &
+    global();
+
+    // never nullptr; kind is Invalid for a malformed descriptor
+    const ParsedDescriptor *
+    get(std::string_view descriptor);
+
+    size_t
+    size();
+};
+
+#endif //SJBCDC_DESCRIPTORCACHE_HPP
@@ -0,0 +1,225 @@
+#include "fingerprint.hpp"
+#include "classFileRead.hpp"
+#include "bytecode.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <tuple>
+
+
+constexpr static uint16_t
+accPrivate = 0x0002;
+
+// deeper than any well-formed chain of references (MethodHandle -> Methodref -> NameAndType -> Utf8)
+constexpr static size_t
+maxConstantDepth = 8;
+
+
+/*
+ * Folds one word into a running hash (an xxh64 round), finished with
+ * avalanche(); far cheaper than a whole xxh64 call for the few words of a
+ * constant
+ */
+static inline uint64_t
+mixWord(uint64_t hash, uint64_t word) {
+    hash ^= std::rotl(word * 0xc2b2ae3d27d4eb4fULL, 31) * 0x9e3779b185ebca87ULL;
+    return std::rotl(hash, 27) * 0x9e3779b185ebca87ULL + 0x85ebca77c2b2ae63ULL;
+}
+
+
+static inline uint64_t
+avalanche(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xc2b2ae3d27d4eb4fULL;
+    hash ^= hash >> 29;
+    hash *= 0x165667b19e3779f9ULL;
+    return hash ^ (hash >> 32);
+}
+
+
+static uint64_t
+hashWords(const std::vector<uint64_t> &words, uint64_t seed = 0) {
+    return xxh64({ reinterpret_cast<const uint8_t *>(words.data()), words.size() * sizeof(uint64_t) }, seed);
+}
+
+
+/*
+ * Hash of a constant by what it says rather than where it is: a Utf8 by its
+ * text, any other constant by its tag, its plain fields and the hashes of
+ * the constants its index fields (ConstantLayout::indexFields) refer to.
+ * Memoized per constant pool index for one class.
+ */
+class ConstantHasher {
+private:
+    const ClassFile &m_classFile;
+    std::vector<uint64_t> m_hashes;     // 0 until computed
+
+    template <uint8_t Tag>
+    uint64_t
+    hashFixedSize(size_t idxInType, size_t depth) {
+        using Layout = ConstantLayout<Tag>;
+        // a copy: with lazyConstantPool, hashing what it refers to decodes constants into the same table
+        const auto constant = (m_classFile.constants().*Layout::storage)[idxInType];
+        uint64_t result = Tag;
+        std::apply([&](auto... fields) {
+            size_t fieldNum = 0;
+            auto hashField = [&](auto field) {
+                uint64_t value = constant.*field;
+                result = mixWord(result, (Layout::indexFields & (1u << fieldNum)) ? hash(value, depth + 1) : value);
+                fieldNum++;
+            };
+            (hashField(fields), ...);
+        }, Layout::fields);
+        return avalanche(result);
+    }
+
+    template <uint8_t... Tags>
+    uint64_t
+    hashFixedSize(ConstantTagList<Tags...>, uint8_t tag, size_t idxInType, size_t depth) {
+        uint64_t result = tag;
+        (void)((tag == Tags && ((result = hashFixedSize<Tags>(idxInType, depth)), true)) || ...);
+        return result;
+    }
+
+public:
+    explicit ConstantHasher(const ClassFile &classFile)
+        : m_classFile(classFile), m_hashes(classFile.constantPoolCount(), 0) {}
+
+    // 0 for index 0, a small value for unusable indices
+    uint64_t
+    hash(size_t cpIdx, size_t depth = 0) {
+        if ((cpIdx == 0) || (cpIdx >= m_hashes.size())) {
+            return 0;
+        }
+        if (m_hashes[cpIdx] != 0) {
+            return m_hashes[cpIdx];
+        }
+        uint8_t tag = m_classFile.constantTag(cpIdx);
+        auto ref = m_classFile.constant(cpIdx);
+        // a reference cycle is only possible in classes parsed with VerifyLevel::None
+        if (!ref || (depth > maxConstantDepth)) {
+            return tag + 1;
+        }
+        const ClassFileConstants &constants = m_classFile.constants();
+        uint64_t result = (tag == CONSTANT_Utf8)
+                          ? xxh64(constants.utf8View(constants.utf8Consts[ref->idxInType]), CONSTANT_Utf8)
+                          : hashFixedSize(FixedSizeConstantTags{}, tag, ref->idxInType, depth);
+        m_hashes[cpIdx] = result;
+        return result;
+    }
+};
+
+
+// hash of the constant the u2 index at the start of an attribute refers to, 0 when there is no such attribute
+static uint64_t
+attributeIndexHash(const ClassFile &classFile, ConstantHasher &hasher, std::span<const AttributeInfo> attributes,
+                   AttributeKind kind) {
+    const AttributeInfo *attribute = ClassFile::findAttribute(attributes, kind);
+    if ((attribute == nullptr) || (attribute->length < 2)) {
+        return 0;
+    }
+    auto bytes = classFile.attributeBytes(*attribute);
+    return hasher.hash(Instruction::u2(bytes.data()));
+}
+
+
+static uint64_t
+apiFingerprint(const ClassFile &classFile, ConstantHasher &hasher) {
+    std::vector<uint64_t> memberHashes;
+    std::vector<uint64_t> words;
+    auto addMembers = [&](std::span<const MemberInfo> members, uint64_t kind) {
+        for (auto &member : members) {
+            if (member.accessFlags & accPrivate) {
+                continue;
+            }
+            auto attributes = classFile.attributes(member);
+            words = { kind, member.accessFlags, hasher.hash(member.nameIndex), hasher.hash(member.descriptorIndex),
+                      attributeIndexHash(classFile, hasher, attributes, AttributeKind::Signature),
+                      attributeIndexHash(classFile, hasher, attributes, AttributeKind::ConstantValue) };
+            memberHashes.push_back(hashWords(words));
+        }
+    };
+    addMembers(classFile.fields(), 0);
+    addMembers(classFile.methods(), 1);
+    // javac may emit members in any order, which no user of the class can tell
+    std::sort(memberHashes.begin(), memberHashes.end());
+
+    words = { classFile.accessFlags(), hasher.hash(classFile.thisClass()), hasher.hash(classFile.superClass()),
+              attributeIndexHash(classFile, hasher, classFile.classAttributes(), AttributeKind::Signature),
+              classFile.interfaces().size() };
+    for (uint16_t interface : classFile.interfaces()) {
+        words.push_back(hasher.hash(interface));
+    }
+    words.insert(words.end(), memberHashes.begin(), memberHashes.end());
+    return hashWords(words);
+}
+
+
+/*
+ * The code is hashed as a copy with every constant pool operand zeroed; the
+ * hashes of the constants those operands refer to are folded in separately,
+ * in code order. Code that does not decode is hashed as it is.
+ */
+static uint64_t
+methodFingerprint(const ClassFile &classFile, ConstantHasher &hasher, const MemberInfo &method,
+                  std::vector<uint8_t> &normalized) {
+    auto code = classFile.code(method);
+    if (!code) {
+        return 0;
+    }
+
+    normalized.assign(code->code.begin(), code->code.end());
+    uint64_t operands = 0;
+    BytecodeIterator iterator(code->code);
+    Instruction insn{};
+    while (iterator.next(insn)) {
+        switch (insn.format) {
+            case OperandFormat::ConstPoolU1: {
+                normalized[insn.pc + 1] = 0;
+                break;
+            }
+            case OperandFormat::ConstPoolU2:
+            case OperandFormat::InvokeInterface:
+            case OperandFormat::InvokeDynamic:
+            case OperandFormat::MultiANewArray: {
+                normalized[insn.pc + 1] = 0;
+                normalized[insn.pc + 2] = 0;
+                break;
+            }
+            default: {
+                continue;
+            }
+        }
+        operands = mixWord(operands, hasher.hash(insn.cpIndex()));
+    }
+    if (iterator.error()) {
+        normalized.assign(code->code.begin(), code->code.end());
+        operands = 0;
+    }
+
+    uint64_t result = mixWord(xxh64(normalized), ((uint64_t)code->maxStack << 16) | code->maxLocals);
+    result = mixWord(result, operands);
+    for (size_t i = 0; i < code->exceptionTableLength; i++) {
+        ExceptionTableEntry entry = code->exceptionTableEntry(i);
+        result = mixWord(result, ((uint64_t)entry.startPc << 32) | ((uint64_t)entry.endPc << 16) | entry.handlerPc);
+        result = mixWord(result, hasher.hash(entry.catchType));
+    }
+    return avalanche(result);
+}
+
+
+void
+computeClassFingerprints(const ClassFile &classFile, ClassFingerprints &fingerprints,
+                         std::optional<uint64_t> fileHash) {
+    ConstantHasher hasher(classFile);
+    fingerprints.file = fileHash ? *fileHash : xxh64(classFile.classBytes());
+    fingerprints.api = apiFingerprint(classFile, hasher);
+
+    std::vector<uint8_t> normalized;
+    fingerprints.methods.clear();
+    fingerprints.methods.reserve(classFile.methods().size());
+    for (auto &method : classFile.methods()) {
+        fingerprints.methods.push_back(methodFingerprint(classFile, hasher, method, normalized));
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef SJBCDC_FINGERPRINT_HPP
+#define SJBCDC_FINGERPRINT_HPP
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+class ClassFile;
+
+/*
+ * Content hashes (xxh64) of a class for incremental builds, so a step can
+ * tell which kind of change it is looking at:
+ *
+ *   file      every byte of the class file
+ *   api       what other classes compile against: the class access flags,
+ *             this/super class and interface names, and the access flags,
+ *             name, descriptor, Signature and ConstantValue of every
+ *             non-private field and method, in any member order
+ *   methods   one per method: max_stack, max_locals, the code and the
+ *             exception table, 0 without a Code attribute
+ *
+ * Constant pool indices never enter api or methods: every index is replaced
+ * by a hash of the constant it refers to, so renumbering the constant pool,
+ * editing a LineNumberTable or LocalVariableTable, or changing a private
+ * member only changes file (and the bodies it touches). Attributes left out
+ * by ClassFileOptions::attributeMask do not count.
+ */
+struct ClassFingerprints {
+    explicit ClassFingerprints(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : methods(resource) {}
+
+    uint64_t file = 0;
+    uint64_t api = 0;
+    std::pmr::vector<uint64_t> methods;     // same order as ClassFile::methods()
+};
+
+/*
+ * Fingerprints of a successfully parsed class; fileHash is xxh64 of its
+ * bytes when that is known already. Lazily parsed constants referred to are
+ * decoded on the way.
+ */
+void
+computeClassFingerprints(const ClassFile &classFile, ClassFingerprints &fingerprints,
+                         std::optional<uint64_t> fileHash = std::nullopt);
+
+#endif //SJBCDC_FINGERPRINT_HPP
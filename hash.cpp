@@ -0,0 +1,103 @@
+#include "hash.hpp"
+#include <bit>
+#include <cstring>
+
+
+constexpr static uint64_t prime1 = 0x9e3779b185ebca87ULL;
+constexpr static uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr static uint64_t prime3 = 0x165667b19e3779f9ULL;
+constexpr static uint64_t prime4 = 0x85ebca77c2b2ae63ULL;
+constexpr static uint64_t prime5 = 0x27d4eb2f165667c5ULL;
+
+
+static inline uint64_t
+readLE64(const uint8_t *ptr) {
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = std::byteswap(value);
+    }
+    return value;
+}
+
+
+static inline uint32_t
+readLE32(const uint8_t *ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = std::byteswap(value);
+    }
+    return value;
+}
+
+
+static inline uint64_t
+round(uint64_t acc, uint64_t input) {
+    acc += input * prime2;
+    acc = std::rotl(acc, 31);
+    return acc * prime1;
+}
+
+
+static inline uint64_t
+mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * prime1 + prime4;
+}
+
+
+uint64_t
+xxh64(std::span<const uint8_t> bytes, uint64_t seed) {
+    const uint8_t *ptr = bytes.data();
+    const uint8_t *end = ptr + bytes.size();
+    uint64_t h;
+
+    if (bytes.size() >= 32) {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        const uint8_t *limit = end - 32;
+        do {
+            v1 = round(v1, readLE64(ptr));
+            v2 = round(v2, readLE64(ptr + 8));
+            v3 = round(v3, readLE64(ptr + 16));
+            v4 = round(v4, readLE64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + prime5;
+    }
+
+    h += bytes.size();
+
+    while (ptr + 8 <= end) {
+        h ^= round(0, readLE64(ptr));
+        h = std::rotl(h, 27) * prime1 + prime4;
+        ptr += 8;
+    }
+    if (ptr + 4 <= end) {
+        h ^= (uint64_t)readLE32(ptr) * prime1;
+        h = std::rotl(h, 23) * prime2 + prime3;
+        ptr += 4;
+    }
+    while (ptr < end) {
+        h ^= (*ptr) * prime5;
+        h = std::rotl(h, 11) * prime1;
+        ptr++;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,20 @@
+#ifndef SJBCDC_HASH_HPP
+#define SJBCDC_HASH_HPP
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/*
+ * XXH64 (same output as the reference xxHash implementation). Used as the
+ * content key of cached classes and for fingerprints, not for security.
+ */
+uint64_t
+xxh64(std::span<const uint8_t> bytes, uint64_t seed = 0);
+
+inline uint64_t
+xxh64(std::string_view bytes, uint64_t seed = 0) {
+    return xxh64({ reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size() }, seed);
+}
+
+#endif //SJBCDC_HASH_HPP
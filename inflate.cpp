@@ -0,0 +1,408 @@
+#include "inflate.hpp"
+#include <array>
+#include <cstring>
+
+
+namespace {
+
+constexpr int maxCodeBits = 15;
+constexpr int fastBits = 10;
+
+/*
+ * Canonical Huffman table. Codes up to fastBits long resolve with one lookup
+ * in fast (symbol << 4 | length, bit-reversed index); longer ones fall back
+ * to the count/symbol walk from zlib's puff.
+ */
+struct Huffman {
+    std::array<uint16_t, maxCodeBits + 1> count{};
+    std::array<uint16_t, 288> symbol{};
+    std::array<uint16_t, 1 << fastBits> fast{};
+
+    bool
+    build(const uint8_t *lengths, int n) {
+        count.fill(0);
+        fast.fill(0);
+        for (int s = 0; s < n; s++) {
+            count[lengths[s]]++;
+        }
+        if (count[0] == n) {
+            // no codes at all: valid for a distance table of a literal-only block
+            return true;
+        }
+
+        int left = 1;
+        for (int len = 1; len <= maxCodeBits; len++) {
+            left <<= 1;
+            left -= count[len];
+            if (left < 0) {
+                return false;
+            }
+        }
+
+        std::array<uint16_t, maxCodeBits + 1> offs{};
+        for (int len = 1; len < maxCodeBits; len++) {
+            offs[len + 1] = offs[len] + count[len];
+        }
+        for (int s = 0; s < n; s++) {
+            if (lengths[s] != 0) {
+                symbol[offs[lengths[s]]++] = (uint16_t)s;
+            }
+        }
+
+        // canonical codes, reversed into the LSB-first order the bits arrive in
+        std::array<uint32_t, maxCodeBits + 1> nextCode{};
+        uint32_t code = 0;
+        for (int len = 1; len <= maxCodeBits; len++) {
+            code = (code + (len > 1 ? count[len - 1] : 0)) << 1;
+            nextCode[len] = code;
+        }
+        for (int s = 0; s < n; s++) {
+            int len = lengths[s];
+            if (len == 0) {
+                continue;
+            }
+            uint32_t c = nextCode[len]++;
+            if (len > fastBits) {
+                continue;
+            }
+            uint32_t reversed = 0;
+            for (int b = 0; b < len; b++) {
+                reversed |= ((c >> b) & 1) << (len - 1 - b);
+            }
+            for (uint32_t fill = reversed; fill < (1u << fastBits); fill += (1u << len)) {
+                fast[fill] = (uint16_t)((s << 4) | len);
+            }
+        }
+        return true;
+    }
+};
+
+
+class BitReader {
+private:
+    const uint8_t *m_src;
+    size_t m_size;
+    size_t m_pos = 0;
+    uint64_t m_bits = 0;
+    int m_count = 0;
+
+public:
+    explicit BitReader(std::span<const uint8_t> src) : m_src(src.data()), m_size(src.size()) {}
+
+    void
+    refill() {
+        if (m_pos + 8 <= m_size) {
+            // branch-free refill to 56+ bits from one unaligned little-endian load
+            uint64_t word;
+            std::memcpy(&word, m_src + m_pos, sizeof(word));
+            m_bits |= word << m_count;
+            m_pos += (63 - m_count) >> 3;
+            m_count |= 56;
+            return;
+        }
+        while (m_count <= 56) {
+            uint64_t byte = 0;
+            if (m_pos < m_size) {
+                byte = m_src[m_pos];
+            }
+            m_pos++;
+            m_bits |= byte << m_count;
+            m_count += 8;
+        }
+    }
+
+    uint32_t
+    peek(int n) {
+        if (m_count < n) {
+            refill();
+        }
+        return (uint32_t)(m_bits & ((1ull << n) - 1));
+    }
+
+    void
+    consume(int n) {
+        m_bits >>= n;
+        m_count -= n;
+    }
+
+    uint32_t
+    bits(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        uint32_t value = peek(n);
+        consume(n);
+        return value;
+    }
+
+    void
+    alignToByte() {
+        consume(m_count & 7);
+    }
+
+    // stored block payload; only valid right after alignToByte
+    bool
+    copyBytes(uint8_t *dst, size_t n) {
+        while ((n > 0) && (m_count >= 8)) {
+            *dst++ = (uint8_t)m_bits;
+            consume(8);
+            n--;
+        }
+        if (n == 0) {
+            return true;
+        }
+        // the bit buffer is empty now, so m_pos is the next unread source byte;
+        // drop the look-ahead bits refill() may have left above m_count
+        m_bits = 0;
+        if (m_pos + n > m_size) {
+            return false;
+        }
+        std::memcpy(dst, m_src + m_pos, n);
+        m_pos += n;
+        return true;
+    }
+
+    // true when more bytes were consumed than the stream holds
+    bool
+    exhausted() const { return m_pos > m_size + (size_t)(m_count / 8); }
+};
+
+
+int
+decodeSymbol(BitReader &in, const Huffman &h) {
+    uint32_t look = in.peek(maxCodeBits);
+    uint16_t entry = h.fast[look & ((1u << fastBits) - 1)];
+    if (entry != 0) {
+        in.consume(entry & 0xf);
+        return entry >> 4;
+    }
+
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len <= maxCodeBits; len++) {
+        code |= (int)((look >> (len - 1)) & 1);
+        int count = h.count[len];
+        if (code - count < first) {
+            in.consume(len);
+            return h.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+
+constexpr uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr uint16_t distBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr uint8_t distExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+
+bool
+inflateCodes(BitReader &in, const Huffman &litLen, const Huffman &dist, std::span<uint8_t> out, size_t &outPos) {
+    while (true) {
+        int sym = decodeSymbol(in, litLen);
+        if ((sym < 0) || in.exhausted()) {
+            return false;
+        }
+        if (sym < 256) {
+            if (outPos >= out.size()) {
+                return false;
+            }
+            out[outPos++] = (uint8_t)sym;
+            continue;
+        }
+        if (sym == 256) {
+            return true;
+        }
+
+        sym -= 257;
+        if (sym >= 29) {
+            return false;
+        }
+        size_t len = lengthBase[sym] + in.bits(lengthExtra[sym]);
+
+        int distSym = decodeSymbol(in, dist);
+        if ((distSym < 0) || (distSym >= 30)) {
+            return false;
+        }
+        size_t distance = distBase[distSym] + in.bits(distExtra[distSym]);
+        if ((distance > outPos) || (len > out.size() - outPos)) {
+            return false;
+        }
+
+        uint8_t *dst = out.data() + outPos;
+        const uint8_t *from = dst - distance;
+        if (distance >= len) {
+            std::memcpy(dst, from, len);
+        } else {
+            // overlapping copy repeats the last `distance` bytes
+            for (size_t i = 0; i < len; i++) {
+                dst[i] = from[i];
+            }
+        }
+        outPos += len;
+    }
+}
+
+
+const std::pair<Huffman, Huffman> &
+fixedTables() {
+    static const auto tables = [] {
+        std::pair<Huffman, Huffman> t;
+        uint8_t lengths[288];
+        int s = 0;
+        for (; s < 144; s++) lengths[s] = 8;
+        for (; s < 256; s++) lengths[s] = 9;
+        for (; s < 280; s++) lengths[s] = 7;
+        for (; s < 288; s++) lengths[s] = 8;
+        t.first.build(lengths, 288);
+        for (s = 0; s < 30; s++) lengths[s] = 5;
+        t.second.build(lengths, 30);
+        return t;
+    }();
+    return tables;
+}
+
+
+bool
+readDynamicTables(BitReader &in, Huffman &litLen, Huffman &dist) {
+    constexpr uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    int nlen = (int)in.bits(5) + 257;
+    int ndist = (int)in.bits(5) + 1;
+    int ncode = (int)in.bits(4) + 4;
+    if ((nlen > 286) || (ndist > 30)) {
+        return false;
+    }
+
+    uint8_t lengths[320] = {};
+    for (int i = 0; i < ncode; i++) {
+        lengths[order[i]] = (uint8_t)in.bits(3);
+    }
+    Huffman codeLen;
+    if (!codeLen.build(lengths, 19)) {
+        return false;
+    }
+
+    int i = 0;
+    while (i < nlen + ndist) {
+        int sym = decodeSymbol(in, codeLen);
+        if (sym < 0) {
+            return false;
+        }
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+
+        uint8_t value = 0;
+        int repeat;
+        if (sym == 16) {
+            if (i == 0) {
+                return false;
+            }
+            value = lengths[i - 1];
+            repeat = 3 + (int)in.bits(2);
+        } else if (sym == 17) {
+            repeat = 3 + (int)in.bits(3);
+        } else {
+            repeat = 11 + (int)in.bits(7);
+        }
+        if (i + repeat > nlen + ndist) {
+            return false;
+        }
+        while (repeat--) {
+            lengths[i++] = value;
+        }
+    }
+
+    // end-of-block must be codable
+    if (lengths[256] == 0) {
+        return false;
+    }
+    return litLen.build(lengths, nlen) && dist.build(lengths + nlen, ndist) && !in.exhausted();
+}
+
+} // namespace
+
+
+bool
+inflateRaw(std::span<const uint8_t> src, std::span<uint8_t> out) {
+    BitReader in(src);
+    size_t outPos = 0;
+    Huffman litLen;
+    Huffman dist;
+
+    bool last;
+    do {
+        last = in.bits(1);
+        uint32_t type = in.bits(2);
+
+        if (type == 0) {
+            in.alignToByte();
+            uint32_t len = in.bits(16);
+            uint32_t nlen = in.bits(16);
+            if ((len != (~nlen & 0xffff)) || (len > out.size() - outPos)) {
+                return false;
+            }
+            if (!in.copyBytes(out.data() + outPos, len)) {
+                return false;
+            }
+            outPos += len;
+        } else if (type == 1) {
+            auto &fixed = fixedTables();
+            if (!inflateCodes(in, fixed.first, fixed.second, out, outPos)) {
+                return false;
+            }
+        } else if (type == 2) {
+            if (!readDynamicTables(in, litLen, dist) || !inflateCodes(in, litLen, dist, out, outPos)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+
+        if (in.exhausted()) {
+            return false;
+        }
+    } while (!last);
+
+    return outPos == out.size();
+}
+
+
+static constexpr auto
+crcTable = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+        }
+        table[n] = c;
+    }
+    return table;
+}();
+
+
+uint32_t
+crc32(std::span<const uint8_t> bytes, uint32_t crc) {
+    crc = ~crc;
+    for (uint8_t byte : bytes) {
+        crc = crcTable[(crc ^ byte) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,20 @@
+#ifndef SJBCDC_INFLATE_HPP
+#define SJBCDC_INFLATE_HPP
+
+#include <cstdint>
+#include <span>
+
+/*
+ * Raw DEFLATE (RFC 1951) decoder, no zlib/gzip framing. Decodes src into out,
+ * which must be exactly as large as the expected uncompressed data (ZIP
+ * entries always record it). Returns false on malformed input, on output
+ * overflow and when the stream ends short of out.size().
+ */
+bool
+inflateRaw(std::span<const uint8_t> src, std::span<uint8_t> out);
+
+// CRC-32 (IEEE 802.3, as used by ZIP)
+uint32_t
+crc32(std::span<const uint8_t> bytes, uint32_t crc = 0);
+
+#endif //SJBCDC_INFLATE_HPP
@@ -1,10 +1,342 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <unistd.h>
 #include "classFileRead.hpp"
+#include "classFileStream.hpp"
+#include "classFileWrite.hpp"
+#include "batchParse.hpp"
+#include "bytecodeVerifier.hpp"
+#include "classCache.hpp"
+#include "classHierarchy.hpp"
+#include "crossReferenceIndex.hpp"
+#include "parseStats.hpp"
 
-int main() {
+static void
+usage(const char *argv0) {
+    std::cerr << "usage: " << argv0 << " [file.class...]\n"
+              << "       " << argv0 << " --batch <dir|file.class|archive.jar|@list> [-j threads] [--intern]\n"
+              << "               [--cache dir] [--stats | --stats-json] [--xref index] [--async]\n"
+              << "               [--verify]\n"
+              << "       " << argv0 << " --xref-query <index> <key|prefix*>...\n"
+              << "       " << argv0 << " --stream   (one class file from stdin, parsed while it arrives)\n"
+              << "       " << argv0 << " --roundtrip <file.class...>   (write back, compare, edit, reparse)\n"
+              << "       " << argv0 << " --fingerprint <file.class...>"
+              << std::endl;
+}
+
+static int
+parseSingle(std::string path) {
     ClassFile clf;
-    std::string path("../ArithmeticAlgo.class");
-    clf.init(path);
+    clf.init(path, ClassFileOptions{ .loadMode = ClassFileLoadMode::Mmap,
+                                     .utf8Storage = Utf8Storage::View });
+    if (!clf.initResult().empty()) {
+        std::cerr << clf.initResult() << std::endl;
+        return 1;
+    }
 
     return 0;
 }
+
+static int
+roundTrip(std::string path) {
+    ClassFile clf;
+    clf.init(path, ClassFileOptions{ .loadMode = ClassFileLoadMode::Mmap,
+                                     .utf8Storage = Utf8Storage::View });
+    if (!clf.initResult().empty()) {
+        std::cerr << clf.initResult() << std::endl;
+        return 1;
+    }
+
+    /*
+     * Once without edits and once with every Utf8 replaced by its own text,
+     * so the constant pool is also written constant by constant
+     */
+    ClassFileEdits sameText(clf);
+    for (size_t cpIdx = 1; cpIdx < clf.constantPoolCount(); cpIdx++) {
+        if (clf.constantTag(cpIdx) == CONSTANT_Utf8) {
+            sameText.replaceUtf8((uint16_t)cpIdx, clf.utf8(cpIdx));
+        }
+    }
+    auto original = clf.classBytes();
+    std::vector<uint8_t> written;
+    for (const ClassFileEdits &edits : { ClassFileEdits(clf), sameText }) {
+        if (!writeClassFile(clf, edits, written)) {
+            std::cerr << path << ": cannot be written" << std::endl;
+            return 1;
+        }
+        auto mismatch = std::mismatch(original.begin(), original.end(), written.begin(), written.end());
+        if ((mismatch.first != original.end()) || (mismatch.second != written.end())) {
+            std::cerr << path << ": written bytes differ at offset " << (mismatch.first - original.begin())
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // then with the class renamed and a String appended, which has to parse again and show both
+    auto thisRef = clf.constant(clf.thisClass());
+    std::string renamed = std::string(clf.thisClassName()) + "$RoundTrip";
+    ClassFileEdits edits(clf);
+    edits.replaceUtf8(clf.constants().classConsts[thisRef->idxInType].nameIndex, renamed);
+    uint16_t stringIndex = edits.addString(edits.addUtf8("round trip"));
+    if ((stringIndex == 0) || !writeClassFile(clf, edits, written)) {
+        std::cerr << path << ": cannot be written with edits" << std::endl;
+        return 1;
+    }
+    ClassFile edited;
+    edited.init(written, path);
+    if (!edited.initResult().empty()) {
+        std::cerr << path << ": edited class does not parse: " << edited.initResult() << std::endl;
+        return 1;
+    }
+    if ((edited.thisClassName() != renamed) || (edited.constantPoolCount() != edits.constantPoolCount()) ||
+        (edited.constantTag(stringIndex) != CONSTANT_String)) {
+        std::cerr << path << ": edited class does not show the edits" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int
+printFingerprints(std::string path) {
+    ClassFile clf;
+    clf.init(path, ClassFileOptions{ .loadMode = ClassFileLoadMode::Mmap,
+                                     .utf8Storage = Utf8Storage::View,
+                                     .fingerprints = true });
+    if (!clf.initResult().empty()) {
+        std::cerr << clf.initResult() << std::endl;
+        return 1;
+    }
+
+    auto &fingerprints = clf.fingerprints();
+    std::cout << std::hex << path << ": file " << fingerprints.file << ", api " << fingerprints.api << "\n";
+    for (size_t i = 0; i < clf.methods().size(); i++) {
+        auto &method = clf.methods()[i];
+        std::cout << "    " << clf.utf8(method.nameIndex) << clf.utf8(method.descriptorIndex) << " "
+                  << fingerprints.methods[i] << "\n";
+    }
+    std::cout << std::dec;
+    return 0;
+}
+
+static int
+parseStream() {
+    ClassFileVisitor visitor;
+    ClassFileStreamParser parser(visitor);
+    std::array<uint8_t, 64 * 1024> chunk{};
+    StreamStatus status = StreamStatus::NeedMore;
+    while (status == StreamStatus::NeedMore) {
+        ssize_t n = read(STDIN_FILENO, chunk.data(), chunk.size());
+        if (n < 0) {
+            std::cerr << "<stdin>: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        if (n == 0) {
+            break;
+        }
+        status = parser.feed(std::span(chunk.data(), (size_t)n));
+    }
+    // a Done parser still has to see the end of the input: trailing bytes are an error
+    if (status != StreamStatus::Error) {
+        uint8_t extra;
+        if ((status == StreamStatus::Done) && (read(STDIN_FILENO, &extra, 1) == 1)) {
+            status = parser.feed(std::span(&extra, 1));
+        } else {
+            status = parser.finish();
+        }
+    }
+    if (status == StreamStatus::Error) {
+        std::cerr << formatClassFileError("<stdin>", parser.error()) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int
+parseBatch(const std::string &source, size_t threads, bool intern, ClassCache *cache, const char *stats,
+           const char *xref, bool async, bool verify) {
+    auto start = std::chrono::steady_clock::now();
+
+    BatchParseOptions options;
+    options.classFileOptions.loadMode = ClassFileLoadMode::Mmap;
+    options.classFileOptions.utf8Storage = intern ? Utf8Storage::Interned : Utf8Storage::View;
+    options.classFileOptions.classCache = cache;
+    options.threads = threads;
+    options.keepClassFiles = (xref != nullptr) || verify;
+    options.asyncLoad = async;
+
+    std::vector<BatchParseResult> results;
+    std::vector<std::filesystem::path> paths;
+    ZipArchive archive;
+    bool fromArchive = source.ends_with(".jar") || source.ends_with(".zip");
+    if (fromArchive) {
+        if (archive.open(source)) {
+            std::cerr << archive.openResult() << std::endl;
+            return 1;
+        }
+        results = parseArchiveClasses(archive, options);
+    } else {
+        paths = (source.starts_with("@")) ? readClassFileList(source.substr(1)) : collectClassFiles(source);
+        results = parseClassFiles(paths, options);
+    }
+
+    size_t errors = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        auto &result = results[i];
+        if (result.parseError) {
+            errors++;
+            std::string name = fromArchive ? archiveEntryPath(archive, *result.entry) : paths[i].string();
+            std::cerr << formatBatchResult(name, result) << std::endl;
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "parsed " << results.size() << " class files, " << errors << " errors, "
+              << elapsed.count() << " s" << std::endl;
+    if (cache != nullptr) {
+        std::cout << "cache: " << cache->hits() << " hits, " << cache->misses() << " misses" << std::endl;
+    }
+    if (intern) {
+        std::cout << SymbolTable::global().size() << " symbols, "
+                  << SymbolTable::global().memoryUsage() << " bytes" << std::endl;
+    }
+    std::vector<const ClassFile *> classes;
+    if ((xref != nullptr) || verify) {
+        classes.reserve(results.size());
+        for (auto &result : results) {
+            classes.push_back(result.classFile.get());
+        }
+    }
+    if (xref != nullptr) {
+        auto index = CrossReferenceIndex::build(classes, threads);
+        if (!index.save(xref)) {
+            std::cerr << xref << ": cannot write the index" << std::endl;
+            return 1;
+        }
+        std::cout << "xref: " << index.keyCount() << " keys, " << index.memoryUsage() << " bytes" << std::endl;
+    }
+    if (verify) {
+        // references to classes outside the batch are taken on trust
+        ClassHierarchy hierarchy;
+        for (const ClassFile *classFile : classes) {
+            if ((classFile != nullptr) && !classFile->parseError()) {
+                hierarchy.add(*classFile);
+            }
+        }
+        hierarchy.refresh();
+        auto verifyErrors = verifyClasses(classes, &hierarchy, threads);
+        size_t failed = 0;
+        for (size_t i = 0; i < verifyErrors.size(); i++) {
+            if (verifyErrors[i]) {
+                failed++;
+                std::string name = fromArchive ? archiveEntryPath(archive, *results[i].entry) : paths[i].string();
+                std::cerr << formatVerifyError(name, *classes[i], verifyErrors[i]) << std::endl;
+            }
+        }
+        std::cout << "verify: " << failed << " classes failed" << std::endl;
+        errors += failed;
+    }
+    if (stats != nullptr) {
+        auto snapshot = parseStatsSnapshot();
+        std::cout << ((std::strcmp(stats, "--stats-json") == 0) ? snapshot.json() + "\n" : snapshot.text());
+    }
+    return (errors == 0) ? 0 : 1;
+}
+
+// a trailing '*' makes the key a prefix
+static int
+queryIndex(const char *path, int keyCount, char **keys) {
+    CrossReferenceIndex index;
+    if (!index.load(path)) {
+        std::cerr << path << ": not a cross-reference index" << std::endl;
+        return 1;
+    }
+    for (int i = 0; i < keyCount; i++) {
+        std::string_view key = keys[i];
+        auto classes = key.ends_with('*') ? index.findPrefix(key.substr(0, key.size() - 1)) : index.find(key);
+        std::cout << key << ": " << classes.size() << " classes\n";
+        for (uint32_t classNum : classes) {
+            std::cout << "    " << index.className(classNum) << "\n";
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 1) {
+        return parseSingle("../ArithmeticAlgo.class");
+    }
+
+    if (std::strcmp(argv[1], "--stream") == 0) {
+        return parseStream();
+    }
+
+    if (std::strcmp(argv[1], "--roundtrip") == 0) {
+        int status = 0;
+        for (int i = 2; i < argc; i++) {
+            status |= roundTrip(argv[i]);
+        }
+        return status;
+    }
+
+    if (std::strcmp(argv[1], "--fingerprint") == 0) {
+        int status = 0;
+        for (int i = 2; i < argc; i++) {
+            status |= printFingerprints(argv[i]);
+        }
+        return status;
+    }
+
+    if (std::strcmp(argv[1], "--xref-query") == 0) {
+        if (argc < 4) {
+            usage(argv[0]);
+            return 2;
+        }
+        return queryIndex(argv[2], argc - 3, argv + 3);
+    }
+
+    if (std::strcmp(argv[1], "--batch") == 0) {
+        if (argc < 3) {
+            usage(argv[0]);
+            return 2;
+        }
+        size_t threads = 0;
+        bool intern = false;
+        std::unique_ptr<ClassCache> cache;
+        const char *stats = nullptr;
+        const char *xref = nullptr;
+        bool async = false;
+        bool verify = false;
+        for (int i = 3; i < argc; i++) {
+            if ((std::strcmp(argv[i], "-j") == 0) && (i + 1 < argc)) {
+                threads = std::stoul(argv[++i]);
+            } else if (std::strcmp(argv[i], "--intern") == 0) {
+                intern = true;
+            } else if ((std::strcmp(argv[i], "--cache") == 0) && (i + 1 < argc)) {
+                cache = std::make_unique<ClassCache>(argv[++i]);
+            } else if ((std::strcmp(argv[i], "--stats") == 0) || (std::strcmp(argv[i], "--stats-json") == 0)) {
+                stats = argv[i];
+            } else if ((std::strcmp(argv[i], "--xref") == 0) && (i + 1 < argc)) {
+                xref = argv[++i];
+            } else if (std::strcmp(argv[i], "--async") == 0) {
+                async = true;
+            } else if (std::strcmp(argv[i], "--verify") == 0) {
+                verify = true;
+            } else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        return parseBatch(argv[2], threads, intern, cache.get(), stats, xref, async, verify);
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        status |= parseSingle(argv[i]);
+    }
+    return status;
+}
@@ -0,0 +1,77 @@
+#include "mappedFile.hpp"
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_addr(std::exchange(other.m_addr, nullptr)),
+      m_size(std::exchange(other.m_size, 0)) {}
+
+
+MappedFile &
+MappedFile::operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+        unmap();
+        m_addr = std::exchange(other.m_addr, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+
+void
+MappedFile::unmap() {
+    if (m_addr != nullptr) {
+        munmap(m_addr, m_size);
+    }
+    m_addr = nullptr;
+    m_size = 0;
+}
+
+
+MappedFile::Status
+MappedFile::map(const std::filesystem::path &path, bool sequential) {
+    unmap();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Status::OpenFailed;
+    }
+
+    struct stat st{};
+    if ((fstat(fd, &st) != 0) || (st.st_size < 0)) {
+        close(fd);
+        return Status::InvalidSize;
+    }
+
+    /*
+     * mmap refuses zero-length mappings; an empty file is simply an empty span
+     * and gets rejected later by the magic check, same as with std::ifstream
+     */
+    if (st.st_size == 0) {
+        close(fd);
+        return Status::Ok;
+    }
+
+    void *addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return Status::OpenFailed;
+    }
+
+    if (sequential) {
+        madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+    }
+
+    m_addr = addr;
+    m_size = (size_t)st.st_size;
+    return Status::Ok;
+}
@@ -0,0 +1,44 @@
+#ifndef SJBCDC_MAPPEDFILE_HPP
+#define SJBCDC_MAPPEDFILE_HPP
+
+#include <cstdint>
+#include <span>
+#include <filesystem>
+
+/*
+ * Read-only private mapping of a whole file. The mapping lives as long as the
+ * object, so spans returned by bytes() must not outlive it.
+ */
+class MappedFile {
+private:
+    void *m_addr = nullptr;
+    size_t m_size = 0;
+
+    void
+    unmap();
+
+public:
+    enum class Status {
+        Ok,
+        OpenFailed,
+        InvalidSize
+    };
+
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    Status
+    map(const std::filesystem::path &path, bool sequential = true);
+
+    std::span<const uint8_t>
+    bytes() const { return { static_cast<const uint8_t *>(m_addr), m_size }; }
+
+    size_t
+    size() const { return m_size; }
+};
+
+#endif //SJBCDC_MAPPEDFILE_HPP
@@ -0,0 +1,316 @@
+#include "parseStats.hpp"
+#include "classFileError.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+
+constexpr static std::array<const char *, parsePhaseCount> phaseNames{
+    "read", "header", "constant pool", "deferred checks", "class structure", "members",
+    "class attributes", "cache lookup", "cache store",
+    "fingerprints"
+};
+
+constexpr static std::array<const char *, CONSTANT_TagCount> tagNames{
+    nullptr, "Utf8", nullptr, "Integer", "Float", "Long", "Double", "Class", "String", "Fieldref",
+    "Methodref", "InterfaceMethodref", "NameAndType", nullptr, nullptr, "MethodHandle", "MethodType",
+    "Dynamic", "InvokeDynamic", "Module", "Package"
+};
+
+
+static_assert(parseErrorCategoryCount + 1 == (size_t)ClassFileErrorCode::Count);
+
+
+static ClassFileErrorCode
+errorCode(size_t category) {
+    return (ClassFileErrorCode)(category + 1);
+}
+
+
+const char *
+parsePhaseName(ParsePhase phase) {
+    return phaseNames[(size_t)phase];
+}
+
+
+#ifdef SJBCDC_ENABLE_STATS
+namespace {
+
+// every counter of a snapshot as one flat array
+enum Slot : size_t {
+    Classes,
+    Failed,
+    Bytes,
+    Allocations,
+    AllocatedBytes,
+    PhaseNanos,
+    PhaseCalls = PhaseNanos + parsePhaseCount,
+    Constants = PhaseCalls + parsePhaseCount,
+    Errors = Constants + CONSTANT_TagCount,
+    SlotCount = Errors + parseErrorCategoryCount
+};
+
+
+struct ThreadCounters {
+    // only the owning thread writes, so a load and a store are enough to add
+    std::array<std::atomic<uint64_t>, SlotCount> values{};
+    std::chrono::steady_clock::time_point lastLap;
+
+    void
+    add(size_t slot, uint64_t n) {
+        values[slot].store(values[slot].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadCounters *> threads;
+    std::array<uint64_t, SlotCount> retired{};  // of threads that have exited
+};
+
+
+// never destroyed: threads may exit after static destructors have run
+Registry &
+registry() {
+    static auto *instance = new Registry;
+    return *instance;
+}
+
+
+struct ThreadRegistration {
+    ThreadCounters counters;
+
+    ThreadRegistration() {
+        Registry &reg = registry();
+        std::lock_guard lock(reg.mutex);
+        reg.threads.push_back(&counters);
+    }
+
+    ~ThreadRegistration() {
+        Registry &reg = registry();
+        std::lock_guard lock(reg.mutex);
+        std::erase(reg.threads, &counters);
+        for (size_t i = 0; i < SlotCount; i++) {
+            reg.retired[i] += counters.values[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+
+ThreadCounters &
+threadCounters() {
+    thread_local ThreadRegistration registration;
+    return registration.counters;
+}
+
+
+class CountingResource : public std::pmr::memory_resource {
+private:
+    std::pmr::memory_resource *m_upstream;
+
+    void *
+    do_allocate(size_t bytes, size_t alignment) override {
+        ThreadCounters &counters = threadCounters();
+        counters.add(Allocations, 1);
+        counters.add(AllocatedBytes, bytes);
+        return m_upstream->allocate(bytes, alignment);
+    }
+
+    void
+    do_deallocate(void *p, size_t bytes, size_t alignment) override {
+        m_upstream->deallocate(p, bytes, alignment);
+    }
+
+    // memory of the upstream can be handed over (e.g. a moved-in buffer) and the other way round
+    bool
+    do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return (this == &other) || m_upstream->is_equal(other);
+    }
+
+public:
+    explicit CountingResource(std::pmr::memory_resource *upstream) : m_upstream(upstream) {}
+
+    std::pmr::memory_resource *
+    upstream() const { return m_upstream; }
+};
+
+}
+
+
+void
+parseStats::begin() {
+    ThreadCounters &counters = threadCounters();
+    counters.add(Classes, 1);
+    counters.lastLap = std::chrono::steady_clock::now();
+}
+
+
+void
+parseStats::lap(ParsePhase phase, bool newCall) {
+    ThreadCounters &counters = threadCounters();
+    auto now = std::chrono::steady_clock::now();
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(now - counters.lastLap).count();
+    counters.add(PhaseNanos + (size_t)phase, (uint64_t)nanos);
+    counters.add(PhaseCalls + (size_t)phase, newCall);
+    counters.lastLap = now;
+}
+
+
+void
+parseStats::addBytes(size_t bytes) {
+    threadCounters().add(Bytes, bytes);
+}
+
+
+void
+parseStats::addConstants(const std::array<size_t, CONSTANT_TagCount> &tagCounts) {
+    ThreadCounters &counters = threadCounters();
+    for (size_t tag = 1; tag < CONSTANT_TagCount; tag++) {
+        if (tagCounts[tag] != 0) {
+            counters.add(Constants + tag, tagCounts[tag]);
+        }
+    }
+}
+
+
+void
+parseStats::addError(size_t category) {
+    ThreadCounters &counters = threadCounters();
+    counters.add(Failed, 1);
+    counters.add(Errors + category, 1);
+}
+
+
+std::pmr::memory_resource *
+parseStats::countingResource(std::pmr::memory_resource *upstream) {
+    thread_local CountingResource *last = nullptr;
+    if ((last != nullptr) && (last->upstream() == upstream)) {
+        return last;
+    }
+
+    static std::mutex mutex;
+    static auto *resources = new std::vector<CountingResource *>;
+    std::lock_guard lock(mutex);
+    for (auto *resource : *resources) {
+        if (resource->upstream() == upstream) {
+            last = resource;
+            return last;
+        }
+    }
+    last = resources->emplace_back(new CountingResource(upstream));
+    return last;
+}
+
+
+ParseStatsSnapshot
+parseStatsSnapshot() {
+    std::array<uint64_t, SlotCount> values{};
+    {
+        Registry &reg = registry();
+        std::lock_guard lock(reg.mutex);
+        values = reg.retired;
+        for (ThreadCounters *counters : reg.threads) {
+            for (size_t i = 0; i < SlotCount; i++) {
+                values[i] += counters->values[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ParseStatsSnapshot snapshot;
+    snapshot.classes = values[Classes];
+    snapshot.failed = values[Failed];
+    snapshot.bytes = values[Bytes];
+    snapshot.allocations = values[Allocations];
+    snapshot.allocatedBytes = values[AllocatedBytes];
+    std::copy_n(values.begin() + PhaseNanos, parsePhaseCount, snapshot.phaseNanos.begin());
+    std::copy_n(values.begin() + PhaseCalls, parsePhaseCount, snapshot.phaseCalls.begin());
+    std::copy_n(values.begin() + Constants, CONSTANT_TagCount, snapshot.constants.begin());
+    std::copy_n(values.begin() + Errors, parseErrorCategoryCount, snapshot.errors.begin());
+    return snapshot;
+}
+
+
+void
+resetParseStats() {
+    Registry &reg = registry();
+    std::lock_guard lock(reg.mutex);
+    reg.retired.fill(0);
+    for (ThreadCounters *counters : reg.threads) {
+        for (auto &value : counters->values) {
+            value.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+#else
+ParseStatsSnapshot
+parseStatsSnapshot() {
+    return {};
+}
+
+
+void
+resetParseStats() {}
+#endif
+
+
+std::string
+ParseStatsSnapshot::text() const {
+    std::ostringstream out;
+    if (!parseStatsEnabled) {
+        out << "parse statistics are not compiled in (SJBCDC_ENABLE_STATS)\n";
+        return out.str();
+    }
+
+    out << classes << " classes (" << failed << " failed), " << bytes << " bytes\n";
+    for (size_t phase = 0; phase < parsePhaseCount; phase++) {
+        if (phaseCalls[phase] == 0) {
+            continue;
+        }
+        out << "  " << phaseNames[phase] << ": " << (double)phaseNanos[phase] / 1e6 << " ms, "
+            << phaseCalls[phase] << " calls, " << phaseNanos[phase] / phaseCalls[phase] << " ns/call\n";
+    }
+    out << "constants:";
+    for (size_t tag = 1; tag < CONSTANT_TagCount; tag++) {
+        if (constants[tag] != 0) {
+            out << " " << tagNames[tag] << " " << constants[tag];
+        }
+    }
+    out << "\nallocations: " << allocations << ", " << allocatedBytes << " bytes\n";
+    for (size_t category = 0; category < parseErrorCategoryCount; category++) {
+        if (errors[category] != 0) {
+            out << "error \"" << classFileErrorMessage(errorCode(category)) << "\": " << errors[category] << "\n";
+        }
+    }
+    return out.str();
+}
+
+
+std::string
+ParseStatsSnapshot::json() const {
+    std::ostringstream out;
+    out << "{\"enabled\": " << (parseStatsEnabled ? "true" : "false") << ", \"classes\": " << classes
+        << ", \"failed\": " << failed << ", \"bytes\": " << bytes << ", \"phases\": {";
+    for (size_t phase = 0; phase < parsePhaseCount; phase++) {
+        out << (phase ? ", " : "") << "\"" << phaseNames[phase] << "\": {\"nanos\": " << phaseNanos[phase]
+            << ", \"calls\": " << phaseCalls[phase] << "}";
+    }
+    out << "}, \"constants\": {";
+    bool first = true;
+    for (size_t tag = 1; tag < CONSTANT_TagCount; tag++) {
+        if (tagNames[tag] != nullptr) {
+            out << (first ? "" : ", ") << "\"" << tagNames[tag] << "\": " << constants[tag];
+            first = false;
+        }
+    }
+    out << "}, \"allocations\": " << allocations << ", \"allocatedBytes\": " << allocatedBytes << ", \"errors\": {";
+    // the messages contain no characters that need escaping
+    for (size_t category = 0; category < parseErrorCategoryCount; category++) {
+        out << (category ? ", " : "") << "\"" << classFileErrorMessage(errorCode(category)) << "\": " << errors[category];
+    }
+    out << "}}";
+    return out.str();
+}
@@ -0,0 +1,110 @@
+#ifndef SJBCDC_PARSESTATS_HPP
+#define SJBCDC_PARSESTATS_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+
+#include "constant_pool.hpp"
+
+/*
+ * Parse statistics: per-phase time, bytes, constants by tag, allocations and
+ * errors by ClassFileErrorCode, summed over all threads (including the
+ * ones that have exited). Recording is compiled in only with
+ * SJBCDC_ENABLE_STATS; without it the SJBCDC_STATS() statements vanish and
+ * snapshots stay empty.
+ *
+ * Every thread counts into its own block, so recording takes no locks and
+ * no atomic read-modify-write; a snapshot may miss updates that are in
+ * flight while it is taken.
+ */
+
+enum class ParsePhase : uint8_t {
+    Read,           // opening and reading or mapping the file
+    Header,         // magic and version
+    ConstantPool,   // decoding with the checks fused into it
+    DeferredChecks, // constants that refer forward, bootstrap method indices
+    ClassStructure, // access flags, this/super class, interfaces
+    Members,        // fields and methods with their attributes
+    ClassAttributes,
+    CacheLookup,
+    CacheStore,
+    Fingerprints,
+    Count
+};
+
+constexpr size_t parsePhaseCount = (size_t)ParsePhase::Count;
+// one per ClassFileErrorCode except None; errors[code - 1]
+constexpr size_t parseErrorCategoryCount = 18;
+
+#ifdef SJBCDC_ENABLE_STATS
+constexpr bool parseStatsEnabled = true;
+#define SJBCDC_STATS(statement) statement
+#else
+constexpr bool parseStatsEnabled = false;
+#define SJBCDC_STATS(statement)
+#endif
+
+struct ParseStatsSnapshot {
+    uint64_t classes = 0;           // init() calls
+    uint64_t failed = 0;
+    uint64_t bytes = 0;             // class bytes parsed (or restored from a ClassCache)
+    std::array<uint64_t, parsePhaseCount> phaseNanos{};
+    std::array<uint64_t, parsePhaseCount> phaseCalls{};     // classes that got through the phase
+    std::array<uint64_t, CONSTANT_TagCount> constants{};
+    uint64_t allocations = 0;       // through the memory resources of ClassFiles
+    uint64_t allocatedBytes = 0;
+    std::array<uint64_t, parseErrorCategoryCount> errors{};
+
+    std::string
+    text() const;
+
+    std::string
+    json() const;
+};
+
+ParseStatsSnapshot
+parseStatsSnapshot();
+
+void
+resetParseStats();
+
+const char *
+parsePhaseName(ParsePhase phase);
+
+#ifdef SJBCDC_ENABLE_STATS
+namespace parseStats {
+
+// starts timing a parse on this thread
+void
+begin();
+
+/*
+ * Adds the time since the last lap (or begin()) to phase; newCall is false
+ * when the phase was already counted for this class
+ */
+void
+lap(ParsePhase phase, bool newCall = true);
+
+void
+addBytes(size_t bytes);
+
+void
+addConstants(const std::array<size_t, CONSTANT_TagCount> &tagCounts);
+
+// category: ClassFileErrorCode - 1
+void
+addError(size_t category);
+
+/*
+ * Resource that counts allocations and forwards them to upstream; one per
+ * upstream resource, alive until the process exits
+ */
+std::pmr::memory_resource *
+countingResource(std::pmr::memory_resource *upstream);
+
+}
+#endif
+
+#endif //SJBCDC_PARSESTATS_HPP
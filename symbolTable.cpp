@@ -0,0 +1,242 @@
+#include "symbolTable.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+
+constexpr static size_t
+initialIndexSize = 64;
+
+// arena chunks start small (most shards of a small run hold a few symbols) and double up to this
+constexpr static size_t
+maxArenaChunkSize = 64 * 1024;
+
+constexpr static size_t
+minArenaChunkSize = 1024;
+
+// strings longer than this get an allocation of their own instead of arena space
+constexpr static size_t
+maxArenaString = 4096;
+
+
+SymbolTable::~SymbolTable() {
+    for (auto &shard : m_shards) {
+        for (auto &segment : shard.segments) {
+            delete[] segment.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+SymbolTable &
+SymbolTable::global() {
+    static SymbolTable table;
+    return table;
+}
+
+
+uint32_t
+SymbolTable::hashBytes(std::string_view bytes) {
+    const auto *ptr = reinterpret_cast<const uint8_t *>(bytes.data());
+    size_t len = bytes.size();
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * 0xff51afd7ed558ccdULL);
+
+    while (len >= 8) {
+        uint64_t word;
+        std::memcpy(&word, ptr, sizeof(word));
+        h = (h ^ word) * 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 29;
+        ptr += 8;
+        len -= 8;
+    }
+    if (len > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, ptr, len);
+        h = (h ^ word) * 0x94d049bb133111ebULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+
+const SymbolTable::Symbol *
+SymbolTable::symbolAt(const Shard &shard, uint32_t index) {
+    uint32_t biased = index + (1u << firstSegmentBits);
+    uint32_t segment = std::bit_width(biased) - 1 - firstSegmentBits;
+    uint32_t offset = biased - (1u << (segment + firstSegmentBits));
+    return shard.segments[segment].load(std::memory_order_acquire) + offset;
+}
+
+
+const char *
+SymbolTable::storeBytes(Shard &shard, std::string_view bytes) {
+    if (bytes.empty()) {
+        return "";
+    }
+    if (bytes.size() > maxArenaString) {
+        shard.arena.push_back(std::make_unique<char[]>(bytes.size()));
+        shard.memoryUsage += bytes.size();
+        std::memcpy(shard.arena.back().get(), bytes.data(), bytes.size());
+        return shard.arena.back().get();
+    }
+
+    if (shard.arenaUsed + bytes.size() > shard.arenaCapacity) {
+        /*
+         * the big allocations sit in the same list, so the current chunk is
+         * kept at the front of it
+         */
+        size_t chunkSize = std::clamp(shard.arenaCapacity * 2, minArenaChunkSize, maxArenaChunkSize);
+        shard.arena.push_back(std::make_unique<char[]>(chunkSize));
+        std::swap(shard.arena.front(), shard.arena.back());
+        shard.arenaUsed = 0;
+        shard.arenaCapacity = chunkSize;
+        shard.memoryUsage += chunkSize;
+    }
+    char *dst = shard.arena.front().get() + shard.arenaUsed;
+    std::memcpy(dst, bytes.data(), bytes.size());
+    shard.arenaUsed += bytes.size();
+    return dst;
+}
+
+
+void
+SymbolTable::growIndex(Shard &shard) {
+    std::vector<uint64_t> slots(shard.slots.empty() ? initialIndexSize : shard.slots.size() * 2, 0);
+    size_t mask = slots.size() - 1;
+    for (uint64_t entry : shard.slots) {
+        if (entry == 0) {
+            continue;
+        }
+        size_t pos = ((entry >> 32) >> shardBits) & mask;
+        while (slots[pos] != 0) {
+            pos = (pos + 1) & mask;
+        }
+        slots[pos] = entry;
+    }
+    shard.memoryUsage += (slots.size() - shard.slots.size()) * sizeof(uint64_t);
+    shard.slots = std::move(slots);
+}
+
+
+/*
+ * Probes the index of a locked shard; returns the id of bytes or noSymbol,
+ * with slot left at the empty slot where it would go
+ */
+SymbolId
+SymbolTable::lookup(const Shard &shard, std::string_view bytes, uint32_t hash, size_t &slot) {
+    size_t mask = shard.slots.size() - 1;
+    slot = (hash >> shardBits) & mask;
+    while (shard.slots[slot] != 0) {
+        uint64_t entry = shard.slots[slot];
+        if ((uint32_t)(entry >> 32) == hash) {
+            auto index = (uint32_t)entry - 1;
+            const Symbol *symbol = symbolAt(shard, index);
+            if ((symbol->length == bytes.size()) &&
+                (std::memcmp(symbol->bytes, bytes.data(), bytes.size()) == 0)) {
+                return (index << shardBits) | (hash & (shardCount - 1));
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return noSymbol;
+}
+
+
+SymbolId
+SymbolTable::intern(std::string_view bytes) {
+    uint32_t hash = hashBytes(bytes);
+    Shard &shard = m_shards[hash & (shardCount - 1)];
+    std::lock_guard lock(shard.mutex);
+
+    if (shard.slots.empty()) {
+        growIndex(shard);
+    }
+    size_t slot = 0;
+    SymbolId id = lookup(shard, bytes, hash, slot);
+    if (id != noSymbol) {
+        return id;
+    }
+
+    uint32_t index = shard.count.load(std::memory_order_relaxed);
+    if (index >= maxSymbolsPerShard) {
+        return noSymbol;
+    }
+    uint32_t biased = index + (1u << firstSegmentBits);
+    uint32_t segment = std::bit_width(biased) - 1 - firstSegmentBits;
+    if (shard.segments[segment].load(std::memory_order_relaxed) == nullptr) {
+        size_t segmentSize = size_t(1) << (segment + firstSegmentBits);
+        shard.segments[segment].store(new Symbol[segmentSize], std::memory_order_release);
+        shard.memoryUsage += segmentSize * sizeof(Symbol);
+    }
+
+    auto *symbol = const_cast<Symbol *>(symbolAt(shard, index));
+    *symbol = Symbol{ storeBytes(shard, bytes), (uint32_t)bytes.size(), hash };
+    shard.slots[slot] = ((uint64_t)hash << 32) | (index + 1);
+    shard.count.store(index + 1, std::memory_order_release);
+    if ((size_t)(index + 1) * 2 > shard.slots.size()) {
+        growIndex(shard);
+    }
+
+    return (index << shardBits) | (hash & (shardCount - 1));
+}
+
+
+SymbolId
+SymbolTable::find(std::string_view bytes) const {
+    uint32_t hash = hashBytes(bytes);
+    const Shard &shard = m_shards[hash & (shardCount - 1)];
+    std::lock_guard lock(shard.mutex);
+
+    if (shard.slots.empty()) {
+        return noSymbol;
+    }
+    size_t slot = 0;
+    return lookup(shard, bytes, hash, slot);
+}
+
+
+std::string_view
+SymbolTable::name(SymbolId id) const {
+    const Shard &shard = m_shards[id & (shardCount - 1)];
+    uint32_t index = id >> shardBits;
+    if ((id == noSymbol) || (index >= shard.count.load(std::memory_order_acquire))) {
+        return {};
+    }
+    const Symbol *symbol = symbolAt(shard, index);
+    return { symbol->bytes, symbol->length };
+}
+
+
+uint32_t
+SymbolTable::hash(SymbolId id) const {
+    const Shard &shard = m_shards[id & (shardCount - 1)];
+    uint32_t index = id >> shardBits;
+    if ((id == noSymbol) || (index >= shard.count.load(std::memory_order_acquire))) {
+        return 0;
+    }
+    return symbolAt(shard, index)->hash;
+}
+
+
+size_t
+SymbolTable::size() const {
+    size_t total = 0;
+    for (auto &shard : m_shards) {
+        total += shard.count.load(std::memory_order_acquire);
+    }
+    return total;
+}
+
+
+size_t
+SymbolTable::memoryUsage() const {
+    size_t total = 0;
+    for (auto &shard : m_shards) {
+        std::lock_guard lock(shard.mutex);
+        total += shard.memoryUsage;
+    }
+    return total;
+}
@@ -0,0 +1,107 @@
+#ifndef SJBCDC_SYMBOLTABLE_HPP
+#define SJBCDC_SYMBOLTABLE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+using SymbolId = uint32_t;
+
+constexpr SymbolId noSymbol = UINT32_MAX;
+
+/*
+ * Interns byte strings (Utf8 constants) into stable 32-bit ids shared by all
+ * classes parsed in the process. Equal strings always get the same id, so
+ * names compare with a single integer compare, and every distinct string is
+ * stored (and hashed) once.
+ *
+ * The table is split into shards picked by the low bits of the hash, each
+ * with its own lock, open-addressing index and string arena. An id is
+ * (index within shard << shardBits) | shard. Symbols are never removed and
+ * never move: name() and hash() take no lock and their views stay valid as
+ * long as the table.
+ */
+class SymbolTable {
+private:
+    static constexpr uint32_t shardBits = 6;
+    static constexpr uint32_t shardCount = 1u << shardBits;
+    static constexpr uint32_t maxSymbolsPerShard = (noSymbol >> shardBits);
+    /*
+     * symbols of a shard live in segments of doubling size (64, 128, ...),
+     * so they never move and lookups by id need no lock
+     */
+    static constexpr uint32_t firstSegmentBits = 6;
+    static constexpr uint32_t segmentCount = 32 - shardBits - firstSegmentBits + 1;
+
+    struct Symbol {
+        const char *bytes;
+        uint32_t length;
+        uint32_t hash;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::vector<uint64_t> slots;    // (hash << 32) | (index + 1), 0 when empty
+        std::atomic<uint32_t> count{0};
+        std::array<std::atomic<Symbol *>, segmentCount> segments{};
+        std::vector<std::unique_ptr<char[]>> arena;
+        size_t arenaUsed = 0;
+        size_t arenaCapacity = 0;
+        size_t memoryUsage = 0;
+    };
+
+    std::array<Shard, shardCount> m_shards;
+
+    static const Symbol *
+    symbolAt(const Shard &shard, uint32_t index);
+
+    static const char *
+    storeBytes(Shard &shard, std::string_view bytes);
+
+    static void
+    growIndex(Shard &shard);
+
+    static SymbolId
+    lookup(const Shard &shard, std::string_view bytes, uint32_t hash, size_t &slot);
+
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+    ~SymbolTable();
+
+    // the process-wide table used unless ClassFileOptions::symbolTable says otherwise
+    static SymbolTable &
+    global();
+
+    static uint32_t
+    hashBytes(std::string_view bytes);
+
+    // noSymbol only once a shard holds maxSymbolsPerShard symbols
+    SymbolId
+    intern(std::string_view bytes);
+
+    // noSymbol when bytes have not been interned
+    SymbolId
+    find(std::string_view bytes) const;
+
+    // empty for ids this table did not hand out
+    std::string_view
+    name(SymbolId id) const;
+
+    uint32_t
+    hash(SymbolId id) const;
+
+    size_t
+    size() const;
+
+    // bytes held by the arenas, symbol segments and indices
+    size_t
+    memoryUsage() const;
+};
+
+#endif //SJBCDC_SYMBOLTABLE_HPP
@@ -0,0 +1,100 @@
+/*
+ * Fingerprints of classes parsed with lazyConstantPool must equal those of
+ * the eager parse: hashing a lazily parsed class decodes constants while
+ * others are being hashed. Checks the generated classes of bench/classGen,
+ * a class whose constants refer to others of their own type (only parsed
+ * with VerifyLevel::None) and any class files given on the command line;
+ * exits 1 on a mismatch.
+ *
+ *   sJBcDcFingerprintTest [--classes N] [class files...]
+ */
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../bench/classGen.hpp"
+#include "../classFileRead.hpp"
+
+
+static bool
+checkClass(const std::string &name, std::span<const uint8_t> bytes, VerifyLevel verifyLevel = VerifyLevel::Full) {
+    ClassFile eager;
+    eager.init(bytes, name, { .verifyLevel = verifyLevel, .fingerprints = true });
+    ClassFile lazy;
+    lazy.init(bytes, name, { .lazyConstantPool = true, .verifyLevel = verifyLevel, .fingerprints = true });
+    if (eager.parseError() || lazy.parseError()) {
+        std::cerr << name << ": " << (eager.parseError() ? eager.initResult() : lazy.initResult()) << std::endl;
+        return false;
+    }
+
+    auto &expected = eager.fingerprints();
+    auto &actual = lazy.fingerprints();
+    if ((expected.file != actual.file) || (expected.api != actual.api) ||
+        !std::equal(expected.methods.begin(), expected.methods.end(), actual.methods.begin(), actual.methods.end())) {
+        std::cerr << name << ": lazy fingerprints differ from eager ones" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * this_class is #1, a Class whose name_index is the first of a chain of
+ * Fieldrefs, each with the next as its class_index: hashing one decodes the
+ * next into the same table while the first is still being read.
+ */
+static std::vector<uint8_t>
+selfReferringClass() {
+    constexpr static uint16_t
+    chainLength = 16;
+
+    std::vector<uint8_t> bytes = { 0xCA, 0xFE, 0xBA, 0xBE, 0, 0, 0, 52 };
+    auto u2 = [&](uint16_t value) {
+        bytes.push_back((uint8_t)(value >> 8));
+        bytes.push_back((uint8_t)value);
+    };
+    u2(2 + chainLength);
+    bytes.push_back(CONSTANT_Class);
+    u2(2);
+    for (uint16_t cpIdx = 2; cpIdx < 2 + chainLength; cpIdx++) {
+        bytes.push_back(CONSTANT_Fieldref);
+        u2((cpIdx + 1 < 2 + chainLength) ? cpIdx + 1 : 1);
+        u2(1);
+    }
+    // access flags, this_class, super_class, interfaces, fields, methods, attributes
+    for (uint16_t value : { 0x0021, 1, 0, 0, 0, 0, 0 }) {
+        u2(value);
+    }
+    return bytes;
+}
+
+
+int main(int argc, char **argv) {
+    size_t classCount = 200;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--classes") == 0) && (i + 1 < argc)) {
+            classCount = std::stoul(argv[++i]);
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+
+    size_t failed = 0;
+    ClassGenOptions options;
+    for (size_t n = 0; n < classCount; n++) {
+        auto bytes = generateClass(options, n);
+        failed += !checkClass("generated " + std::to_string(n), bytes);
+    }
+    failed += !checkClass("self-referring constants", selfReferringClass(), VerifyLevel::None);
+    for (auto &path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), {});
+        failed += !checkClass(path, bytes);
+    }
+
+    std::cout << (classCount + 1 + paths.size()) << " classes, " << failed << " failed" << std::endl;
+    return (failed == 0) ? 0 : 1;
+}
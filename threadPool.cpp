@@ -0,0 +1,134 @@
+#include "threadPool.hpp"
+#include <algorithm>
+
+
+static thread_local const WorkStealingPool *tlsPool = nullptr;
+static thread_local size_t tlsWorker = 0;
+
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        m_threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        std::lock_guard lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+
+size_t
+WorkStealingPool::currentWorker() const {
+    return (tlsPool == this) ? tlsWorker : m_threads.size();
+}
+
+
+void
+WorkStealingPool::submit(std::function<void()> task) {
+    size_t target = currentWorker();
+    if (target >= m_queues.size()) {
+        target = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    }
+
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(m_queues[target]->mutex);
+        m_queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // under m_sleepMutex so a worker about to sleep cannot miss it
+        std::lock_guard lock(m_sleepMutex);
+        m_queued.fetch_add(1, std::memory_order_release);
+    }
+    m_wake.notify_one();
+}
+
+
+bool
+WorkStealingPool::popTask(size_t self, std::function<void()> &task) {
+    {
+        auto &own = *m_queues[self];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < m_queues.size(); i++) {
+        auto &victim = *m_queues[(self + i) % m_queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void
+WorkStealingPool::workerLoop(size_t self) {
+    tlsPool = this;
+    tlsWorker = self;
+
+    std::function<void()> task;
+    while (true) {
+        if (popTask(self, task)) {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard lock(m_sleepMutex);
+                m_idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock lock(m_sleepMutex);
+        m_wake.wait(lock, [this] { return m_stop || (m_queued.load(std::memory_order_acquire) > 0); });
+        if (m_stop && (m_queued.load(std::memory_order_acquire) == 0)) {
+            return;
+        }
+    }
+}
+
+
+void
+WorkStealingPool::wait() {
+    std::unique_lock lock(m_sleepMutex);
+    m_idle.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+}
+
+
+void
+WorkStealingPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t)> &body) {
+    grain = std::max<size_t>(grain, 1);
+    for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = std::min(count, begin + grain);
+        submit([&body, begin, end] {
+            for (size_t i = begin; i < end; i++) {
+                body(i);
+            }
+        });
+    }
+    wait();
+}
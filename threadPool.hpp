@@ -0,0 +1,70 @@
+#ifndef SJBCDC_THREADPOOL_HPP
+#define SJBCDC_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of workers, each with its own task deque. A worker pops its own
+ * deque from the back and, once it runs dry, steals from the front of the
+ * others, so uneven tasks (a few huge classes among many small ones) balance
+ * without a central queue.
+ */
+class WorkStealingPool {
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    bool m_stop = false;
+
+    std::atomic<size_t> m_queued{0};    // tasks sitting in some deque
+    std::atomic<size_t> m_pending{0};   // tasks submitted and not yet finished
+    std::atomic<size_t> m_nextQueue{0};
+
+    bool
+    popTask(size_t self, std::function<void()> &task);
+
+    void
+    workerLoop(size_t self);
+
+public:
+    // 0 threads means std::thread::hardware_concurrency()
+    explicit WorkStealingPool(size_t threads = 0);
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+    ~WorkStealingPool();
+
+    size_t
+    threadCount() const { return m_threads.size(); }
+
+    // index of the calling worker, or threadCount() outside the pool
+    size_t
+    currentWorker() const;
+
+    void
+    submit(std::function<void()> task);
+
+    // blocks until every submitted task has finished; not callable from a worker
+    void
+    wait();
+
+    // runs body(i) for every i in [0, count) in chunks of grain and waits
+    void
+    parallelFor(size_t count, size_t grain, const std::function<void(size_t)> &body);
+};
+
+#endif //SJBCDC_THREADPOOL_HPP
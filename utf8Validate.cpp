@@ -0,0 +1,186 @@
+#include "utf8Validate.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SJBCDC_UTF8_X86 1
+#endif
+
+
+constexpr static size_t
+invalidSequence = SIZE_MAX;
+
+
+/*
+ * Validates one character starting at bytes[i]; returns the index of the next
+ * character or invalidSequence
+ */
+static inline size_t
+validateSequence(const uint8_t *bytes, size_t i, size_t len) {
+    uint8_t lead = bytes[i];
+    if ((lead != 0) && (lead < 0x80)) {
+        return i + 1;
+    }
+    if ((lead & 0xe0) == 0xc0) {
+        if ((i + 1 >= len) || ((bytes[i + 1] & 0xc0) != 0x80)) {
+            return invalidSequence;
+        }
+        return i + 2;
+    }
+    if ((lead & 0xf0) == 0xe0) {
+        if ((i + 2 >= len) || ((bytes[i + 1] & 0xc0) != 0x80) || ((bytes[i + 2] & 0xc0) != 0x80)) {
+            return invalidSequence;
+        }
+        return i + 3;
+    }
+    // 0x00, a stray continuation byte or 0xf0-0xff
+    return invalidSequence;
+}
+
+
+/*
+ * Scalar walk over [i, until); may stop up to two bytes past until when the
+ * last character straddles it, so the caller resumes on a character boundary
+ */
+static inline size_t
+validateRange(const uint8_t *bytes, size_t i, size_t until, size_t len) {
+    while (i < until) {
+        i = validateSequence(bytes, i, len);
+        if (i == invalidSequence) {
+            return invalidSequence;
+        }
+    }
+    return i;
+}
+
+
+bool
+validModifiedUtf8Scalar(const uint8_t *bytes, size_t len) {
+    return validateRange(bytes, 0, len, len) != invalidSequence;
+}
+
+
+#ifdef SJBCDC_UTF8_X86
+
+/*
+ * Blocks made only of 0x01-0x7f bytes are accepted with one compare and one
+ * movemask; the scalar walker takes over for blocks holding anything else
+ */
+static bool
+validModifiedUtf8Sse2(const uint8_t *bytes, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    while (i + 16 <= len) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i));
+        int special = _mm_movemask_epi8(_mm_or_si128(block, _mm_cmpeq_epi8(block, zero)));
+        if (special == 0) {
+            i += 16;
+            continue;
+        }
+        i = validateRange(bytes, i, i + 16, len);
+        if (i == invalidSequence) {
+            return false;
+        }
+    }
+    return validateRange(bytes, i, len, len) != invalidSequence;
+}
+
+
+__attribute__((target("avx2")))
+static bool
+validModifiedUtf8Avx2(const uint8_t *bytes, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i));
+        int special = _mm256_movemask_epi8(_mm256_or_si256(block, _mm256_cmpeq_epi8(block, zero)));
+        if (special == 0) {
+            i += 32;
+            continue;
+        }
+        i = validateRange(bytes, i, i + 32, len);
+        if (i == invalidSequence) {
+            return false;
+        }
+    }
+    return validateRange(bytes, i, len, len) != invalidSequence;
+}
+
+#endif
+
+
+using Utf8ValidatorFn = bool (*)(const uint8_t *, size_t);
+
+struct Utf8Validator {
+    Utf8ValidatorFn fn;
+    const char *name;
+};
+
+
+static Utf8Validator
+selectValidator() {
+#ifdef SJBCDC_UTF8_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return { validModifiedUtf8Avx2, "avx2" };
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return { validModifiedUtf8Sse2, "sse2" };
+    }
+#endif
+    return { validModifiedUtf8Scalar, "scalar" };
+}
+
+
+static const Utf8Validator &
+validator() {
+    static const Utf8Validator selected = selectValidator();
+    return selected;
+}
+
+
+bool
+validModifiedUtf8(const uint8_t *bytes, size_t len) {
+    // short names and descriptors never reach a full block
+    if (len < 16) {
+        return validModifiedUtf8Scalar(bytes, len);
+    }
+    return validator().fn(bytes, len);
+}
+
+
+const char *
+modifiedUtf8ValidatorName() {
+    return validator().name;
+}
+
+
+bool
+ModifiedUtf8Validator::update(const uint8_t *bytes, size_t len) {
+    size_t i = 0;
+    for (; m_valid && (m_pendingContinuations > 0) && (i < len); i++, m_pendingContinuations--) {
+        m_valid = (bytes[i] & 0xc0) == 0x80;
+    }
+    if (!m_valid || (i == len)) {
+        return m_valid;
+    }
+
+    // a lead byte among the last two whose character does not fit is kept for the next piece
+    size_t end = len;
+    for (size_t lead = len - 1; (lead >= i) && (len - lead <= 2); lead--) {
+        size_t charLen = ((bytes[lead] & 0xe0) == 0xc0) ? 2 : ((bytes[lead] & 0xf0) == 0xe0) ? 3 : 0;
+        if (charLen != 0) {
+            if (lead + charLen > len) {
+                end = lead;
+                m_pendingContinuations = (uint8_t)(lead + charLen - len);
+            }
+            break;
+        }
+        if (((bytes[lead] & 0xc0) != 0x80) || (lead == 0)) {
+            break;
+        }
+    }
+
+    // the kept bytes after the lead byte were seen to be continuation bytes above
+    m_valid = validModifiedUtf8(bytes + i, end - i);
+    return m_valid;
+}
@@ -0,0 +1,46 @@
+#ifndef SJBCDC_UTF8VALIDATE_HPP
+#define SJBCDC_UTF8VALIDATE_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Checks bytes against the JVMS 4.4.7 modified UTF-8 rules: no 0x00 and no
+ * 0xf0-0xff bytes, every lead byte is followed by the right number of
+ * continuation bytes and no continuation byte stands on its own.
+ * The implementation (AVX2, SSE2 or scalar) is picked once at runtime.
+ */
+bool
+validModifiedUtf8(const uint8_t *bytes, size_t len);
+
+bool
+validModifiedUtf8Scalar(const uint8_t *bytes, size_t len);
+
+const char *
+modifiedUtf8ValidatorName();
+
+/*
+ * The same check over bytes that arrive in pieces, where a character may be
+ * split between two update() calls. Whole characters inside a piece go
+ * through validModifiedUtf8; only a cut-off character is carried over, as
+ * the number of continuation bytes still expected.
+ */
+class ModifiedUtf8Validator {
+private:
+    uint8_t m_pendingContinuations = 0;
+    bool m_valid = true;
+
+public:
+    // false once anything seen so far is invalid
+    bool
+    update(const uint8_t *bytes, size_t len);
+
+    // valid and not ending inside a character
+    bool
+    finish() const { return m_valid && (m_pendingContinuations == 0); }
+
+    void
+    reset() { *this = ModifiedUtf8Validator{}; }
+};
+
+#endif //SJBCDC_UTF8VALIDATE_HPP
@@ -0,0 +1,262 @@
+#include "zipArchive.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <new>
+
+#include "inflate.hpp"
+
+
+constexpr static uint32_t localHeaderSignature = 0x04034b50;
+constexpr static uint32_t centralHeaderSignature = 0x02014b50;
+constexpr static uint32_t endOfCentralDirSignature = 0x06054b50;
+constexpr static uint32_t zip64EndOfCentralDirSignature = 0x06064b50;
+constexpr static uint32_t zip64LocatorSignature = 0x07064b50;
+
+constexpr static size_t localHeaderSize = 30;
+constexpr static size_t centralHeaderSize = 46;
+constexpr static size_t endOfCentralDirSize = 22;
+constexpr static size_t zip64LocatorSize = 20;
+constexpr static size_t zip64EndOfCentralDirSize = 56;
+
+constexpr static uint16_t methodStored = 0;
+constexpr static uint16_t methodDeflated = 8;
+constexpr static uint16_t flagEncrypted = 0x0001;
+// a class file is at most u4 bytes, and DEFLATE expands by at most 1032:1
+constexpr static uint64_t maxEntrySize = UINT32_MAX;
+constexpr static uint64_t maxDeflateRatio = 1032;
+
+constexpr static auto
+errorMessages = std::to_array<std::string_view>({
+    "",
+    "Encrypted entry",
+    "Invalid local header",
+    "Invalid stored entry size",
+    "CRC mismatch",
+    "Unsupported compression method",
+    "Corrupt deflate stream",
+    "Entry too large"
+});
+static_assert(errorMessages.size() == (size_t)ZipEntryError::Count);
+
+
+// ZIP fields are little-endian, unlike the class file itself
+template <typename type>
+static inline type
+readLE(std::span<const uint8_t> bytes, size_t pos) {
+    type value = 0;
+    for (size_t i = 0; i < sizeof(type); i++) {
+        value |= (type)bytes[pos + i] << (8 * i);
+    }
+    return value;
+}
+
+
+static inline bool
+rangeInside(std::span<const uint8_t> bytes, uint64_t pos, uint64_t len) {
+    return (pos <= bytes.size()) && (len <= bytes.size() - pos);
+}
+
+
+// pulls 64-bit sizes/offset out of a zip64 extended information extra field
+static bool
+applyZip64Extra(std::span<const uint8_t> extra, ZipEntry &entry) {
+    size_t pos = 0;
+    while (pos + 4 <= extra.size()) {
+        auto id = readLE<uint16_t>(extra, pos);
+        auto size = readLE<uint16_t>(extra, pos + 2);
+        pos += 4;
+        if (pos + size > extra.size()) {
+            return false;
+        }
+        if (id == 0x0001) {
+            size_t field = pos;
+            auto take = [&](uint64_t &dst) {
+                if (dst != 0xffffffff) {
+                    return true;
+                }
+                if (field + 8 > pos + size) {
+                    return false;
+                }
+                dst = readLE<uint64_t>(extra, field);
+                field += 8;
+                return true;
+            };
+            return take(entry.uncompressedSize) && take(entry.compressedSize) && take(entry.localHeaderOffset);
+        }
+        pos += size;
+    }
+    return true;
+}
+
+
+bool
+ZipArchive::parseCentralDirectory() {
+    auto bytes = m_file.bytes();
+    if (bytes.size() < endOfCentralDirSize) {
+        m_result = m_path.string() + ": Not a ZIP archive";
+        return true;
+    }
+
+    // the end record sits before an archive comment of at most 64 KiB
+    size_t lowest = (bytes.size() > endOfCentralDirSize + 0xffff) ? bytes.size() - endOfCentralDirSize - 0xffff : 0;
+    size_t eocd = bytes.size() - endOfCentralDirSize;
+    while (readLE<uint32_t>(bytes, eocd) != endOfCentralDirSignature) {
+        if (eocd == lowest) {
+            m_result = m_path.string() + ": Not a ZIP archive";
+            return true;
+        }
+        eocd--;
+    }
+
+    uint64_t entryCount = readLE<uint16_t>(bytes, eocd + 10);
+    uint64_t dirSize = readLE<uint32_t>(bytes, eocd + 12);
+    uint64_t dirOffset = readLE<uint32_t>(bytes, eocd + 16);
+
+    if ((eocd >= zip64LocatorSize) && (readLE<uint32_t>(bytes, eocd - zip64LocatorSize) == zip64LocatorSignature)) {
+        auto zip64Eocd = readLE<uint64_t>(bytes, eocd - zip64LocatorSize + 8);
+        if (!rangeInside(bytes, zip64Eocd, zip64EndOfCentralDirSize) ||
+            (readLE<uint32_t>(bytes, zip64Eocd) != zip64EndOfCentralDirSignature)) {
+            m_result = m_path.string() + ": Invalid ZIP64 end of central directory";
+            return true;
+        }
+        entryCount = readLE<uint64_t>(bytes, zip64Eocd + 32);
+        dirSize = readLE<uint64_t>(bytes, zip64Eocd + 40);
+        dirOffset = readLE<uint64_t>(bytes, zip64Eocd + 48);
+    }
+
+    if (!rangeInside(bytes, dirOffset, dirSize)) {
+        m_result = m_path.string() + ": Invalid central directory";
+        return true;
+    }
+
+    m_entries.clear();
+    m_entries.reserve(std::min<uint64_t>(entryCount, dirSize / centralHeaderSize));
+    size_t pos = dirOffset;
+    for (uint64_t i = 0; i < entryCount; i++) {
+        if (!rangeInside(bytes, pos, centralHeaderSize) ||
+            (readLE<uint32_t>(bytes, pos) != centralHeaderSignature)) {
+            m_result = m_path.string() + ": Invalid central directory entry " + std::to_string(i);
+            return true;
+        }
+
+        auto nameLen = readLE<uint16_t>(bytes, pos + 28);
+        auto extraLen = readLE<uint16_t>(bytes, pos + 30);
+        auto commentLen = readLE<uint16_t>(bytes, pos + 32);
+        if (!rangeInside(bytes, pos + centralHeaderSize, (uint64_t)nameLen + extraLen + commentLen)) {
+            m_result = m_path.string() + ": Invalid central directory entry " + std::to_string(i);
+            return true;
+        }
+
+        ZipEntry entry{
+            std::string(reinterpret_cast<const char *>(bytes.data() + pos + centralHeaderSize), nameLen),
+            readLE<uint16_t>(bytes, pos + 8),
+            readLE<uint16_t>(bytes, pos + 10),
+            readLE<uint32_t>(bytes, pos + 16),
+            readLE<uint32_t>(bytes, pos + 20),
+            readLE<uint32_t>(bytes, pos + 24),
+            readLE<uint32_t>(bytes, pos + 42)
+        };
+        if (!applyZip64Extra(bytes.subspan(pos + centralHeaderSize + nameLen, extraLen), entry)) {
+            m_result = m_path.string() + ": Invalid ZIP64 extra field in " + entry.name;
+            return true;
+        }
+
+        m_entries.push_back(std::move(entry));
+        pos += centralHeaderSize + nameLen + extraLen + commentLen;
+    }
+
+    return false;
+}
+
+
+std::string_view
+zipEntryErrorMessage(ZipEntryError error) {
+    return ((size_t)error < errorMessages.size()) ? errorMessages[(size_t)error] : std::string_view();
+}
+
+
+bool
+ZipArchive::open(const std::filesystem::path &path) {
+    m_path = path;
+    m_entries.clear();
+    m_result.clear();
+
+    if (m_file.map(path, false) != MappedFile::Status::Ok) {
+        m_result = m_path.string() + ": Error while opening file";
+        return true;
+    }
+    return parseCentralDirectory();
+}
+
+
+std::span<const uint8_t>
+ZipArchive::rawData(const ZipEntry &entry) const {
+    auto bytes = m_file.bytes();
+    if (!rangeInside(bytes, entry.localHeaderOffset, localHeaderSize) ||
+        (readLE<uint32_t>(bytes, entry.localHeaderOffset) != localHeaderSignature)) {
+        return {};
+    }
+
+    uint64_t dataOffset = entry.localHeaderOffset + localHeaderSize +
+                          readLE<uint16_t>(bytes, entry.localHeaderOffset + 26) +
+                          readLE<uint16_t>(bytes, entry.localHeaderOffset + 28);
+    if (!rangeInside(bytes, dataOffset, entry.compressedSize)) {
+        return {};
+    }
+    return bytes.subspan(dataOffset, entry.compressedSize);
+}
+
+
+std::span<const uint8_t>
+ZipArchive::read(const ZipEntry &entry, std::pmr::vector<uint8_t> &out, ZipEntryError &err) const {
+    err = ZipEntryError::None;
+    if (entry.flags & flagEncrypted) {
+        err = ZipEntryError::Encrypted;
+        return {};
+    }
+
+    auto raw = rawData(entry);
+    if ((raw.data() == nullptr) && (entry.compressedSize != 0)) {
+        err = ZipEntryError::InvalidLocalHeader;
+        return {};
+    }
+
+    if (entry.method == methodStored) {
+        if (raw.size() != entry.uncompressedSize) {
+            err = ZipEntryError::InvalidStoredSize;
+            return {};
+        }
+        if (crc32(raw) != entry.crc32) {
+            err = ZipEntryError::CrcMismatch;
+            return {};
+        }
+        return raw;
+    }
+
+    if (entry.method != methodDeflated) {
+        err = ZipEntryError::UnsupportedMethod;
+        return {};
+    }
+
+    // the sizes come from the central directory: nothing is allocated for what raw cannot inflate to
+    if ((entry.uncompressedSize > maxEntrySize) || (entry.uncompressedSize > maxDeflateRatio * raw.size())) {
+        err = ZipEntryError::TooLarge;
+        return {};
+    }
+    try {
+        out.resize(entry.uncompressedSize);
+    } catch (const std::bad_alloc &) {
+        err = ZipEntryError::TooLarge;
+        return {};
+    }
+    if (!inflateRaw(raw, out)) {
+        err = ZipEntryError::CorruptDeflate;
+        return {};
+    }
+    if (crc32(out) != entry.crc32) {
+        err = ZipEntryError::CrcMismatch;
+        return {};
+    }
+    return out;
+}
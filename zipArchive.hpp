@@ -0,0 +1,86 @@
+#ifndef SJBCDC_ZIPARCHIVE_HPP
+#define SJBCDC_ZIPARCHIVE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mappedFile.hpp"
+
+struct ZipEntry {
+    std::string name;
+    uint16_t flags;
+    uint16_t method;            // 0 stored, 8 deflated
+    uint32_t crc32;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+    uint64_t localHeaderOffset;
+};
+
+// why ZipArchive::read could not produce the bytes of an entry
+enum class ZipEntryError : uint8_t {
+    None,
+    Encrypted,
+    InvalidLocalHeader,
+    InvalidStoredSize,
+    CrcMismatch,
+    UnsupportedMethod,      // ZipEntry::method is neither stored nor deflated
+    CorruptDeflate,
+    TooLarge,               // more than a class file can be or the compressed bytes can inflate to
+    Count
+};
+
+// the message of an error, e.g. "CRC mismatch"; empty for None
+std::string_view
+zipEntryErrorMessage(ZipEntryError error);
+
+/*
+ * Read-only JAR/ZIP archive: the file is mapped once and the central
+ * directory indexed on open(). Entry data is located lazily through the
+ * local headers; stored entries are handed out as spans into the mapping,
+ * deflated ones are inflated with inflateRaw.
+ */
+class ZipArchive {
+private:
+    MappedFile m_file;
+    std::filesystem::path m_path;
+    std::vector<ZipEntry> m_entries;
+    std::string m_result;
+
+    bool
+    parseCentralDirectory();
+
+public:
+    // true on error, with the message in openResult()
+    bool
+    open(const std::filesystem::path &path);
+
+    std::string
+    openResult() const { return m_result; }
+
+    const std::filesystem::path &
+    path() const { return m_path; }
+
+    const std::vector<ZipEntry> &
+    entries() const { return m_entries; }
+
+    // compressed bytes of the entry inside the mapping; empty on a broken local header
+    std::span<const uint8_t>
+    rawData(const ZipEntry &entry) const;
+
+    /*
+     * Uncompressed bytes of the entry. Stored entries come back as a view of
+     * the mapping and leave out untouched; deflated entries are inflated into
+     * out and the returned span views it. Sets err and returns an empty span
+     * on failure, which includes a size larger than the compressed bytes can
+     * inflate to.
+     */
+    std::span<const uint8_t>
+    read(const ZipEntry &entry, std::pmr::vector<uint8_t> &out, ZipEntryError &err) const;
+};
+
+#endif //SJBCDC_ZIPARCHIVE_HPP